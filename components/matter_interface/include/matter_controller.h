@@ -9,6 +9,56 @@
 extern "C" {
 #endif
 
+// Maximum number of attribute paths of a single read request, and of a single subscription. The Matter
+// specification guarantees that every server accepts at least this many paths.
+#define MATTER_MAX_READ_PATHS 9
+#define MATTER_MAX_SUBSCRIBE_PATHS 3
+
+// Values of the fields of `matter_attribute_path_t` matching every endpoint, cluster or attribute.
+#define MATTER_WILDCARD_ENDPOINT 0xFFFF
+#define MATTER_WILDCARD_CLUSTER 0xFFFFFFFF
+#define MATTER_WILDCARD_ATTRIBUTE 0xFFFFFFFF
+
+/**
+ * @brief An attribute path of a multi-path read or subscription. Any field may be a wildcard.
+ */
+typedef struct {
+    uint16_t endpoint_id;
+    uint32_t cluster_id;
+    uint32_t attribute_id;
+} matter_attribute_path_t;
+
+/**
+ * @brief Kind of operation in a command batch.
+ */
+typedef enum {
+    MATTER_BATCH_OP_INVOKE,
+    MATTER_BATCH_OP_READ,
+    MATTER_BATCH_OP_SUBSCRIBE,
+} matter_batch_op_type_t;
+
+/**
+ * @brief A single operation of a command batch.
+ */
+typedef struct matter_batch_op {
+    matter_batch_op_type_t type;
+    // Target node ID.
+    uint64_t node_id;
+    uint16_t endpoint_id;
+    uint32_t cluster_id;
+    // Command ID for MATTER_BATCH_OP_INVOKE, attribute ID otherwise.
+    uint32_t id;
+    // Command data payload as a JSON string (MATTER_BATCH_OP_INVOKE only).
+    const char *command_data;
+    // Reporting intervals in seconds (MATTER_BATCH_OP_SUBSCRIBE only).
+    uint16_t min_interval;
+    uint16_t max_interval;
+    // Subscriber the subscription is held for (MATTER_BATCH_OP_SUBSCRIBE only).
+    int subscriber;
+    // Set by matter_controller_execute_batch to the outcome of the operation.
+    esp_err_t result;
+} matter_batch_op_t;
+
 esp_err_t matter_controller_init(uint64_t node_id, uint64_t fabric_id, uint16_t listen_port,
                                  void (*read_attribute_data_callback)(
                                      uint64_t,
@@ -46,29 +96,159 @@ esp_err_t invoke_cluster_command(uint64_t destination_id, uint16_t endpoint_id,
 /**
  * @brief Send a read request for a specific attribute.
  *
+ * A read of an attribute whose read is already in flight joins it instead of sending another request: the
+ * attribute report of the outstanding read reaches every client, so concurrent reads of a path cost a single
+ * transaction with the node.
+ *
  * @param node_id                     Target node ID.
  * @param endpoint_id                 Endpoint containing the attribute.
  * @param cluster_id                  Cluster ID of the attribute.
  * @param attribute_id                Attribute ID to read.
+ * @param[out] joined                 Set to whether an outstanding read was joined. May be null.
  * @return esp_err_t                  ESP_OK on success, error code otherwise.
  */
-esp_err_t send_read_attr_command(uint64_t node_id, uint16_t endpoint_id, uint32_t cluster_id, uint32_t attribute_id);
+esp_err_t send_read_attr_command(uint64_t node_id, uint16_t endpoint_id, uint32_t cluster_id, uint32_t attribute_id,
+                                 bool *joined);
+
+/**
+ * @brief Read several attributes of a node in a single Interaction Model transaction.
+ *
+ * Every attribute matching a path is reported through the attribute report callback, with its concrete path.
+ * Paths whose read is already in flight join it and are left out of the request, as with
+ * `send_read_attr_command`; nothing is sent if all of them are.
+ *
+ * @param node_id     Target node ID.
+ * @param paths       Attribute paths, wildcards allowed.
+ * @param count       Number of paths, 1 to MATTER_MAX_READ_PATHS.
+ * @param[out] joined Set to the number of paths that joined an outstanding read. May be null.
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if `count` is out of range, error code otherwise.
+ */
+esp_err_t send_read_attrs_command(uint64_t node_id, const matter_attribute_path_t *paths, size_t count,
+                                  size_t *joined);
+
+/**
+ * @brief A subscription of the registry, as returned by `matter_subscription_list`.
+ */
+typedef struct {
+    // Registry handle of the subscription, used to release it.
+    uint32_t handle;
+    uint64_t node_id;
+    matter_attribute_path_t paths[MATTER_MAX_SUBSCRIBE_PATHS];
+    size_t path_count;
+    uint16_t min_interval;
+    uint16_t max_interval;
+    // Whether the node established the subscription; `subscription_id` is only valid once it did.
+    bool established;
+    uint32_t subscription_id;
+    // Times the subscription was sent again after it ended while still in use.
+    uint32_t resubscriptions;
+    size_t subscriber_count;
+} matter_subscription_info_t;
+
+/**
+ * @brief Subscribe to attributes of a node on behalf of a subscriber, sharing an existing subscription.
+ *
+ * Subscriptions are kept in a registry keyed by node and attribute paths. A request matching a live
+ * subscription only adds the subscriber to it, whatever its intervals, so a node carries a single
+ * subscription per path set however many subscribers want it. A subscription is shut down once its last
+ * subscriber released it, and sent again if it ends while still in use.
+ *
+ * @param subscriber    Identifies the holder of the subscription, e.g. a client connection. Acquiring the same
+ *                      subscription twice with one subscriber holds it once.
+ * @param node_id       Target node ID.
+ * @param paths         Attribute paths, wildcards allowed.
+ * @param count         Number of paths, 1 to MATTER_MAX_SUBSCRIBE_PATHS.
+ * @param min_interval  Minimum reporting interval in seconds, if a new subscription is sent.
+ * @param max_interval  Maximum reporting interval in seconds, if a new subscription is sent.
+ * @param[out] handle   Set to the registry handle of the subscription.
+ * @param[out] shared   Set to whether an existing subscription was shared instead of sending a new one.
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if `count` is out of range, ESP_ERR_NO_MEM if the
+ *                   registry or the subscription has no room left, error code otherwise.
+ */
+esp_err_t matter_subscription_acquire(int subscriber, uint64_t node_id, const matter_attribute_path_t *paths,
+                                      size_t count, uint16_t min_interval, uint16_t max_interval, uint32_t *handle,
+                                      bool *shared);
+
+/**
+ * @brief Release a subscription held by a subscriber, shutting it down if nobody else holds it.
+ *
+ * @param subscriber  The subscriber that acquired the subscription.
+ * @param handle      Registry handle of the subscription.
+ * @return esp_err_t ESP_OK on success, ESP_ERR_NOT_FOUND if `subscriber` does not hold the subscription,
+ *                   ESP_ERR_INVALID_STATE if the CHIP stack could not be locked.
+ */
+esp_err_t matter_subscription_release(int subscriber, uint32_t handle);
+
+/**
+ * @brief Release every subscription held by a subscriber, e.g. when its connection closes.
+ *
+ * The release runs on the CHIP task; this function returns without waiting for the CHIP stack lock.
+ *
+ * @param subscriber  The subscriber.
+ * @return esp_err_t ESP_OK if the release was scheduled, error code otherwise.
+ */
+esp_err_t matter_subscription_release_all(int subscriber);
+
+/**
+ * @brief List the subscriptions of the registry.
+ *
+ * @param[out] subscriptions  Receives up to `max` subscriptions.
+ * @param max                 Capacity of `subscriptions`.
+ * @return Number of subscriptions written to `subscriptions`.
+ */
+size_t matter_subscription_list(matter_subscription_info_t *subscriptions, size_t max);
+
+/**
+ * @brief Issue a batch of invoke, read and subscribe operations under a single CHIP stack lock.
+ *
+ * Reads addressed to the same node are merged into multi-path read requests of up to
+ * MATTER_MAX_READ_PATHS paths each, and join reads of the same paths already in flight. Subscriptions
+ * go through the registry, as with `matter_subscription_acquire`. The outcome of every operation is stored
+ * in its `result` field.
+ *
+ * @param ops    Operations to issue, in order.
+ * @param count  Number of operations.
+ * @return esp_err_t ESP_OK if the batch was processed (see the per-operation results),
+ *                   ESP_ERR_INVALID_STATE if the CHIP stack could not be locked.
+ */
+esp_err_t matter_controller_execute_batch(matter_batch_op_t *ops, size_t count);
+
+/**
+ * @brief Time the controller waited for the CHIP stack lock.
+ */
+typedef struct {
+    uint32_t acquisitions;
+    // Attempts that failed to get the lock.
+    uint32_t failures;
+    uint64_t total_wait_us;
+    uint32_t max_wait_us;
+} matter_lock_stats_t;
+
+/**
+ * @brief Get the CHIP stack lock wait statistics of the controller since boot.
+ *
+ * @param[out] stats Filled with the statistics.
+ */
+void matter_controller_get_lock_stats(matter_lock_stats_t *stats);
+
+/**
+ * @brief Attribute reads of the controller.
+ */
+typedef struct {
+    // Read requests sent to nodes.
+    uint32_t requests;
+    // Attribute paths sent in those requests.
+    uint32_t paths_read;
+    // Attribute paths that joined a read already in flight instead of being sent.
+    uint32_t paths_joined;
+} matter_read_stats_t;
 
 /**
- * @brief Subscribe to a specific attribute and receive updates.
+ * @brief Get the attribute read statistics of the controller since boot.
  *
- * @param node_id           Target node ID.
- * @param endpoint_id       Endpoint containing the attribute.
- * @param cluster_id        Cluster ID containing the attribute.
- * @param attribute_id      ID of the attribute to subscribe to.
- * @param min_interval      Minimum reporting interval (in seconds).
- * @param max_interval      Maximum reporting interval (in seconds).
- * @param auto_resubscribe  Automatically resubscribe on connection loss.
- * @return esp_err_t        ESP_OK on success, error code otherwise.
+ * @param[out] stats Filled with the statistics.
  */
-esp_err_t send_subscribe_attr_command(uint64_t node_id, uint16_t endpoint_id, uint32_t cluster_id,
-                                      uint32_t attribute_id, uint16_t min_interval, uint16_t max_interval,
-                                      bool auto_resubscribe);
+void matter_controller_get_read_stats(matter_read_stats_t *stats);
 
 #ifdef __cplusplus
 }
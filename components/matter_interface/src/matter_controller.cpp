@@ -1,7 +1,9 @@
 #include "matter_controller.h"
+#include "sdkconfig.h"
 
 #include <esp_err.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <esp_matter_console.h>
 #include <esp_matter_controller_client.h>
 #include <portmacro.h>
@@ -10,12 +12,39 @@
 #include <esp_matter_controller_read_command.h>
 #include <esp_matter_controller_subscribe_command.h>
 #include <esp_matter_controller_utils.h>
+#include <platform/PlatformManager.h>
+
+#include <cstring>
 
 static const char *TAG = "MATTER_UTIL";
 
 static esp_matter::controller::attribute_report_cb_t attribute_report_cb = nullptr;
 static esp_matter::controller::subscribe_done_cb_t subscribe_done_cb = nullptr;
 
+// Waits for the CHIP stack lock, guarded by lock_stats_mux.
+static matter_lock_stats_t lock_stats = {};
+static portMUX_TYPE lock_stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Locks the CHIP stack and records how long the caller waited for it.
+ */
+static esp_matter::lock::status_t lock_chip_stack() {
+    const int64_t start_us = esp_timer_get_time();
+    const esp_matter::lock::status_t status = esp_matter::lock::chip_stack_lock(portMAX_DELAY);
+    const auto wait_us = static_cast<uint32_t>(esp_timer_get_time() - start_us);
+
+    portENTER_CRITICAL(&lock_stats_mux);
+    if (status == esp_matter::lock::FAILED) {
+        lock_stats.failures++;
+    } else {
+        lock_stats.acquisitions++;
+    }
+    lock_stats.total_wait_us += wait_us;
+    if (wait_us > lock_stats.max_wait_us) lock_stats.max_wait_us = wait_us;
+    portEXIT_CRITICAL(&lock_stats_mux);
+    return status;
+}
+
 esp_err_t matter_controller_init(const uint64_t node_id, const uint64_t fabric_id, const uint16_t listen_port,
                                  void (*read_attribute_data_callback)(
                                      uint64_t,
@@ -23,7 +52,7 @@ esp_err_t matter_controller_init(const uint64_t node_id, const uint64_t fabric_i
                                      chip::TLV::TLVReader *),
                                 void (*subscribe_done_callback)(uint64_t remote_node_id, uint32_t subscription_id)
                                 ) {
-    if (!read_attribute_data_callback || !subscribe_done_cb) {
+    if (!read_attribute_data_callback || !subscribe_done_callback) {
         ESP_LOGE(TAG, "Invalid read attribute callback");
         return ESP_ERR_INVALID_ARG;
     }
@@ -34,7 +63,7 @@ esp_err_t matter_controller_init(const uint64_t node_id, const uint64_t fabric_i
     esp_err_t err = ESP_OK;
 
     ESP_LOGI(TAG, "Initializing Matter controller client");
-    esp_matter::lock::chip_stack_lock(portMAX_DELAY);
+    lock_chip_stack();
 
     err = esp_matter::controller::matter_controller_client::get_instance().init(node_id, fabric_id, listen_port);
     if (err != ESP_OK) {
@@ -69,23 +98,12 @@ esp_err_t pairing_ble_thread(const uint64_t node_id, const uint32_t pin, const u
     return esp_matter::controller::pairing_ble_thread(node_id, pin, discriminator, dataset_tlvs, dataset_len);
 }
 
-esp_err_t invoke_cluster_command(const uint64_t destination_id, const uint16_t endpoint_id, const uint32_t cluster_id,
-                                 const uint32_t command_id, const char *command_data_field) {
-    if (!command_data_field) {
-        ESP_LOGE(TAG, "Invalid command data field");
-        return ESP_ERR_INVALID_ARG;
-    }
-
-    ESP_LOGI(TAG, "Sending cluster invoke command");
-
-    // Lock the CHIP stack for thread-safe access
-    esp_matter::lock::status_t lock_status = esp_matter::lock::chip_stack_lock(portMAX_DELAY);
-    if (lock_status != esp_matter::lock::SUCCESS) {
-        ESP_LOGE(TAG, "Failed to lock Chip stack");
-        return ESP_ERR_INVALID_STATE;
-    }
-
-    // Send the command
+/**
+ * Sends a cluster invoke command. The CHIP stack lock must be held by the caller.
+ */
+static esp_err_t invoke_cluster_command_locked(const uint64_t destination_id, const uint16_t endpoint_id,
+                                               const uint32_t cluster_id, const uint32_t command_id,
+                                               const char *command_data_field) {
     esp_err_t err = esp_matter::controller::send_invoke_cluster_command(destination_id, endpoint_id, cluster_id,
                                                                         command_id, command_data_field);
     if (err != ESP_OK) {
@@ -93,58 +111,92 @@ esp_err_t invoke_cluster_command(const uint64_t destination_id, const uint16_t e
     } else {
         ESP_LOGI(TAG, "Cluster invoke command sent successfully");
     }
-
-    // Unlock the CHIP stack
-    esp_matter::lock::chip_stack_unlock();
-
     return err;
 }
 
-esp_err_t send_subscribe_attr_command(uint64_t node_id, const uint16_t endpoint_id, const uint32_t cluster_id,
-                                      const uint32_t attribute_id, uint16_t min_interval, uint16_t max_interval,
-                                      bool auto_resubscribe) {
-
-    // Allocate memory for attribute path
-    ScopedMemoryBufferWithSize<AttributePathParams> attr_paths;
-    attr_paths.Alloc(1);
+/**
+ * Allocates the attribute path array of a read or subscribe command. Wildcard fields of `paths` carry the
+ * invalid IDs, which is how AttributePathParams marks a wildcard, so they are copied as they are.
+ */
+static esp_err_t alloc_attribute_paths(const matter_attribute_path_t *paths, const size_t count,
+                                       ScopedMemoryBufferWithSize<AttributePathParams> &attr_paths) {
+    attr_paths.Alloc(count);
     if (!attr_paths.Get()) {
         ESP_LOGE(TAG, "Failed to alloc memory for attribute paths");
         return ESP_ERR_NO_MEM;
     }
-    attr_paths[0] = AttributePathParams(endpoint_id, cluster_id, attribute_id);
+    for (size_t i = 0; i < count; ++i) {
+        attr_paths[i] = AttributePathParams(paths[i].endpoint_id, paths[i].cluster_id, paths[i].attribute_id);
+    }
+    return ESP_OK;
+}
+
+static void on_subscription_established(uint32_t handle, uint32_t subscription_id);
+static void on_subscription_ended(uint32_t handle);
+
+/**
+ * A subscription sent on behalf of the registry. It reports to the registry under its handle when the node
+ * establishes it, which the done callback of `subscribe_command` does not: that one only runs once the
+ * subscription has ended.
+ */
+class registry_subscribe_command : public esp_matter::controller::subscribe_command {
+public:
+    registry_subscribe_command(const uint32_t handle, const uint64_t node_id,
+                               ScopedMemoryBufferWithSize<AttributePathParams> &&attr_paths,
+                               ScopedMemoryBufferWithSize<EventPathParams> &&event_paths,
+                               const uint16_t min_interval, const uint16_t max_interval)
+        : subscribe_command(node_id, std::move(attr_paths), std::move(event_paths), min_interval, max_interval, true,
+                            attribute_report_cb, nullptr, subscribe_done_cb, on_failure),
+          handle(handle) {}
+
+    // Runs again with a new ID every time the subscription is re-established after dropping.
+    void OnSubscriptionEstablished(chip::SubscriptionId subscription_id) override {
+        subscribe_command::OnSubscriptionEstablished(subscription_id);
+        on_subscription_established(handle, subscription_id);
+    }
+
+    void OnDone(chip::app::ReadClient *client) override {
+        // The base class deletes the command
+        const uint32_t ended = handle;
+        subscribe_command::OnDone(client);
+        on_subscription_ended(ended);
+    }
+
+private:
+    // Called instead of the done callback when the node could not be reached; the command is deleted next.
+    static void on_failure(void *command) {
+        on_subscription_ended(static_cast<registry_subscribe_command *>(command)->handle);
+    }
+
+    const uint32_t handle;
+};
+
+/**
+ * Creates and sends the subscription of a registry entry for the given attribute paths, resubscribing
+ * automatically when it drops. The CHIP stack lock must be held by the caller.
+ */
+static esp_err_t send_subscribe_command_locked(uint32_t handle, uint64_t node_id,
+                                               const matter_attribute_path_t *paths, const size_t count,
+                                               uint16_t min_interval, uint16_t max_interval) {
+    ScopedMemoryBufferWithSize<AttributePathParams> attr_paths;
+    esp_err_t err = alloc_attribute_paths(paths, count, attr_paths);
+    if (err != ESP_OK) return err;
 
     // Empty event path array (not subscribing to events)
     ScopedMemoryBufferWithSize<EventPathParams> event_paths;
     event_paths.Alloc(0);
 
-    // Lock CHIP stack before creating command
-    esp_matter::lock::status_t lock_status = esp_matter::lock::chip_stack_lock(portMAX_DELAY);
-    if (lock_status != esp_matter::lock::SUCCESS) {
-        ESP_LOGE(TAG, "Failed to lock Chip stack");
-        return ESP_ERR_INVALID_STATE;
-    }
-
     // Create and initialize the subscription command
-    auto *cmd = chip::Platform::New<esp_matter::controller::subscribe_command>(
-        node_id,
-        std::move(attr_paths),
-        std::move(event_paths),
-        min_interval,
-        max_interval,
-        auto_resubscribe,
-        attribute_report_cb,
-        nullptr,
-        subscribe_done_cb,
-        nullptr
-    );
+    auto *cmd = chip::Platform::New<registry_subscribe_command>(handle, node_id, std::move(attr_paths),
+                                                                std::move(event_paths), min_interval,
+                                                                max_interval);
     if (!cmd) {
         ESP_LOGE(TAG, "Failed to alloc memory for subscribe_command");
-        esp_matter::lock::chip_stack_unlock();
         return ESP_ERR_NO_MEM;
     }
 
     // Send the subscription command
-    esp_err_t err = cmd->send_command();
+    err = cmd->send_command();
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to send subscribe attr command: %s", esp_err_to_name(err));
         chip::Platform::Delete(cmd);
@@ -152,39 +204,87 @@ esp_err_t send_subscribe_attr_command(uint64_t node_id, const uint16_t endpoint_
         ESP_LOGI(TAG, "Subscribe attr command sent successfully");
     }
 
-    // Unlock the CHIP stack
-    esp_matter::lock::chip_stack_unlock();
-
     return err;
 }
 
-esp_err_t send_read_attr_command(uint64_t node_id, const uint16_t endpoint_id, const uint32_t cluster_id,
-                                 const uint32_t attribute_id) {
+// An attribute path whose read is in flight. Reads of the same path join it until it is done.
+struct in_flight_read_t {
+    bool used;
+    uint64_t node_id;
+    matter_attribute_path_t path;
+    int64_t sent_us;
+};
 
-    // Allocate memory for an attribute path
-    ScopedMemoryBufferWithSize<AttributePathParams> attr_paths;
-    attr_paths.Alloc(1);
-    if (!attr_paths.Get()) {
-        ESP_LOGE(TAG, "Failed to alloc memory for attribute paths");
-        return ESP_ERR_NO_MEM;
+// Guarded by the CHIP stack lock, like the subscription registry: read callbacks run on the CHIP task.
+static in_flight_read_t in_flight_reads[CONFIG_MATTER_MAX_IN_FLIGHT_READS];
+
+// Reads sent and joined, guarded by lock_stats_mux.
+static matter_read_stats_t read_stats = {};
+
+static bool same_path(const matter_attribute_path_t &a, const matter_attribute_path_t &b) {
+    return a.endpoint_id == b.endpoint_id && a.cluster_id == b.cluster_id && a.attribute_id == b.attribute_id;
+}
+
+/**
+ * Finds the in-flight read of a path. Reads older than CONFIG_MATTER_READ_COALESCE_TIMEOUT_MS are dropped
+ * on the way: the read command does not report a node it could not reach, so such entries would never be
+ * cleared otherwise. The CHIP stack lock must be held by the caller.
+ */
+static in_flight_read_t *find_in_flight_read_locked(const uint64_t node_id, const matter_attribute_path_t &path,
+                                                    const int64_t now_us) {
+    in_flight_read_t *found = nullptr;
+    for (auto &read: in_flight_reads) {
+        if (!read.used) continue;
+        if (now_us - read.sent_us > static_cast<int64_t>(CONFIG_MATTER_READ_COALESCE_TIMEOUT_MS) * 1000) {
+            read.used = false;
+        } else if (read.node_id == node_id && same_path(read.path, path)) {
+            found = &read;
+        }
+    }
+    return found;
+}
+
+/**
+ * Records that a path is being read. Left untracked if every entry is in use, in which case later reads of
+ * the path are sent on their own. The CHIP stack lock must be held by the caller.
+ */
+static void track_read_locked(const uint64_t node_id, const matter_attribute_path_t &path, const int64_t now_us) {
+    for (auto &read: in_flight_reads) {
+        if (read.used) continue;
+        read = {true, node_id, path, now_us};
+        return;
     }
-    attr_paths[0] = AttributePathParams(endpoint_id, cluster_id, attribute_id);
+    ESP_LOGW(TAG, "No room to track in-flight read, it will not be shared");
+}
+
+/**
+ * Called on the CHIP task when a read is done, whether or not it succeeded, to stop joining its paths.
+ */
+static void on_read_done(const uint64_t node_id, const ScopedMemoryBufferWithSize<AttributePathParams> &attr_paths,
+                         const ScopedMemoryBufferWithSize<EventPathParams> &) {
+    for (size_t i = 0; i < attr_paths.AllocatedSize(); ++i) {
+        const matter_attribute_path_t path = {attr_paths[i].mEndpointId, attr_paths[i].mClusterId,
+                                              attr_paths[i].mAttributeId};
+        for (auto &read: in_flight_reads) {
+            if (read.used && read.node_id == node_id && same_path(read.path, path)) read.used = false;
+        }
+    }
+}
 
+/**
+ * Creates and sends a read request for the given attribute paths as a single Interaction Model
+ * transaction. The CHIP stack lock must be held by the caller.
+ */
+static esp_err_t send_read_command_locked(uint64_t node_id, ScopedMemoryBufferWithSize<AttributePathParams> &&attr_paths) {
     // Empty event path array (not reading events)
     ScopedMemoryBufferWithSize<EventPathParams> event_paths;
     event_paths.Alloc(0);
 
-    // Lock CHIP stack
-    if (esp_matter::lock::chip_stack_lock(portMAX_DELAY) != esp_matter::lock::SUCCESS) {
-        ESP_LOGE(TAG, "Failed to lock CHIP stack");
-        return ESP_ERR_INVALID_STATE;
-    }
-
     // Create and initialize the read command
     esp_err_t err = ESP_OK;
     auto *cmd = chip::Platform::New<esp_matter::controller::read_command>(
         node_id, std::move(attr_paths), std::move(event_paths),
-        attribute_report_cb, nullptr, nullptr);
+        attribute_report_cb, nullptr, on_read_done);
     if (!cmd) {
         ESP_LOGE(TAG, "Failed to alloc memory for read_command");
         err = ESP_ERR_NO_MEM;
@@ -196,8 +296,517 @@ esp_err_t send_read_attr_command(uint64_t node_id, const uint16_t endpoint_id, c
         }
     }
 
+    return err;
+}
+
+/**
+ * Reads attribute paths of a node in one request, leaving out the paths whose read is already in flight, or
+ * that appear twice: their report reaches every client of the outstanding read. No request is sent if all
+ * of them are. The CHIP stack lock must be held by the caller.
+ *
+ * @param[out] joined Set to the number of paths that joined an outstanding read. May be null.
+ */
+static esp_err_t send_shared_read_locked(const uint64_t node_id, const matter_attribute_path_t *paths,
+                                         const size_t count, size_t *joined) {
+    const int64_t now_us = esp_timer_get_time();
+    matter_attribute_path_t to_send[MATTER_MAX_READ_PATHS];
+    size_t send_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        bool duplicate = find_in_flight_read_locked(node_id, paths[i], now_us) != nullptr;
+        for (size_t j = 0; j < send_count && !duplicate; ++j) {
+            duplicate = same_path(to_send[j], paths[i]);
+        }
+        if (!duplicate) to_send[send_count++] = paths[i];
+    }
+    if (joined) *joined = count - send_count;
+
+    esp_err_t err = ESP_OK;
+    if (send_count > 0) {
+        ScopedMemoryBufferWithSize<AttributePathParams> attr_paths;
+        err = alloc_attribute_paths(to_send, send_count, attr_paths);
+        if (err == ESP_OK) err = send_read_command_locked(node_id, std::move(attr_paths));
+        if (err == ESP_OK) {
+            for (size_t i = 0; i < send_count; ++i) {
+                track_read_locked(node_id, to_send[i], now_us);
+            }
+        }
+    } else {
+        ESP_LOGI(TAG, "Joined the in-flight read of %zu attribute paths of node 0x%" PRIX64, count, node_id);
+    }
+
+    portENTER_CRITICAL(&lock_stats_mux);
+    if (err == ESP_OK) {
+        read_stats.paths_read += send_count;
+        read_stats.paths_joined += count - send_count;
+        if (send_count > 0) read_stats.requests++;
+    }
+    portEXIT_CRITICAL(&lock_stats_mux);
+    return err;
+}
+
+esp_err_t invoke_cluster_command(const uint64_t destination_id, const uint16_t endpoint_id, const uint32_t cluster_id,
+                                 const uint32_t command_id, const char *command_data_field) {
+    if (!command_data_field) {
+        ESP_LOGE(TAG, "Invalid command data field");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ESP_LOGI(TAG, "Sending cluster invoke command");
+
+    // Lock the CHIP stack for thread-safe access
+    esp_matter::lock::status_t lock_status = lock_chip_stack();
+    if (lock_status != esp_matter::lock::SUCCESS) {
+        ESP_LOGE(TAG, "Failed to lock Chip stack");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Send the command
+    esp_err_t err = invoke_cluster_command_locked(destination_id, endpoint_id, cluster_id, command_id,
+                                                  command_data_field);
+
+    // Unlock the CHIP stack
+    esp_matter::lock::chip_stack_unlock();
+
+    return err;
+}
+
+esp_err_t send_read_attr_command(uint64_t node_id, const uint16_t endpoint_id, const uint32_t cluster_id,
+                                 const uint32_t attribute_id, bool *joined) {
+    const matter_attribute_path_t path = {endpoint_id, cluster_id, attribute_id};
+
+    // Lock CHIP stack
+    if (lock_chip_stack() != esp_matter::lock::SUCCESS) {
+        ESP_LOGE(TAG, "Failed to lock CHIP stack");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    size_t joined_count = 0;
+    esp_err_t err = send_shared_read_locked(node_id, &path, 1, &joined_count);
+
     // Unlock the CHIP stack
     esp_matter::lock::chip_stack_unlock();
 
+    if (joined) *joined = joined_count > 0;
     return err;
 }
+
+esp_err_t send_read_attrs_command(uint64_t node_id, const matter_attribute_path_t *paths, const size_t count,
+                                  size_t *joined) {
+    if (!paths || count == 0 || count > MATTER_MAX_READ_PATHS) {
+        ESP_LOGE(TAG, "Invalid attribute paths");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (lock_chip_stack() != esp_matter::lock::SUCCESS) {
+        ESP_LOGE(TAG, "Failed to lock CHIP stack");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    ESP_LOGI(TAG, "Reading %zu attribute paths from node 0x%" PRIX64, count, node_id);
+    esp_err_t err = send_shared_read_locked(node_id, paths, count, joined);
+
+    esp_matter::lock::chip_stack_unlock();
+
+    return err;
+}
+
+enum subscription_state_t : uint8_t {
+    SUBSCRIPTION_FREE,
+    // Sent, waiting for the node to establish it.
+    SUBSCRIPTION_PENDING,
+    SUBSCRIPTION_ACTIVE,
+    // Held by nobody, waiting for the subscription to end. It is shut down as soon as its ID is known. The
+    // entry is not reused before it ends, so that the node never keeps a subscription the registry lost.
+    SUBSCRIPTION_CLOSING,
+};
+
+struct subscription_t {
+    subscription_state_t state;
+    uint32_t handle;
+    uint64_t node_id;
+    matter_attribute_path_t paths[MATTER_MAX_SUBSCRIBE_PATHS];
+    size_t path_count;
+    uint16_t min_interval;
+    uint16_t max_interval;
+    // Valid once the subscription was established; 0 before.
+    uint32_t subscription_id;
+    uint32_t resubscriptions;
+    size_t subscriber_count;
+    int subscribers[CONFIG_MATTER_SUBSCRIPTION_MAX_SUBSCRIBERS];
+};
+
+// Registry of the subscriptions of the controller. Guarded by the CHIP stack lock: commands lock the stack,
+// and subscription callbacks and scheduled work run on the CHIP task, which holds it.
+static subscription_t subscriptions[CONFIG_MATTER_MAX_SUBSCRIPTIONS];
+static uint32_t next_subscription_handle = 1;
+
+static bool same_paths(const subscription_t &subscription, const uint64_t node_id,
+                       const matter_attribute_path_t *paths, const size_t count) {
+    if (subscription.node_id != node_id || subscription.path_count != count) return false;
+    for (size_t i = 0; i < count; ++i) {
+        const matter_attribute_path_t &a = subscription.paths[i];
+        if (a.endpoint_id != paths[i].endpoint_id || a.cluster_id != paths[i].cluster_id ||
+            a.attribute_id != paths[i].attribute_id) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool is_live(const subscription_t &subscription) {
+    return subscription.state == SUBSCRIPTION_PENDING || subscription.state == SUBSCRIPTION_ACTIVE;
+}
+
+static subscription_t *find_subscription(const uint32_t handle) {
+    for (auto &subscription: subscriptions) {
+        if (is_live(subscription) && subscription.handle == handle) return &subscription;
+    }
+    return nullptr;
+}
+
+/**
+ * Finds the entry a subscription command reports to, whatever its state.
+ */
+static subscription_t *find_subscription_entry(const uint32_t handle) {
+    for (auto &subscription: subscriptions) {
+        if (subscription.state != SUBSCRIPTION_FREE && subscription.handle == handle) return &subscription;
+    }
+    return nullptr;
+}
+
+/**
+ * Sends the subscription of an entry and marks it pending. The CHIP stack lock must be held by the caller.
+ */
+static esp_err_t send_subscription_locked(subscription_t &subscription) {
+    esp_err_t err = send_subscribe_command_locked(subscription.handle, subscription.node_id, subscription.paths,
+                                                  subscription.path_count, subscription.min_interval,
+                                                  subscription.max_interval);
+    if (err != ESP_OK) return err;
+    subscription.state = SUBSCRIPTION_PENDING;
+    subscription.subscription_id = 0;
+    return ESP_OK;
+}
+
+/**
+ * Shuts down the established subscription of an entry nobody holds any more. The subscription usually ends
+ * within the call, which frees the entry; the entry is also freed if the subscription cannot be shut down,
+ * so it never blocks the registry. Must not be called from a callback of the subscription itself. The CHIP
+ * stack lock must be held by the caller.
+ */
+static void shutdown_subscription_locked(subscription_t &subscription) {
+    ESP_LOGI(TAG, "Shutting down subscription 0x%" PRIX32 " of node 0x%" PRIX64, subscription.subscription_id,
+             subscription.node_id);
+    // Closing the subscription ends it synchronously, so the entry must be closing before
+    subscription.state = SUBSCRIPTION_CLOSING;
+    esp_err_t err = esp_matter::controller::send_shutdown_subscription(subscription.node_id,
+                                                                       subscription.subscription_id);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to shut down subscription: %s", esp_err_to_name(err));
+        subscription.state = SUBSCRIPTION_FREE;
+    }
+}
+
+/**
+ * Shuts down the subscription of a closing entry once it was established. Scheduled on the CHIP task, as
+ * the subscription cannot be closed from within its own callbacks.
+ */
+static void shutdown_closing_subscription(const intptr_t handle) {
+    for (auto &subscription: subscriptions) {
+        if (subscription.state == SUBSCRIPTION_CLOSING && subscription.handle == static_cast<uint32_t>(handle) &&
+            subscription.subscription_id != 0) {
+            shutdown_subscription_locked(subscription);
+        }
+    }
+}
+
+/**
+ * Removes a subscriber from an entry, shutting its subscription down once nobody holds it. A pending
+ * subscription is marked closing, and shut down as soon as the node establishes it. The CHIP stack lock must
+ * be held by the caller.
+ *
+ * @return true if `subscriber` held the subscription.
+ */
+static bool release_subscriber_locked(subscription_t &subscription, const int subscriber) {
+    for (size_t i = 0; i < subscription.subscriber_count; ++i) {
+        if (subscription.subscribers[i] != subscriber) continue;
+        subscription.subscribers[i] = subscription.subscribers[--subscription.subscriber_count];
+        if (subscription.subscriber_count == 0) {
+            if (subscription.state == SUBSCRIPTION_ACTIVE) {
+                shutdown_subscription_locked(subscription);
+            } else {
+                subscription.state = SUBSCRIPTION_CLOSING;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Adds a subscriber to the live subscription of the given paths, sending a new subscription if there is
+ * none. The CHIP stack lock must be held by the caller.
+ */
+static esp_err_t acquire_subscription_locked(const int subscriber, const uint64_t node_id,
+                                             const matter_attribute_path_t *paths, const size_t count,
+                                             const uint16_t min_interval, const uint16_t max_interval,
+                                             uint32_t *handle, bool *shared) {
+    if (!paths || count == 0 || count > MATTER_MAX_SUBSCRIBE_PATHS) return ESP_ERR_INVALID_ARG;
+
+    subscription_t *subscription = nullptr;
+    for (auto &candidate: subscriptions) {
+        if (is_live(candidate) && same_paths(candidate, node_id, paths, count)) {
+            subscription = &candidate;
+            break;
+        }
+    }
+
+    if (subscription) {
+        bool held = false;
+        for (size_t i = 0; i < subscription->subscriber_count && !held; ++i) {
+            held = subscription->subscribers[i] == subscriber;
+        }
+        if (!held) {
+            if (subscription->subscriber_count == CONFIG_MATTER_SUBSCRIPTION_MAX_SUBSCRIBERS) return ESP_ERR_NO_MEM;
+            subscription->subscribers[subscription->subscriber_count++] = subscriber;
+        }
+        ESP_LOGI(TAG, "Sharing subscription %" PRIu32 " of node 0x%" PRIX64 " with %zu subscribers",
+                 subscription->handle, node_id, subscription->subscriber_count);
+        if (handle) *handle = subscription->handle;
+        if (shared) *shared = true;
+        return ESP_OK;
+    }
+
+    for (auto &candidate: subscriptions) {
+        if (candidate.state == SUBSCRIPTION_FREE) {
+            subscription = &candidate;
+            break;
+        }
+    }
+    if (!subscription) {
+        ESP_LOGW(TAG, "No room for another subscription (limit %d)", CONFIG_MATTER_MAX_SUBSCRIPTIONS);
+        return ESP_ERR_NO_MEM;
+    }
+
+    subscription_t entry = {};
+    entry.handle = next_subscription_handle++;
+    entry.node_id = node_id;
+    memcpy(entry.paths, paths, count * sizeof(paths[0]));
+    entry.path_count = count;
+    entry.min_interval = min_interval;
+    entry.max_interval = max_interval;
+    entry.subscribers[0] = subscriber;
+    entry.subscriber_count = 1;
+    ESP_LOGI(TAG, "Subscribing to %zu attribute paths of node 0x%" PRIX64, count, node_id);
+    esp_err_t err = send_subscription_locked(entry);
+    if (err != ESP_OK) return err;
+
+    *subscription = entry;
+    if (handle) *handle = entry.handle;
+    if (shared) *shared = false;
+    return ESP_OK;
+}
+
+/**
+ * Records the ID of a subscription the node established, or re-established after it dropped. A subscription
+ * released while it was pending is shut down now that it can be, right after the callback returns. Runs on
+ * the CHIP task.
+ */
+static void on_subscription_established(const uint32_t handle, const uint32_t subscription_id) {
+    subscription_t *subscription = find_subscription_entry(handle);
+    if (!subscription) return;
+
+    ESP_LOGI(TAG, "Subscription %" PRIu32 " of node 0x%" PRIX64 " established with ID 0x%" PRIX32, handle,
+             subscription->node_id, subscription_id);
+    subscription->subscription_id = subscription_id;
+    if (subscription->state == SUBSCRIPTION_CLOSING) {
+        CHIP_ERROR err = chip::DeviceLayer::PlatformMgr().ScheduleWork(shutdown_closing_subscription,
+                                                                       static_cast<intptr_t>(handle));
+        if (err != CHIP_NO_ERROR) ESP_LOGE(TAG, "Failed to schedule the shutdown of subscription %" PRIu32, handle);
+    } else {
+        subscription->state = SUBSCRIPTION_ACTIVE;
+    }
+}
+
+/**
+ * Frees the entry of a subscription that ended, or could not be sent because the node was unreachable. An
+ * established subscription that is still held is sent again; one that never got established is not, so an
+ * unreachable node or one refusing the subscription does not keep the entry busy. Runs on the CHIP task.
+ */
+static void on_subscription_ended(const uint32_t handle) {
+    subscription_t *subscription = find_subscription_entry(handle);
+    if (!subscription) return;
+
+    if (subscription->state == SUBSCRIPTION_ACTIVE && subscription->subscriber_count > 0) {
+        ESP_LOGW(TAG, "Subscription 0x%" PRIX32 " of node 0x%" PRIX64 " ended, subscribing again",
+                 subscription->subscription_id, subscription->node_id);
+        subscription->resubscriptions++;
+        if (send_subscription_locked(*subscription) == ESP_OK) return;
+    } else if (subscription->state == SUBSCRIPTION_PENDING) {
+        ESP_LOGW(TAG, "Subscription %" PRIu32 " of node 0x%" PRIX64 " could not be established", handle,
+                 subscription->node_id);
+    }
+    subscription->state = SUBSCRIPTION_FREE;
+}
+
+esp_err_t matter_subscription_acquire(const int subscriber, const uint64_t node_id,
+                                      const matter_attribute_path_t *paths, const size_t count,
+                                      const uint16_t min_interval, const uint16_t max_interval, uint32_t *handle,
+                                      bool *shared) {
+    if (!paths || count == 0 || count > MATTER_MAX_SUBSCRIBE_PATHS) {
+        ESP_LOGE(TAG, "Invalid attribute paths");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (lock_chip_stack() != esp_matter::lock::SUCCESS) {
+        ESP_LOGE(TAG, "Failed to lock CHIP stack");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = acquire_subscription_locked(subscriber, node_id, paths, count, min_interval, max_interval,
+                                                handle, shared);
+
+    esp_matter::lock::chip_stack_unlock();
+
+    return err;
+}
+
+esp_err_t matter_subscription_release(const int subscriber, const uint32_t handle) {
+    if (lock_chip_stack() != esp_matter::lock::SUCCESS) {
+        ESP_LOGE(TAG, "Failed to lock CHIP stack");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    subscription_t *subscription = find_subscription(handle);
+    esp_err_t err = subscription && release_subscriber_locked(*subscription, subscriber) ? ESP_OK : ESP_ERR_NOT_FOUND;
+
+    esp_matter::lock::chip_stack_unlock();
+
+    return err;
+}
+
+esp_err_t matter_subscription_release_all(const int subscriber) {
+    CHIP_ERROR err = chip::DeviceLayer::PlatformMgr().ScheduleWork([](const intptr_t arg) {
+        for (auto &subscription: subscriptions) {
+            if (is_live(subscription)) release_subscriber_locked(subscription, static_cast<int>(arg));
+        }
+    }, static_cast<intptr_t>(subscriber));
+    return err == CHIP_NO_ERROR ? ESP_OK : ESP_FAIL;
+}
+
+size_t matter_subscription_list(matter_subscription_info_t *list, const size_t max) {
+    if (lock_chip_stack() != esp_matter::lock::SUCCESS) {
+        ESP_LOGE(TAG, "Failed to lock CHIP stack");
+        return 0;
+    }
+
+    size_t count = 0;
+    for (const auto &subscription: subscriptions) {
+        if (count == max) break;
+        if (!is_live(subscription)) continue;
+        matter_subscription_info_t &info = list[count++];
+        info.handle = subscription.handle;
+        info.node_id = subscription.node_id;
+        memcpy(info.paths, subscription.paths, sizeof(info.paths));
+        info.path_count = subscription.path_count;
+        info.min_interval = subscription.min_interval;
+        info.max_interval = subscription.max_interval;
+        info.established = subscription.state == SUBSCRIPTION_ACTIVE;
+        info.subscription_id = subscription.subscription_id;
+        info.resubscriptions = subscription.resubscriptions;
+        info.subscriber_count = subscription.subscriber_count;
+    }
+
+    esp_matter::lock::chip_stack_unlock();
+
+    return count;
+}
+
+/**
+ * Sends all pending read operations for the node of `ops[first]`, starting at `first`, as one read request
+ * of at most MATTER_MAX_READ_PATHS paths. The CHIP stack lock must be held by the caller.
+ */
+static void send_batched_reads_locked(matter_batch_op_t *ops, const size_t count, const size_t first) {
+    const uint64_t node_id = ops[first].node_id;
+
+    // Collect the pending reads addressed to the same node
+    size_t members[MATTER_MAX_READ_PATHS];
+    size_t member_count = 0;
+    for (size_t i = first; i < count && member_count < MATTER_MAX_READ_PATHS; ++i) {
+        if (ops[i].type == MATTER_BATCH_OP_READ && ops[i].node_id == node_id &&
+            ops[i].result == ESP_ERR_NOT_FINISHED) {
+            members[member_count++] = i;
+        }
+    }
+
+    matter_attribute_path_t paths[MATTER_MAX_READ_PATHS];
+    for (size_t i = 0; i < member_count; ++i) {
+        const matter_batch_op_t &op = ops[members[i]];
+        paths[i] = {op.endpoint_id, op.cluster_id, op.id};
+    }
+    ESP_LOGI(TAG, "Reading %zu attribute paths from node 0x%" PRIX64 " in one request", member_count, node_id);
+    const esp_err_t err = send_shared_read_locked(node_id, paths, member_count, nullptr);
+
+    for (size_t i = 0; i < member_count; ++i) {
+        ops[members[i]].result = err;
+    }
+}
+
+esp_err_t matter_controller_execute_batch(matter_batch_op_t *ops, const size_t count) {
+    if (!ops && count > 0) return ESP_ERR_INVALID_ARG;
+
+    for (size_t i = 0; i < count; ++i) {
+        ops[i].result = ESP_ERR_NOT_FINISHED;
+    }
+
+    // Lock the CHIP stack once for the whole batch
+    if (lock_chip_stack() != esp_matter::lock::SUCCESS) {
+        ESP_LOGE(TAG, "Failed to lock CHIP stack");
+        for (size_t i = 0; i < count; ++i) {
+            ops[i].result = ESP_ERR_INVALID_STATE;
+        }
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        matter_batch_op_t &op = ops[i];
+        if (op.result != ESP_ERR_NOT_FINISHED) continue; // already sent as part of a merged read
+
+        switch (op.type) {
+            case MATTER_BATCH_OP_INVOKE:
+                op.result = op.command_data
+                                ? invoke_cluster_command_locked(op.node_id, op.endpoint_id, op.cluster_id, op.id,
+                                                                op.command_data)
+                                : ESP_ERR_INVALID_ARG;
+                break;
+            case MATTER_BATCH_OP_READ:
+                send_batched_reads_locked(ops, count, i);
+                break;
+            case MATTER_BATCH_OP_SUBSCRIBE: {
+                const matter_attribute_path_t path = {op.endpoint_id, op.cluster_id, op.id};
+                op.result = acquire_subscription_locked(op.subscriber, op.node_id, &path, 1, op.min_interval,
+                                                        op.max_interval, nullptr, nullptr);
+                break;
+            }
+            default:
+                op.result = ESP_ERR_INVALID_ARG;
+                break;
+        }
+    }
+
+    // Unlock the CHIP stack
+    esp_matter::lock::chip_stack_unlock();
+
+    return ESP_OK;
+}
+
+void matter_controller_get_lock_stats(matter_lock_stats_t *stats) {
+    portENTER_CRITICAL(&lock_stats_mux);
+    *stats = lock_stats;
+    portEXIT_CRITICAL(&lock_stats_mux);
+}
+
+void matter_controller_get_read_stats(matter_read_stats_t *stats) {
+    portENTER_CRITICAL(&lock_stats_mux);
+    *stats = read_stats;
+    portEXIT_CRITICAL(&lock_stats_mux);
+}
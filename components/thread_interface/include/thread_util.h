@@ -187,6 +187,28 @@ esp_err_t thread_br_init();
  */
 esp_err_t thread_br_deinit();
 
+// -----------------------------------------------------------------------------
+// Lock Statistics
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Time the functions of this module waited for the OpenThread lock.
+ */
+typedef struct {
+    uint32_t acquisitions;
+    // Attempts that gave up before getting the lock.
+    uint32_t timeouts;
+    uint64_t total_wait_us;
+    uint32_t max_wait_us;
+} thread_lock_stats_t;
+
+/**
+ * @brief Gets the OpenThread lock wait statistics since boot.
+ *
+ * @param[out] stats Filled with the statistics.
+ */
+void thread_get_lock_stats(thread_lock_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -5,6 +5,7 @@
 #include <esp_openthread.h>
 #include <esp_openthread_border_router.h>
 #include <esp_openthread_lock.h>
+#include <esp_timer.h>
 #include <portmacro.h>
 
 #include <openthread/dataset.h>
@@ -15,12 +16,38 @@
 
 static const char *TAG = "THREAD_UTIL";
 
+// Waits for the OpenThread lock, guarded by lock_stats_mux.
+static thread_lock_stats_t lock_stats = {};
+static portMUX_TYPE lock_stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Acquires the OpenThread lock and records how long the caller waited for it.
+ *
+ * @return true if the lock was acquired, false on timeout.
+ */
+static bool acquire_ot_lock(const TickType_t timeout) {
+    const int64_t start_us = esp_timer_get_time();
+    const bool acquired = esp_openthread_lock_acquire(timeout);
+    const auto wait_us = static_cast<uint32_t>(esp_timer_get_time() - start_us);
+
+    portENTER_CRITICAL(&lock_stats_mux);
+    if (acquired) {
+        lock_stats.acquisitions++;
+    } else {
+        lock_stats.timeouts++;
+    }
+    lock_stats.total_wait_us += wait_us;
+    if (wait_us > lock_stats.max_wait_us) lock_stats.max_wait_us = wait_us;
+    portEXIT_CRITICAL(&lock_stats_mux);
+    return acquired;
+}
+
 // -----------------------------------------------------------------------------
 // Interface Control
 // -----------------------------------------------------------------------------
 
 esp_err_t ifconfig_up() {
-    esp_openthread_lock_acquire(portMAX_DELAY);
+    acquire_ot_lock(portMAX_DELAY);
 
     otInstance *instance = esp_openthread_get_instance();
     if (!instance) {
@@ -36,7 +63,7 @@ esp_err_t ifconfig_up() {
 }
 
 esp_err_t ifconfig_down() {
-    esp_openthread_lock_acquire(portMAX_DELAY);
+    acquire_ot_lock(portMAX_DELAY);
 
     otInstance *instance = esp_openthread_get_instance();
     if (!instance) {
@@ -90,7 +117,7 @@ esp_err_t thread_dataset_init(const uint16_t channel, const uint16_t pan_id, con
     otInstance *instance = esp_openthread_get_instance();
     if (!instance) return ESP_ERR_INVALID_STATE;
 
-    if (!esp_openthread_lock_acquire(pdMS_TO_TICKS(5000))) return ESP_FAIL;
+    if (!acquire_ot_lock(pdMS_TO_TICKS(5000))) return ESP_FAIL;
 
     auto *dataset = static_cast<otOperationalDataset *>(calloc(1, sizeof(otOperationalDataset)));
     if (!dataset) {
@@ -159,7 +186,7 @@ esp_err_t thread_start() {
     otInstance *instance = esp_openthread_get_instance();
     if (!instance) return ESP_ERR_INVALID_STATE;
 
-    esp_openthread_lock_acquire(portMAX_DELAY);
+    acquire_ot_lock(portMAX_DELAY);
     const bool success = (otThreadSetEnabled(instance, true) == OT_ERROR_NONE);
     esp_openthread_lock_release();
 
@@ -170,7 +197,7 @@ esp_err_t thread_stop() {
     otInstance *instance = esp_openthread_get_instance();
     if (!instance) return ESP_ERR_INVALID_STATE;
 
-    esp_openthread_lock_acquire(portMAX_DELAY);
+    acquire_ot_lock(portMAX_DELAY);
     const bool success = (otThreadSetEnabled(instance, false) == OT_ERROR_NONE);
     esp_openthread_lock_release();
 
@@ -260,7 +287,7 @@ esp_err_t thread_get_active_dataset(otOperationalDataset *dataset) {
     otInstance *instance = esp_openthread_get_instance();
     if (!instance || !dataset) return ESP_ERR_INVALID_ARG;
 
-    esp_openthread_lock_acquire(portMAX_DELAY);
+    acquire_ot_lock(portMAX_DELAY);
     bool success = (otDatasetGetActive(instance, dataset) == OT_ERROR_NONE);
     esp_openthread_lock_release();
 
@@ -273,7 +300,7 @@ esp_err_t thread_get_active_dataset_tlvs(uint8_t *dataset_tlvs, uint8_t *dataset
     otInstance *instance = esp_openthread_get_instance();
     if (!instance) return ESP_ERR_INVALID_STATE;
 
-    esp_openthread_lock_acquire(portMAX_DELAY);
+    acquire_ot_lock(portMAX_DELAY);
 
     otOperationalDatasetTlvs tlvs = {};
     if (otDatasetGetActiveTlvs(instance, &tlvs) != OT_ERROR_NONE) {
@@ -300,7 +327,7 @@ esp_err_t thread_get_active_dataset_tlvs(uint8_t *dataset_tlvs, uint8_t *dataset
 esp_err_t thread_br_init() {
     esp_openthread_set_backbone_netif(esp_netif_get_handle_from_ifkey("WIFI_STA_DEF"));
 
-    esp_openthread_lock_acquire(portMAX_DELAY);
+    acquire_ot_lock(portMAX_DELAY);
     const esp_err_t err = esp_openthread_border_router_init();
     esp_openthread_lock_release();
 
@@ -308,8 +335,18 @@ esp_err_t thread_br_init() {
 }
 
 esp_err_t thread_br_deinit(void) {
-    esp_openthread_lock_acquire(portMAX_DELAY);
+    acquire_ot_lock(portMAX_DELAY);
     esp_err_t err = esp_openthread_border_router_deinit();
     esp_openthread_lock_release();
     return err;
 }
+
+// -----------------------------------------------------------------------------
+// Lock Statistics
+// -----------------------------------------------------------------------------
+
+void thread_get_lock_stats(thread_lock_stats_t *stats) {
+    portENTER_CRITICAL(&lock_stats_mux);
+    *stats = lock_stats;
+    portEXIT_CRITICAL(&lock_stats_mux);
+}
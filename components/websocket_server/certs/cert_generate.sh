@@ -9,17 +9,40 @@ V3_EXT="v3.ext"
 
 CERTS_DIR=$(cd "$(dirname "$0")" && pwd)
 ESP32_IP=${1:-$DEFAULT_IP}
-
-openssl genrsa -out "$CERTS_DIR/rootCA.key" $KEY_SIZE
+# "rsa" or "ecdsa": an ECDSA P-256 key makes full TLS handshakes several times cheaper for the ESP32
+KEY_TYPE=${2:-rsa}
+
+case "$KEY_TYPE" in
+    rsa)
+        KEY_USAGE="digitalSignature, keyEncipherment"
+        ;;
+    ecdsa)
+        KEY_USAGE="digitalSignature"
+        ;;
+    *)
+        echo "Usage: $0 [ip] [rsa|ecdsa]" >&2
+        exit 1
+        ;;
+esac
+
+generate_key() {
+    if [ "$KEY_TYPE" = "ecdsa" ]; then
+        openssl genpkey -algorithm EC -pkeyopt ec_paramgen_curve:P-256 -out "$1"
+    else
+        openssl genrsa -out "$1" $KEY_SIZE
+    fi
+}
+
+generate_key "$CERTS_DIR/rootCA.key"
 openssl req -x509 -new -key "$CERTS_DIR/rootCA.key" -days $DAYS -subj "$ROOT_SUBJ" -out "$CERTS_DIR/rootCA.pem"
 
-openssl genrsa -out "$CERTS_DIR/prvtkey.pem" $KEY_SIZE
+generate_key "$CERTS_DIR/prvtkey.pem"
 openssl req -new -key "$CERTS_DIR/prvtkey.pem" -subj "/CN=$ESP32_IP" -out "$CERTS_DIR/esp32.csr"
 
 cat > "$CERTS_DIR/$V3_EXT" <<EOF
 authorityKeyIdentifier=keyid,issuer
 basicConstraints=CA:FALSE
-keyUsage = digitalSignature, keyEncipherment
+keyUsage = $KEY_USAGE
 extendedKeyUsage = serverAuth
 subjectAltName = IP:$ESP32_IP
 EOF
@@ -0,0 +1,53 @@
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest input compressed as a single LZ77 stream; longer inputs are emitted as stored blocks.
+#define DEFLATE_MAX_INPUT 65535
+
+/**
+ * Working memory of the compressor. Its size is fixed by the window and hash sizes, so compression never
+ * allocates.
+ *
+ * @param window_bits Base-2 logarithm of the window: the farthest distance a match may refer back.
+ * @param hash_bits Base-2 logarithm of the number of hash chains.
+ */
+typedef struct {
+    uint8_t window_bits;
+    uint8_t hash_bits;
+    // Most recent position + 1 of every hash, 0 if none: (1 << hash_bits) entries.
+    uint16_t *head;
+    // Previous position + 1 with the same hash, per window slot: (1 << window_bits) entries.
+    uint16_t *prev;
+} deflate_workspace_t;
+
+/**
+ * Returns the largest size `deflate_compress` can produce for `len` bytes of input.
+ */
+size_t deflate_bound(size_t len);
+
+/**
+ * Compresses a buffer as a raw DEFLATE stream (RFC 1951, no zlib or gzip wrapper).
+ *
+ * The input is encoded with LZ77 and the fixed Huffman codes, falling back to stored blocks when that
+ * would not make it smaller. Every call produces an independent stream.
+ *
+ * @param workspace Working memory. Must not be used by another compression at the same time.
+ * @param in The input.
+ * @param len Length of the input in bytes.
+ * @param out Output buffer of at least `deflate_bound(len)` bytes.
+ * @return Length of the compressed stream in bytes.
+ */
+size_t deflate_compress(const deflate_workspace_t *workspace, const uint8_t *in, size_t len, uint8_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DEFLATE_H
@@ -33,6 +33,18 @@ typedef bool (*wss_check_client_alive_cb_t)(wss_keep_alive_t h, int fd);
 
 typedef bool (*wss_client_not_alive_cb_t)(wss_keep_alive_t h, int fd);
 
+/**
+ * Activity of a client as recorded by the server, in milliseconds since boot (`esp_timer_get_time() / 1000`).
+ */
+typedef struct {
+    // Time of the last frame of any type received from the client, 0 if none.
+    int64_t last_frame_ms;
+    // Time of the last pong received from the client, 0 if none.
+    int64_t last_pong_ms;
+} wss_client_activity_t;
+
+typedef bool (*wss_get_client_activity_cb_t)(wss_keep_alive_t h, int fd, wss_client_activity_t *activity);
+
 typedef struct {
     /**
      * @var max_clients
@@ -46,6 +58,7 @@ typedef struct {
      * - If the number of connected clients exceeds this limit, new connections may be rejected, or existing ones
      *   may be dropped depending on the implementation logic.
      * - This parameter influences the size of allocated queues and memory used for client state tracking.
+     * - Must be between 1 and 65534.
      */
     size_t max_clients;
     /**
@@ -105,6 +118,10 @@ typedef struct {
      * If a client surpasses this timeout, the keep-alive mechanism will trigger the configured
      * `client_not_alive_cb` callback to handle the unresponsive client.
      *
+     * An idle client is pinged after `keep_alive_period_ms` and pinged again if it does not answer. How
+     * long each ping waits for its pong adapts to the client's measured round-trip time, so a client on
+     * a fast link is given up on sooner; this value is the upper bound.
+     *
      * This parameter is configurable and plays a critical role in maintaining the responsiveness
      * and resource utilization of the WebSocket server.
      */
@@ -146,6 +163,15 @@ typedef struct {
      * WebSocket keep-alive mechanism for managing inactive clients.
      */
     wss_client_not_alive_cb_t client_not_alive_cb;
+    /**
+     * @var get_client_activity_cb
+     * @brief Callback reading the activity the server recorded for a client, or NULL.
+     *
+     * The keep-alive task calls it when a client is due for a check, instead of being told about every
+     * frame. A client that sent anything within the last `keep_alive_period_ms` is not pinged, and the
+     * time of its pongs gives its round-trip time. Returns false if the client is unknown.
+     */
+    wss_get_client_activity_cb_t get_client_activity_cb;
     /**
      * @var user_ctx
      * @brief User-defined context pointer utilized for custom application logic.
@@ -176,6 +202,7 @@ typedef struct {
     .not_alive_after_ms = 10000, \
     .check_client_alive_cb = NULL, \
     .client_not_alive_cb = NULL, \
+    .get_client_activity_cb = NULL, \
     .user_ctx = NULL \
     }
 
@@ -232,6 +259,9 @@ esp_err_t wss_keep_alive_remove_client(wss_keep_alive_t h, int fd);
  * that the client's connection is marked as active and prevents it from being
  * flagged as inactive until the next activity check.
  *
+ * Every call goes through the keep-alive queue; servers that record activity
+ * per frame should provide `get_client_activity_cb` instead.
+ *
  * @param h A pointer to the keep-alive storage (wss_keep_alive_t).
  *          Represents the context of the WebSocket server's keep-alive system.
  * @param fd The file descriptor of the client whose activity status
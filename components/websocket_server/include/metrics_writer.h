@@ -0,0 +1,110 @@
+#ifndef METRICS_WRITER_H
+#define METRICS_WRITER_H
+
+#include <esp_err.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Size of the buffer a writer collects output in before handing it to its sink.
+#define METRICS_WRITER_BUFFER_SIZE 512
+
+// Number of finite buckets of a latency histogram; a final +Inf bucket follows them.
+#define METRICS_HISTOGRAM_BUCKETS 12
+
+/**
+ * Receives a chunk of rendered output.
+ *
+ * @return ESP_OK, or an error that stops the writer.
+ */
+typedef esp_err_t (*metrics_sink_t)(void *ctx, const char *data, size_t len);
+
+/**
+ * Streaming writer of the Prometheus text exposition format.
+ *
+ * Output is collected in a small fixed buffer and passed to the sink whenever it fills up, so a document of
+ * any size is rendered without holding it in memory. Errors are sticky: once the sink fails, further writes
+ * are ignored and `metrics_writer_finish` reports the error.
+ */
+typedef struct {
+    char buf[METRICS_WRITER_BUFFER_SIZE];
+    size_t len;
+    metrics_sink_t sink;
+    void *ctx;
+    esp_err_t err;
+} metrics_writer_t;
+
+/**
+ * Latency histogram with the fixed bucket bounds of METRICS_HISTOGRAM_BOUNDS_US, from 1 ms to 10 s. Not
+ * synchronized; the owner guards it with its own lock.
+ */
+typedef struct {
+    // Observations per bucket, not cumulative; the last entry counts those above every bound.
+    uint32_t buckets[METRICS_HISTOGRAM_BUCKETS + 1];
+    uint64_t count;
+    uint64_t sum_us;
+} metrics_histogram_t;
+
+// Upper bounds of the finite histogram buckets, in microseconds.
+extern const uint32_t METRICS_HISTOGRAM_BOUNDS_US[METRICS_HISTOGRAM_BUCKETS];
+
+void metrics_histogram_record(metrics_histogram_t *histogram, uint32_t us);
+
+/**
+ * Initializes a writer.
+ *
+ * @param writer The writer.
+ * @param sink Function receiving the output.
+ * @param ctx Passed to `sink`.
+ */
+void metrics_writer_init(metrics_writer_t *writer, metrics_sink_t sink, void *ctx);
+
+/**
+ * Hands the remaining output to the sink.
+ *
+ * @return ESP_OK, or the first error returned by the sink.
+ */
+esp_err_t metrics_writer_finish(metrics_writer_t *writer);
+
+/**
+ * Starts a metric family. Every sample of the family must follow before the next family starts.
+ *
+ * @param name Name of the family, e.g. "ws_frames_received_total".
+ * @param type "counter", "gauge", "summary" or "histogram".
+ * @param help One-line description.
+ */
+void metrics_write_family(metrics_writer_t *writer, const char *name, const char *type, const char *help);
+
+/**
+ * Writes an integer sample.
+ *
+ * @param name Name of the sample.
+ * @param label Name of the only label of the sample, or null for a sample without labels.
+ * @param label_value Value of the label, escaped as needed.
+ * @param value The value.
+ */
+void metrics_write_uint(metrics_writer_t *writer, const char *name, const char *label, const char *label_value,
+                        uint64_t value);
+
+/**
+ * Writes a sample in seconds from a value in microseconds, without going through floating point.
+ */
+void metrics_write_seconds(metrics_writer_t *writer, const char *name, const char *label, const char *label_value,
+                           uint64_t us);
+
+/**
+ * Writes the `_bucket`, `_sum` and `_count` samples of a histogram in seconds.
+ *
+ * @param name Name of the histogram family.
+ */
+void metrics_write_histogram(metrics_writer_t *writer, const char *name, const char *label, const char *label_value,
+                             const metrics_histogram_t *histogram);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // METRICS_WRITER_H
@@ -0,0 +1,53 @@
+#ifndef TLS_SESSION_H
+#define TLS_SESSION_H
+
+#include "websocket_server.h"
+
+#include <esp_err.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Server certificate and private key in DER form.
+ */
+typedef struct {
+    const uint8_t *cert;
+    size_t cert_len;
+    const uint8_t *key;
+    size_t key_len;
+} tls_credentials_t;
+
+/**
+ * Converts the PEM certificate and private key of the server to DER, once.
+ *
+ * esp-tls parses the credentials again for every connection; given DER it skips the base64 decoding. The
+ * conversion is done on the first call and kept for the lifetime of the firmware, so later calls, such as
+ * server restarts, return the same buffers and ignore their arguments.
+ *
+ * @param cert_pem The certificate, a null-terminated PEM string.
+ * @param key_pem The unencrypted private key, a null-terminated PEM string.
+ * @param[out] credentials The converted credentials.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the PEM could not be decoded, ESP_ERR_NO_MEM if out
+ *         of memory.
+ */
+esp_err_t tls_load_credentials(const char *cert_pem, const char *key_pem, tls_credentials_t *credentials);
+
+/**
+ * Returns the counters of the TLS handshakes performed as a server.
+ *
+ * Handshakes are measured by wrapping `mbedtls_ssl_handshake` and `mbedtls_ssl_ticket_parse` at link time.
+ * The server task performs one handshake at a time, which the measurement relies on.
+ *
+ * @param[out] stats The counters.
+ */
+void tls_get_handshake_stats(ws_handshake_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TLS_SESSION_H
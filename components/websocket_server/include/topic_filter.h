@@ -0,0 +1,61 @@
+#ifndef TOPIC_FILTER_H
+#define TOPIC_FILTER_H
+
+#include <esp_err.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maximum number of clients the filter tracks; client i is bit i of a match mask.
+#define TOPIC_FILTER_MAX_CLIENTS 32
+// Maximum number of segments in a pattern.
+#define TOPIC_FILTER_MAX_SEGMENTS 12
+// Capacity of the trie: distinct pattern prefixes over all clients, and their total text.
+#define TOPIC_FILTER_MAX_NODES 128
+#define TOPIC_FILTER_MAX_TEXT 1024
+
+// Topics name the events broadcast to WebSocket clients, such as `thread.role` or
+// `matter.attribute_report/node/0x1234/endpoint/1/cluster/0x6/attribute/0x0`. Both '.' and '/' separate
+// segments, and segments are compared case-insensitively.
+//
+// A pattern matches topics segment by segment. A `*` segment matches any single segment, except in last
+// position, where it matches one or more remaining segments: `thread.*` matches every Thread event and
+// `matter.attribute_report/node/0x1234/*` every report of node 0x1234. A pattern of just `*` matches
+// every topic.
+//
+// The patterns of all clients are compiled into a single trie whose nodes carry bitmasks of clients, so
+// matching a topic costs one walk over its segments however many clients are connected.
+
+/**
+ * Compiles the patterns of every client, replacing the current filter.
+ *
+ * The new trie is built next to the one in use and swapped in atomically, so matching may run concurrently.
+ * Building must not: callers serialize calls to this function.
+ *
+ * @param patterns `patterns[i]` is the comma-separated pattern list of client i, or nullptr if the client
+ *                 has none. An empty string is an empty list.
+ * @param client_count Number of entries in `patterns`, at most TOPIC_FILTER_MAX_CLIENTS.
+ * @return
+ *     - ESP_OK: The filter was replaced.
+ *     - ESP_ERR_INVALID_ARG: A pattern is malformed: an empty segment, a `*` that is not a whole segment, or
+ *       more than TOPIC_FILTER_MAX_SEGMENTS segments. The current filter is kept.
+ *     - ESP_ERR_NO_MEM: The patterns do not fit into the trie. The current filter is kept.
+ */
+esp_err_t topic_filter_build(const char *const *patterns, size_t client_count);
+
+/**
+ * Finds the clients with a pattern matching a topic.
+ *
+ * @param topic The topic of an event.
+ * @return Mask with bit i set if client i has a matching pattern.
+ */
+uint32_t topic_filter_match(const char *topic);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TOPIC_FILTER_H
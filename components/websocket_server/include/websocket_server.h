@@ -1,13 +1,145 @@
 #ifndef WEBSOCKET_SERVER_H
 #define WEBSOCKET_SERVER_H
 
+#include "metrics_writer.h"
+
 #include <esp_err.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-typedef esp_err_t (*ws_inbound_message_handler_t)(const char *json);
+/**
+ * Wire protocol of a WebSocket session.
+ *
+ * Clients select the protocol when opening the connection with the `proto` query parameter of the
+ * handshake request: `/ws` or `/ws?proto=json` for JSON in text frames, `/ws?proto=cbor` for CBOR in
+ * binary frames. Handshakes requesting any other protocol are closed.
+ *
+ * Adding `compress=deflate` to the query (e.g. `/ws?proto=json&compress=deflate`) makes the server
+ * compress every outbound message of the session as a raw DEFLATE stream (RFC 1951) sent in a binary
+ * frame, which inflates to a message of the negotiated protocol. Inbound messages are never compressed:
+ * they are sent in the frame type of the negotiated protocol, and a client sending the other type is
+ * disconnected with close status 1003.
+ * Sessions that do not ask for compression are unaffected. Handshakes asking for it are closed when the
+ * firmware is built without CONFIG_WEBSOCKET_DEFLATE.
+ */
+typedef enum {
+    WS_PROTOCOL_JSON,
+    WS_PROTOCOL_CBOR,
+} ws_protocol_t;
+
+/**
+ * What happens to a message when the outbound queue of a recipient is full.
+ *
+ * Every client has a queue bounded by CONFIG_WEBSOCKET_CLIENT_QUEUE_LENGTH messages and
+ * CONFIG_WEBSOCKET_CLIENT_QUEUE_BYTES bytes. To make room, the oldest queued messages that are not
+ * WS_OVERFLOW_DISCONNECT are dropped first.
+ *
+ * The policy also selects the priority of the message: WS_OVERFLOW_DISCONNECT messages form the control
+ * lane and are sent ahead of telemetry, with telemetry guaranteed one message after every
+ * CONFIG_WEBSOCKET_CONTROL_BURST control messages.
+ */
+typedef enum {
+    // Telemetry: drop the message if no room can be made.
+    WS_OVERFLOW_DROP_OLDEST,
+    // State: replace a queued message of the same topic, which is stale; otherwise like
+    // WS_OVERFLOW_DROP_OLDEST.
+    WS_OVERFLOW_COALESCE,
+    // Control: must not be lost; disconnect the client if no room can be made.
+    WS_OVERFLOW_DISCONNECT,
+} ws_overflow_policy_t;
+
+/**
+ * Outbound queue statistics of a connected client.
+ */
+typedef struct {
+    int fd;
+    ws_protocol_t protocol;
+    // Whether outbound messages are compressed.
+    bool deflate;
+    // Current queue depth.
+    size_t queued_messages;
+    size_t queued_bytes;
+    // Highest queue depth since the client connected.
+    size_t peak_messages;
+    size_t peak_bytes;
+    // Messages sent, dropped by their overflow policy, replaced by a newer message of the same topic, and
+    // sends that failed.
+    uint32_t sent;
+    uint32_t dropped;
+    uint32_t coalesced;
+    uint32_t send_failures;
+    // Bytes of messages sent, as put on the wire and before compression.
+    uint64_t sent_bytes;
+    uint64_t raw_bytes;
+    // Frames received, control frames included, and their payload bytes.
+    uint32_t received;
+    uint64_t received_bytes;
+} ws_client_stats_t;
+
+/**
+ * TLS handshakes of the server since boot. A handshake is resumed when the client presented a valid
+ * session ticket, which skips the key exchange and the certificate.
+ */
+typedef struct {
+    uint32_t full;
+    uint32_t resumed;
+    uint32_t failed;
+    // Time spent in completed handshakes of each kind, in microseconds.
+    uint64_t full_us;
+    uint64_t resumed_us;
+} ws_handshake_stats_t;
+
+/**
+ * Callback invoked for every inbound data message.
+ *
+ * @param fd The file descriptor of the client that sent the message. Replies can be sent with
+ *           `websocket_send_to_client` in the protocol of the session (`websocket_get_client_protocol`).
+ * @param protocol Encoding of the message: the protocol the client negotiated, whose frame type the message
+ *                 was checked against.
+ * @param message The message payload. The buffer is owned by the server, stays valid until the callback
+ *                returns and may be modified in place by the callback. It is null-terminated at `len`.
+ * @param len Length of the message in bytes.
+ */
+typedef esp_err_t (*ws_inbound_message_handler_t)(int fd, ws_protocol_t protocol, char *message, size_t len);
+
+/**
+ * Callback invoked on the server task when a client completed the WebSocket handshake, before any message is
+ * sent to it.
+ *
+ * @param fd The file descriptor of the client.
+ * @param protocol The protocol the client negotiated.
+ */
+typedef void (*ws_client_connected_handler_t)(int fd, ws_protocol_t protocol);
+
+/**
+ * Callback invoked on the server task when a WebSocket client disconnected, once it no longer receives
+ * messages. Its file descriptor may be reused by the next client.
+ *
+ * @param fd The file descriptor the client had.
+ */
+typedef void (*ws_client_disconnected_handler_t)(int fd);
+
+/**
+ * Callback receiving the events replayed to a client.
+ *
+ * @param data The encoded event, valid until the callback returns.
+ * @param len Length of the event in bytes.
+ * @param ctx The context passed to `websocket_replay_events`.
+ */
+typedef void (*ws_replay_visitor_t)(const uint8_t *data, size_t len, void *ctx);
+
+/**
+ * Callback adding the application's metrics to a scrape of /metrics, after those of the server. Runs on the
+ * server task, so it must not block for long.
+ *
+ * @param writer The writer the metrics are rendered with.
+ */
+typedef void (*ws_metrics_handler_t)(metrics_writer_t *writer);
 
 /**
  * Starts the WebSocket server and initializes its necessary components.
@@ -16,12 +148,15 @@ typedef esp_err_t (*ws_inbound_message_handler_t)(const char *json);
  * registers a handler for processing inbound messages received on active WebSocket sessions.
  *
  * @param message_handler_fun A pointer to a function that will be called when a new message is received on an active WebSocket session.
+ * @param connected_handler_fun Function called for every client that connects, e.g. to send it the current
+ *                              state. May be null.
  * @return
  * - ESP_OK on successful initialization and start of the WebSocket server.
  * - ESP_ERR_INVALID_ARG if the handler parameter is invalid.
  * - Other error codes indicating failures during initialization.
  */
-esp_err_t websocket_server_start(ws_inbound_message_handler_t message_handler_fun);
+esp_err_t websocket_server_start(ws_inbound_message_handler_t message_handler_fun,
+                                 ws_client_connected_handler_t connected_handler_fun);
 
 /**
  * Stops the WebSocket server and cleans up associated resources.
@@ -36,6 +171,22 @@ esp_err_t websocket_server_start(ws_inbound_message_handler_t message_handler_fu
  */
 esp_err_t websocket_server_stop(void);
 
+/**
+ * Sets the callback adding the application's metrics to /metrics. Must be called before the server is
+ * started. The endpoint is only served when CONFIG_WEBSOCKET_METRICS is enabled.
+ *
+ * @param handler The callback, or null to serve the server's metrics only.
+ */
+void websocket_server_set_metrics_handler(ws_metrics_handler_t handler);
+
+/**
+ * Sets the callback notified of disconnected clients, e.g. to release what they held. Must be called before
+ * the server is started.
+ *
+ * @param handler The callback, or null.
+ */
+void websocket_server_set_disconnected_handler(ws_client_disconnected_handler_t handler);
+
 /**
  * Sends a WebSocket message to a specific client asynchronously.
  *
@@ -64,21 +215,150 @@ esp_err_t websocket_server_stop(void);
 esp_err_t websocket_send_message_to_client(int fd, const char *message);
 
 /**
- * @brief Broadcasts a message to all connected WebSocket clients.
+ * Sends an encoded message to a specific client asynchronously, as a text frame for WebSocket
+ * sessions using WS_PROTOCOL_JSON and as a binary frame for WS_PROTOCOL_CBOR.
  *
- * This function sends the specified message to all clients currently connected to the WebSocket server.
- * It filters out connected clients that are in WebSocket mode and delivers the message as a WebSocket text frame.
+ * The message is copied, so the caller keeps ownership of `data`. It is queued with
+ * WS_OVERFLOW_DISCONNECT: a client whose queue is full is disconnected rather than miss a reply.
+ *
+ * @param fd The file descriptor of the WebSocket connection for the specific client.
+ * @param protocol The protocol `data` is encoded in; selects the frame type.
+ * @param data The encoded message.
+ * @param len Length of the message in bytes.
+ * @return
+ *         - ESP_OK on successful queuing of the message for sending.
+ *         - ESP_ERR_INVALID_ARG if the server is not running or `data` is null.
+ *         - ESP_ERR_NO_MEM if the copy of the message could not be allocated.
+ *         - ESP_FAIL if `fd` is not a connected client or the client was disconnected.
+ */
+esp_err_t websocket_send_to_client(int fd, ws_protocol_t protocol, const uint8_t *data, size_t len);
+
+/**
+ * @brief Broadcasts a message to all connected WebSocket clients using the JSON protocol.
+ *
+ * Clients that negotiated another protocol are skipped; use `websocket_broadcast` to reach them. The
+ * message is queued with WS_OVERFLOW_DROP_OLDEST.
  *
  * @param message The message to broadcast. Must be a null-terminated string. The message is sent as-is
- *                to all connected WebSocket clients.
+ *                in a WebSocket text frame.
  *
  * @return
  *     - ESP_OK: The message was successfully sent to all valid clients.
  *     - ESP_ERR_INVALID_ARG: The server or message parameter is invalid (e.g., the server is not initialized or a message is null).
- *     - ESP_FAIL: Failed to retrieve the client list or send the frame to one or more clients.
+ *     - ESP_FAIL: Failed to send the frame to one or more clients.
  */
 esp_err_t websocket_broadcast_message(const char *message);
 
+/**
+ * Broadcasts an encoded message to the WebSocket clients using the given protocol that subscribed to its
+ * topic.
+ *
+ * @param protocol The protocol `data` is encoded in. Only clients that negotiated it receive the message.
+ * @param topic The topic of the message (see topic_filter.h), or nullptr to send it to every client using
+ *              `protocol`. Clients that never set topic patterns receive every message.
+ * @param seq Sequence number of the event the message carries, or 0 if it is not an event. Events are kept
+ *            in the replay ring of the protocol (see `websocket_replay_events`) once a client using it has
+ *            connected, even if nobody is subscribed to them right now.
+ * @param policy What to do for recipients whose outbound queue is full.
+ * @param data The encoded message. Copied once, and compressed once if some recipients negotiated
+ *             compression; the copies are shared by the queues of all recipients and freed after the last
+ *             send.
+ * @param len Length of the message in bytes.
+ * @return
+ *     - ESP_OK: The message was handed to the queues of all matching clients. Drops are counted in the
+ *       client statistics.
+ *     - ESP_ERR_INVALID_ARG: The server is not running or `data` is null.
+ *     - ESP_ERR_NO_MEM: The copy of the message could not be allocated.
+ */
+esp_err_t websocket_broadcast(ws_protocol_t protocol, const char *topic, uint64_t seq, ws_overflow_policy_t policy,
+                              const uint8_t *data, size_t len);
+
+/**
+ * Returns the protocol negotiated by a client.
+ *
+ * @param fd The file descriptor of the client.
+ * @return The protocol of the session, or WS_PROTOCOL_JSON if `fd` is not a connected WebSocket client.
+ */
+ws_protocol_t websocket_get_client_protocol(int fd);
+
+/**
+ * Counts the connected WebSocket clients that negotiated a protocol and would receive a broadcast of a
+ * topic, so that callers can skip encoding messages nobody would receive.
+ *
+ * @param protocol The protocol to count.
+ * @param topic The topic to match, or nullptr to count every client using `protocol`.
+ * @return Number of matching clients.
+ */
+size_t websocket_get_subscriber_count(ws_protocol_t protocol, const char *topic);
+
+/**
+ * Replaces the topic patterns of a client. Once set, the client only receives broadcasts whose topic
+ * matches one of its patterns.
+ *
+ * @param fd The file descriptor of the client.
+ * @param topics Comma-separated topic patterns (see topic_filter.h), an empty string to receive no
+ *               broadcasts, or nullptr to receive every broadcast again.
+ * @return
+ *     - ESP_OK: The patterns were applied.
+ *     - ESP_ERR_NOT_FOUND: `fd` is not a connected WebSocket client.
+ *     - ESP_ERR_INVALID_ARG: The list is too long or a pattern is malformed.
+ *     - ESP_ERR_NO_MEM: The patterns of all clients together exceed the capacity of the topic filter.
+ *     - ESP_ERR_INVALID_STATE: The server has not been started.
+ */
+esp_err_t websocket_set_client_topics(int fd, const char *topics);
+
+/**
+ * Returns the outbound queue statistics of a client.
+ *
+ * @param fd The file descriptor of the client.
+ * @param[out] stats The statistics.
+ * @return ESP_OK, ESP_ERR_NOT_FOUND if `fd` is not a connected WebSocket client, or ESP_ERR_INVALID_ARG
+ *         if `stats` is null.
+ */
+esp_err_t websocket_get_client_stats(int fd, ws_client_stats_t *stats);
+
+/**
+ * Returns the outbound queue statistics of every connected client.
+ *
+ * @param[out] stats Receives the statistics.
+ * @param max_count Capacity of `stats`.
+ * @return Number of entries written to `stats`.
+ */
+size_t websocket_get_all_client_stats(ws_client_stats_t *stats, size_t max_count);
+
+/**
+ * Returns the TLS handshake counters of the server.
+ *
+ * @param[out] stats The counters.
+ */
+void websocket_get_handshake_stats(ws_handshake_stats_t *stats);
+
+/**
+ * Checks whether events of a protocol are kept for replay, which is the case once a client using it has
+ * connected. Events must then be broadcast even if nobody is subscribed to them.
+ */
+bool websocket_replay_enabled(ws_protocol_t protocol);
+
+/**
+ * Passes the recorded events a client missed to a visitor, oldest first.
+ *
+ * The server keeps the last CONFIG_WEBSOCKET_REPLAY_RING_LENGTH events of each protocol, up to
+ * CONFIG_WEBSOCKET_REPLAY_RING_BYTES bytes. Only events of the client's protocol matching its current topic
+ * patterns are visited. Events broadcast while the replay runs may be both replayed and received normally.
+ *
+ * @param fd The file descriptor of the client.
+ * @param after_seq Sequence number of the last event the client received.
+ * @param visitor Called for every missed event.
+ * @param ctx Passed to `visitor`.
+ * @return
+ *     - ESP_OK: Every missed event still recorded was visited.
+ *     - ESP_ERR_INVALID_STATE: Events after `after_seq` were already dropped from the ring, or `after_seq` was
+ *       never reached, e.g. because it predates a restart. Nothing was visited.
+ *     - ESP_ERR_NOT_FOUND: `fd` is not a connected WebSocket client.
+ *     - ESP_ERR_INVALID_ARG: `visitor` is null.
+ */
+esp_err_t websocket_replay_events(int fd, uint64_t after_seq, ws_replay_visitor_t visitor, void *ctx);
+
 #ifdef __cplusplus
 }
 #endif
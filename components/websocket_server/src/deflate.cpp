@@ -0,0 +1,199 @@
+#include "deflate.h"
+
+#include <cstring>
+
+// Shortest and longest match DEFLATE can encode.
+static constexpr size_t MIN_MATCH = 3;
+static constexpr size_t MAX_MATCH = 258;
+
+// Number of positions of a hash chain inspected when looking for a match.
+static constexpr size_t MAX_CHAIN = 32;
+
+// Bytes added by every stored block: header bits padded to a byte, LEN and NLEN.
+static constexpr size_t STORED_BLOCK_OVERHEAD = 5;
+static constexpr size_t STORED_BLOCK_MAX = 65535;
+
+// Bytes a single symbol can complete: a match takes up to 31 bits, on top of up to 7 pending bits.
+static constexpr size_t MAX_SYMBOL_BYTES = 4;
+// Bytes the end-of-block code and the final flush can complete: 7 bits on top of up to 7 pending bits.
+static constexpr size_t END_OF_BLOCK_BYTES = 2;
+
+// Length codes 257..285 of RFC 1951 section 3.2.5: base length and number of extra bits.
+static constexpr uint16_t LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static constexpr uint8_t LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+// Distance codes 0..29: base distance and number of extra bits.
+static constexpr uint16_t DIST_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+    4097, 6145, 8193, 12289, 16385, 24577
+};
+static constexpr uint8_t DIST_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// LSB-first bit writer over a buffer known to be large enough.
+struct bit_writer_t {
+    uint8_t *out;
+    size_t len;
+    uint32_t bits;
+    uint8_t count;
+};
+
+static void put_bits(bit_writer_t *w, const uint32_t value, const uint8_t count) {
+    w->bits |= value << w->count;
+    w->count += count;
+    while (w->count >= 8) {
+        w->out[w->len++] = static_cast<uint8_t>(w->bits);
+        w->bits >>= 8;
+        w->count -= 8;
+    }
+}
+
+static void flush_bits(bit_writer_t *w) {
+    if (w->count > 0) w->out[w->len++] = static_cast<uint8_t>(w->bits);
+    w->bits = 0;
+    w->count = 0;
+}
+
+/**
+ * Writes a Huffman code, which DEFLATE packs starting with its most significant bit.
+ */
+static void put_code(bit_writer_t *w, const uint32_t code, const uint8_t length) {
+    uint32_t reversed = 0;
+    for (uint8_t i = 0; i < length; ++i) {
+        reversed |= ((code >> i) & 1) << (length - 1 - i);
+    }
+    put_bits(w, reversed, length);
+}
+
+/**
+ * Writes a literal/length symbol with the fixed Huffman code of RFC 1951 section 3.2.6.
+ */
+static void put_fixed_symbol(bit_writer_t *w, const uint16_t symbol) {
+    if (symbol < 144) {
+        put_code(w, 0x30 + symbol, 8);
+    } else if (symbol < 256) {
+        put_code(w, 0x190 + symbol - 144, 9);
+    } else if (symbol < 280) {
+        put_code(w, symbol - 256, 7);
+    } else {
+        put_code(w, 0xC0 + symbol - 280, 8);
+    }
+}
+
+static void put_match(bit_writer_t *w, const size_t length, const size_t distance) {
+    size_t code = 28;
+    while (LENGTH_BASE[code] > length) --code;
+    put_fixed_symbol(w, static_cast<uint16_t>(257 + code));
+    put_bits(w, length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+
+    code = 29;
+    while (DIST_BASE[code] > distance) --code;
+    put_code(w, code, 5);
+    put_bits(w, distance - DIST_BASE[code], DIST_EXTRA[code]);
+}
+
+static uint32_t hash3(const uint8_t *p, const uint8_t hash_bits) {
+    const uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+    return (v * 2654435761u) >> (32 - hash_bits);
+}
+
+/**
+ * Writes the input as stored blocks.
+ */
+static size_t write_stored(const uint8_t *in, const size_t len, uint8_t *out) {
+    bit_writer_t w = {.out = out, .len = 0, .bits = 0, .count = 0};
+    size_t pos = 0;
+    do {
+        const size_t block = len - pos < STORED_BLOCK_MAX ? len - pos : STORED_BLOCK_MAX;
+        const bool final = pos + block == len;
+        put_bits(&w, final ? 1 : 0, 1);
+        put_bits(&w, 0, 2);
+        flush_bits(&w);
+        out[w.len++] = static_cast<uint8_t>(block);
+        out[w.len++] = static_cast<uint8_t>(block >> 8);
+        out[w.len++] = static_cast<uint8_t>(~block);
+        out[w.len++] = static_cast<uint8_t>(~block >> 8);
+        if (block > 0) memcpy(out + w.len, in + pos, block);
+        w.len += block;
+        pos += block;
+    } while (pos < len);
+    return w.len;
+}
+
+size_t deflate_bound(const size_t len) {
+    const size_t blocks = len / STORED_BLOCK_MAX + 1;
+    return len + blocks * STORED_BLOCK_OVERHEAD;
+}
+
+size_t deflate_compress(const deflate_workspace_t *workspace, const uint8_t *in, const size_t len, uint8_t *out) {
+    if (len > DEFLATE_MAX_INPUT || len < MIN_MATCH) return write_stored(in, len, out);
+
+    const size_t window = static_cast<size_t>(1) << workspace->window_bits;
+    const size_t window_mask = window - 1;
+    memset(workspace->head, 0, (static_cast<size_t>(1) << workspace->hash_bits) * sizeof(uint16_t));
+
+    // A fixed Huffman block never needs more than 9 bits per input byte; stop as soon as it cannot beat
+    // the stored form, which the output buffer is sized for
+    const size_t limit = len + STORED_BLOCK_OVERHEAD;
+    bit_writer_t w = {.out = out, .len = 0, .bits = 0, .count = 0};
+    put_bits(&w, 1, 1);
+    put_bits(&w, 1, 2);
+
+    size_t pos = 0;
+    while (pos < len) {
+        // Leave room for this symbol and the end of the block, so the output never passes `limit`
+        if (w.len + MAX_SYMBOL_BYTES + END_OF_BLOCK_BYTES > limit) return write_stored(in, len, out);
+
+        size_t best_len = 0;
+        size_t best_dist = 0;
+        if (pos + MIN_MATCH <= len) {
+            const uint32_t h = hash3(in + pos, workspace->hash_bits);
+            const size_t max_len = len - pos < MAX_MATCH ? len - pos : MAX_MATCH;
+
+            size_t candidate = workspace->head[h];
+            for (size_t chain = 0; candidate > 0 && chain < MAX_CHAIN; ++chain) {
+                const size_t match = candidate - 1;
+                if (pos - match > window - 1) break;
+
+                size_t n = 0;
+                while (n < max_len && in[match + n] == in[pos + n]) ++n;
+                if (n > best_len) {
+                    best_len = n;
+                    best_dist = pos - match;
+                    if (n == max_len) break;
+                }
+
+                const size_t next = workspace->prev[match & window_mask];
+                if (next == 0 || next - 1 >= match) break;
+                candidate = next;
+            }
+
+            workspace->prev[pos & window_mask] = workspace->head[h];
+            workspace->head[h] = static_cast<uint16_t>(pos + 1);
+        }
+
+        if (best_len >= MIN_MATCH) {
+            put_match(&w, best_len, best_dist);
+            // Index the positions covered by the match so later data can refer to them
+            for (size_t i = pos + 1; i < pos + best_len && i + MIN_MATCH <= len; ++i) {
+                const uint32_t h = hash3(in + i, workspace->hash_bits);
+                workspace->prev[i & window_mask] = workspace->head[h];
+                workspace->head[h] = static_cast<uint16_t>(i + 1);
+            }
+            pos += best_len;
+        } else {
+            put_fixed_symbol(&w, in[pos]);
+            pos++;
+        }
+    }
+
+    put_fixed_symbol(&w, 256);
+    flush_bits(&w);
+    if (w.len >= limit) return write_stored(in, len, out);
+    return w.len;
+}
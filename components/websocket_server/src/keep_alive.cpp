@@ -15,21 +15,42 @@ static const char *TAG = "WSS_KEEP_ALIVE";
 struct client_fd_action_t {
     // Types of client FD actions
     enum Type {
-        NO_CLIENT = 0,
+        NO_ACTION = 0,
         CLIENT_FD_ADD,
         CLIENT_FD_REMOVE,
         CLIENT_UPDATE,
-        CLIENT_ACTIVE,
         STOP_TASK
     } type;
 
     // File descriptor representing a client connection
     int fd;
+};
+
+// A client monitored by the keep-alive task.
+struct keep_alive_client_t {
+    // File descriptor of the client connection
+    int fd;
+
+    // Tracks the last time the client was marked as active.
+    int64_t last_seen;
+
+    // Time at which the client is checked next.
+    int64_t deadline;
+
+    // Position of the client in the deadline heap.
+    size_t heap_pos;
 
-    //Tracks the last time a client was marked as active.
-    uint64_t last_seen;
+    // Time the last unanswered ping was sent, 0 if none, and number of unanswered pings.
+    int64_t ping_sent;
+    uint8_t pings_unanswered;
+
+    // Smoothed round-trip time of pings, 0 until the first pong.
+    int64_t srtt_ms;
 };
 
+// Marks an unused entry of the fd index.
+static constexpr uint16_t NO_SLOT = UINT16_MAX;
+
 // Stores data and configurations for the WebSocket Server (WSS) keep-alive mechanism.
 struct wss_keep_alive_storage {
     // Maximum number of clients that can be managed within the WebSocket keep-alive storage system.
@@ -41,6 +62,9 @@ struct wss_keep_alive_storage {
     // A callback of the type `wss_client_not_alive_cb_t` that is invoked when a client is determined to be not alive.
     wss_client_not_alive_cb_t client_not_alive_cb;
 
+    // Callback reading the activity the server recorded for a client, or nullptr.
+    wss_get_client_activity_cb_t get_client_activity_cb;
+
     // The interval in milliseconds for the periodic keep-alive checks.
     size_t keep_alive_period_ms;
 
@@ -53,15 +77,38 @@ struct wss_keep_alive_storage {
     // Queue handle used for communication between the keep-alive task and other parts of the system.
     QueueHandle_t q;
 
-    // Array representing the actions for each client connected to the system.
-    client_fd_action_t clients[];
+    // Number of registered clients.
+    size_t count;
+
+    // Min-heap of the slots of the registered clients, ordered by deadline: `count` entries.
+    uint16_t *heap;
+
+    // Stack of the slots not holding a client: `max_clients - count` entries.
+    uint16_t *free_slots;
+
+    // Open-addressing table mapping file descriptors to slots, `index_mask + 1` entries.
+    uint16_t *index;
+    size_t index_mask;
+
+    // Client slots, `max_clients` entries.
+    keep_alive_client_t clients[];
 };
 
 // Default timeout duration (in milliseconds) for the keep-alive mechanism.
 static constexpr int64_t DEFAULT_KEEP_ALIVE_TIMEOUT_MS = 30000;
 
-// Minimum interval in milliseconds for performing keep-alive checks.
-static constexpr int64_t MIN_KEEP_ALIVE_CHECK_MS = 1000;
+// Shortest wait for the next check, so that clients due close together are checked in the same wake-up.
+static constexpr int64_t KEEP_ALIVE_CHECK_GRANULARITY_MS = 100;
+
+// Queue entries beyond one per client, for bursts of activity updates.
+static constexpr size_t KEEP_ALIVE_QUEUE_SLACK = 4;
+
+// Pings an idle client gets before it is considered not alive.
+static constexpr uint8_t PING_ATTEMPTS = 2;
+
+// A ping waits this many smoothed round-trip times for its pong, but never less than the minimum.
+static constexpr int64_t PONG_TIMEOUT_RTTS = 4;
+static constexpr int64_t MIN_PONG_TIMEOUT_MS = 500;
 
 /**
  * @brief Retrieves the current time in milliseconds.
@@ -75,64 +122,167 @@ static int64_t get_current_time_ms() {
     return esp_timer_get_time() / 1000;
 }
 
+// ---- FD INDEX ----
+
 /**
- * @brief Calculates the time until the next keep-alive check for active clients.
- *
- * This function iterates over the list of clients in the keep-alive storage
- * and computes the shortest time interval until a client requires the next
- * keep-alive check. Only clients marked as `CLIENT_ACTIVE` are considered.
- * If no active client has a shorter interval than the default keep-alive period,
- * the default timeout value is returned.
+ * Returns the preferred index entry of a file descriptor. Descriptors are small consecutive integers, so
+ * they are used as their own hash.
+ */
+static size_t index_home(const wss_keep_alive_storage *h, const int fd) {
+    return static_cast<size_t>(fd) & h->index_mask;
+}
+
+/**
+ * Finds the index entry of a client.
  *
- * @param h A pointer to the `wss_keep_alive_storage` structure containing client information.
- * @param current_time The current time in milliseconds, used for calculating the
- *                     time interval until the next keep-alive check.
- * @return The time in milliseconds until the next keep-alive check for the active clients.
- *         Returns `DEFAULT_KEEP_ALIVE_TIMEOUT_MS` if no client is active or if all
- *         active clients require checks after the default interval.
+ * @return Position of the entry in the index, or the position of the empty entry ending its probe sequence
+ *         if the client is not registered.
  */
-static uint64_t calculate_next_check(const wss_keep_alive_storage *h, const int64_t current_time) {
-    uint64_t next_check_time_ms = DEFAULT_KEEP_ALIVE_TIMEOUT_MS;
-
-    for (size_t i = 0; i < h->max_clients; i++) {
-        if (h->clients[i].type == client_fd_action_t::CLIENT_ACTIVE) {
-            const uint64_t expected_next_check = h->clients[i].last_seen + h->keep_alive_period_ms;
-            uint64_t time_until_check = expected_next_check - current_time;
-            if (time_until_check < next_check_time_ms) {
-                next_check_time_ms = time_until_check;
-            }
+static size_t index_find(const wss_keep_alive_storage *h, const int fd) {
+    size_t pos = index_home(h, fd);
+    while (h->index[pos] != NO_SLOT && h->clients[h->index[pos]].fd != fd) {
+        pos = (pos + 1) & h->index_mask;
+    }
+    return pos;
+}
+
+/**
+ * Empties an index entry, moving later entries of the probe sequence back so lookups need no tombstones.
+ */
+static void index_remove(wss_keep_alive_storage *h, size_t hole) {
+    for (size_t pos = (hole + 1) & h->index_mask; h->index[pos] != NO_SLOT; pos = (pos + 1) & h->index_mask) {
+        const size_t home = index_home(h, h->clients[h->index[pos]].fd);
+        // The entry may fill the hole unless its home lies cyclically between the hole and itself
+        if (((pos - home) & h->index_mask) >= ((pos - hole) & h->index_mask)) {
+            h->index[hole] = h->index[pos];
+            hole = pos;
+        }
+    }
+    h->index[hole] = NO_SLOT;
+}
+
+// ---- DEADLINE HEAP ----
+
+static bool heap_earlier(const wss_keep_alive_storage *h, const size_t a, const size_t b) {
+    return h->clients[h->heap[a]].deadline < h->clients[h->heap[b]].deadline;
+}
+
+static void heap_swap(wss_keep_alive_storage *h, const size_t a, const size_t b) {
+    const uint16_t slot = h->heap[a];
+    h->heap[a] = h->heap[b];
+    h->heap[b] = slot;
+    h->clients[h->heap[a]].heap_pos = a;
+    h->clients[h->heap[b]].heap_pos = b;
+}
+
+/**
+ * Restores the heap order around an entry whose deadline changed.
+ */
+static void heap_update(wss_keep_alive_storage *h, size_t pos) {
+    while (pos > 0 && heap_earlier(h, pos, (pos - 1) / 2)) {
+        heap_swap(h, pos, (pos - 1) / 2);
+        pos = (pos - 1) / 2;
+    }
+    while (true) {
+        size_t earliest = pos;
+        for (size_t child = 2 * pos + 1; child <= 2 * pos + 2 && child < h->count; ++child) {
+            if (heap_earlier(h, child, earliest)) earliest = child;
         }
+        if (earliest == pos) return;
+        heap_swap(h, pos, earliest);
+        pos = earliest;
     }
-    return next_check_time_ms;
 }
 
+static void heap_remove(wss_keep_alive_storage *h, const size_t pos) {
+    const size_t last = --h->count;
+    if (pos == last) return;
+    heap_swap(h, pos, last);
+    heap_update(h, pos);
+}
+
+// ---- CLIENTS ----
+
 /**
- * Calculates the amount of time in milliseconds until the next keep-alive check
- * should be performed based on the current time and keep-alive storage data.
+ * Forgets a registered client.
  *
- * If the calculated delay is less than 0, it defaults to the minimum keep-alive
- * check interval defined by `MIN_KEEP_ALIVE_CHECK_MS`.
+ * @param h Pointer to the keep-alive storage structure.
+ * @param index_pos Position of the client's entry in the fd index.
+ */
+static void release_client(wss_keep_alive_storage *h, const size_t index_pos) {
+    const uint16_t slot = h->index[index_pos];
+    heap_remove(h, h->clients[slot].heap_pos);
+    index_remove(h, index_pos);
+    h->free_slots[h->max_clients - h->count - 1] = slot;
+}
+
+/**
+ * @brief Calculates the time until the next keep-alive check.
  *
- * @param h Pointer to the `wss_keep_alive_storage` structure containing
- *          configuration and client data for determining keep-alive timing.
+ * The registered clients are ordered by the time of their next check, so this only looks at the
+ * earliest one.
  *
- * @return The time in milliseconds until the next keep-alive check should be
- *         performed.
+ * @param h A pointer to the `wss_keep_alive_storage` structure containing client information.
+ * @return The time in milliseconds until the next keep-alive check. Returns
+ *         `DEFAULT_KEEP_ALIVE_TIMEOUT_MS` if no client is registered.
  */
 static uint64_t get_next_keep_alive_check(const wss_keep_alive_storage *h) {
-    const int64_t now = get_current_time_ms();
-    const uint64_t check_after_ms = calculate_next_check(h, now);
+    if (h->count == 0) return DEFAULT_KEEP_ALIVE_TIMEOUT_MS;
 
-    return check_after_ms < MIN_KEEP_ALIVE_CHECK_MS ? MIN_KEEP_ALIVE_CHECK_MS : check_after_ms;
+    const int64_t until_check = h->clients[h->heap[0]].deadline - get_current_time_ms();
+    return until_check < KEEP_ALIVE_CHECK_GRANULARITY_MS ? KEEP_ALIVE_CHECK_GRANULARITY_MS : until_check;
+}
+
+/**
+ * Records activity of a client: it is alive, any outstanding ping is settled and its next check is one
+ * keep-alive period after the activity.
+ */
+static void mark_seen(wss_keep_alive_storage *h, keep_alive_client_t &client, const int64_t seen) {
+    client.last_seen = seen;
+    client.ping_sent = 0;
+    client.pings_unanswered = 0;
+    client.deadline = seen + static_cast<int64_t>(h->keep_alive_period_ms);
+    heap_update(h, client.heap_pos);
+}
+
+/**
+ * Returns how long a ping to a client waits for its pong. Until a round trip was measured, the time left
+ * after the idle period is split evenly between the pings.
+ */
+static int64_t get_pong_timeout(const wss_keep_alive_storage *h, const keep_alive_client_t &client) {
+    const int64_t idle_budget = static_cast<int64_t>(h->not_alive_after_ms) -
+                                static_cast<int64_t>(h->keep_alive_period_ms);
+    int64_t timeout = idle_budget / PING_ATTEMPTS;
+    if (client.srtt_ms > 0 && client.srtt_ms * PONG_TIMEOUT_RTTS < timeout) {
+        timeout = client.srtt_ms * PONG_TIMEOUT_RTTS;
+    }
+    return timeout < MIN_PONG_TIMEOUT_MS ? MIN_PONG_TIMEOUT_MS : timeout;
+}
+
+/**
+ * Catches up with the activity the server recorded for a client since the keep-alive task last looked,
+ * and takes a round-trip sample if a pong answered the outstanding ping.
+ */
+static void update_activity(wss_keep_alive_storage *h, keep_alive_client_t &client) {
+    wss_client_activity_t activity = {};
+    if (!h->get_client_activity_cb || !h->get_client_activity_cb(h, client.fd, &activity)) return;
+
+    if (client.ping_sent > 0 && activity.last_pong_ms >= client.ping_sent) {
+        const int64_t rtt = activity.last_pong_ms - client.ping_sent;
+        client.srtt_ms = client.srtt_ms == 0 ? rtt + 1 : client.srtt_ms + (rtt - client.srtt_ms) / 8;
+        ESP_LOGD(TAG, "Client fd:%d rtt:%lldms srtt:%lldms", client.fd, static_cast<long long>(rtt),
+                 static_cast<long long>(client.srtt_ms));
+    }
+    if (activity.last_frame_ms > client.last_seen) {
+        mark_seen(h, client, activity.last_frame_ms);
+    }
 }
 
 /**
  * @brief Registers a new client in the keep-alive storage.
  *
- * This function attempts to add a new client to the keep-alive storage. It iterates
- * through the storage to find an available slot for the new client. If a slot is
- * found, the client is marked as active, its file descriptor is stored, and the
- * client's last-seen time is updated to the current timestamp.
+ * The client takes a free slot, is marked as seen now and is scheduled for its first check one
+ * keep-alive period later. Registering a client that is already registered refreshes it.
  *
  * @param h Pointer to the keep-alive storage structure.
  * @param client_fd File descriptor of the client to register.
@@ -140,28 +290,28 @@ static uint64_t get_next_keep_alive_check(const wss_keep_alive_storage *h) {
  * @return false if no available slot is found or registration fails.
  */
 static bool register_client(wss_keep_alive_storage *h, const int client_fd) {
-    for (size_t i = 0; i < h->max_clients; i++) {
-        if (h->clients[i].type == client_fd_action_t::NO_CLIENT) {
-            h->clients[i].type = client_fd_action_t::CLIENT_ACTIVE;
-            h->clients[i].fd = client_fd;
-            h->clients[i].last_seen = get_current_time_ms();
-            ESP_LOGI(TAG, "Client fd:%d added", client_fd);
-            return true;
+    const size_t index_pos = index_find(h, client_fd);
+    uint16_t slot = h->index[index_pos];
+    if (slot == NO_SLOT) {
+        if (h->count == h->max_clients) {
+            ESP_LOGW(TAG, "Cannot add new client fd:%d", client_fd);
+            return false;
         }
+        slot = h->free_slots[h->max_clients - h->count - 1];
+        h->index[index_pos] = slot;
+        h->heap[h->count] = slot;
+        h->clients[slot].fd = client_fd;
+        h->clients[slot].heap_pos = h->count++;
+        h->clients[slot].srtt_ms = 0;
     }
-    ESP_LOGW(TAG, "Cannot add new client fd:%d", client_fd);
-    return false;
+
+    mark_seen(h, h->clients[slot], get_current_time_ms());
+    ESP_LOGI(TAG, "Client fd:%d added", client_fd);
+    return true;
 }
 
 /**
- * Unregisters a client from the `wss_keep_alive_storage` instance by removing
- * the client file descriptor (fd).
- *
- * This function iterates through the list of clients in the `wss_keep_alive_storage`
- * instance and searches for an active client (with the type `CLIENT_ACTIVE`)
- * that matches the given `client_fd`. If a match is found, the client's type
- * is set to `NO_CLIENT`, marking it as unregistered, and its file descriptor
- * is reset to -1.
+ * Unregisters a client from the `wss_keep_alive_storage` instance, freeing its slot.
  *
  * @param h Pointer to the `wss_keep_alive_storage` instance containing client
  *          information and status.
@@ -170,37 +320,69 @@ static bool register_client(wss_keep_alive_storage *h, const int client_fd) {
  *         `client_fd` was not found or the client was already unregistered.
  */
 static bool unregister_client(wss_keep_alive_storage *h, const int client_fd) {
-    for (size_t i = 0; i < h->max_clients; i++) {
-        if (h->clients[i].type == client_fd_action_t::CLIENT_ACTIVE && h->clients[i].fd == client_fd) {
-            h->clients[i].type = client_fd_action_t::NO_CLIENT;
-            h->clients[i].fd = -1;
-            ESP_LOGI(TAG, "Client fd:%d removed", client_fd);
-            return true;
-        }
+    const size_t index_pos = index_find(h, client_fd);
+    if (h->index[index_pos] == NO_SLOT) {
+        ESP_LOGW(TAG, "Attempted to remove invalid fd:%d", client_fd);
+        return false;
     }
-    ESP_LOGW(TAG, "Attempted to remove invalid fd:%d", client_fd);
-    return false;
+    release_client(h, index_pos);
+    ESP_LOGI(TAG, "Client fd:%d removed", client_fd);
+    return true;
 }
 
 /**
- * Updates the status of a client in the keep-alive storage by marking it as active
- * and updating its `last_seen` timestamp to the current time. It searches through
- * the list of clients in the specified storage for the given client file descriptor.
+ * Updates the status of a client in the keep-alive storage by updating its `last_seen` timestamp to the
+ * current time and postponing its next check by a keep-alive period.
  *
  * @param h A pointer to the `wss_keep_alive_storage` structure that holds the client information.
  * @param client_fd The file descriptor of the client to be updated.
  * @return `true` if the client was successfully found and updated, `false` otherwise.
  */
 static bool refresh_client_status(wss_keep_alive_storage *h, const int client_fd) {
-    for (size_t i = 0; i < h->max_clients; i++) {
-        if (h->clients[i].type == client_fd_action_t::CLIENT_ACTIVE && h->clients[i].fd == client_fd) {
-            h->clients[i].last_seen = get_current_time_ms();
-            ESP_LOGI(TAG, "Client fd:%d marked as active", client_fd);
-            return true;
+    const uint16_t slot = h->index[index_find(h, client_fd)];
+    if (slot == NO_SLOT) {
+        ESP_LOGW(TAG, "Cannot find client fd:%d to update", client_fd);
+        return false;
+    }
+
+    mark_seen(h, h->clients[slot], get_current_time_ms());
+    ESP_LOGD(TAG, "Client fd:%d marked as active", client_fd);
+    return true;
+}
+
+/**
+ * Checks every client whose deadline has come. A client that was active since its last check is only
+ * rescheduled. An idle one is pinged, and considered not alive once `PING_ATTEMPTS` pings went
+ * unanswered, in which case it is reported and forgotten.
+ *
+ * @param h A pointer to the `wss_keep_alive_storage` structure that holds the client information.
+ */
+static void check_due_clients(wss_keep_alive_storage *h) {
+    const int64_t now = get_current_time_ms();
+    while (h->count > 0 && h->clients[h->heap[0]].deadline <= now) {
+        keep_alive_client_t &client = h->clients[h->heap[0]];
+        const int fd = client.fd;
+
+        update_activity(h, client);
+        if (client.deadline > now) continue;
+
+        if (client.pings_unanswered >= PING_ATTEMPTS) {
+            ESP_LOGW(TAG, "Client fd:%d not alive", fd);
+            release_client(h, index_find(h, fd));
+            if (h->client_not_alive_cb) {
+                h->client_not_alive_cb(h, fd);
+            }
+            continue;
+        }
+
+        client.ping_sent = now;
+        client.pings_unanswered++;
+        client.deadline = now + get_pong_timeout(h, client);
+        heap_update(h, client.heap_pos);
+        if (h->check_client_alive_cb) {
+            h->check_client_alive_cb(h, fd);
         }
     }
-    ESP_LOGW(TAG, "Cannot find client fd:%d to update", client_fd);
-    return false;
 }
 
 /**
@@ -223,8 +405,8 @@ static bool refresh_client_status(wss_keep_alive_storage *h, const int client_fd
  * - Terminates and cleans up resources when a STOP_TASK action is received.
  *
  * Key behaviors:
- * - If no action is received before timeout, it iterates through all clients
- *   and checks for inactivity.
+ * - After every action, and when the earliest deadline is reached, it checks the clients
+ *   that are due, in deadline order, without visiting the others.
  * - Executes user-provided callbacks to handle client-specific actions such as
  *   notifying about inactive clients or performing custom checks.
  *
@@ -260,22 +442,10 @@ static void keep_alive_task(void *arg) {
                     ESP_LOGW(TAG, "Unknown action type:%d", action.type);
                     break;
             }
-        } else {
-            const uint64_t now = get_current_time_ms();
-            for (size_t i = 0; i < h->max_clients; i++) {
-                if (h->clients[i].type == client_fd_action_t::CLIENT_ACTIVE) {
-                    if ((now - h->clients[i].last_seen) > h->not_alive_after_ms) {
-                        ESP_LOGW(TAG, "Client fd:%d not alive", h->clients[i].fd);
-                        if (h->client_not_alive_cb) {
-                            h->client_not_alive_cb(h, h->clients[i].fd);
-                        }
-                        h->clients[i].type = client_fd_action_t::NO_CLIENT;
-                    } else if (h->check_client_alive_cb) {
-                        h->check_client_alive_cb(h, h->clients[i].fd);
-                    }
-                }
-            }
         }
+
+        // Checked after every wake-up, so a steady stream of actions cannot postpone the checks
+        if (run_task) check_due_clients(h);
     }
 
     vQueueDelete(h->q);
@@ -289,16 +459,39 @@ wss_keep_alive_t wss_keep_alive_start(wss_keep_alive_config_t *config) {
         config->task_stack_size = 8192;
     }
 
-    const size_t queue_size = config->max_clients / 2;
-    const size_t client_list_size = config->max_clients + queue_size;
+    if (config->max_clients == 0 || config->max_clients >= NO_SLOT) {
+        ESP_LOGE(TAG, "Invalid max_clients:%u", static_cast<unsigned>(config->max_clients));
+        return nullptr;
+    }
 
+    // Every client can have an action pending, plus some slack for bursts of activity updates
+    const size_t queue_size = config->max_clients + KEEP_ALIVE_QUEUE_SLACK;
+
+    // Keeping the index at most half full keeps probe sequences short
+    size_t index_size = 1;
+    while (index_size < 2 * config->max_clients) index_size <<= 1;
+
+    const size_t clients_size = config->max_clients * sizeof(keep_alive_client_t);
+    const size_t slots_size = (2 * config->max_clients + index_size) * sizeof(uint16_t);
     auto *h = static_cast<wss_keep_alive_storage *>(
-        calloc(1, sizeof(wss_keep_alive_storage) + client_list_size * sizeof(client_fd_action_t))
+        calloc(1, sizeof(wss_keep_alive_storage) + clients_size + slots_size)
     );
     if (!h) return nullptr;
 
+    h->heap = reinterpret_cast<uint16_t *>(reinterpret_cast<uint8_t *>(h->clients) + clients_size);
+    h->free_slots = h->heap + config->max_clients;
+    h->index = h->free_slots + config->max_clients;
+    h->index_mask = index_size - 1;
+    for (size_t i = 0; i < config->max_clients; ++i) {
+        h->free_slots[i] = static_cast<uint16_t>(config->max_clients - 1 - i);
+    }
+    for (size_t i = 0; i < index_size; ++i) {
+        h->index[i] = NO_SLOT;
+    }
+
     h->check_client_alive_cb = config->check_client_alive_cb;
     h->client_not_alive_cb = config->client_not_alive_cb;
+    h->get_client_activity_cb = config->get_client_activity_cb;
     h->max_clients = config->max_clients;
     h->keep_alive_period_ms = config->keep_alive_period_ms;
     h->not_alive_after_ms = config->not_alive_after_ms;
@@ -317,22 +510,22 @@ wss_keep_alive_t wss_keep_alive_start(wss_keep_alive_config_t *config) {
 }
 
 void wss_keep_alive_stop(const wss_keep_alive_t h) {
-    constexpr client_fd_action_t stop = {.type = client_fd_action_t::STOP_TASK, .fd = -1, .last_seen = 0};
+    constexpr client_fd_action_t stop = {.type = client_fd_action_t::STOP_TASK, .fd = -1};
     xQueueSendToBack(h->q, &stop, 0);
 }
 
 esp_err_t wss_keep_alive_add_client(const wss_keep_alive_t h, const int fd) {
-    const client_fd_action_t action = {.type = client_fd_action_t::CLIENT_FD_ADD, .fd = fd, .last_seen = 0};
+    const client_fd_action_t action = {.type = client_fd_action_t::CLIENT_FD_ADD, .fd = fd};
     return xQueueSendToBack(h->q, &action, 0) == pdTRUE ? ESP_OK : ESP_FAIL;
 }
 
 esp_err_t wss_keep_alive_remove_client(const wss_keep_alive_t h, const int fd) {
-    const client_fd_action_t action = {.type = client_fd_action_t::CLIENT_FD_REMOVE, .fd = fd, .last_seen = 0};
+    const client_fd_action_t action = {.type = client_fd_action_t::CLIENT_FD_REMOVE, .fd = fd};
     return xQueueSendToBack(h->q, &action, 0) == pdTRUE ? ESP_OK : ESP_FAIL;
 }
 
 esp_err_t wss_keep_alive_client_is_active(const wss_keep_alive_t h, const int fd) {
-    const client_fd_action_t action = {.type = client_fd_action_t::CLIENT_UPDATE, .fd = fd, .last_seen = 0};
+    const client_fd_action_t action = {.type = client_fd_action_t::CLIENT_UPDATE, .fd = fd};
     return xQueueSendToBack(h->q, &action, 0) == pdTRUE ? ESP_OK : ESP_FAIL;
 }
 
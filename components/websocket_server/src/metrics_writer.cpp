@@ -0,0 +1,172 @@
+#include "metrics_writer.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+const uint32_t METRICS_HISTOGRAM_BOUNDS_US[METRICS_HISTOGRAM_BUCKETS] = {
+    1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 10000000
+};
+
+// Longest text a single formatted number can take.
+static constexpr size_t NUMBER_SIZE = 24;
+
+void metrics_histogram_record(metrics_histogram_t *histogram, const uint32_t us) {
+    size_t bucket = 0;
+    while (bucket < METRICS_HISTOGRAM_BUCKETS && us > METRICS_HISTOGRAM_BOUNDS_US[bucket]) ++bucket;
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->sum_us += us;
+}
+
+static void flush(metrics_writer_t *writer) {
+    if (writer->err == ESP_OK && writer->len > 0) writer->err = writer->sink(writer->ctx, writer->buf, writer->len);
+    writer->len = 0;
+}
+
+static void write_raw(metrics_writer_t *writer, const char *data, size_t len) {
+    while (len > 0 && writer->err == ESP_OK) {
+        if (writer->len == sizeof(writer->buf)) flush(writer);
+        const size_t room = sizeof(writer->buf) - writer->len;
+        const size_t n = len < room ? len : room;
+        memcpy(writer->buf + writer->len, data, n);
+        writer->len += n;
+        data += n;
+        len -= n;
+    }
+}
+
+static void write_string(metrics_writer_t *writer, const char *s) {
+    write_raw(writer, s, strlen(s));
+}
+
+/**
+ * Writes a label value, escaping backslashes, quotes and line feeds.
+ */
+static void write_label_value(metrics_writer_t *writer, const char *value) {
+    for (const char *p = value; *p; ++p) {
+        switch (*p) {
+            case '\\':
+                write_raw(writer, "\\\\", 2);
+                break;
+            case '"':
+                write_raw(writer, "\\\"", 2);
+                break;
+            case '\n':
+                write_raw(writer, "\\n", 2);
+                break;
+            default:
+                write_raw(writer, p, 1);
+                break;
+        }
+    }
+}
+
+/**
+ * Writes one label of a sample, opening the label set before the first one.
+ */
+static void write_label(metrics_writer_t *writer, bool *first, const char *label, const char *value) {
+    write_raw(writer, *first ? "{" : ",", 1);
+    write_string(writer, label);
+    write_raw(writer, "=\"", 2);
+    write_label_value(writer, value ? value : "");
+    write_raw(writer, "\"", 1);
+    *first = false;
+}
+
+/**
+ * Writes a sample name and its labels up to the value: `name{label="value",extra_label="extra_value"} `.
+ * Either label may be null.
+ */
+static void write_sample_start(metrics_writer_t *writer, const char *name, const char *suffix, const char *label,
+                               const char *label_value, const char *extra_label, const char *extra_value) {
+    write_string(writer, name);
+    if (suffix) write_string(writer, suffix);
+    bool first = true;
+    if (label) write_label(writer, &first, label, label_value);
+    if (extra_label) write_label(writer, &first, extra_label, extra_value);
+    if (first) {
+        write_raw(writer, " ", 1);
+    } else {
+        write_raw(writer, "} ", 2);
+    }
+}
+
+static void format_uint(char *out, const uint64_t value) {
+    snprintf(out, NUMBER_SIZE, "%" PRIu64, value);
+}
+
+static void format_seconds(char *out, const uint64_t us) {
+    snprintf(out, NUMBER_SIZE, "%" PRIu64 ".%06" PRIu64, us / 1000000, us % 1000000);
+}
+
+void metrics_writer_init(metrics_writer_t *writer, const metrics_sink_t sink, void *ctx) {
+    writer->len = 0;
+    writer->sink = sink;
+    writer->ctx = ctx;
+    writer->err = ESP_OK;
+}
+
+esp_err_t metrics_writer_finish(metrics_writer_t *writer) {
+    flush(writer);
+    return writer->err;
+}
+
+void metrics_write_family(metrics_writer_t *writer, const char *name, const char *type, const char *help) {
+    write_raw(writer, "# HELP ", 7);
+    write_string(writer, name);
+    write_raw(writer, " ", 1);
+    write_string(writer, help);
+    write_raw(writer, "\n# TYPE ", 8);
+    write_string(writer, name);
+    write_raw(writer, " ", 1);
+    write_string(writer, type);
+    write_raw(writer, "\n", 1);
+}
+
+void metrics_write_uint(metrics_writer_t *writer, const char *name, const char *label, const char *label_value,
+                        const uint64_t value) {
+    char number[NUMBER_SIZE];
+    format_uint(number, value);
+    write_sample_start(writer, name, nullptr, label, label_value, nullptr, nullptr);
+    write_string(writer, number);
+    write_raw(writer, "\n", 1);
+}
+
+void metrics_write_seconds(metrics_writer_t *writer, const char *name, const char *label, const char *label_value,
+                           const uint64_t us) {
+    char number[NUMBER_SIZE];
+    format_seconds(number, us);
+    write_sample_start(writer, name, nullptr, label, label_value, nullptr, nullptr);
+    write_string(writer, number);
+    write_raw(writer, "\n", 1);
+}
+
+void metrics_write_histogram(metrics_writer_t *writer, const char *name, const char *label, const char *label_value,
+                             const metrics_histogram_t *histogram) {
+    char number[NUMBER_SIZE];
+    char bound[NUMBER_SIZE];
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i <= METRICS_HISTOGRAM_BUCKETS; ++i) {
+        cumulative += histogram->buckets[i];
+        if (i < METRICS_HISTOGRAM_BUCKETS) {
+            format_seconds(bound, METRICS_HISTOGRAM_BOUNDS_US[i]);
+        } else {
+            strcpy(bound, "+Inf");
+        }
+        format_uint(number, cumulative);
+        write_sample_start(writer, name, "_bucket", label, label_value, "le", bound);
+        write_string(writer, number);
+        write_raw(writer, "\n", 1);
+    }
+
+    format_seconds(number, histogram->sum_us);
+    write_sample_start(writer, name, "_sum", label, label_value, nullptr, nullptr);
+    write_string(writer, number);
+    write_raw(writer, "\n", 1);
+
+    format_uint(number, histogram->count);
+    write_sample_start(writer, name, "_count", label, label_value, nullptr, nullptr);
+    write_string(writer, number);
+    write_raw(writer, "\n", 1);
+}
@@ -0,0 +1,164 @@
+#include "tls_session.h"
+#include "sdkconfig.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <mbedtls/pem.h>
+#include <mbedtls/ssl.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const char *TAG = "tls_session";
+
+// Longest PEM label handled, e.g. "ENCRYPTED PRIVATE KEY".
+static constexpr size_t MAX_PEM_LABEL_LEN = 32;
+
+// Credentials converted by the first call of tls_load_credentials.
+static tls_credentials_t loaded_credentials = {};
+
+// The server handshake in progress, the time spent in it so far and whether a session ticket was accepted.
+// Only written by the server task.
+static const mbedtls_ssl_context *handshake_ssl = nullptr;
+static int64_t handshake_us = 0;
+static bool handshake_resumed = false;
+
+static ws_handshake_stats_t handshake_stats = {};
+static portMUX_TYPE handshake_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// ---- CREDENTIALS ----
+
+/**
+ * Decodes the first PEM object of a string, whatever its label, into a newly allocated buffer.
+ */
+static esp_err_t pem_to_der(const char *pem, uint8_t **der, size_t *der_len) {
+    static constexpr char BEGIN[] = "-----BEGIN ";
+    const char *label = strstr(pem, BEGIN);
+    if (!label) return ESP_ERR_INVALID_ARG;
+    label += sizeof(BEGIN) - 1;
+    const char *label_end = strstr(label, "-----");
+    if (!label_end || static_cast<size_t>(label_end - label) > MAX_PEM_LABEL_LEN) return ESP_ERR_INVALID_ARG;
+
+    const int label_len = static_cast<int>(label_end - label);
+    char header[MAX_PEM_LABEL_LEN + 17];
+    char footer[MAX_PEM_LABEL_LEN + 15];
+    snprintf(header, sizeof(header), "-----BEGIN %.*s-----", label_len, label);
+    snprintf(footer, sizeof(footer), "-----END %.*s-----", label_len, label);
+
+    mbedtls_pem_context ctx;
+    mbedtls_pem_init(&ctx);
+    size_t used;
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    if (mbedtls_pem_read_buffer(&ctx, header, footer, reinterpret_cast<const unsigned char *>(pem), nullptr, 0,
+                                &used) == 0) {
+        size_t len;
+        const unsigned char *buf = mbedtls_pem_get_buffer(&ctx, &len);
+        *der = static_cast<uint8_t *>(malloc(len));
+        if (*der) {
+            memcpy(*der, buf, len);
+            *der_len = len;
+            err = ESP_OK;
+        } else {
+            err = ESP_ERR_NO_MEM;
+        }
+    }
+    mbedtls_pem_free(&ctx);
+    return err;
+}
+
+esp_err_t tls_load_credentials(const char *cert_pem, const char *key_pem, tls_credentials_t *credentials) {
+    if (!credentials) return ESP_ERR_INVALID_ARG;
+
+    // Only the server task starts the server, so no lock is needed
+    if (!loaded_credentials.cert) {
+        if (!cert_pem || !key_pem) return ESP_ERR_INVALID_ARG;
+
+        uint8_t *cert;
+        size_t cert_len;
+        esp_err_t err = pem_to_der(cert_pem, &cert, &cert_len);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to decode the server certificate: %s", esp_err_to_name(err));
+            return err;
+        }
+        uint8_t *key;
+        size_t key_len;
+        err = pem_to_der(key_pem, &key, &key_len);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to decode the server key: %s", esp_err_to_name(err));
+            free(cert);
+            return err;
+        }
+        loaded_credentials = {.cert = cert, .cert_len = cert_len, .key = key, .key_len = key_len};
+    }
+
+    *credentials = loaded_credentials;
+    return ESP_OK;
+}
+
+// ---- HANDSHAKE STATISTICS ----
+
+extern "C" int __real_mbedtls_ssl_handshake(mbedtls_ssl_context *ssl);
+
+/**
+ * Times server handshakes. esp-tls may call this several times per handshake when the socket would block,
+ * so the time is accumulated until the handshake completes or fails.
+ */
+extern "C" int __wrap_mbedtls_ssl_handshake(mbedtls_ssl_context *ssl) {
+    if (mbedtls_ssl_conf_get_endpoint(mbedtls_ssl_context_get_config(ssl)) != MBEDTLS_SSL_IS_SERVER) {
+        return __real_mbedtls_ssl_handshake(ssl);
+    }
+
+    if (ssl != handshake_ssl) {
+        handshake_ssl = ssl;
+        handshake_us = 0;
+        handshake_resumed = false;
+    }
+    const int64_t start = esp_timer_get_time();
+    const int ret = __real_mbedtls_ssl_handshake(ssl);
+    handshake_us += esp_timer_get_time() - start;
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE ||
+        ret == MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS || ret == MBEDTLS_ERR_SSL_CRYPTO_IN_PROGRESS) {
+        return ret;
+    }
+
+    portENTER_CRITICAL(&handshake_stats_lock);
+    if (ret != 0) {
+        handshake_stats.failed++;
+    } else if (handshake_resumed) {
+        handshake_stats.resumed++;
+        handshake_stats.resumed_us += handshake_us;
+    } else {
+        handshake_stats.full++;
+        handshake_stats.full_us += handshake_us;
+    }
+    portEXIT_CRITICAL(&handshake_stats_lock);
+
+    ESP_LOGD(TAG, "%s handshake %s in %lld us", handshake_resumed ? "Resumed" : "Full",
+             ret == 0 ? "completed" : "failed", static_cast<long long>(handshake_us));
+    handshake_ssl = nullptr;
+    return ret;
+}
+
+#if CONFIG_ESP_TLS_SERVER_SESSION_TICKETS
+extern "C" int __real_mbedtls_ssl_ticket_parse(void *p_ticket, mbedtls_ssl_session *session, unsigned char *buf,
+                                               size_t len);
+
+/**
+ * Marks the server handshake in progress as resumed when the client's session ticket is accepted.
+ */
+extern "C" int __wrap_mbedtls_ssl_ticket_parse(void *p_ticket, mbedtls_ssl_session *session, unsigned char *buf,
+                                               const size_t len) {
+    const int ret = __real_mbedtls_ssl_ticket_parse(p_ticket, session, buf, len);
+    if (ret == 0 && handshake_ssl) handshake_resumed = true;
+    return ret;
+}
+#endif
+
+void tls_get_handshake_stats(ws_handshake_stats_t *stats) {
+    if (!stats) return;
+
+    portENTER_CRITICAL(&handshake_stats_lock);
+    *stats = handshake_stats;
+    portEXIT_CRITICAL(&handshake_stats_lock);
+}
@@ -0,0 +1,172 @@
+#include "topic_filter.h"
+
+#include <freertos/FreeRTOS.h>
+#include <cstring>
+#include <strings.h>
+
+// No node; ends child and sibling lists.
+static constexpr int16_t NO_NODE = -1;
+
+// One pattern segment. Node 0 is the root and has no segment.
+struct topic_node_t {
+    // Offset and length of the segment in `topic_trie_t::text`; "*" matches any single segment.
+    uint16_t text;
+    uint8_t len;
+    // First child and next sibling.
+    int16_t child;
+    int16_t sibling;
+    // Clients with a pattern ending at this node.
+    uint32_t exact;
+    // Clients with a pattern continuing with a trailing `*` after this node.
+    uint32_t rest;
+};
+
+struct topic_trie_t {
+    size_t node_count;
+    size_t text_len;
+    topic_node_t nodes[TOPIC_FILTER_MAX_NODES];
+    char text[TOPIC_FILTER_MAX_TEXT];
+};
+
+// The trie in use and the one the next build writes to. Readers walk the active trie inside `trie_lock`,
+// so a trie is never rewritten while it is being read.
+static topic_trie_t tries[2] = {};
+static size_t active_trie = 0;
+static portMUX_TYPE trie_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool is_separator(const char c) {
+    return c == '.' || c == '/';
+}
+
+/**
+ * Returns the length of the segment starting at `s`.
+ */
+static size_t segment_length(const char *s, const char *end) {
+    size_t len = 0;
+    while (s + len < end && !is_separator(s[len])) ++len;
+    return len;
+}
+
+static bool is_wildcard(const char *s, const size_t len) {
+    return len == 1 && s[0] == '*';
+}
+
+/**
+ * Finds the child of `parent` holding a segment, adding it if needed.
+ *
+ * @return Index of the child, or NO_NODE if the trie is full.
+ */
+static int16_t find_or_add_child(topic_trie_t *trie, const int16_t parent, const char *segment, const size_t len) {
+    for (int16_t i = trie->nodes[parent].child; i != NO_NODE; i = trie->nodes[i].sibling) {
+        const topic_node_t &node = trie->nodes[i];
+        if (node.len == len && strncasecmp(trie->text + node.text, segment, len) == 0) return i;
+    }
+
+    if (trie->node_count >= TOPIC_FILTER_MAX_NODES || trie->text_len + len > TOPIC_FILTER_MAX_TEXT) {
+        return NO_NODE;
+    }
+
+    const auto index = static_cast<int16_t>(trie->node_count++);
+    topic_node_t &node = trie->nodes[index];
+    node = {
+        .text = static_cast<uint16_t>(trie->text_len),
+        .len = static_cast<uint8_t>(len),
+        .child = NO_NODE,
+        .sibling = trie->nodes[parent].child,
+        .exact = 0,
+        .rest = 0
+    };
+    memcpy(trie->text + trie->text_len, segment, len);
+    trie->text_len += len;
+    trie->nodes[parent].child = index;
+    return index;
+}
+
+/**
+ * Adds one pattern of a client to the trie.
+ */
+static esp_err_t add_pattern(topic_trie_t *trie, const char *pattern, const char *end, const uint32_t client_bit) {
+    int16_t node = 0;
+    size_t segments = 0;
+    const char *s = pattern;
+    while (true) {
+        const size_t len = segment_length(s, end);
+        if (len == 0 || len > UINT8_MAX || ++segments > TOPIC_FILTER_MAX_SEGMENTS) return ESP_ERR_INVALID_ARG;
+        for (size_t i = 0; i < len; ++i) {
+            if (s[i] == '*' && len != 1) return ESP_ERR_INVALID_ARG;
+        }
+
+        const bool last = s + len == end;
+        if (last && is_wildcard(s, len)) {
+            trie->nodes[node].rest |= client_bit;
+            return ESP_OK;
+        }
+
+        node = find_or_add_child(trie, node, s, len);
+        if (node == NO_NODE) return ESP_ERR_NO_MEM;
+        if (last) {
+            trie->nodes[node].exact |= client_bit;
+            return ESP_OK;
+        }
+        s += len + 1;
+    }
+}
+
+/**
+ * Collects the clients of the patterns below `node` that match the rest of a topic.
+ */
+static uint32_t match_node(const topic_trie_t *trie, const int16_t node, const char *topic, const char *end) {
+    if (topic > end) return trie->nodes[node].exact;
+
+    uint32_t mask = trie->nodes[node].rest;
+    const size_t len = segment_length(topic, end);
+    for (int16_t i = trie->nodes[node].child; i != NO_NODE; i = trie->nodes[i].sibling) {
+        const topic_node_t &child = trie->nodes[i];
+        const char *text = trie->text + child.text;
+        if (is_wildcard(text, child.len) ||
+            (child.len == len && strncasecmp(text, topic, len) == 0)) {
+            mask |= match_node(trie, i, topic + len + 1, end);
+        }
+    }
+    return mask;
+}
+
+esp_err_t topic_filter_build(const char *const *patterns, const size_t client_count) {
+    if (client_count > TOPIC_FILTER_MAX_CLIENTS) return ESP_ERR_INVALID_ARG;
+
+    topic_trie_t *trie = &tries[active_trie ^ 1];
+    trie->node_count = 1;
+    trie->text_len = 0;
+    trie->nodes[0] = {.text = 0, .len = 0, .child = NO_NODE, .sibling = NO_NODE, .exact = 0, .rest = 0};
+
+    for (size_t client = 0; client < client_count; ++client) {
+        const char *list = patterns[client];
+        if (!list || *list == '\0') continue;
+
+        while (true) {
+            const char *end = strchr(list, ',');
+            if (!end) end = list + strlen(list);
+
+            const esp_err_t ret = add_pattern(trie, list, end, 1u << client);
+            if (ret != ESP_OK) return ret;
+
+            if (*end == '\0') break;
+            list = end + 1;
+        }
+    }
+
+    portENTER_CRITICAL(&trie_lock);
+    active_trie ^= 1;
+    portEXIT_CRITICAL(&trie_lock);
+    return ESP_OK;
+}
+
+uint32_t topic_filter_match(const char *topic) {
+    const char *end = topic + strlen(topic);
+
+    portENTER_CRITICAL(&trie_lock);
+    const topic_trie_t *trie = &tries[active_trie];
+    const uint32_t mask = trie->node_count > 0 ? match_node(trie, 0, topic, end) : 0;
+    portEXIT_CRITICAL(&trie_lock);
+    return mask;
+}
@@ -1,25 +1,169 @@
 #include "websocket_server.h"
+#include "sdkconfig.h"
+#include <esp_attr.h>
 #include <esp_log.h>
 #include <esp_https_server.h>
 #include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <atomic>
+#include <cstring>
+#include <new>
 #include <unistd.h>
+#include "deflate.h"
 #include "keep_alive.h"
+#include "tls_session.h"
+#include "topic_filter.h"
 
 // Max number of clients that can connect to the WebSocket server simultaneously.
-constexpr int MAX_CLIENTS = 10;
+constexpr int MAX_CLIENTS = CONFIG_WEBSOCKET_MAX_CLIENTS;
+static_assert(MAX_CLIENTS <= TOPIC_FILTER_MAX_CLIENTS, "Every client needs a bit in topic filter masks");
+// httpd uses 3 sockets of its own besides the client sockets, and the other stacks take theirs from the same pool
+static_assert(MAX_CLIENTS + 3 + CONFIG_WEBSOCKET_RESERVED_SOCKETS <= CONFIG_LWIP_MAX_SOCKETS,
+              "Raise LWIP_MAX_SOCKETS or lower WEBSOCKET_MAX_CLIENTS");
 
 // URI path for the WebSocket server endpoint.
 constexpr char WEBSOCKET_URI[] = "/ws";
 
+// URI path of the Prometheus metrics endpoint.
+constexpr char METRICS_URI[] = "/metrics";
+
 // Static instance of the HTTP server.
 static httpd_handle_t server = nullptr;
 
 // Static variable to store the WebSocket inbound message handler callback.
 static ws_inbound_message_handler_t message_handler = nullptr;
 
+// Callback notified of every client that completes the handshake, or nullptr.
+static ws_client_connected_handler_t connected_handler = nullptr;
+
+// Callback notified of every WebSocket client that disconnects, or nullptr.
+static ws_client_disconnected_handler_t disconnected_handler = nullptr;
+
 // Static variable to manage and monitor websocket client connections for the server.
 static wss_keep_alive_t keep_alive = nullptr;
 
+// Maximum length of the handshake query string that is inspected for protocol negotiation.
+constexpr size_t MAX_QUERY_LEN = 64;
+
+// Maximum length of the topic pattern list of a client, including the terminator.
+constexpr size_t MAX_TOPICS_LEN = 256;
+
+// High-water marks of the outbound queue of every client: number of messages and their total size.
+constexpr size_t CLIENT_QUEUE_LENGTH = CONFIG_WEBSOCKET_CLIENT_QUEUE_LENGTH;
+constexpr size_t CLIENT_QUEUE_BYTES = CONFIG_WEBSOCKET_CLIENT_QUEUE_BYTES;
+
+// Number of control messages sent to a client in a row before a waiting telemetry message gets its turn.
+constexpr uint8_t CONTROL_BURST = CONFIG_WEBSOCKET_CONTROL_BURST;
+
+// Capacity of the replay ring of each protocol: number of events and their total size.
+constexpr size_t REPLAY_RING_LENGTH = CONFIG_WEBSOCKET_REPLAY_RING_LENGTH;
+constexpr size_t REPLAY_RING_BYTES = CONFIG_WEBSOCKET_REPLAY_RING_BYTES;
+
+// Largest inbound message, possibly reassembled from fragments, and number of buffers receiving messages.
+constexpr size_t MAX_INBOUND_MESSAGE = CONFIG_WEBSOCKET_MAX_INBOUND_MESSAGE_SIZE;
+constexpr size_t RX_BUFFER_COUNT = CONFIG_WEBSOCKET_RX_BUFFERS;
+
+// Largest payload of a control frame (RFC 6455 section 5.5).
+constexpr size_t MAX_CONTROL_PAYLOAD = 125;
+
+// Status codes of the close frames sent to misbehaving clients (RFC 6455 section 7.4.1).
+constexpr uint16_t CLOSE_PROTOCOL_ERROR = 1002;
+constexpr uint16_t CLOSE_UNSUPPORTED_DATA = 1003;
+constexpr uint16_t CLOSE_MESSAGE_TOO_BIG = 1009;
+constexpr uint16_t CLOSE_TRY_AGAIN_LATER = 1013;
+
+struct SharedPayload;
+
+// A message waiting in the outbound queue of a client.
+struct ws_queue_entry_t {
+    SharedPayload *payload;
+    ws_overflow_policy_t policy;
+};
+
+// A connected WebSocket client, the protocol it negotiated during the handshake and its topic patterns.
+struct ws_client_t {
+    bool active;
+    int fd;
+    ws_protocol_t protocol;
+    // Whether the client asked for compressed messages.
+    bool deflate;
+    // Whether the client set topic patterns; clients that did not receive every broadcast.
+    bool filtered;
+    // Comma-separated topic patterns, compiled into the topic filter under the client's slot index.
+    char topics[MAX_TOPICS_LEN];
+    // Messages waiting to be sent, oldest first, and their total size in bytes.
+    ws_queue_entry_t queue[CLIENT_QUEUE_LENGTH];
+    size_t queue_count;
+    size_t queue_bytes;
+    // Control messages sent since the last telemetry message.
+    uint8_t control_streak;
+    // Set once the client is being disconnected; nothing more is queued for or sent to it.
+    bool evicted;
+    // Liveness read by the keep-alive task: times of the last frame and the last pong received.
+    wss_client_activity_t activity;
+    // Message being received: its receive buffer, -1 if none, and its length so far. Only used by the server
+    // task.
+    int8_t rx_buffer;
+    size_t rx_len;
+    // Queue high-water marks and delivery counters; the queue depth is filled in when they are read.
+    ws_client_stats_t stats;
+};
+
+// Connected WebSocket clients. Written by the server task, read by any task that sends messages.
+static ws_client_t clients[MAX_CLIENTS] = {};
+static portMUX_TYPE clients_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Slot bitmaps mirroring the client table, so senders visit connected clients only: clients that are active and
+// not evicted, and among those the ones with queued messages. Guarded by clients_lock and kept up to date by
+// `update_slot_masks`.
+static uint32_t ready_slots = 0;
+static uint32_t pending_slots = 0;
+
+// Serializes topic filter updates, which read the patterns of every client.
+static SemaphoreHandle_t topics_lock = nullptr;
+
+// Whether a work item draining the client queues is pending on the server task. Guarded by clients_lock.
+static bool drain_scheduled = false;
+
+// Why the server disconnected a client.
+enum eviction_reason_t {
+    // The client stopped answering pings.
+    EVICTION_KEEP_ALIVE,
+    // Its outbound queue overflowed with messages that must not be lost, or a send failed.
+    EVICTION_SLOW_CONSUMER,
+    // It sent frames violating the protocol or exceeding the receive limits.
+    EVICTION_PROTOCOL,
+    EVICTION_REASON_COUNT,
+};
+
+// Counters of the clients that disconnected, so server totals survive them, and disconnections by reason.
+// Guarded by clients_lock.
+static ws_client_stats_t closed_client_totals = {};
+static uint32_t evictions[EVICTION_REASON_COUNT] = {};
+
+// Adds the application's metrics to /metrics.
+static ws_metrics_handler_t metrics_handler = nullptr;
+
+#if CONFIG_WEBSOCKET_DEFLATE
+// Working memory of the compressor, shared by all senders and serialized by deflate_lock.
+static uint16_t deflate_head[1 << (CONFIG_WEBSOCKET_DEFLATE_MEM_LEVEL + 7)];
+static uint16_t deflate_prev[1 << CONFIG_WEBSOCKET_DEFLATE_WINDOW_BITS];
+static const deflate_workspace_t deflate_workspace = {
+    .window_bits = CONFIG_WEBSOCKET_DEFLATE_WINDOW_BITS,
+    .hash_bits = CONFIG_WEBSOCKET_DEFLATE_MEM_LEVEL + 7,
+    .head = deflate_head,
+    .prev = deflate_prev
+};
+static SemaphoreHandle_t deflate_lock = nullptr;
+#endif
+
+// Receive buffers, each holding one inbound message and its terminator. A message keeps its buffer until its
+// last fragment arrived. Only used by the server task.
+EXT_RAM_BSS_ATTR static uint8_t rx_buffers[RX_BUFFER_COUNT][MAX_INBOUND_MESSAGE + 1];
+static bool rx_buffer_used[RX_BUFFER_COUNT] = {};
+
 // The start address of the server certificate in PEM format.
 extern const char servercert_pem_start[] asm("_binary_servercert_pem_start");
 // The end marker for the server certificate's PEM file contents embedded in the binary.
@@ -29,49 +173,701 @@ extern const char prvtkey_pem_start[] asm("_binary_prvtkey_pem_start");
 // The end of the private key PEM file in binary form.
 extern const char prvtkey_pem_end[] asm("_binary_prvtkey_pem_end");
 
-// Structure for holding arguments required to send asynchronous data over a WebSocket.
-struct AsyncSendArg {
-    // Handle to the HTTP server instance.
-    httpd_handle_t httpd_handle;
-    // File descriptor for a client connection.
-    int client_fd;
-    // A pointer to a character array (C-style string) that holds the message to be sent to a websocket client.
-    char *message;
+/**
+ * An immutable encoded message shared by every client it is queued for.
+ *
+ * The message is copied once, into the same allocation as this header, and every queue entry holds one
+ * reference. The payload is freed when the last reference is dropped.
+ */
+struct SharedPayload {
+    std::atomic<uint32_t> refs;
+    // Frame type: text for JSON messages, binary for CBOR and compressed messages.
+    httpd_ws_type_t type;
+    // Length of the message in bytes, and its length before compression.
+    size_t len;
+    size_t raw_len;
+    // The message, stored right after the structure.
+    uint8_t *message;
+    // Topic of the message, stored after the message, or nullptr. Used to coalesce queued messages.
+    const char *topic;
+    // Sequence number of the event the message carries, or 0 if it is not an event.
+    uint64_t seq;
 };
 
+// Memory shared payloads are allocated from. They are queued for clients and kept in the replay rings.
+#if CONFIG_WEBSOCKET_PAYLOADS_IN_PSRAM
+constexpr uint32_t PAYLOAD_CAPS = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+#else
+constexpr uint32_t PAYLOAD_CAPS = MALLOC_CAP_DEFAULT;
+#endif
+
+/**
+ * The type of the data frames carrying uncompressed messages of a protocol, in both directions: text for JSON,
+ * binary for CBOR.
+ */
+static httpd_ws_type_t frame_type(const ws_protocol_t protocol) {
+    return protocol == WS_PROTOCOL_CBOR ? HTTPD_WS_TYPE_BINARY : HTTPD_WS_TYPE_TEXT;
+}
+
+static void *alloc_payload(const size_t size) {
+    return heap_caps_malloc(size, PAYLOAD_CAPS);
+}
+
 /**
- * Frees the memory associated with an AsyncSendArg structure,
- * including its message member.
+ * Copies a message into a new shared payload holding a single reference.
  *
- * @param arg A pointer to the AsyncSendArg structure to be freed.
- *            This includes the message member and the structure itself.
+ * @param protocol The protocol the message is encoded in.
+ * @param topic The topic of the message, or nullptr.
+ * @param data The message.
+ * @param len Length of the message in bytes.
+ * @return The payload, or nullptr if it could not be allocated.
  */
-static void free_async_send_arg(AsyncSendArg *arg) {
-    free(arg->message);
-    free(arg);
+static SharedPayload *create_shared_payload(const ws_protocol_t protocol, const char *topic, const uint8_t *data,
+                                            const size_t len) {
+    const size_t topic_size = topic ? strlen(topic) + 1 : 0;
+    void *mem = alloc_payload(sizeof(SharedPayload) + len + topic_size);
+    if (!mem) return nullptr;
+
+    auto *payload = new(mem) SharedPayload();
+    payload->refs.store(1, std::memory_order_relaxed);
+    payload->type = frame_type(protocol);
+    payload->len = len;
+    payload->raw_len = len;
+    payload->message = reinterpret_cast<uint8_t *>(payload + 1);
+    memcpy(payload->message, data, len);
+    payload->seq = 0;
+    payload->topic = nullptr;
+    if (topic) {
+        char *copy = reinterpret_cast<char *>(payload->message + len);
+        memcpy(copy, topic, topic_size);
+        payload->topic = copy;
+    }
+    return payload;
 }
 
+#if CONFIG_WEBSOCKET_DEFLATE
 /**
- * @brief Asynchronously sends a WebSocket message to a client.
+ * Compresses a message into a new shared payload holding a single reference.
  *
- * This function creates a WebSocket frame and sends it asynchronously to
- * the specified client using the provided HTTPD handle. After sending
- * the frame, the allocated resources for the argument are freed.
+ * The payload is allocated for the worst case and shrunk to the compressed size afterwards.
  *
- * @param arg Pointer to the AsyncSendArg structure containing the HTTPD handle,
- * the client file descriptor, and the message to be sent.
- */
-static void async_send_task(void *arg) {
-    auto *send_arg = static_cast<AsyncSendArg *>(arg);
-    httpd_ws_frame_t frame = {
-        .final = true,
-        .fragmented = false,
-        .type = HTTPD_WS_TYPE_TEXT,
-        .payload = reinterpret_cast<uint8_t *>(send_arg->message),
-        .len = strlen(send_arg->message)
-    };
-    httpd_ws_send_frame_async(send_arg->httpd_handle, send_arg->client_fd, &frame);
-    free_async_send_arg(send_arg);
+ * @param topic The topic of the message, or nullptr.
+ * @param data The message.
+ * @param len Length of the message in bytes.
+ * @return The payload, or nullptr if it could not be allocated.
+ */
+static SharedPayload *create_compressed_payload(const char *topic, const uint8_t *data, const size_t len) {
+    const size_t topic_size = topic ? strlen(topic) + 1 : 0;
+    void *mem = alloc_payload(sizeof(SharedPayload) + deflate_bound(len) + topic_size);
+    if (!mem) return nullptr;
+
+    auto *compressed = static_cast<uint8_t *>(mem) + sizeof(SharedPayload);
+    xSemaphoreTake(deflate_lock, portMAX_DELAY);
+    const size_t compressed_len = deflate_compress(&deflate_workspace, data, len, compressed);
+    xSemaphoreGive(deflate_lock);
+
+    // Shrinking normally happens in place; keep the larger block if it does not
+    void *shrunk = heap_caps_realloc(mem, sizeof(SharedPayload) + compressed_len + topic_size, PAYLOAD_CAPS);
+    if (shrunk) mem = shrunk;
+
+    auto *payload = new(mem) SharedPayload();
+    payload->refs.store(1, std::memory_order_relaxed);
+    payload->type = HTTPD_WS_TYPE_BINARY;
+    payload->len = compressed_len;
+    payload->raw_len = len;
+    payload->message = reinterpret_cast<uint8_t *>(payload + 1);
+    payload->seq = 0;
+    payload->topic = nullptr;
+    if (topic) {
+        char *copy = reinterpret_cast<char *>(payload->message + compressed_len);
+        memcpy(copy, topic, topic_size);
+        payload->topic = copy;
+    }
+    return payload;
+}
+#endif
+
+/**
+ * Drops a reference to a shared payload and frees it when none are left.
+ */
+static void release_shared_payload(SharedPayload *payload) {
+    if (payload->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        payload->~SharedPayload();
+        heap_caps_free(payload);
+    }
+}
+
+/**
+ * Recomputes the bits of a slot in `ready_slots` and `pending_slots` from its client. Called with clients_lock
+ * held after every change to the client's state or queue.
+ */
+static void update_slot_masks(const size_t slot) {
+    const ws_client_t &client = clients[slot];
+    const uint32_t bit = 1u << slot;
+    const bool ready = client.active && !client.evicted;
+    ready_slots = ready ? ready_slots | bit : ready_slots & ~bit;
+    pending_slots = ready && client.queue_count > 0 ? pending_slots | bit : pending_slots & ~bit;
+}
+
+/**
+ * Registers a client that completed the WebSocket handshake.
+ *
+ * @return true on success, false if all entries are in use.
+ */
+static bool add_client(const int fd, const ws_protocol_t protocol, const bool deflate) {
+    bool added = false;
+    portENTER_CRITICAL(&clients_lock);
+    for (auto &client: clients) {
+        if (client.active && client.fd == fd) {
+            client.protocol = protocol;
+            client.deflate = deflate;
+            added = true;
+            break;
+        }
+    }
+    for (size_t i = 0; i < MAX_CLIENTS && !added; ++i) {
+        ws_client_t &client = clients[i];
+        if (!client.active) {
+            client.active = true;
+            client.fd = fd;
+            client.protocol = protocol;
+            client.deflate = deflate;
+            client.filtered = false;
+            client.queue_count = 0;
+            client.queue_bytes = 0;
+            client.control_streak = 0;
+            client.evicted = false;
+            client.activity = {};
+            client.rx_buffer = -1;
+            client.rx_len = 0;
+            client.stats = {};
+            update_slot_masks(i);
+            added = true;
+        }
+    }
+    portEXIT_CRITICAL(&clients_lock);
+    return added;
+}
+
+/**
+ * Adds the delivery counters of a client to server totals.
+ */
+static void add_client_totals(const ws_client_stats_t &stats, ws_client_stats_t *totals) {
+    totals->sent += stats.sent;
+    totals->dropped += stats.dropped;
+    totals->coalesced += stats.coalesced;
+    totals->send_failures += stats.send_failures;
+    totals->sent_bytes += stats.sent_bytes;
+    totals->raw_bytes += stats.raw_bytes;
+    totals->received += stats.received;
+    totals->received_bytes += stats.received_bytes;
+}
+
+/**
+ * Unregisters a client and drops its queued messages. Does nothing if the client is not registered.
+ *
+ * @return true if the client was registered.
+ */
+static bool remove_client(const int fd) {
+    bool removed = false;
+    SharedPayload *dropped[CLIENT_QUEUE_LENGTH];
+    size_t dropped_count = 0;
+
+    portENTER_CRITICAL(&clients_lock);
+    for (size_t slot = 0; slot < MAX_CLIENTS; ++slot) {
+        ws_client_t &client = clients[slot];
+        if (client.active && client.fd == fd) {
+            client.active = false;
+            add_client_totals(client.stats, &closed_client_totals);
+            for (size_t i = 0; i < client.queue_count; ++i) {
+                dropped[dropped_count++] = client.queue[i].payload;
+            }
+            client.queue_count = 0;
+            client.queue_bytes = 0;
+            if (client.rx_buffer >= 0) {
+                rx_buffer_used[client.rx_buffer] = false;
+                client.rx_buffer = -1;
+            }
+            update_slot_masks(slot);
+            removed = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&clients_lock);
+
+    for (size_t i = 0; i < dropped_count; ++i) {
+        release_shared_payload(dropped[i]);
+    }
+    return removed;
+}
+
+/**
+ * Determines the protocol and compression requested in the query string of a handshake request.
+ *
+ * @param req The handshake request.
+ * @param[out] protocol The requested protocol; WS_PROTOCOL_JSON if the request does not name one.
+ * @param[out] deflate Whether the request asks for compressed messages.
+ * @return true if the protocol and compression are absent or supported, false otherwise.
+ */
+static bool negotiate_protocol(httpd_req_t *req, ws_protocol_t *protocol, bool *deflate) {
+    *protocol = WS_PROTOCOL_JSON;
+    *deflate = false;
+
+    char query[MAX_QUERY_LEN];
+    char value[8];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK) return true;
+
+    if (httpd_query_key_value(query, "compress", value, sizeof(value)) == ESP_OK) {
+#if CONFIG_WEBSOCKET_DEFLATE
+        if (strcmp(value, "deflate") != 0) return false;
+        *deflate = true;
+#else
+        return false;
+#endif
+    }
+
+    if (httpd_query_key_value(query, "proto", value, sizeof(value)) != ESP_OK) return true;
+    if (strcmp(value, "json") == 0) return true;
+    if (strcmp(value, "cbor") == 0) {
+        *protocol = WS_PROTOCOL_CBOR;
+        return true;
+    }
+    return false;
+}
+
+// ---- REPLAY RING ----
+
+/**
+ * The most recent events of one protocol, oldest first, kept so that a client that reconnects can be sent
+ * the events it missed. Every entry holds a reference to the payload that was broadcast.
+ */
+struct ws_replay_ring_t {
+    SharedPayload *events[REPLAY_RING_LENGTH];
+    // Index of the oldest event, number of events and their total size.
+    size_t head;
+    size_t count;
+    size_t bytes;
+    // Highest sequence number dropped from the ring, and highest recorded. Every event in between is still
+    // in the ring.
+    uint64_t dropped_seq;
+    uint64_t last_seq;
+    // Whether a client using the protocol connected since the server started; until then nothing is recorded.
+    bool enabled;
+};
+
+static ws_replay_ring_t replay_rings[2] = {};
+static portMUX_TYPE replay_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Appends an event to the replay ring of its protocol, dropping the oldest events beyond the ring's
+ * capacity. An empty ring accepts any event, however large.
+ */
+static void record_event(const ws_protocol_t protocol, SharedPayload *payload) {
+    SharedPayload *dropped[REPLAY_RING_LENGTH];
+    size_t dropped_count = 0;
+
+    payload->refs.fetch_add(1, std::memory_order_relaxed);
+    portENTER_CRITICAL(&replay_lock);
+    ws_replay_ring_t &ring = replay_rings[protocol];
+    while (ring.count > 0 && (ring.count == REPLAY_RING_LENGTH || ring.bytes + payload->len > REPLAY_RING_BYTES)) {
+        SharedPayload *oldest = ring.events[ring.head];
+        ring.head = (ring.head + 1) % REPLAY_RING_LENGTH;
+        ring.count--;
+        ring.bytes -= oldest->len;
+        if (oldest->seq > ring.dropped_seq) ring.dropped_seq = oldest->seq;
+        dropped[dropped_count++] = oldest;
+    }
+    ring.events[(ring.head + ring.count) % REPLAY_RING_LENGTH] = payload;
+    ring.count++;
+    ring.bytes += payload->len;
+    if (payload->seq > ring.last_seq) ring.last_seq = payload->seq;
+    portEXIT_CRITICAL(&replay_lock);
+
+    for (size_t i = 0; i < dropped_count; ++i) {
+        release_shared_payload(dropped[i]);
+    }
+}
+
+/**
+ * Records that an event could not be kept, so that a replay spanning it is reported as incomplete and the
+ * client falls back to the snapshot instead of silently missing the event.
+ */
+static void record_lost_event(const ws_protocol_t protocol, const uint64_t seq) {
+    portENTER_CRITICAL(&replay_lock);
+    ws_replay_ring_t &ring = replay_rings[protocol];
+    if (seq > ring.dropped_seq) ring.dropped_seq = seq;
+    portEXIT_CRITICAL(&replay_lock);
+}
+
+/**
+ * Drops every recorded event.
+ */
+static void clear_replay_rings() {
+    for (auto &ring: replay_rings) {
+        SharedPayload *dropped[REPLAY_RING_LENGTH];
+        size_t dropped_count = 0;
+
+        portENTER_CRITICAL(&replay_lock);
+        for (size_t i = 0; i < ring.count; ++i) {
+            dropped[dropped_count++] = ring.events[(ring.head + i) % REPLAY_RING_LENGTH];
+        }
+        ring = {};
+        portEXIT_CRITICAL(&replay_lock);
+
+        for (size_t i = 0; i < dropped_count; ++i) {
+            release_shared_payload(dropped[i]);
+        }
+    }
+}
+
+// ---- OUTBOUND QUEUES ----
+
+// Outcome of queueing a message for a client.
+enum enqueue_result_t {
+    ENQUEUE_QUEUED,
+    // The message was dropped by its overflow policy.
+    ENQUEUE_DROPPED,
+    // The message could not be queued and its policy requires disconnecting the client.
+    ENQUEUE_EVICT,
+};
+
+/**
+ * Checks whether a message fits into a queue. An empty queue accepts any message, however large.
+ */
+static bool queue_fits(const ws_client_t &client, const size_t len) {
+    return client.queue_count < CLIENT_QUEUE_LENGTH &&
+           (client.queue_count == 0 || client.queue_bytes + len <= CLIENT_QUEUE_BYTES);
+}
+
+/**
+ * Tells whether a message travels in the control lane. Messages that must not be lost (command replies
+ * and events) are control; everything that may be dropped or coalesced is telemetry.
+ */
+static bool is_control(const ws_overflow_policy_t policy) {
+    return policy == WS_OVERFLOW_DISCONNECT;
+}
+
+/**
+ * Picks the next message to send to a client. Called with clients_lock held on a non-empty queue.
+ *
+ * Control messages go first, so replies do not wait behind a flood of reports, but after CONTROL_BURST of
+ * them in a row a waiting telemetry message is sent, so telemetry is never starved. Each lane keeps its
+ * order.
+ *
+ * @return Index of the message in the queue.
+ */
+static size_t next_queue_entry(ws_client_t &client) {
+    size_t control = 0;
+    while (control < client.queue_count && !is_control(client.queue[control].policy)) ++control;
+    size_t telemetry = 0;
+    while (telemetry < client.queue_count && is_control(client.queue[telemetry].policy)) ++telemetry;
+
+    if (control < client.queue_count && (telemetry == client.queue_count || client.control_streak < CONTROL_BURST)) {
+        client.control_streak++;
+        return control;
+    }
+    client.control_streak = 0;
+    return telemetry;
+}
+
+static void remove_queue_entry(ws_client_t &client, const size_t index) {
+    client.queue_bytes -= client.queue[index].payload->len;
+    memmove(&client.queue[index], &client.queue[index + 1],
+            (client.queue_count - index - 1) * sizeof(ws_queue_entry_t));
+    client.queue_count--;
+}
+
+/**
+ * Appends a message to the queue of a client, applying its overflow policy. Called with clients_lock held.
+ *
+ * Replaced and dropped messages are not released here, since that may free memory; they are returned in
+ * `released` for the caller to release after leaving the critical section.
+ *
+ * @param client The recipient.
+ * @param payload The message. A reference is taken if it is queued.
+ * @param policy What to do when the queue is full.
+ * @param[out] released Receives up to CLIENT_QUEUE_LENGTH messages removed from the queue.
+ * @param[out] released_count Number of entries written to `released`.
+ */
+static enqueue_result_t enqueue_message(ws_client_t &client, SharedPayload *payload, const ws_overflow_policy_t policy,
+                                       SharedPayload **released, size_t *released_count) {
+    // Replace a queued message of the same topic; its content is stale anyway
+    if (policy == WS_OVERFLOW_COALESCE && payload->topic) {
+        for (size_t i = 0; i < client.queue_count; ++i) {
+            ws_queue_entry_t &entry = client.queue[i];
+            if (entry.policy != WS_OVERFLOW_COALESCE || !entry.payload->topic ||
+                strcmp(entry.payload->topic, payload->topic) != 0) {
+                continue;
+            }
+
+            released[(*released_count)++] = entry.payload;
+            client.queue_bytes = client.queue_bytes - entry.payload->len + payload->len;
+            payload->refs.fetch_add(1, std::memory_order_relaxed);
+            entry.payload = payload;
+            client.stats.coalesced++;
+            return ENQUEUE_QUEUED;
+        }
+    }
+
+    // Make room by dropping the oldest messages that may be dropped
+    while (!queue_fits(client, payload->len)) {
+        size_t victim = 0;
+        while (victim < client.queue_count && is_control(client.queue[victim].policy)) ++victim;
+        if (victim == client.queue_count) break;
+
+        released[(*released_count)++] = client.queue[victim].payload;
+        remove_queue_entry(client, victim);
+        client.stats.dropped++;
+    }
+
+    if (!queue_fits(client, payload->len)) {
+        if (policy == WS_OVERFLOW_DISCONNECT) return ENQUEUE_EVICT;
+        client.stats.dropped++;
+        return ENQUEUE_DROPPED;
+    }
+
+    payload->refs.fetch_add(1, std::memory_order_relaxed);
+    client.queue[client.queue_count++] = {.payload = payload, .policy = policy};
+    client.queue_bytes += payload->len;
+    if (client.queue_count > client.stats.peak_messages) client.stats.peak_messages = client.queue_count;
+    if (client.queue_bytes > client.stats.peak_bytes) client.stats.peak_bytes = client.queue_bytes;
+    return ENQUEUE_QUEUED;
+}
+
+/**
+ * Closes the connection of a client that cannot keep up or misbehaves.
+ *
+ * @param cause Why the client is disconnected, for the metrics.
+ * @param reason Description for the log.
+ */
+static void evict_client(const int fd, const eviction_reason_t cause, const char *reason) {
+    portENTER_CRITICAL(&clients_lock);
+    evictions[cause]++;
+    portEXIT_CRITICAL(&clients_lock);
+    ESP_LOGW("websocket_server", "Disconnecting client fd=%d: %s", fd, reason);
+    httpd_sess_trigger_close(server, fd);
+}
+
+static void drain_queues(void *arg);
+
+/**
+ * Makes sure a work item draining the client queues is pending on the server task.
+ */
+static void schedule_drain() {
+    bool schedule = false;
+    portENTER_CRITICAL(&clients_lock);
+    if (!drain_scheduled) {
+        drain_scheduled = true;
+        schedule = true;
+    }
+    portEXIT_CRITICAL(&clients_lock);
+    if (!schedule) return;
+
+    const esp_err_t err = httpd_queue_work(server, drain_queues, nullptr);
+    if (err != ESP_OK) {
+        // Queued messages stay where they are until the next message schedules another attempt
+        ESP_LOGE("websocket_server", "Failed to schedule sending: %s", esp_err_to_name(err));
+        portENTER_CRITICAL(&clients_lock);
+        drain_scheduled = false;
+        portEXIT_CRITICAL(&clients_lock);
+    }
+}
+
+/**
+ * Queues a message for every client selected by a predicate and schedules sending.
+ *
+ * However many clients receive the message, sending it takes a single work item on the server task.
+ *
+ * @param payload The message. The caller keeps its own reference.
+ * @param policy What to do when the queue of a recipient is full.
+ * @param slots Slots of the candidate recipients, typically a snapshot of `ready_slots`.
+ * @param matches Called with clients_lock held as `matches(slot, client)` for every active candidate.
+ * @return Number of clients the message was queued for.
+ */
+template<typename Match>
+static size_t queue_for_clients(SharedPayload *payload, const ws_overflow_policy_t policy, const uint32_t slots,
+                                Match matches) {
+    size_t queued = 0;
+    for (uint32_t remaining = slots; remaining != 0; remaining &= remaining - 1) {
+        const size_t i = __builtin_ctz(remaining);
+        SharedPayload *released[CLIENT_QUEUE_LENGTH];
+        size_t released_count = 0;
+        enqueue_result_t result = ENQUEUE_DROPPED;
+        bool selected = false;
+        int fd = -1;
+
+        portENTER_CRITICAL(&clients_lock);
+        ws_client_t &client = clients[i];
+        if (client.active && !client.evicted && matches(i, client)) {
+            selected = true;
+            fd = client.fd;
+            result = enqueue_message(client, payload, policy, released, &released_count);
+            if (result == ENQUEUE_EVICT) client.evicted = true;
+            update_slot_masks(i);
+        }
+        portEXIT_CRITICAL(&clients_lock);
+
+        for (size_t k = 0; k < released_count; ++k) {
+            release_shared_payload(released[k]);
+        }
+        if (!selected) continue;
+
+        if (result == ENQUEUE_QUEUED) {
+            queued++;
+        } else if (result == ENQUEUE_EVICT) {
+            evict_client(fd, EVICTION_SLOW_CONSUMER, "outbound queue full");
+        }
+    }
+
+    if (queued > 0) schedule_drain();
+    return queued;
+}
+
+/**
+ * Queues a message for every client selected by a predicate, compressed for the clients that asked for it.
+ *
+ * The message is copied at most once as is and compressed at most once, whatever the number of recipients.
+ * Events are recorded in the replay ring before they are queued, so a client never receives an event that
+ * could not be replayed.
+ *
+ * @param protocol The protocol the message is encoded in.
+ * @param topic The topic of the message, or nullptr.
+ * @param seq Sequence number of the event the message carries, or 0 if it is not an event.
+ * @param policy What to do when the queue of a recipient is full.
+ * @param data The message.
+ * @param len Length of the message in bytes.
+ * @param matches Called with clients_lock held as `matches(slot, client)` for every active client.
+ * @param[out] queued Number of clients the message was queued for.
+ * @return ESP_OK, or ESP_ERR_NO_MEM if a copy of the message could not be allocated.
+ */
+template<typename Match>
+static esp_err_t queue_message(const ws_protocol_t protocol, const char *topic, const uint64_t seq,
+                               const ws_overflow_policy_t policy, const uint8_t *data, const size_t len, Match matches,
+                               size_t *queued) {
+    *queued = 0;
+    bool want_plain = false;
+    bool want_deflate = false;
+
+    portENTER_CRITICAL(&replay_lock);
+    const bool record = seq != 0 && replay_rings[protocol].enabled;
+    portEXIT_CRITICAL(&replay_lock);
+
+    portENTER_CRITICAL(&clients_lock);
+    const uint32_t slots = ready_slots;
+    for (uint32_t remaining = slots; remaining != 0; remaining &= remaining - 1) {
+        const size_t i = __builtin_ctz(remaining);
+        const ws_client_t &client = clients[i];
+        if (matches(i, client)) (client.deflate ? want_deflate : want_plain) = true;
+    }
+    portEXIT_CRITICAL(&clients_lock);
+
+    esp_err_t ret = ESP_OK;
+    if (want_plain || record) {
+        SharedPayload *payload = create_shared_payload(protocol, topic, data, len);
+        if (payload) {
+            payload->seq = seq;
+            if (record) record_event(protocol, payload);
+            const auto plain = [&matches](const size_t slot, const ws_client_t &client) {
+                return !client.deflate && matches(slot, client);
+            };
+            *queued += queue_for_clients(payload, policy, slots, plain);
+            release_shared_payload(payload);
+        } else {
+            // The sequence number is taken; nobody receives the event, and a replay must not skip over it
+            if (record) record_lost_event(protocol, seq);
+            ret = ESP_ERR_NO_MEM;
+        }
+    }
+#if CONFIG_WEBSOCKET_DEFLATE
+    if (want_deflate) {
+        SharedPayload *payload = create_compressed_payload(topic, data, len);
+        if (payload) {
+            const auto compressed = [&matches](const size_t slot, const ws_client_t &client) {
+                return client.deflate && matches(slot, client);
+            };
+            *queued += queue_for_clients(payload, policy, slots, compressed);
+            release_shared_payload(payload);
+        } else {
+            ret = ESP_ERR_NO_MEM;
+        }
+    }
+#endif
+    return ret;
+}
+
+/**
+ * Sends the queued messages of all clients. Runs on the server task.
+ *
+ * Clients are served round-robin, one message each per pass, so a client on a slow link does not hold back
+ * the others. Within a client, control messages take priority over telemetry (see `next_queue_entry`). A
+ * client whose send fails is disconnected. Each pass visits only the clients in `pending_slots`. The work item
+ * keeps going until that set is empty; the check and clearing `drain_scheduled` happen under the same lock, so
+ * messages queued meanwhile always get another work item.
+ */
+static void drain_queues(void *) {
+    while (true) {
+        portENTER_CRITICAL(&clients_lock);
+        const uint32_t slots = pending_slots;
+        if (slots == 0) drain_scheduled = false;
+        portEXIT_CRITICAL(&clients_lock);
+        if (slots == 0) return;
+
+        for (uint32_t remaining = slots; remaining != 0; remaining &= remaining - 1) {
+            const size_t slot = __builtin_ctz(remaining);
+            ws_client_t &client = clients[slot];
+            SharedPayload *payload = nullptr;
+            int fd = -1;
+            portENTER_CRITICAL(&clients_lock);
+            if (client.active && !client.evicted && client.queue_count > 0) {
+                const size_t next = next_queue_entry(client);
+                payload = client.queue[next].payload;
+                fd = client.fd;
+                remove_queue_entry(client, next);
+                update_slot_masks(slot);
+            }
+            portEXIT_CRITICAL(&clients_lock);
+            if (!payload) continue;
+
+            httpd_ws_frame_t frame = {
+                .final = true,
+                .fragmented = false,
+                .type = payload->type,
+                .payload = payload->message,
+                .len = payload->len
+            };
+            const esp_err_t err = httpd_ws_send_frame_async(server, fd, &frame);
+            const size_t sent_bytes = payload->len;
+            const size_t raw_bytes = payload->raw_len;
+            release_shared_payload(payload);
+
+            portENTER_CRITICAL(&clients_lock);
+            if (client.active && client.fd == fd) {
+                if (err == ESP_OK) {
+                    client.stats.sent++;
+                    client.stats.sent_bytes += sent_bytes;
+                    client.stats.raw_bytes += raw_bytes;
+                } else {
+                    client.stats.send_failures++;
+                    client.evicted = true;
+                    update_slot_masks(slot);
+                }
+            }
+            portEXIT_CRITICAL(&clients_lock);
+            if (err != ESP_OK) evict_client(fd, EVICTION_SLOW_CONSUMER, esp_err_to_name(err));
+        }
+    }
+}
+
+/**
+ * Fills in the statistics of a client. Called with clients_lock held.
+ */
+static void get_client_stats(const ws_client_t &client, ws_client_stats_t *stats) {
+    *stats = client.stats;
+    stats->fd = client.fd;
+    stats->protocol = client.protocol;
+    stats->deflate = client.deflate;
+    stats->queued_messages = client.queue_count;
+    stats->queued_bytes = client.queue_bytes;
 }
 
 /**
@@ -84,8 +880,10 @@ static void async_send_task(void *arg) {
  * @param fd      The file descriptor of the client connection to be closed.
  */
 static void on_client_close(httpd_handle_t handle, const int fd) {
+    const bool was_client = remove_client(fd);
     wss_keep_alive_remove_client(keep_alive, fd);
     close(fd);
+    if (was_client && disconnected_handler) disconnected_handler(fd);
 }
 
 /**
@@ -101,10 +899,27 @@ static httpd_ssl_config_t create_ssl_config() {
     httpd_ssl_config_t config = HTTPD_SSL_CONFIG_DEFAULT();
     config.httpd.global_user_ctx = keep_alive;
     config.httpd.close_fn = &on_client_close;
-    config.servercert = reinterpret_cast<const uint8_t *>(servercert_pem_start);
-    config.servercert_len = servercert_pem_end - servercert_pem_start;
-    config.prvtkey_pem = reinterpret_cast<const uint8_t *>(prvtkey_pem_start);
-    config.prvtkey_len = prvtkey_pem_end - prvtkey_pem_start;
+    config.httpd.max_open_sockets = MAX_CLIENTS;
+    // Bounds how long a stalled client can block the server task before it is disconnected
+    config.httpd.send_wait_timeout = CONFIG_WEBSOCKET_SEND_TIMEOUT;
+
+    // DER credentials spare every connection the PEM decoding; the PEM files are the fallback
+    tls_credentials_t credentials;
+    if (tls_load_credentials(servercert_pem_start, prvtkey_pem_start, &credentials) == ESP_OK) {
+        config.servercert = credentials.cert;
+        config.servercert_len = credentials.cert_len;
+        config.prvtkey_pem = credentials.key;
+        config.prvtkey_len = credentials.key_len;
+    } else {
+        config.servercert = reinterpret_cast<const uint8_t *>(servercert_pem_start);
+        config.servercert_len = servercert_pem_end - servercert_pem_start;
+        config.prvtkey_pem = reinterpret_cast<const uint8_t *>(prvtkey_pem_start);
+        config.prvtkey_len = prvtkey_pem_end - prvtkey_pem_start;
+    }
+#if CONFIG_ESP_TLS_SERVER_SESSION_TICKETS
+    // Reconnecting clients resume their session with a ticket instead of a full handshake
+    config.session_tickets = true;
+#endif
     return config;
 }
 
@@ -132,8 +947,48 @@ static bool send_ping_to_client(wss_keep_alive_t h, const int fd) {
 }
 
 /**
- * Processes an incoming WebSocket frame and performs actions based
- * on the frame type. Handles text frames, pong frames, and close frames.
+ * Records that a frame was received from a client, which proves it is alive, and counts it. Called for every
+ * frame, so it only stamps the client; the keep-alive task reads the stamps when the client is due for a check.
+ *
+ * @param fd The file descriptor of the client.
+ * @param is_pong Whether the frame is a pong, which also gives the client's round-trip time.
+ * @param len Payload length of the frame.
+ */
+static void record_activity(const int fd, const bool is_pong, const size_t len) {
+    const int64_t now = esp_timer_get_time() / 1000;
+    portENTER_CRITICAL(&clients_lock);
+    for (auto &client: clients) {
+        if (client.active && client.fd == fd) {
+            client.activity.last_frame_ms = now;
+            if (is_pong) client.activity.last_pong_ms = now;
+            client.stats.received++;
+            client.stats.received_bytes += len;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&clients_lock);
+}
+
+/**
+ * Reads the activity recorded for a client. Matches `wss_get_client_activity_cb_t`.
+ */
+static bool get_client_activity(wss_keep_alive_t, const int fd, wss_client_activity_t *activity) {
+    bool found = false;
+    portENTER_CRITICAL(&clients_lock);
+    for (const auto &client: clients) {
+        if (client.active && client.fd == fd) {
+            *activity = client.activity;
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&clients_lock);
+    return found;
+}
+
+/**
+ * Processes an incoming control frame: ping, pong or close. Messages are handed to the message handler by
+ * receive_and_handle_frame once reassembled.
  *
  * @param frame The WebSocket frame to be processed.
  * @param fd The file descriptor of the client connection associated
@@ -141,14 +996,15 @@ static bool send_ping_to_client(wss_keep_alive_t h, const int fd) {
  */
 static void process_frame(const httpd_ws_frame_t &frame, const int fd) {
     switch (frame.type) {
-        case HTTPD_WS_TYPE_TEXT:
-            if (message_handler) {
-                message_handler(reinterpret_cast<const char *>(frame.payload));
-            }
+        case HTTPD_WS_TYPE_PING: {
+            // Control frames are handled here, so the server does not answer pings by itself
+            httpd_ws_frame_t pong = {.type = HTTPD_WS_TYPE_PONG, .payload = frame.payload, .len = frame.len};
+            httpd_ws_send_frame_async(server, fd, &pong);
             break;
+        }
         case HTTPD_WS_TYPE_PONG:
+            // Liveness was already recorded when the frame was received
             ESP_LOGD("websocket_server", "Received pong from fd=%d", fd);
-            wss_keep_alive_client_is_active(keep_alive, fd);
             break;
         case HTTPD_WS_TYPE_CLOSE:
             wss_keep_alive_remove_client(keep_alive, fd);
@@ -159,22 +1015,96 @@ static void process_frame(const httpd_ws_frame_t &frame, const int fd) {
     }
 }
 
+// ---- INBOUND FRAMES ----
+
 /**
- * Receives and processes a WebSocket frame from an HTTP request.
+ * Takes a free receive buffer.
  *
- * This method handles the reception of a WebSocket frame from the client,
- * processes its payload if present, and calls the appropriate frame type handler.
- * It also ensures proper memory management for the frame payload and logs errors
- * in case of failures.
+ * @return Index of the buffer, or -1 if every buffer is in use.
+ */
+static int8_t acquire_rx_buffer() {
+    for (size_t i = 0; i < RX_BUFFER_COUNT; ++i) {
+        if (!rx_buffer_used[i]) {
+            rx_buffer_used[i] = true;
+            return static_cast<int8_t>(i);
+        }
+    }
+    return -1;
+}
+
+/**
+ * Returns the message being received from a client to the pool.
+ */
+static void release_rx_buffer(ws_client_t &client) {
+    if (client.rx_buffer >= 0) rx_buffer_used[client.rx_buffer] = false;
+    client.rx_buffer = -1;
+    client.rx_len = 0;
+}
+
+/**
+ * Finds the client sending a frame. Called on the server task, which is the only one registering and
+ * unregistering clients, so no lock is needed.
+ */
+static ws_client_t *find_receiving_client(const int fd) {
+    for (auto &client: clients) {
+        if (client.active && client.fd == fd) return &client;
+    }
+    return nullptr;
+}
+
+/**
+ * Sends a close frame with a status code to a client and disconnects it.
+ */
+static void close_client(const int fd, const uint16_t status, const char *reason) {
+    uint8_t payload[2] = {static_cast<uint8_t>(status >> 8), static_cast<uint8_t>(status)};
+    httpd_ws_frame_t close = {.type = HTTPD_WS_TYPE_CLOSE, .payload = payload, .len = sizeof(payload)};
+    httpd_ws_send_frame_async(server, fd, &close);
+    evict_client(fd, EVICTION_PROTOCOL, reason);
+}
+
+/**
+ * Receives a control frame, which is short and never fragmented, on the stack and processes it.
+ */
+static esp_err_t receive_control_frame(httpd_req_t *req, httpd_ws_frame_t &frame, const int fd) {
+    if (frame.len > MAX_CONTROL_PAYLOAD) {
+        close_client(fd, CLOSE_PROTOCOL_ERROR, "oversized control frame");
+        return ESP_OK;
+    }
+
+    uint8_t payload[MAX_CONTROL_PAYLOAD + 1];
+    frame.payload = payload;
+    if (frame.len > 0) {
+        const esp_err_t ret = httpd_ws_recv_frame(req, &frame, frame.len);
+        if (ret != ESP_OK) {
+            ESP_LOGE("websocket_server", "Failed to receive payload: %s", esp_err_to_name(ret));
+            return ret;
+        }
+    }
+    payload[frame.len] = '\0';
+    process_frame(frame, fd);
+    return ESP_OK;
+}
+
+/**
+ * Receives a WebSocket frame from an HTTP request and processes it.
+ *
+ * Data frames are received into a buffer of the receive pool, and fragmented messages are reassembled
+ * there; a message is processed once its last fragment arrived, so inbound traffic allocates nothing. A
+ * frame that would make its message longer than MAX_INBOUND_MESSAGE is refused from its header, before
+ * its payload is read, and the client is disconnected with close status 1009; a fragmentation error gets
+ * 1002, and running out of receive buffers 1013. Messages are handed over in the protocol the client
+ * negotiated; a message in frames of the other type (text for JSON, binary for CBOR) is refused from its
+ * header as well, with close status 1003. Compression only applies to outbound messages, so clients of a
+ * compressed session still send plain messages.
  *
  * @param req Pointer to the HTTP request object that contains the WebSocket frame.
  * @return
- *     - ESP_OK: The WebSocket frame was received and handled successfully.
- *     - ESP_ERR_NO_MEM: Memory allocation for the payload failed.
+ *     - ESP_OK: The WebSocket frame was received and handled, or the client is being disconnected.
  *     - Other esp_err_t codes: Errors from the underlying WebSocket frame
  *       reception function.
  */
 static esp_err_t receive_and_handle_frame(httpd_req_t *req) {
+    const int fd = httpd_req_to_sockfd(req);
     httpd_ws_frame_t frame = {};
     esp_err_t ret = httpd_ws_recv_frame(req, &frame, 0);
     if (ret != ESP_OK) {
@@ -183,29 +1113,152 @@ static esp_err_t receive_and_handle_frame(httpd_req_t *req) {
     }
 
     ESP_LOGD("websocket_server", "Received frame: type=%d, len=%d", frame.type, frame.len);
+    record_activity(fd, frame.type == HTTPD_WS_TYPE_PONG, frame.len);
 
-    if (frame.len > 0) {
-        auto *buf = static_cast<uint8_t *>(calloc(1, frame.len + 1));
-        if (!buf) {
-            ESP_LOGE("websocket_server", "Memory allocation failed for payload");
-            return ESP_ERR_NO_MEM;
+    if (frame.type != HTTPD_WS_TYPE_TEXT && frame.type != HTTPD_WS_TYPE_BINARY &&
+        frame.type != HTTPD_WS_TYPE_CONTINUE) {
+        return receive_control_frame(req, frame, fd);
+    }
+
+    ws_client_t *client = find_receiving_client(fd);
+    if (!client) {
+        ESP_LOGW("websocket_server", "Frame from unknown client fd=%d", fd);
+        return ESP_FAIL;
+    }
+
+    // A text or binary frame starts a message, a continuation frame extends the one being received
+    const bool starts_message = frame.type != HTTPD_WS_TYPE_CONTINUE;
+    if (starts_message == (client->rx_buffer >= 0)) {
+        close_client(fd, CLOSE_PROTOCOL_ERROR, starts_message ? "message interleaved with a fragmented one"
+                                                              : "continuation frame without a message");
+        return ESP_OK;
+    }
+    if (frame.len > MAX_INBOUND_MESSAGE - client->rx_len) {
+        close_client(fd, CLOSE_MESSAGE_TOO_BIG, "message too big");
+        return ESP_OK;
+    }
+    if (starts_message) {
+        if (frame.type != frame_type(client->protocol)) {
+            close_client(fd, CLOSE_UNSUPPORTED_DATA, client->protocol == WS_PROTOCOL_CBOR
+                                                         ? "text message on a CBOR session"
+                                                         : "binary message on a JSON session");
+            return ESP_OK;
         }
-        frame.payload = buf;
+        client->rx_buffer = acquire_rx_buffer();
+        if (client->rx_buffer < 0) {
+            close_client(fd, CLOSE_TRY_AGAIN_LATER, "no receive buffer left");
+            return ESP_OK;
+        }
+        client->rx_len = 0;
+    }
+
+    uint8_t *buf = rx_buffers[client->rx_buffer];
+    if (frame.len > 0) {
+        frame.payload = buf + client->rx_len;
         ret = httpd_ws_recv_frame(req, &frame, frame.len);
-        if (ret == ESP_OK) {
-            process_frame(frame, httpd_req_to_sockfd(req));
-        } else {
+        if (ret != ESP_OK) {
             ESP_LOGE("websocket_server", "Failed to receive payload: %s", esp_err_to_name(ret));
+            release_rx_buffer(*client);
+            return ret;
         }
-        free(buf);
-    } else {
-        frame.payload = nullptr;
-        process_frame(frame, httpd_req_to_sockfd(req));
+        client->rx_len += frame.len;
     }
+    if (!frame.final) return ESP_OK;
 
-    return ret;
+    buf[client->rx_len] = '\0';
+    if (message_handler) message_handler(fd, client->protocol, reinterpret_cast<char *>(buf), client->rx_len);
+    release_rx_buffer(*client);
+    return ESP_OK;
+}
+
+// ---- METRICS ----
+
+#if CONFIG_WEBSOCKET_METRICS
+/**
+ * Sends a chunk of the metrics document. Matches `metrics_sink_t`.
+ */
+static esp_err_t send_metrics_chunk(void *ctx, const char *data, const size_t len) {
+    return httpd_resp_send_chunk(static_cast<httpd_req_t *>(ctx), data, static_cast<ssize_t>(len));
+}
+
+/**
+ * Renders the metrics of the server.
+ */
+static void write_server_metrics(metrics_writer_t *writer) {
+    // Totals of every client since the server started, copied so that rendering runs without the lock
+    ws_client_stats_t totals = {};
+    uint32_t eviction_counts[EVICTION_REASON_COUNT];
+    size_t connected[2] = {};
+    size_t queued_messages = 0;
+    portENTER_CRITICAL(&clients_lock);
+    add_client_totals(closed_client_totals, &totals);
+    for (const auto &client: clients) {
+        if (!client.active) continue;
+        add_client_totals(client.stats, &totals);
+        connected[client.protocol]++;
+        queued_messages += client.queue_count;
+    }
+    memcpy(eviction_counts, evictions, sizeof(eviction_counts));
+    portEXIT_CRITICAL(&clients_lock);
+
+    metrics_write_family(writer, "ws_clients", "gauge", "Connected WebSocket clients.");
+    metrics_write_uint(writer, "ws_clients", "protocol", "json", connected[WS_PROTOCOL_JSON]);
+    metrics_write_uint(writer, "ws_clients", "protocol", "cbor", connected[WS_PROTOCOL_CBOR]);
+
+    metrics_write_family(writer, "ws_frames_received_total", "counter", "Frames received, control frames included.");
+    metrics_write_uint(writer, "ws_frames_received_total", nullptr, nullptr, totals.received);
+    metrics_write_family(writer, "ws_received_bytes_total", "counter", "Payload bytes of the frames received.");
+    metrics_write_uint(writer, "ws_received_bytes_total", nullptr, nullptr, totals.received_bytes);
+
+    metrics_write_family(writer, "ws_messages_sent_total", "counter", "Messages sent.");
+    metrics_write_uint(writer, "ws_messages_sent_total", nullptr, nullptr, totals.sent);
+    metrics_write_family(writer, "ws_sent_bytes_total", "counter", "Bytes of the messages sent, as put on the wire.");
+    metrics_write_uint(writer, "ws_sent_bytes_total", nullptr, nullptr, totals.sent_bytes);
+    metrics_write_family(writer, "ws_send_failures_total", "counter", "Sends that failed.");
+    metrics_write_uint(writer, "ws_send_failures_total", nullptr, nullptr, totals.send_failures);
+    metrics_write_family(writer, "ws_messages_dropped_total", "counter",
+                         "Messages dropped by their overflow policy.");
+    metrics_write_uint(writer, "ws_messages_dropped_total", nullptr, nullptr, totals.dropped);
+    metrics_write_family(writer, "ws_messages_coalesced_total", "counter",
+                         "Queued messages replaced by a newer one of the same topic.");
+    metrics_write_uint(writer, "ws_messages_coalesced_total", nullptr, nullptr, totals.coalesced);
+    metrics_write_family(writer, "ws_queued_messages", "gauge", "Messages waiting in the outbound queues.");
+    metrics_write_uint(writer, "ws_queued_messages", nullptr, nullptr, queued_messages);
+
+    metrics_write_family(writer, "ws_evictions_total", "counter", "Clients disconnected by the server.");
+    metrics_write_uint(writer, "ws_evictions_total", "reason", "keep_alive", eviction_counts[EVICTION_KEEP_ALIVE]);
+    metrics_write_uint(writer, "ws_evictions_total", "reason", "slow_consumer",
+                       eviction_counts[EVICTION_SLOW_CONSUMER]);
+    metrics_write_uint(writer, "ws_evictions_total", "reason", "protocol_error", eviction_counts[EVICTION_PROTOCOL]);
+
+    ws_handshake_stats_t handshakes;
+    websocket_get_handshake_stats(&handshakes);
+    metrics_write_family(writer, "tls_handshakes_failed_total", "counter", "TLS handshakes that failed.");
+    metrics_write_uint(writer, "tls_handshakes_failed_total", nullptr, nullptr, handshakes.failed);
+    metrics_write_family(writer, "tls_handshake_seconds", "summary", "Duration of the completed TLS handshakes.");
+    metrics_write_seconds(writer, "tls_handshake_seconds_sum", "kind", "full", handshakes.full_us);
+    metrics_write_uint(writer, "tls_handshake_seconds_count", "kind", "full", handshakes.full);
+    metrics_write_seconds(writer, "tls_handshake_seconds_sum", "kind", "resumed", handshakes.resumed_us);
+    metrics_write_uint(writer, "tls_handshake_seconds_count", "kind", "resumed", handshakes.resumed);
 }
 
+/**
+ * Serves /metrics in the Prometheus text format. The document is streamed in chunks as it is rendered.
+ */
+static esp_err_t metrics_uri_handler(httpd_req_t *req) {
+    httpd_resp_set_type(req, "text/plain; version=0.0.4; charset=utf-8");
+
+    metrics_writer_t writer;
+    metrics_writer_init(&writer, send_metrics_chunk, req);
+    write_server_metrics(&writer);
+    if (metrics_handler) metrics_handler(&writer);
+    const esp_err_t err = metrics_writer_finish(&writer);
+    if (err != ESP_OK) return err;
+
+    return httpd_resp_send_chunk(req, nullptr, 0);
+}
+#endif
+
 /**
  * Handles incoming websocket requests and processes connection or message frames.
  *
@@ -220,24 +1273,68 @@ static esp_err_t websocket_handler(httpd_req_t *req) {
     const int fd = httpd_req_to_sockfd(req);
 
     if (req->method == HTTP_GET) {
-        ESP_LOGI("websocket_server", "Client connected: fd=%d", fd);
+        ws_protocol_t protocol;
+        bool deflate;
+        if (!negotiate_protocol(req, &protocol, &deflate)) {
+            ESP_LOGW("websocket_server", "Client fd=%d requested an unsupported protocol", fd);
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        if (!add_client(fd, protocol, deflate)) {
+            ESP_LOGW("websocket_server", "No room for client fd=%d", fd);
+            return ESP_FAIL;
+        }
+
+        ESP_LOGI("websocket_server", "Client connected: fd=%d, protocol=%s%s", fd,
+                 protocol == WS_PROTOCOL_CBOR ? "cbor" : "json", deflate ? ", deflate" : "");
+        // From now on, events of the protocol are kept for clients that reconnect
+        portENTER_CRITICAL(&replay_lock);
+        replay_rings[protocol].enabled = true;
+        portEXIT_CRITICAL(&replay_lock);
+
         wss_keep_alive_add_client(keep_alive, fd);
+        if (connected_handler) connected_handler(fd, protocol);
         return ESP_OK;
     }
 
     return receive_and_handle_frame(req);
 }
-esp_err_t websocket_server_start(const ws_inbound_message_handler_t message_handler_fun) {
+esp_err_t websocket_server_start(const ws_inbound_message_handler_t message_handler_fun,
+                                 const ws_client_connected_handler_t connected_handler_fun) {
     // Prevent starting if the server is already running
     if (server) return ESP_FAIL;
 
     // Set user-provided handler for message processing
     message_handler = message_handler_fun;
+    connected_handler = connected_handler_fun;
+    for (auto &client: clients) {
+        client.active = false;
+    }
+    for (auto &used: rx_buffer_used) {
+        used = false;
+    }
+    ready_slots = 0;
+    pending_slots = 0;
+    drain_scheduled = false;
+    clear_replay_rings();
+    if (!topics_lock) {
+        topics_lock = xSemaphoreCreateMutex();
+        if (!topics_lock) return ESP_ERR_NO_MEM;
+    }
+#if CONFIG_WEBSOCKET_DEFLATE
+    if (!deflate_lock) {
+        deflate_lock = xSemaphoreCreateMutex();
+        if (!deflate_lock) return ESP_ERR_NO_MEM;
+    }
+#endif
 
     // Configure keep-alive: handle inactive clients and ping checking
     wss_keep_alive_config_t ka_cfg = KEEP_ALIVE_CONFIG_DEFAULT();
+    ka_cfg.max_clients = MAX_CLIENTS;
     ka_cfg.client_not_alive_cb = [](wss_keep_alive_t h, const int fd) {
         // Close the session if a client fails to keep-alive
+        portENTER_CRITICAL(&clients_lock);
+        evictions[EVICTION_KEEP_ALIVE]++;
+        portEXIT_CRITICAL(&clients_lock);
         httpd_sess_trigger_close(wss_keep_alive_get_user_ctx(h), fd);
         return true;
     };
@@ -245,6 +1342,8 @@ esp_err_t websocket_server_start(const ws_inbound_message_handler_t message_hand
         // Send ping to verify if a client is alive
         return send_ping_to_client(h, fd);
     };
+    // Received frames are stamped on the client, so busy clients are not pinged
+    ka_cfg.get_client_activity_cb = get_client_activity;
 
     // Start the keep-alive monitor
     keep_alive = wss_keep_alive_start(&ka_cfg);
@@ -267,9 +1366,26 @@ esp_err_t websocket_server_start(const ws_inbound_message_handler_t message_hand
     httpd_register_uri_handler(server, &ws_uri);
     wss_keep_alive_set_user_ctx(keep_alive, server);
 
+#if CONFIG_WEBSOCKET_METRICS
+    static constexpr httpd_uri_t metrics_uri = {
+        .uri = METRICS_URI,
+        .method = HTTP_GET,
+        .handler = metrics_uri_handler
+    };
+    httpd_register_uri_handler(server, &metrics_uri);
+#endif
+
     return ESP_OK;
 }
 
+void websocket_server_set_metrics_handler(const ws_metrics_handler_t handler) {
+    metrics_handler = handler;
+}
+
+void websocket_server_set_disconnected_handler(const ws_client_disconnected_handler_t handler) {
+    disconnected_handler = handler;
+}
+
 esp_err_t websocket_server_stop() {
     // Prevent stopping if the server is not running
     if (!server) return ESP_FAIL;
@@ -285,41 +1401,192 @@ esp_err_t websocket_server_stop() {
     return ret;
 }
 
-esp_err_t websocket_send_message_to_client(const int fd, const char *message) {
+esp_err_t websocket_send_to_client(const int fd, const ws_protocol_t protocol, const uint8_t *data,
+                                   const size_t len) {
     // Validate server state and message input
-    if (!server || !message) return ESP_ERR_INVALID_ARG;
+    if (!server || !data) return ESP_ERR_INVALID_ARG;
 
-    // Allocate and prepare an async send task
-    auto *arg = static_cast<AsyncSendArg *>(malloc(sizeof(AsyncSendArg)));
-    if (!arg) return ESP_ERR_NO_MEM;
+    // Replies must not be lost: a client that cannot take them is disconnected
+    size_t queued;
+    const esp_err_t ret = queue_message(protocol, nullptr, 0, WS_OVERFLOW_DISCONNECT, data, len,
+                                        [fd](size_t, const ws_client_t &client) {
+                                            return client.fd == fd;
+                                        }, &queued);
+    if (ret != ESP_OK) return ret;
+    return queued > 0 ? ESP_OK : ESP_FAIL;
+}
 
-    arg->httpd_handle = server;
-    arg->client_fd = fd;
-    arg->message = strdup(message);
-    if (!arg->message) {
-        free(arg);
-        return ESP_ERR_NO_MEM;
-    }
+esp_err_t websocket_send_message_to_client(const int fd, const char *message) {
+    if (!message) return ESP_ERR_INVALID_ARG;
+    return websocket_send_to_client(fd, WS_PROTOCOL_JSON, reinterpret_cast<const uint8_t *>(message),
+                                    strlen(message));
+}
+
+esp_err_t websocket_broadcast(const ws_protocol_t protocol, const char *topic, const uint64_t seq,
+                              const ws_overflow_policy_t policy, const uint8_t *data, const size_t len) {
+    // Validate input
+    if (!server || !data) return ESP_ERR_INVALID_ARG;
 
-    // Queue task for asynchronous WebSocket transmission
-    return httpd_queue_work(server, async_send_task, arg);
+    const uint32_t subscribers = topic ? topic_filter_match(topic) : UINT32_MAX;
+    const auto matches = [protocol, subscribers](const size_t slot, const ws_client_t &client) {
+        return client.protocol == protocol && (!client.filtered || (subscribers & (1u << slot)));
+    };
+
+    // Every recipient's queue shares one copy of the message, or of its compressed form
+    size_t queued;
+    return queue_message(protocol, topic, seq, policy, data, len, matches, &queued);
 }
 
 esp_err_t websocket_broadcast_message(const char *message) {
-    // Validate input
-    if (!server || !message) return ESP_ERR_INVALID_ARG;
+    if (!message) return ESP_ERR_INVALID_ARG;
+    return websocket_broadcast(WS_PROTOCOL_JSON, nullptr, 0, WS_OVERFLOW_DROP_OLDEST,
+                               reinterpret_cast<const uint8_t *>(message), strlen(message));
+}
+
+ws_protocol_t websocket_get_client_protocol(const int fd) {
+    ws_protocol_t protocol = WS_PROTOCOL_JSON;
+    portENTER_CRITICAL(&clients_lock);
+    for (const auto &client: clients) {
+        if (client.active && client.fd == fd) {
+            protocol = client.protocol;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&clients_lock);
+    return protocol;
+}
 
-    // Retrieve a list of connected WebSocket clients
-    int fds[MAX_CLIENTS];
-    size_t count = MAX_CLIENTS;
-    if (httpd_get_client_list(server, &count, fds) != ESP_OK) return ESP_FAIL;
+size_t websocket_get_subscriber_count(const ws_protocol_t protocol, const char *topic) {
+    const uint32_t subscribers = topic ? topic_filter_match(topic) : UINT32_MAX;
 
-    // Iterate and send a message to all active WebSocket clients
-    for (size_t i = 0; i < count; ++i) {
-        if (httpd_ws_get_fd_info(server, fds[i]) == HTTPD_WS_CLIENT_WEBSOCKET) {
-            websocket_send_message_to_client(fds[i], message);
+    // Evicted clients are skipped like in websocket_broadcast, as they would not receive the message
+    size_t count = 0;
+    portENTER_CRITICAL(&clients_lock);
+    for (uint32_t remaining = ready_slots; remaining != 0; remaining &= remaining - 1) {
+        const size_t i = __builtin_ctz(remaining);
+        const ws_client_t &client = clients[i];
+        count += client.protocol == protocol && (!client.filtered || (subscribers & (1u << i)));
+    }
+    portEXIT_CRITICAL(&clients_lock);
+    return count;
+}
+
+esp_err_t websocket_set_client_topics(const int fd, const char *topics) {
+    if (!topics_lock) return ESP_ERR_INVALID_STATE;
+    if (topics && strlen(topics) >= MAX_TOPICS_LEN) return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(topics_lock, portMAX_DELAY);
+
+    // Topics only change under topics_lock, so the other clients' patterns can be read without clients_lock
+    int slot = -1;
+    const char *patterns[MAX_CLIENTS] = {};
+    portENTER_CRITICAL(&clients_lock);
+    for (size_t i = 0; i < MAX_CLIENTS; ++i) {
+        if (!clients[i].active) continue;
+        if (clients[i].fd == fd) {
+            slot = static_cast<int>(i);
+            patterns[i] = topics;
+        } else if (clients[i].filtered) {
+            patterns[i] = clients[i].topics;
+        }
+    }
+    portEXIT_CRITICAL(&clients_lock);
+
+    esp_err_t ret = slot < 0 ? ESP_ERR_NOT_FOUND : topic_filter_build(patterns, MAX_CLIENTS);
+    if (ret == ESP_OK) {
+        portENTER_CRITICAL(&clients_lock);
+        ws_client_t &client = clients[slot];
+        if (client.active && client.fd == fd) {
+            client.filtered = topics != nullptr;
+            if (topics) strcpy(client.topics, topics);
+        } else {
+            ret = ESP_ERR_NOT_FOUND;
         }
+        portEXIT_CRITICAL(&clients_lock);
     }
 
+    xSemaphoreGive(topics_lock);
+    return ret;
+}
+
+esp_err_t websocket_get_client_stats(const int fd, ws_client_stats_t *stats) {
+    if (!stats) return ESP_ERR_INVALID_ARG;
+
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    portENTER_CRITICAL(&clients_lock);
+    for (const auto &client: clients) {
+        if (client.active && client.fd == fd) {
+            get_client_stats(client, stats);
+            ret = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&clients_lock);
+    return ret;
+}
+
+size_t websocket_get_all_client_stats(ws_client_stats_t *stats, const size_t max_count) {
+    size_t count = 0;
+    portENTER_CRITICAL(&clients_lock);
+    for (const auto &client: clients) {
+        if (count == max_count) break;
+        if (client.active) get_client_stats(client, &stats[count++]);
+    }
+    portEXIT_CRITICAL(&clients_lock);
+    return count;
+}
+
+bool websocket_replay_enabled(const ws_protocol_t protocol) {
+    portENTER_CRITICAL(&replay_lock);
+    const bool enabled = replay_rings[protocol].enabled;
+    portEXIT_CRITICAL(&replay_lock);
+    return enabled;
+}
+
+esp_err_t websocket_replay_events(const int fd, const uint64_t after_seq, const ws_replay_visitor_t visitor,
+                                  void *ctx) {
+    if (!visitor) return ESP_ERR_INVALID_ARG;
+
+    int slot = -1;
+    ws_protocol_t protocol = WS_PROTOCOL_JSON;
+    bool filtered = false;
+    portENTER_CRITICAL(&clients_lock);
+    for (size_t i = 0; i < MAX_CLIENTS; ++i) {
+        if (clients[i].active && clients[i].fd == fd) {
+            slot = static_cast<int>(i);
+            protocol = clients[i].protocol;
+            filtered = clients[i].filtered;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&clients_lock);
+    if (slot < 0) return ESP_ERR_NOT_FOUND;
+
+    // Take references to the missed events, then visit them without holding the lock
+    SharedPayload *events[REPLAY_RING_LENGTH];
+    size_t event_count = 0;
+    portENTER_CRITICAL(&replay_lock);
+    const ws_replay_ring_t &ring = replay_rings[protocol];
+    const bool complete = after_seq >= ring.dropped_seq && after_seq <= ring.last_seq;
+    for (size_t i = 0; complete && i < ring.count; ++i) {
+        SharedPayload *event = ring.events[(ring.head + i) % REPLAY_RING_LENGTH];
+        if (event->seq <= after_seq) continue;
+        event->refs.fetch_add(1, std::memory_order_relaxed);
+        events[event_count++] = event;
+    }
+    portEXIT_CRITICAL(&replay_lock);
+    if (!complete) return ESP_ERR_INVALID_STATE;
+
+    for (size_t i = 0; i < event_count; ++i) {
+        SharedPayload *event = events[i];
+        if (!filtered || !event->topic || (topic_filter_match(event->topic) & (1u << slot))) {
+            visitor(event->message, event->len, ctx);
+        }
+        release_shared_payload(event);
+    }
     return ESP_OK;
 }
+
+void websocket_get_handshake_stats(ws_handshake_stats_t *stats) {
+    tls_get_handshake_stats(stats);
+}
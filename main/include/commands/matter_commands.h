@@ -2,12 +2,16 @@
 #define COMMANDS_H
 
 #include <esp_event.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Size of a subscription formatted by `execute_subscriptions_get_command`, including the terminator.
+#define MATTER_SUBSCRIPTION_TEXT_SIZE 144
+
 /**
  * Initializes the Matter controller to handle commands within a Matter-enabled network.
  *
@@ -50,29 +54,119 @@ esp_err_t execute_cmd_invoke_command(uint64_t destination_id, uint16_t endpoint_
 /**
  * Executes an attribute read command for a specific node, endpoint, cluster, and attribute.
  *
+ * A read accepting a value up to `max_age_ms` old is answered from the last reported value when it is recent
+ * enough, without querying the node: the client is sent the stored value as an attribute report. Otherwise a
+ * read of the same attribute already in flight is joined rather than sending another one.
+ *
+ * @param fd The client that sent the read.
  * @param node_id The unique identifier of the target node.
  * @param endpoint_id The endpoint on the node where the attribute resides.
  * @param cluster_id The identifier of the cluster to which the attribute belongs.
  * @param attribute_id The identifier of the attribute to be read.
+ * @param max_age_ms Oldest stored value accepted, in milliseconds, or 0 to always query the node.
+ * @param cached Set to whether the read was answered from a stored value.
+ * @param age_ms Set to the age of the stored value if `cached`.
+ * @param joined Set to whether an outstanding read of the attribute was joined.
  * @return An esp_err_t indicating success or the type of error encountered during execution.
  */
-esp_err_t execute_attr_read_command(uint64_t node_id, uint16_t endpoint_id, uint32_t cluster_id,
-                                    uint32_t attribute_id);
+esp_err_t execute_attr_read_command(int fd, uint64_t node_id, uint16_t endpoint_id, uint32_t cluster_id,
+                                    uint32_t attribute_id, uint32_t max_age_ms, bool *cached, uint32_t *age_ms,
+                                    bool *joined);
 
 /**
  * Executes an attribute subscription command for a specified node, endpoint, cluster, and attribute,
- * with defined minimum and maximum reporting intervals.
+ * with defined minimum and maximum reporting intervals. The subscription is held for the client and shared
+ * with the clients holding the same one.
  *
+ * @param fd The client the subscription is held for.
  * @param node_id ID of the target node for the subscription command.
  * @param endpoint_id ID of the endpoint where the attribute is located.
  * @param cluster_id ID of the cluster to which the attribute belongs.
  * @param attribute_id ID of the attribute to be subscribed.
  * @param min_interval Minimum reporting interval, in seconds.
  * @param max_interval Maximum reporting interval, in seconds.
+ * @param handle Set to the registry handle of the subscription.
+ * @param shared Set to whether an existing subscription was shared.
  * @return `ESP_OK` on success, or an appropriate error code if the command fails.
  */
-esp_err_t execute_attr_subscribe_command(uint64_t node_id, uint16_t endpoint_id, uint32_t cluster_id,
-                                         uint32_t attribute_id, uint16_t min_interval, uint16_t max_interval);
+esp_err_t execute_attr_subscribe_command(int fd, uint64_t node_id, uint16_t endpoint_id, uint32_t cluster_id,
+                                         uint32_t attribute_id, uint16_t min_interval, uint16_t max_interval,
+                                         uint32_t *handle, bool *shared);
+
+/**
+ * Reads several attribute paths of a node in one request. Paths whose read is already in flight join it.
+ *
+ * @param node_id ID of the target node.
+ * @param paths Comma-separated list of `endpoint/cluster/attribute` paths, e.g. "1/0x6/0,0/0x28/0x1". Each ID is
+ *              decimal or 0x-prefixed hexadecimal, or `*` for a wildcard.
+ * @param path_count Set to the number of paths parsed.
+ * @param joined_count Set to the number of paths that joined an outstanding read.
+ * @return `ESP_OK` on success, `ESP_ERR_INVALID_ARG` for a malformed list, `ESP_ERR_INVALID_SIZE` for more than
+ *         MATTER_MAX_READ_PATHS paths, or an appropriate error code if the read fails.
+ */
+esp_err_t execute_attrs_read_command(uint64_t node_id, const char *paths, size_t *path_count, size_t *joined_count);
+
+/**
+ * Subscribes to several attribute paths of a node with a single subscription, held for the client like
+ * those of `execute_attr_subscribe_command`.
+ *
+ * @param fd The client the subscription is held for.
+ * @param node_id ID of the target node.
+ * @param paths Attribute paths, in the format of `execute_attrs_read_command`.
+ * @param min_interval Minimum reporting interval, in seconds.
+ * @param max_interval Maximum reporting interval, in seconds.
+ * @param path_count Set to the number of paths parsed.
+ * @param handle Set to the registry handle of the subscription.
+ * @param shared Set to whether an existing subscription was shared.
+ * @return `ESP_OK` on success, `ESP_ERR_INVALID_ARG` for a malformed list, `ESP_ERR_INVALID_SIZE` for more than
+ *         MATTER_MAX_SUBSCRIBE_PATHS paths, or an appropriate error code if the subscription fails.
+ */
+esp_err_t execute_attrs_subscribe_command(int fd, uint64_t node_id, const char *paths, uint16_t min_interval,
+                                          uint16_t max_interval, size_t *path_count, uint32_t *handle,
+                                          bool *shared);
+
+/**
+ * Releases a subscription held by a client. The subscription is shut down once no client holds it.
+ *
+ * @param fd The client.
+ * @param handle Registry handle of the subscription.
+ * @return `ESP_OK` on success, `ESP_ERR_NOT_FOUND` if the client does not hold the subscription, or an
+ *         appropriate error code otherwise.
+ */
+esp_err_t execute_subscription_cancel_command(int fd, uint32_t handle);
+
+/**
+ * Lists the subscriptions of the controller, each formatted as
+ * `<handle> <node_id> <paths> <subscription_id> <subscribers>`: the node and subscription IDs in hexadecimal,
+ * the paths in the format of `execute_attrs_read_command`, and `-` for the ID of a subscription the node has
+ * not established yet. Subscriptions beyond `max` are left out.
+ *
+ * @param subscriptions Receives up to `max` formatted subscriptions.
+ * @param max Capacity of `subscriptions`.
+ * @param count Set to the number of subscriptions written.
+ * @return `ESP_OK`.
+ */
+esp_err_t execute_subscriptions_get_command(char (*subscriptions)[MATTER_SUBSCRIPTION_TEXT_SIZE], size_t max,
+                                            size_t *count);
+
+/**
+ * Releases every subscription held by a client that disconnected. Registered with
+ * `websocket_server_set_disconnected_handler`.
+ *
+ * @param fd The client.
+ */
+void release_client_subscriptions(int fd);
+
+struct matter_batch_op;
+
+/**
+ * Executes a batch of Matter invoke, read and subscribe operations under a single CHIP stack lock.
+ *
+ * @param ops The operations to issue, in order. The outcome of each is stored in its `result` field.
+ * @param count Number of operations.
+ * @return `ESP_OK` if the batch was processed, or an error code if the CHIP stack could not be locked.
+ */
+esp_err_t execute_matter_batch_command(struct matter_batch_op *ops, size_t count);
 
 
 #ifdef __cplusplus
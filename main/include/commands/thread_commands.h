@@ -2,6 +2,7 @@
 #define THREAD_COMMANDS_H
 
 #include <esp_event.h>
+#include <openthread/dataset.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -119,24 +120,16 @@ esp_err_t execute_thread_attached_get_command(bool *is_attached);
 esp_err_t execute_thread_role_get_command(const char **role_str);
 
 /**
- * @brief Fetches the active Thread network dataset and serializes it into a JSON string.
+ * @brief Fetches the active Thread network dataset.
  *
- * This function retrieves the active Thread dataset, including details such as the network name,
- * channel, PAN ID, extended PAN ID, and mesh local prefix. The data is formatted into a JSON
- * string and stored in the provided buffer. If the dataset cannot be retrieved or memory
- * allocation for the JSON object fails, the function returns an error.
- *
- * @param[out] json_buf Pointer to a buffer where the JSON string representation of the dataset
- *                      will be stored.
- * @param[in] buf_size  Size of the provided buffer in bytes. The JSON string will be truncated
- *                      if it exceeds this size.
+ * @param[out] dataset Filled with the active operational dataset, including the network name,
+ *                     channel, PAN ID, extended PAN ID and mesh local prefix.
  *
  * @return
  *         - ESP_OK on success.
- *         - ESP_FAIL if the dataset could not be retrieved or JSON serialization fails.
- *         - ESP_ERR_NO_MEM if memory allocation for the JSON object fails.
+ *         - ESP_FAIL if the dataset could not be retrieved.
  */
-esp_err_t execute_thread_active_dataset_get_command(char *json_buf, size_t buf_size);
+esp_err_t execute_thread_active_dataset_get_command(otOperationalDataset *dataset);
 
 /**
  * @brief Retrieves the list of unicast addresses for the Thread network.
@@ -0,0 +1,202 @@
+#ifndef CBOR_H
+#define CBOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Major types of RFC 8949.
+#define CBOR_MAJOR_UINT 0
+#define CBOR_MAJOR_NEGINT 1
+#define CBOR_MAJOR_BYTES 2
+#define CBOR_MAJOR_TEXT 3
+#define CBOR_MAJOR_ARRAY 4
+#define CBOR_MAJOR_MAP 5
+#define CBOR_MAJOR_TAG 6
+#define CBOR_MAJOR_SIMPLE 7
+
+// The input is not valid CBOR or uses a feature the tokenizer does not support.
+#define CBOR_TOKENIZE_ERROR_INVALID (-1)
+// The input is valid so far but needs more tokens or deeper nesting than the caller allows.
+#define CBOR_TOKENIZE_ERROR_LIMIT (-2)
+
+// Maximum nesting depth of arrays and maps accepted by the tokenizer.
+#define CBOR_TOKENIZE_MAX_DEPTH 8
+
+// ---- ENCODING ----
+
+/**
+ * Output buffer for CBOR encoding.
+ *
+ * Output goes to a caller-provided buffer. When the buffer is too small, the writer moves to a heap buffer
+ * and keeps going. Write errors are sticky: once an allocation fails, `failed` is set and further writes
+ * are ignored, so callers only need to check the writer once after encoding a whole message.
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+    // Whether `buf` was allocated by the writer.
+    bool owned;
+    bool failed;
+} cbor_writer_t;
+
+/**
+ * Initializes an empty writer on top of a caller-provided buffer.
+ *
+ * @param writer The writer.
+ * @param buf Initial output buffer. May be null, in which case the writer starts on the heap.
+ * @param cap Capacity of `buf` in bytes.
+ */
+void cbor_writer_init(cbor_writer_t *writer, uint8_t *buf, size_t cap);
+
+/**
+ * Releases the heap buffer of a writer, if it moved to one.
+ */
+void cbor_writer_release(cbor_writer_t *writer);
+
+/**
+ * Writes an unsigned integer.
+ */
+void cbor_write_uint(cbor_writer_t *writer, uint64_t value);
+
+/**
+ * Writes a signed integer, using the negative integer major type for values below zero.
+ */
+void cbor_write_int(cbor_writer_t *writer, int64_t value);
+
+/**
+ * Writes a UTF-8 text string of `len` bytes.
+ */
+void cbor_write_text(cbor_writer_t *writer, const char *text, size_t len);
+
+/**
+ * Writes a byte string of `len` bytes.
+ */
+void cbor_write_bytes(cbor_writer_t *writer, const uint8_t *data, size_t len);
+
+/**
+ * Writes `true` or `false`.
+ */
+void cbor_write_bool(cbor_writer_t *writer, bool value);
+
+/**
+ * Writes `null`.
+ */
+void cbor_write_null(cbor_writer_t *writer);
+
+/**
+ * Writes a double-precision float.
+ */
+void cbor_write_double(cbor_writer_t *writer, double value);
+
+/**
+ * Writes a data item that is already encoded, such as a complete earlier message, without validating it.
+ */
+void cbor_write_encoded(cbor_writer_t *writer, const uint8_t *data, size_t len);
+
+/**
+ * Opens an array or map whose size is not known yet.
+ *
+ * @param writer The writer.
+ * @param major CBOR_MAJOR_ARRAY or CBOR_MAJOR_MAP.
+ * @return Offset of the container header, to be passed to `cbor_end_container`.
+ */
+size_t cbor_begin_container(cbor_writer_t *writer, uint8_t major);
+
+/**
+ * Closes a container opened with `cbor_begin_container` by patching its header with the final size.
+ *
+ * The container is encoded with a definite length, shifting its contents when the size needs more than
+ * the single header byte reserved when it was opened.
+ *
+ * @param writer The writer.
+ * @param offset The value returned by `cbor_begin_container`.
+ * @param major The major type the container was opened with.
+ * @param count Number of elements of an array, or number of key/value pairs of a map.
+ */
+void cbor_end_container(cbor_writer_t *writer, size_t offset, uint8_t major, size_t count);
+
+// ---- DECODING ----
+
+/**
+ * Kind of CBOR data item a token refers to.
+ */
+typedef enum {
+    CBOR_TOKEN_UINT,
+    CBOR_TOKEN_NEGINT,
+    CBOR_TOKEN_BYTES,
+    CBOR_TOKEN_TEXT,
+    CBOR_TOKEN_ARRAY,
+    CBOR_TOKEN_MAP,
+    // false, true, null or undefined; `value` holds the simple value (20 to 23).
+    CBOR_TOKEN_SIMPLE,
+    // Half, single or double-precision float; `value` holds the raw bits.
+    CBOR_TOKEN_FLOAT,
+} cbor_token_type_t;
+
+/**
+ * A single CBOR data item located inside the input buffer.
+ *
+ * Tokens are stored in document order. Map entries are emitted as a key token immediately followed by the
+ * value token. Tags are skipped; the token describes the tagged item.
+ */
+typedef struct {
+    cbor_token_type_t type;
+    // Offset of the content of a byte or text string, or of the item header otherwise.
+    uint32_t start;
+    // Integer value, raw float bits, simple value, string length in bytes or number of container children
+    // (elements for arrays, key/value pairs for maps). Negative integers store -1 - n.
+    uint64_t value;
+    // Index of the first token after this item and all of its children.
+    uint16_t next;
+} cbor_token_t;
+
+/**
+ * Tokenizes a CBOR data item without allocating memory and without modifying the input.
+ *
+ * Indefinite-length items are not supported and reported as invalid.
+ *
+ * @param data The encoded item.
+ * @param len Length of `data` in bytes. Trailing bytes after the first item are invalid.
+ * @param tokens Caller-provided token array.
+ * @param max_tokens Capacity of `tokens`.
+ * @return Number of tokens produced (the root item is token 0), CBOR_TOKENIZE_ERROR_INVALID if the input is
+ *         not a single well-formed item, or CBOR_TOKENIZE_ERROR_LIMIT if the item does not fit into `tokens`
+ *         or exceeds CBOR_TOKENIZE_MAX_DEPTH.
+ */
+int cbor_tokenize(const uint8_t *data, size_t len, cbor_token_t *tokens, size_t max_tokens);
+
+/**
+ * Finds a map entry by text key.
+ *
+ * @param data The tokenized input.
+ * @param tokens The token array produced by `cbor_tokenize`.
+ * @param map Index of a map token.
+ * @param key Null-terminated key to look up.
+ * @return Index of the entry's value token, or -1 if `map` is not a map or has no such text key.
+ */
+int cbor_map_get(const uint8_t *data, const cbor_token_t *tokens, int map, const char *key);
+
+/**
+ * Null-terminates a text string token in place and returns it as a C string.
+ *
+ * The terminator overwrites the byte following the string, which belongs to the header of the next item
+ * (or lies past the end of the input, so the buffer must hold one extra byte). Tokens keep all decoded
+ * header values, so this is safe once tokenization has finished. Text containing NUL bytes is truncated.
+ *
+ * @param data The tokenized, writable input.
+ * @param token A text string token.
+ * @return The string inside `data`.
+ */
+char *cbor_text_terminate(uint8_t *data, const cbor_token_t *token);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CBOR_H
@@ -0,0 +1,101 @@
+#ifndef COMMAND_EXECUTOR_H
+#define COMMAND_EXECUTOR_H
+
+#include "websocket_server.h"
+
+#include <esp_err.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Function executing one inbound message on the executor task.
+ *
+ * @param fd The file descriptor of the client that sent the message.
+ * @param protocol Encoding of the message.
+ * @param message The message, null-terminated at `len`. Writable and owned by the executor until the
+ *                function returns.
+ * @param len Length of the message in bytes.
+ */
+typedef esp_err_t (*command_executor_handler_t)(int fd, ws_protocol_t protocol, char *message, size_t len);
+
+/**
+ * Function notifying a client that its message was not admitted. Runs on the submitting task.
+ *
+ * @param fd The file descriptor of the client that sent the message.
+ * @param protocol Encoding of the message.
+ * @param message The rejected message, writable until the function returns.
+ * @param len Length of the message in bytes.
+ * @param reason ESP_ERR_NO_MEM if the queue was full, ESP_ERR_INVALID_SIZE if the message was too large.
+ */
+typedef void (*command_executor_reject_handler_t)(int fd, ws_protocol_t protocol, char *message, size_t len,
+                                                  esp_err_t reason);
+
+/**
+ * Runtime statistics of the command executor.
+ */
+typedef struct {
+    // Capacity of the queue (CONFIG_COMMAND_EXECUTOR_QUEUE_LENGTH).
+    uint32_t capacity;
+    // Messages currently waiting for the executor.
+    uint32_t depth;
+    // Highest queue depth observed since startup.
+    uint32_t max_depth;
+    // Messages accepted into the queue.
+    uint64_t submitted;
+    // Messages rejected because the queue was full or the message was too large.
+    uint64_t rejected;
+    // Messages executed, and how many of them returned an error.
+    uint64_t completed;
+    uint64_t failed;
+    // Time between admission and start of execution, in microseconds.
+    uint64_t total_wait_us;
+    uint32_t max_wait_us;
+    // Time spent executing a single message, in microseconds.
+    uint64_t total_exec_us;
+    uint32_t max_exec_us;
+} command_executor_stats_t;
+
+/**
+ * Allocates the message buffers and starts the executor task.
+ *
+ * @param handler Function called on the executor task for every admitted message.
+ * @param reject_handler Function called for every message that is not admitted. May be null.
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if already started, ESP_ERR_NO_MEM if the buffers, queues
+ *         or task could not be created.
+ */
+esp_err_t command_executor_start(command_executor_handler_t handler, command_executor_reject_handler_t reject_handler);
+
+/**
+ * Admits an inbound message for asynchronous execution.
+ *
+ * The message is copied into a preallocated buffer and queued; the call never blocks. The outcome of the
+ * command is reported asynchronously by the handler; rejected messages are passed to the reject handler.
+ * Matches `ws_inbound_message_handler_t` so that it can be registered with the WebSocket server directly.
+ *
+ * @param fd The file descriptor of the client that sent the message.
+ * @param protocol Encoding of the message.
+ * @param message The message.
+ * @param len Length of the message in bytes.
+ * @return ESP_OK if the message was queued, ESP_ERR_INVALID_SIZE if it exceeds
+ *         CONFIG_COMMAND_EXECUTOR_MAX_MESSAGE_SIZE, ESP_ERR_NO_MEM if the queue is full, or ESP_ERR_INVALID_STATE
+ *         if the executor is not running.
+ */
+esp_err_t command_executor_submit(int fd, ws_protocol_t protocol, char *message, size_t len);
+
+/**
+ * Returns a snapshot of the executor statistics.
+ *
+ * @param[out] stats Filled with the current statistics.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if `stats` is null.
+ */
+esp_err_t command_executor_get_stats(command_executor_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMAND_EXECUTOR_H
@@ -0,0 +1,152 @@
+#ifndef COMMAND_REGISTRY_H
+#define COMMAND_REGISTRY_H
+
+#include "messages/command_response.h"
+#include "metrics_writer.h"
+
+#include <esp_err.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maximum number of payload fields a single command can declare.
+#define COMMAND_MAX_ARGS 8
+
+/**
+ * Wire type of a single command payload field.
+ */
+typedef enum {
+    // JSON string, passed to the handler as-is.
+    COMMAND_ARG_STRING,
+    // JSON number holding a non-negative integer, range-checked against the descriptor's `max`.
+    COMMAND_ARG_UINT,
+    // Decimal integer carried in a JSON string so that 64-bit values keep their precision, or a native
+    // unsigned integer in CBOR, range-checked against the descriptor's `max`.
+    COMMAND_ARG_UINT_STRING,
+} command_arg_type_t;
+
+/**
+ * Describes one field of a command payload.
+ */
+typedef struct {
+    // Key of the field inside the "payload" object.
+    const char *name;
+    // Expected wire type of the field.
+    command_arg_type_t type;
+    // Upper bound for integer fields. Ignored for strings.
+    uint64_t max;
+    // Whether the field may be left out. A missing field decodes as 0, or as null for strings. Tables leave
+    // it out for required fields.
+    bool optional;
+} command_arg_descriptor_t;
+
+/**
+ * Decoded value of one payload field. Strings point into the inbound message and are only valid while
+ * the handler runs; integers are stored in `num`.
+ */
+typedef struct {
+    const char *str;
+    uint64_t num;
+} command_arg_t;
+
+/**
+ * Decoded payload of a command. `values[i]` corresponds to the i-th field of the command descriptor.
+ */
+typedef struct {
+    size_t count;
+    command_arg_t values[COMMAND_MAX_ARGS];
+    // File descriptor of the client that sent the command.
+    int client_fd;
+} command_args_t;
+
+/**
+ * Executes a command with an already validated and decoded payload.
+ *
+ * @param args The decoded payload.
+ * @param[out] result Empty result to which the handler adds the fields of the response payload.
+ */
+typedef esp_err_t (*command_handler_t)(const command_args_t *args, command_result_t *result);
+
+struct matter_batch_op;
+
+/**
+ * Translates a decoded payload into a Matter operation that can be issued as part of a batch.
+ * String arguments are referenced, not copied.
+ */
+typedef void (*command_batch_builder_t)(const command_args_t *args, struct matter_batch_op *op);
+
+/**
+ * Registry entry binding an action string to its handler and payload layout.
+ */
+typedef struct {
+    // Action name as sent in the "action" field, e.g. "matter.attribute_read".
+    const char *action;
+    // Function executing the command.
+    command_handler_t handler;
+    // Payload fields, in the order the handler expects them in `command_args_t::values`.
+    const command_arg_descriptor_t *args;
+    // Number of entries in `args`.
+    size_t arg_count;
+    // Builds the batch form of the command, or nullptr if the command cannot be part of a batch.
+    command_batch_builder_t batch;
+} command_descriptor_t;
+
+/**
+ * Looks up the registry entry for an action.
+ *
+ * The registry is built at compile time with a perfect hash, so a lookup costs two hashes of the action
+ * string and a single string comparison regardless of how many commands are registered.
+ *
+ * @param action Null-terminated action name.
+ * @return The matching descriptor, or nullptr if the action is unknown.
+ */
+const command_descriptor_t *command_registry_find(const char *action);
+
+/**
+ * Execution statistics of a command since boot.
+ */
+typedef struct {
+    uint32_t executed;
+    // Executions that returned an error.
+    uint32_t failed;
+    // Time from the start of execution until the response was sent.
+    metrics_histogram_t latency;
+} command_stats_t;
+
+/**
+ * Returns the number of registered commands, which are numbered from 0 for `command_registry_at` and
+ * `command_registry_get_stats`.
+ */
+size_t command_registry_count(void);
+
+/**
+ * Returns the registry entry of a command by its number, or nullptr if `index` is out of range.
+ */
+const command_descriptor_t *command_registry_at(size_t index);
+
+/**
+ * Records one execution of a command.
+ *
+ * @param command The registry entry of the command.
+ * @param result What the handler returned.
+ * @param exec_us Duration of the execution in microseconds.
+ */
+void command_registry_record(const command_descriptor_t *command, esp_err_t result, uint32_t exec_us);
+
+/**
+ * Copies the execution statistics of a command.
+ *
+ * @param index Number of the command.
+ * @param[out] stats Filled with the statistics; zeroed if `index` is out of range.
+ */
+void command_registry_get_stats(size_t index, command_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMAND_REGISTRY_H
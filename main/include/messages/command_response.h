@@ -0,0 +1,109 @@
+#ifndef COMMAND_RESPONSE_H
+#define COMMAND_RESPONSE_H
+
+#include <esp_err.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maximum length of a string request ID.
+#define COMMAND_REQUEST_ID_MAX_LEN 64
+// Largest numeric request ID. Numbers above 2^53 cannot be represented exactly by JavaScript clients.
+#define COMMAND_REQUEST_ID_MAX_NUMBER 9007199254740991ULL
+
+// Maximum number of fields in a command result.
+#define COMMAND_RESULT_MAX_FIELDS 12
+// Storage for the strings of a command result, including terminators.
+#define COMMAND_RESULT_ARENA_SIZE 1024
+
+/**
+ * Optional client-chosen identifier of a request, echoed in the response with its original JSON type.
+ */
+typedef struct {
+    bool present;
+    bool is_string;
+    uint64_t number;
+    char string[COMMAND_REQUEST_ID_MAX_LEN + 1];
+} command_request_id_t;
+
+/**
+ * Type of a command result field.
+ */
+typedef enum {
+    COMMAND_RESULT_BOOL,
+    COMMAND_RESULT_UINT,
+    COMMAND_RESULT_STRING,
+    // `count` consecutive null-terminated strings starting at `str`.
+    COMMAND_RESULT_STRING_ARRAY,
+} command_result_type_t;
+
+/**
+ * One field of a command result.
+ */
+typedef struct {
+    // Key of the field. Must be a string with static storage duration.
+    const char *key;
+    command_result_type_t type;
+    bool boolean;
+    uint64_t number;
+    // Points into the owning result's arena.
+    const char *str;
+    size_t count;
+} command_result_field_t;
+
+/**
+ * Payload produced by a command handler, encoded into the response once the handler returns.
+ *
+ * Strings are copied into the result, so handlers may release their own buffers before returning.
+ */
+typedef struct {
+    size_t field_count;
+    command_result_field_t fields[COMMAND_RESULT_MAX_FIELDS];
+    size_t arena_used;
+    char arena[COMMAND_RESULT_ARENA_SIZE];
+} command_result_t;
+
+/**
+ * Removes all fields from a result.
+ */
+void command_result_reset(command_result_t *result);
+
+/**
+ * Adds a boolean field to a result.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the result has no room left.
+ */
+esp_err_t command_result_add_bool(command_result_t *result, const char *key, bool value);
+
+/**
+ * Adds an unsigned integer field to a result.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the result has no room left.
+ */
+esp_err_t command_result_add_uint(command_result_t *result, const char *key, uint64_t value);
+
+/**
+ * Adds a string field to a result. The string is copied.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if `value` is null, ESP_ERR_NO_MEM if the result has no
+ *         room left.
+ */
+esp_err_t command_result_add_string(command_result_t *result, const char *key, const char *value);
+
+/**
+ * Adds an array of strings to a result. The strings are copied; null entries are skipped.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the result has no room left.
+ */
+esp_err_t command_result_add_string_array(command_result_t *result, const char *key, const char *const *values,
+                                          size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMAND_RESPONSE_H
@@ -1,19 +1,55 @@
 #ifndef JSON_REQUEST_HANDLER_H
 #define JSON_REQUEST_HANDLER_H
 
+#include "websocket_server.h"
+
 #include <esp_err.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /**
- * @brief Handles an incoming JSON request: parses, authenticates, and dispatches the command.
+ * @brief Handles an incoming request: parses, authenticates, and dispatches the command.
+ *
+ * JSON messages are decoded in place without heap allocation: string values are unescaped inside
+ * `inbound_message`, so the buffer is modified. Messages too large for the in-situ decoder are
+ * parsed with cJSON instead.
+ *
+ * CBOR messages carry the same envelope as a map with text keys. Integers are native, so 64-bit node IDs
+ * may be sent as unsigned integers instead of decimal strings. Text values are null-terminated in place,
+ * which requires one writable byte after the end of the message.
+ *
+ * Besides single commands, a message of type "batch" may carry a "commands" array of {action, payload}
+ * objects. Batched Matter commands are issued under a single CHIP stack lock and reads addressed to the
+ * same node are merged.
+ *
+ * Every request may carry an optional "request_id" (a string or a non-negative integer). Exactly one
+ * "response" message echoing it is sent to the originating client, holding the outcome and result of
+ * the command, or the per-command outcomes of a batch.
  *
- * @param inbound_message The incoming JSON message as a string.
+ * @param fd The file descriptor of the originating client.
+ * @param protocol Encoding of the message.
+ * @param inbound_message The incoming message. Must be writable; does not need to be null-terminated.
+ * @param len Length of the message in bytes.
  * @return ESP_OK on success, or an error code on failure.
  */
-esp_err_t handle_json_inbound_message(const char *inbound_message);
+esp_err_t handle_inbound_message(int fd, ws_protocol_t protocol, char *inbound_message, size_t len);
+
+/**
+ * @brief Answers a request that was not admitted for execution with an error response.
+ *
+ * The request ID and action are recovered from the message when possible so that the client can
+ * correlate the rejection.
+ *
+ * @param fd The file descriptor of the originating client.
+ * @param protocol Encoding of the message.
+ * @param inbound_message The rejected message. Must be writable.
+ * @param len Length of the message in bytes.
+ * @param reason The reason for the rejection, sent as the response error.
+ */
+void reject_inbound_message(int fd, ws_protocol_t protocol, char *inbound_message, size_t len, esp_err_t reason);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,105 @@
+#ifndef JSON_TOKENIZER_H
+#define JSON_TOKENIZER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The input is not valid JSON.
+#define JSON_TOKENIZE_ERROR_INVALID (-1)
+// The input is valid so far but needs more tokens or deeper nesting than the caller allows.
+#define JSON_TOKENIZE_ERROR_LIMIT (-2)
+
+// Maximum nesting depth of objects and arrays accepted by the tokenizer.
+#define JSON_TOKENIZE_MAX_DEPTH 8
+
+/**
+ * Kind of JSON value a token refers to.
+ */
+typedef enum {
+    JSON_TOKEN_OBJECT,
+    JSON_TOKEN_ARRAY,
+    JSON_TOKEN_STRING,
+    // Number, true, false or null.
+    JSON_TOKEN_PRIMITIVE,
+} json_token_type_t;
+
+/**
+ * A single JSON value located inside the input buffer.
+ *
+ * Tokens are stored in document order. Object members are emitted as a key token immediately followed by the
+ * value token. For strings, [start, end) excludes the quotes and still contains the raw escape sequences.
+ */
+typedef struct {
+    json_token_type_t type;
+    // Offset of the first character of the value.
+    uint32_t start;
+    // Offset one past the last character of the value.
+    uint32_t end;
+    // Number of direct children: members for objects, elements for arrays, 0 otherwise.
+    uint16_t size;
+    // Index of the first token after this value and all of its children.
+    uint16_t next;
+} json_token_t;
+
+/**
+ * Tokenizes a JSON document without allocating memory and without modifying the input.
+ *
+ * @param js The JSON text. Does not need to be null-terminated.
+ * @param len Length of `js` in bytes.
+ * @param tokens Caller-provided token array.
+ * @param max_tokens Capacity of `tokens`.
+ * @return Number of tokens produced (the root value is token 0), JSON_TOKENIZE_ERROR_INVALID if the text is
+ *         not valid JSON, or JSON_TOKENIZE_ERROR_LIMIT if the document does not fit into `tokens` or exceeds
+ *         JSON_TOKENIZE_MAX_DEPTH.
+ */
+int json_tokenize(const char *js, size_t len, json_token_t *tokens, size_t max_tokens);
+
+/**
+ * Finds a member of an object by key.
+ *
+ * Keys are compared against their raw (still escaped) text.
+ *
+ * @param js The tokenized JSON text.
+ * @param tokens The token array produced by `json_tokenize`.
+ * @param object Index of an object token.
+ * @param key Null-terminated key to look up.
+ * @return Index of the member's value token, or -1 if `object` is not an object or has no such key.
+ */
+int json_object_get(const char *js, const json_token_t *tokens, int object, const char *key);
+
+/**
+ * Decodes a string token in place and null-terminates it.
+ *
+ * Escape sequences are resolved (including \uXXXX surrogate pairs, emitted as UTF-8) directly inside the input
+ * buffer; the closing quote is overwritten by the terminator. Must be called at most once per token, after
+ * tokenization has finished.
+ *
+ * @param js The tokenized, writable JSON text.
+ * @param token A string token.
+ * @return Pointer to the decoded string inside `js`.
+ */
+char *json_string_decode(char *js, const json_token_t *token);
+
+/**
+ * Parses a number token as an unsigned 64-bit integer.
+ *
+ * Plain digit sequences are converted exactly; numbers with a fraction or exponent are accepted if they
+ * denote an integral value.
+ *
+ * @param js The tokenized JSON text.
+ * @param token A primitive token.
+ * @param[out] out The parsed value.
+ * @return true if the token is a non-negative integer that fits into uint64_t, false otherwise.
+ */
+bool json_number_to_uint64(const char *js, const json_token_t *token, uint64_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JSON_TOKENIZER_H
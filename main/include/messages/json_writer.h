@@ -0,0 +1,115 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maximum nesting depth of objects and arrays.
+#define JSON_WRITER_MAX_DEPTH 16
+
+/**
+ * Streaming JSON writer producing the same text as cJSON_PrintUnformatted, without building a tree.
+ *
+ * Output goes to a caller-provided buffer. When the buffer is too small, the writer moves to a heap buffer
+ * and keeps going. Errors are sticky: once an allocation fails or nesting is unbalanced, `failed` is set
+ * and further writes are ignored.
+ */
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+    // Whether `buf` was allocated by the writer.
+    bool owned;
+    bool failed;
+    size_t depth;
+    // Per open container: whether it already holds an element, so the next one needs a separator.
+    bool has_items[JSON_WRITER_MAX_DEPTH];
+    // Set between a key and its value.
+    bool after_key;
+} json_writer_t;
+
+/**
+ * Initializes a writer on top of a caller-provided buffer.
+ *
+ * @param writer The writer.
+ * @param buf Initial output buffer. May be null, in which case the writer starts on the heap.
+ * @param cap Capacity of `buf` in bytes.
+ */
+void json_writer_init(json_writer_t *writer, char *buf, size_t cap);
+
+/**
+ * Releases the heap buffer of a writer, if it moved to one.
+ */
+void json_writer_release(json_writer_t *writer);
+
+/**
+ * Null-terminates the output and returns it.
+ *
+ * @return The JSON text, owned by the writer, or nullptr if the writer failed or containers are still open.
+ */
+const char *json_writer_finish(json_writer_t *writer);
+
+void json_begin_object(json_writer_t *writer);
+
+void json_end_object(json_writer_t *writer);
+
+void json_begin_array(json_writer_t *writer);
+
+void json_end_array(json_writer_t *writer);
+
+/**
+ * Writes the key of the next object member.
+ */
+void json_write_key(json_writer_t *writer, const char *key);
+
+/**
+ * Writes a string value, escaped like cJSON.
+ */
+void json_write_string(json_writer_t *writer, const char *value);
+
+/**
+ * Writes a string value of a given length, which need not be null-terminated and may contain null bytes.
+ */
+void json_write_text(json_writer_t *writer, const char *text, size_t len);
+
+/**
+ * Writes binary data as a string of uppercase hex digits.
+ */
+void json_write_hex_string(json_writer_t *writer, const uint8_t *data, size_t len);
+
+/**
+ * Writes a number formatted like cJSON: integral values within the range of `int` with "%d", others with
+ * the shortest of "%1.15g" and "%1.17g" that reads back as the same double, NaN and infinities as null.
+ */
+void json_write_number(json_writer_t *writer, double value);
+
+/**
+ * Writes an unsigned integer with all of its digits. Unlike json_write_number, values beyond 2^53 keep
+ * their precision, and large round values are not written in exponent notation.
+ */
+void json_write_uint(json_writer_t *writer, uint64_t value);
+
+/**
+ * Writes a signed integer with all of its digits, like json_write_uint.
+ */
+void json_write_int(json_writer_t *writer, int64_t value);
+
+void json_write_bool(json_writer_t *writer, bool value);
+
+void json_write_null(json_writer_t *writer);
+
+/**
+ * Writes a value that is already JSON text, such as a complete earlier message, without validating it.
+ */
+void json_write_encoded(json_writer_t *writer, const char *json, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JSON_WRITER_H
@@ -0,0 +1,127 @@
+#ifndef MESSAGE_ENCODER_H
+#define MESSAGE_ENCODER_H
+
+#include "messages/cbor.h"
+#include "messages/json_writer.h"
+#include "websocket_server.h"
+
+#include <esp_err.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maximum nesting depth of objects and arrays in an outbound message, deep enough for nested attribute
+// values inside a snapshot.
+#define MESSAGE_ENCODER_MAX_DEPTH 16
+
+/**
+ * Builds one outbound message in the encoding of a WebSocket protocol, so that every message is described
+ * once and serialized as JSON text or as CBOR.
+ *
+ * The message is streamed into a buffer taken from a fixed pool of CONFIG_OUTBOUND_MESSAGE_POOL_SIZE
+ * buffers of CONFIG_OUTBOUND_MESSAGE_BUFFER_SIZE bytes, so encoding does not allocate. Only messages larger
+ * than a pool buffer, or encoded while every buffer is in use, move to the heap.
+ *
+ * Values are added to the innermost open object or array. Inside objects every value needs a key; inside
+ * arrays the key must be null. Errors are sticky and reported by `message_encoder_finish`.
+ */
+typedef struct {
+    ws_protocol_t protocol;
+    bool failed;
+    size_t depth;
+    // Index of the pool buffer backing the output, or -1 if none was available.
+    int pool_slot;
+    // Per open container: whether it is an object.
+    bool is_object[MESSAGE_ENCODER_MAX_DEPTH];
+    // WS_PROTOCOL_JSON: the output.
+    json_writer_t json;
+    // WS_PROTOCOL_CBOR: the output and, per open container, its header offset and size so far.
+    cbor_writer_t cbor;
+    size_t cbor_offsets[MESSAGE_ENCODER_MAX_DEPTH];
+    size_t cbor_counts[MESSAGE_ENCODER_MAX_DEPTH];
+} message_encoder_t;
+
+/**
+ * Initializes an encoder, takes a buffer from the pool and opens the root object of the message.
+ * Every initialized encoder must be released with `message_encoder_release`.
+ */
+void message_encoder_init(message_encoder_t *enc, ws_protocol_t protocol);
+
+/**
+ * Closes the root object and returns the encoded message.
+ *
+ * @param enc The encoder.
+ * @param[out] data The encoded message, owned by the encoder and valid until it is released. JSON text
+ *             is null-terminated.
+ * @param[out] len Length of the encoded message in bytes, excluding the terminator.
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if an allocation failed, ESP_ERR_INVALID_STATE if containers
+ *         were not balanced.
+ */
+esp_err_t message_encoder_finish(message_encoder_t *enc, const uint8_t **data, size_t *len);
+
+/**
+ * Returns the buffer of an encoder to the pool, or frees it if the message moved to the heap.
+ */
+void message_encoder_release(message_encoder_t *enc);
+
+/**
+ * Opens a nested object.
+ */
+void message_begin_object(message_encoder_t *enc, const char *key);
+
+/**
+ * Opens a nested array.
+ */
+void message_begin_array(message_encoder_t *enc, const char *key);
+
+/**
+ * Closes the innermost open object or array.
+ */
+void message_end(message_encoder_t *enc);
+
+void message_add_string(message_encoder_t *enc, const char *key, const char *value);
+
+/**
+ * Adds a string of a given length, which need not be null-terminated.
+ */
+void message_add_text(message_encoder_t *enc, const char *key, const char *text, size_t len);
+
+void message_add_bool(message_encoder_t *enc, const char *key, bool value);
+
+/**
+ * Adds an unsigned integer: a native 64-bit integer in CBOR, a number with all of its digits in JSON.
+ */
+void message_add_uint(message_encoder_t *enc, const char *key, uint64_t value);
+
+/**
+ * Adds a signed integer: a native 64-bit integer in CBOR, a number with all of its digits in JSON.
+ */
+void message_add_int(message_encoder_t *enc, const char *key, int64_t value);
+
+/**
+ * Adds a floating-point number: a double in CBOR, a number in JSON, where NaN and infinities become null.
+ */
+void message_add_double(message_encoder_t *enc, const char *key, double value);
+
+void message_add_null(message_encoder_t *enc, const char *key);
+
+/**
+ * Adds binary data: a byte string in CBOR, an uppercase hex string in JSON.
+ */
+void message_add_bytes(message_encoder_t *enc, const char *key, const uint8_t *data, size_t len);
+
+/**
+ * Adds a value that is already encoded in the protocol of the encoder, such as a complete earlier message.
+ * The value must be a single JSON value or CBOR data item.
+ */
+void message_add_encoded(message_encoder_t *enc, const char *key, const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MESSAGE_ENCODER_H
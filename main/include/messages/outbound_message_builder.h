@@ -1,13 +1,69 @@
 #ifndef JSON_OUTBOUND_MESSAGE_H
 #define JSON_OUTBOUND_MESSAGE_H
 
+#include "messages/command_response.h"
+#include "messages/state_store.h"
+#include "websocket_server.h"
+
 #include <stdint.h>
 #include <esp_err.h>
+#include <lib/core/TLVReader.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/*
+ * Every message is encoded in the protocol negotiated by its recipient: JSON text for WS_PROTOCOL_JSON
+ * clients, CBOR for WS_PROTOCOL_CBOR clients. Both carry the same keys; CBOR uses native 64-bit integers
+ * and byte strings where JSON uses numbers and hex strings.
+ *
+ * Every broadcast is an event carrying a "seq" number, increasing by one per event across all topics. A
+ * client that reconnects sends `client.resume` with the last "seq" it received and is sent what it missed
+ * (see `send_replay_message`).
+ *
+ * Broadcasts only reach clients subscribed to their topic (see `client.subscribe`). The topic of a broadcast
+ * is its action; events about a Matter node extend it with the node, e.g.
+ * `matter.subscribe_done/node/0x1234`, and attribute reports with the full attribute path, e.g.
+ * `matter.attribute_report/node/0x1234/endpoint/1/cluster/0x6/attribute/0x0`. IDs are lowercase hex.
+ */
+
+// ---- RESPONSES ----
+
+/**
+ * Sends the response to a single command to the client that issued it.
+ *
+ * The message has type "response" and carries the echoed "request_id" (omitted if the request had none), the
+ * "action", a "status" of "ok" or "error", the "error" name for failures and the command's result as
+ * "payload".
+ *
+ * @param fd The file descriptor of the originating client.
+ * @param request_id The request ID of the command. May be null.
+ * @param action The action of the command, or null if it could not be decoded.
+ * @param status The outcome of the command.
+ * @param result The result produced by the command handler. May be null.
+ * @return ESP_OK if the message was queued for sending, or an error code otherwise.
+ */
+esp_err_t send_command_response_message(int fd, const command_request_id_t *request_id, const char *action,
+                                        esp_err_t status, const command_result_t *result);
+
+/**
+ * Sends the aggregated outcome of a batch envelope to the client that issued it.
+ *
+ * The response has action "batch" and a payload holding a "results" array with one entry per batched
+ * command, in request order. Each entry carries the command's "action" (omitted if it could not be
+ * decoded), a "status" of "ok" or "error" and, for failures, the "error" name.
+ *
+ * @param fd The file descriptor of the originating client.
+ * @param request_id The request ID of the batch. May be null.
+ * @param actions Action name of each command, or null entries for commands without a valid action.
+ * @param results Outcome of each command.
+ * @param count Number of commands in the batch.
+ * @return ESP_OK if the message was queued for sending, or an error code otherwise.
+ */
+esp_err_t send_batch_response_message(int fd, const command_request_id_t *request_id, const char *const *actions,
+                                      const esp_err_t *results, size_t count);
+
 // ---- THREAD ----
 
 /**
@@ -159,19 +215,46 @@ esp_err_t broadcast_info_matter_commissioning_complete_message(uint64_t nodeId,
 /**
  * Broadcasts a message containing a Matter attribute report.
  *
- * This function builds and sends a JSON message including the node ID, endpoint ID,
+ * This function builds and sends a message including the node ID, endpoint ID,
  * cluster ID, attribute ID, and reported value. It is typically used when receiving
  * attribute report data from a Matter device.
  *
+ * JSON clients receive `value` as a typed JSON value decoded from the TLV element, whole, including
+ * structures and lists (see `message_add_tlv`). CBOR clients receive the raw TLV element as a byte string
+ * when `tlv` is given, and the value decoded to CBOR otherwise.
+ *
  * @param nodeId The 64-bit Node ID of the device.
  * @param endpointId The 16-bit endpoint ID.
  * @param clusterId The 32-bit cluster ID.
  * @param attributeId The 32-bit attribute ID being reported.
- * @param value The attribute value as a string. Must not be null.
+ * @param value Reader positioned on the attribute value. Only read during the call.
+ * @param tlv The attribute value as an anonymous TLV element. May be null.
+ * @param tlv_len Length of `tlv` in bytes.
  * @return ESP_OK on success, or ESP_ERR_INVALID_ARG / ESP_FAIL on failure.
 */
 esp_err_t broadcast_info_matter_attribute_report_message(uint64_t nodeId, uint16_t endpointId, uint32_t clusterId,
-                                                         uint32_t attributeId, const char *value);
+                                                         uint32_t attributeId, const chip::TLV::TLVReader *value,
+                                                         const uint8_t *tlv, size_t tlv_len);
+
+/**
+ * Checks whether a report of an attribute must be encoded for a protocol, so that the value is only
+ * prepared in the forms someone needs.
+ *
+ * @return true if a client using the protocol is subscribed to the attribute's report topic, or events of
+ *         the protocol are kept for replay.
+ */
+bool matter_attribute_report_wanted(ws_protocol_t protocol, uint64_t nodeId, uint16_t endpointId, uint32_t clusterId,
+                                    uint32_t attributeId);
+
+/**
+ * Sends a stored attribute value to a single client, as a "matter.attribute_report" message like the one
+ * broadcast when the node reports it. It carries no "seq", since it is not a new event.
+ *
+ * @param fd The file descriptor of the client.
+ * @param attribute The stored value.
+ * @return ESP_OK if the message was queued, or an error code otherwise.
+ */
+esp_err_t send_matter_attribute_report_message(int fd, const state_attribute_t *attribute);
 
 /**
  * Broadcasts an information message indicating that a Matter subscription has successfully completed.
@@ -182,6 +265,35 @@ esp_err_t broadcast_info_matter_attribute_report_message(uint64_t nodeId, uint16
  */
 esp_err_t broadcast_info_matter_subscribe_done_message(uint64_t nodeId, uint32_t subscription_id);
 
+// ---- STATE ----
+
+/**
+ * Sends the latest known state to a client in a single message, so that it does not have to query it.
+ *
+ * The message has action "state.snapshot". Its payload holds, under the action of each status event, the
+ * payload of the last such event, e.g. `"thread.role": {"role": "leader"}`; values that were never reported
+ * are omitted. "matter.attribute_report" is an array of report payloads, one per stored attribute. The
+ * message carries the "seq" of the last event broadcast before it, if any. Matches
+ * `ws_client_connected_handler_t`.
+ *
+ * @param fd The file descriptor of the client.
+ * @param protocol The protocol the client negotiated.
+ */
+void send_state_snapshot_message(int fd, ws_protocol_t protocol);
+
+/**
+ * Sends a client the events it missed, in a single message with action "client.replay" whose payload holds
+ * the missed events, oldest first, as an "events" array of complete messages. Only events matching the
+ * client's current topic patterns are included, so clients resubscribe before resuming.
+ *
+ * @param fd The file descriptor of the client.
+ * @param after_seq The "seq" of the last event the client received.
+ * @param[out] count Number of events replayed. May be null.
+ * @return ESP_OK if the replay was queued, ESP_ERR_INVALID_STATE if the missed events are no longer all
+ *         recorded (send a snapshot instead), or another error code otherwise.
+ */
+esp_err_t send_replay_message(int fd, uint64_t after_seq, size_t *count);
+
 #ifdef __cplusplus
 }
 #endif
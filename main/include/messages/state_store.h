@@ -0,0 +1,175 @@
+#ifndef STATE_STORE_H
+#define STATE_STORE_H
+
+#include "sdkconfig.h"
+
+#include <esp_err.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maximum number of addresses kept per address list.
+#define STATE_STORE_MAX_ADDRESSES 16
+// Size of an address string, including the terminator.
+#define STATE_STORE_ADDRESS_SIZE 46
+
+/*
+ * Latest known state of the orchestrator, kept so that a client that connects gets the full picture in one
+ * message instead of querying the Thread mesh. The event handlers record every change here before
+ * broadcasting it.
+ *
+ * Every value is only reported once it is known, i.e. after the first event that set it.
+ */
+
+/**
+ * Boolean statuses reported by events.
+ */
+typedef enum {
+    STATE_THREAD_STACK_RUNNING,
+    STATE_THREAD_INTERFACE_UP,
+    STATE_THREAD_ATTACHED,
+    STATE_MESHCOP_PUBLISHED,
+    STATE_FLAG_COUNT,
+} state_flag_t;
+
+/**
+ * Address lists reported by events.
+ */
+typedef enum {
+    STATE_UNICAST_ADDRESSES,
+    STATE_MULTICAST_ADDRESSES,
+    STATE_ADDRESS_LIST_COUNT,
+} state_address_list_t;
+
+typedef struct {
+    bool known;
+    size_t count;
+    char addresses[STATE_STORE_MAX_ADDRESSES][STATE_STORE_ADDRESS_SIZE];
+} state_addresses_t;
+
+typedef struct {
+    bool known;
+    uint64_t active_timestamp;
+    char network_name[17];
+    uint8_t extended_pan_id[8];
+    uint8_t mesh_local_prefix[8];
+    uint16_t pan_id;
+    uint16_t channel;
+} state_dataset_t;
+
+/**
+ * Last reported value of a Matter attribute, as its TLV element. Reads with a maximum age are answered from
+ * these values (see `state_store_get_attribute`).
+ */
+typedef struct {
+    uint64_t node_id;
+    uint16_t endpoint_id;
+    uint32_t cluster_id;
+    uint32_t attribute_id;
+    // Value of a global counter when the entry was last updated or read; the least recently used entry is
+    // replaced first.
+    uint32_t used;
+    // Time of the last update, from esp_timer_get_time().
+    int64_t updated_us;
+    // Data version of the cluster the value was reported with, if the report carried one.
+    bool has_data_version;
+    uint32_t data_version;
+    uint8_t tlv[CONFIG_STATE_STORE_MAX_VALUE_SIZE];
+    size_t tlv_len;
+} state_attribute_t;
+
+/**
+ * Counters of reads looked up in the stored attribute values since boot.
+ */
+typedef struct {
+    // Reads answered from a stored value.
+    uint32_t hits;
+    // Reads that found no value, or one older than they accepted.
+    uint32_t misses;
+    // Values forgotten to make room for another attribute.
+    uint32_t evictions;
+} state_cache_stats_t;
+
+typedef struct {
+    bool flags_known[STATE_FLAG_COUNT];
+    bool flags[STATE_FLAG_COUNT];
+    char thread_role[16];
+    char wifi_status[16];
+    state_addresses_t address_lists[STATE_ADDRESS_LIST_COUNT];
+    state_dataset_t dataset;
+    size_t attribute_count;
+    state_attribute_t attributes[CONFIG_STATE_STORE_MAX_ATTRIBUTES];
+} orchestrator_state_t;
+
+/**
+ * Creates the lock guarding the store. Must be called before any other function of the store.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the lock could not be created.
+ */
+esp_err_t state_store_init(void);
+
+void state_store_set_flag(state_flag_t flag, bool value);
+
+void state_store_set_thread_role(const char *role);
+
+void state_store_set_wifi_status(const char *status);
+
+/**
+ * Replaces an address list. Null entries are skipped; addresses beyond STATE_STORE_MAX_ADDRESSES are
+ * dropped.
+ */
+void state_store_set_addresses(state_address_list_t list, const char *const *addresses, size_t count);
+
+void state_store_set_active_dataset(uint64_t active_timestamp, const char *network_name,
+                                    const uint8_t *extended_pan_id, const uint8_t *mesh_local_prefix,
+                                    uint16_t pan_id, uint16_t channel);
+
+/**
+ * Records the value of an attribute. When CONFIG_STATE_STORE_MAX_ATTRIBUTES attributes are known, the
+ * least recently used one is forgotten.
+ *
+ * @param tlv The value as an anonymous TLV element, or null if it could not be copied. A value that is null
+ *            or larger than CONFIG_STATE_STORE_MAX_VALUE_SIZE bytes is not kept, and the attribute's previous
+ *            value is forgotten, so that it is not served as current.
+ * @param tlv_len Length of `tlv` in bytes.
+ * @param data_version Data version of the cluster the value was reported with, or null if unknown.
+ */
+void state_store_set_attribute(uint64_t node_id, uint16_t endpoint_id, uint32_t cluster_id, uint32_t attribute_id,
+                               const uint8_t *tlv, size_t tlv_len, const uint32_t *data_version);
+
+/**
+ * Looks up the stored value of an attribute for a read that accepts values up to a given age. Every lookup
+ * counts as a hit or a miss in the cache statistics.
+ *
+ * @param max_age_ms Oldest value accepted, in milliseconds since it was reported.
+ * @param[out] attribute Receives a copy of the stored value on a hit.
+ * @param[out] age_ms Set to the age of the value on a hit. May be null.
+ * @return true if a value at most `max_age_ms` old is stored, false otherwise.
+ */
+bool state_store_get_attribute(uint64_t node_id, uint16_t endpoint_id, uint32_t cluster_id, uint32_t attribute_id,
+                               uint32_t max_age_ms, state_attribute_t *attribute, uint32_t *age_ms);
+
+/**
+ * Returns the statistics of reads looked up in the stored attribute values.
+ */
+void state_store_get_cache_stats(state_cache_stats_t *stats);
+
+/**
+ * Locks the store for reading. Updates block until `state_store_release` is called, so the state must be
+ * read quickly.
+ *
+ * @return The state.
+ */
+const orchestrator_state_t *state_store_acquire(void);
+
+void state_store_release(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STATE_STORE_H
@@ -0,0 +1,36 @@
+#ifndef TLV_ENCODER_H
+#define TLV_ENCODER_H
+
+#include "messages/message_encoder.h"
+
+#include <lib/core/TLVReader.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Adds a Matter TLV element to a message as a typed value, walking nested containers recursively and writing
+ * straight into the encoder, so values of any size are encoded whole:
+ *
+ * - Signed and unsigned integers, booleans, floating-point numbers and null map to their JSON or CBOR
+ *   counterparts.
+ * - UTF-8 strings map to strings and byte strings to byte strings, which JSON carries as hex strings.
+ * - Structures map to objects keyed by member tag: the tag number for context tags, "0xPPPPPPPP:N" for
+ *   profile tags, and "" for anonymous members.
+ * - Arrays and lists map to arrays. Member tags of lists are dropped.
+ *
+ * A malformed element, or one nested deeper than the encoder allows, fails the encoder, like any other
+ * encoding error.
+ *
+ * @param enc The encoder.
+ * @param key Key of the value, or null inside an array.
+ * @param element Reader positioned on the element. The reader is left untouched; the walk runs on a copy.
+ */
+void message_add_tlv(message_encoder_t *enc, const char *key, const chip::TLV::TLVReader *element);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TLV_ENCODER_H
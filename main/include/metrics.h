@@ -0,0 +1,24 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "metrics_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Renders the metrics of the orchestrator: the command executor and every executed command, free heap, the
+ * stack high-water marks of its tasks, the time spent waiting for the CHIP and OpenThread locks, the
+ * attribute cache and attribute reads. Registered with `websocket_server_set_metrics_handler`, so it is
+ * scraped together with the server's metrics at /metrics.
+ *
+ * @param writer The writer the metrics are rendered with.
+ */
+void write_orchestrator_metrics(metrics_writer_t *writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // METRICS_H
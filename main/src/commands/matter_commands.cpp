@@ -2,8 +2,14 @@
 
 #include "matter_interface.h"
 #include "matter_controller.h"
+#include "messages/outbound_message_builder.h"
+#include "messages/state_store.h"
 #include "thread_util.h"
+#include "sdkconfig.h"
 
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
 #include "event_handlers/chip_event_handler.h"
@@ -29,14 +35,142 @@ esp_err_t execute_cmd_invoke_command(const uint64_t destination_id, const uint16
     return invoke_cluster_command(destination_id, endpoint_id, cluster_id, command_id, payload_json);
 }
 
-esp_err_t execute_attr_read_command(uint64_t node_id, const uint16_t endpoint_id, const uint32_t cluster_id,
-                                 const uint32_t attribute_id) {
-    return send_read_attr_command(node_id, endpoint_id, cluster_id, attribute_id);
+esp_err_t execute_attr_read_command(const int fd, uint64_t node_id, const uint16_t endpoint_id,
+                                    const uint32_t cluster_id, const uint32_t attribute_id, const uint32_t max_age_ms,
+                                    bool *cached, uint32_t *age_ms, bool *joined) {
+    *cached = false;
+    *joined = false;
+    if (max_age_ms > 0) {
+        state_attribute_t attribute;
+        if (state_store_get_attribute(node_id, endpoint_id, cluster_id, attribute_id, max_age_ms, &attribute,
+                                      age_ms)) {
+            *cached = true;
+            return send_matter_attribute_report_message(fd, &attribute);
+        }
+    }
+    return send_read_attr_command(node_id, endpoint_id, cluster_id, attribute_id, joined);
+}
+
+esp_err_t execute_attr_subscribe_command(const int fd, uint64_t node_id, const uint16_t endpoint_id,
+                                         const uint32_t cluster_id, const uint32_t attribute_id,
+                                         uint16_t min_interval, uint16_t max_interval, uint32_t *handle,
+                                         bool *shared) {
+    const matter_attribute_path_t path = {endpoint_id, cluster_id, attribute_id};
+    return matter_subscription_acquire(fd, node_id, &path, 1, min_interval, max_interval, handle, shared);
+}
+
+/**
+ * Parses one ID of an attribute path: `*` for `wildcard`, otherwise a number below `wildcard`, so that a
+ * concrete ID can never be taken for a wildcard. Advances `*p` past the ID.
+ */
+static bool parse_path_id(const char **p, const uint32_t wildcard, uint32_t *id) {
+    if (**p == '*') {
+        ++*p;
+        *id = wildcard;
+        return true;
+    }
+    if (**p < '0' || **p > '9') return false;
+    char *end;
+    const unsigned long value = strtoul(*p, &end, 0);
+    if (value >= wildcard) return false;
+    *p = end;
+    *id = static_cast<uint32_t>(value);
+    return true;
+}
+
+/**
+ * Parses a comma-separated list of `endpoint/cluster/attribute` paths.
+ */
+static esp_err_t parse_attribute_paths(const char *list, matter_attribute_path_t *paths, const size_t max,
+                                       size_t *count) {
+    *count = 0;
+    const char *p = list;
+    while (true) {
+        if (*count == max) return ESP_ERR_INVALID_SIZE;
+        uint32_t endpoint_id, cluster_id, attribute_id;
+        if (!parse_path_id(&p, MATTER_WILDCARD_ENDPOINT, &endpoint_id) || *p++ != '/' ||
+            !parse_path_id(&p, MATTER_WILDCARD_CLUSTER, &cluster_id) || *p++ != '/' ||
+            !parse_path_id(&p, MATTER_WILDCARD_ATTRIBUTE, &attribute_id)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        paths[(*count)++] = {static_cast<uint16_t>(endpoint_id), cluster_id, attribute_id};
+        if (*p == '\0') return ESP_OK;
+        if (*p++ != ',') return ESP_ERR_INVALID_ARG;
+    }
+}
+
+esp_err_t execute_attrs_read_command(const uint64_t node_id, const char *paths, size_t *path_count,
+                                     size_t *joined_count) {
+    matter_attribute_path_t parsed[MATTER_MAX_READ_PATHS];
+    esp_err_t err = parse_attribute_paths(paths, parsed, MATTER_MAX_READ_PATHS, path_count);
+    if (err != ESP_OK) return err;
+    return send_read_attrs_command(node_id, parsed, *path_count, joined_count);
+}
+
+esp_err_t execute_attrs_subscribe_command(const int fd, const uint64_t node_id, const char *paths,
+                                          const uint16_t min_interval, const uint16_t max_interval,
+                                          size_t *path_count, uint32_t *handle, bool *shared) {
+    matter_attribute_path_t parsed[MATTER_MAX_SUBSCRIBE_PATHS];
+    esp_err_t err = parse_attribute_paths(paths, parsed, MATTER_MAX_SUBSCRIBE_PATHS, path_count);
+    if (err != ESP_OK) return err;
+    return matter_subscription_acquire(fd, node_id, parsed, *path_count, min_interval, max_interval, handle, shared);
+}
+
+/**
+ * Formats one ID of an attribute path as parsed by `parse_path_id`.
+ */
+static void format_path_id(char *out, const size_t size, const uint32_t id, const uint32_t wildcard,
+                           const char *format) {
+    if (id == wildcard) {
+        snprintf(out, size, "*");
+    } else {
+        snprintf(out, size, format, id);
+    }
+}
+
+/**
+ * Formats a subscription as documented by `execute_subscriptions_get_command`.
+ */
+static void format_subscription(const matter_subscription_info_t &info, char *out, const size_t size) {
+    const matter_attribute_path_t *paths = info.paths;
+    char text[MATTER_MAX_SUBSCRIBE_PATHS * 32] = "";
+    size_t len = 0;
+    for (size_t i = 0; i < info.path_count; ++i) {
+        char endpoint[8], cluster[12], attribute[12];
+        format_path_id(endpoint, sizeof(endpoint), paths[i].endpoint_id, MATTER_WILDCARD_ENDPOINT, "%" PRIu32);
+        format_path_id(cluster, sizeof(cluster), paths[i].cluster_id, MATTER_WILDCARD_CLUSTER, "0x%" PRIX32);
+        format_path_id(attribute, sizeof(attribute), paths[i].attribute_id, MATTER_WILDCARD_ATTRIBUTE, "0x%" PRIX32);
+        len += snprintf(text + len, sizeof(text) - len, "%s%s/%s/%s", i > 0 ? "," : "", endpoint, cluster, attribute);
+    }
+
+    char subscription_id[12] = "-";
+    if (info.established) snprintf(subscription_id, sizeof(subscription_id), "0x%" PRIX32, info.subscription_id);
+
+    snprintf(out, size, "%" PRIu32 " 0x%" PRIX64 " %s %s %zu", info.handle, info.node_id, text, subscription_id,
+             info.subscriber_count);
+}
+
+esp_err_t execute_subscriptions_get_command(char (*subscriptions)[MATTER_SUBSCRIPTION_TEXT_SIZE], const size_t max,
+                                            size_t *count) {
+    matter_subscription_info_t infos[CONFIG_MATTER_MAX_SUBSCRIPTIONS];
+    *count = matter_subscription_list(infos, max < CONFIG_MATTER_MAX_SUBSCRIPTIONS ? max
+                                                                                : CONFIG_MATTER_MAX_SUBSCRIPTIONS);
+    for (size_t i = 0; i < *count; ++i) {
+        format_subscription(infos[i], subscriptions[i], MATTER_SUBSCRIPTION_TEXT_SIZE);
+    }
+    return ESP_OK;
+}
+
+esp_err_t execute_subscription_cancel_command(const int fd, const uint32_t handle) {
+    return matter_subscription_release(fd, handle);
+}
+
+void release_client_subscriptions(const int fd) {
+    matter_subscription_release_all(fd);
 }
 
-esp_err_t execute_attr_subscribe_command(uint64_t node_id, const uint16_t endpoint_id, const uint32_t cluster_id,
-                                      const uint32_t attribute_id, uint16_t min_interval, uint16_t max_interval) {
-    return send_subscribe_attr_command(node_id, endpoint_id, cluster_id, attribute_id, min_interval, max_interval, true);
+esp_err_t execute_matter_batch_command(matter_batch_op_t *ops, const size_t count) {
+    return matter_controller_execute_batch(ops, count);
 }
 
 esp_err_t execute_matter_controller_init_command(const uint64_t node_id, const uint64_t fabric_id, const uint16_t listen_port) {
@@ -2,7 +2,6 @@
 #include "thread_util.h"
 #include <esp_log.h>
 #include <esp_check.h>
-#include <cJSON.h>
 #include <cstring>
 
 static const char *TAG = "THREAD_COMMANDS";
@@ -49,40 +48,10 @@ esp_err_t execute_thread_role_get_command(const char **role_str) {
     return thread_get_device_role_string(role_str);
 }
 
-esp_err_t execute_thread_active_dataset_get_command(char *json_buf, size_t buf_size) {
-    otOperationalDataset dataset;
-    if (thread_get_active_dataset(&dataset) != ESP_OK) {
+esp_err_t execute_thread_active_dataset_get_command(otOperationalDataset *dataset) {
+    if (thread_get_active_dataset(dataset) != ESP_OK) {
         return ESP_FAIL;
     }
-
-    cJSON *root = cJSON_CreateObject();
-    if (!root) return ESP_ERR_NO_MEM;
-
-    char ext_pan_id[17] = {};
-    char mesh_prefix[33] = {};
-
-    for (int i = 0; i < 8; ++i) {
-        snprintf(ext_pan_id + i * 2, 3, "%02X", dataset.mExtendedPanId.m8[i]);
-        snprintf(mesh_prefix + i * 4, 5, "%02X00", dataset.mMeshLocalPrefix.m8[i]); // simplified
-    }
-
-    cJSON_AddStringToObject(root, "network_name", (const char *)dataset.mNetworkName.m8);
-    cJSON_AddNumberToObject(root, "channel", dataset.mChannel);
-    cJSON_AddNumberToObject(root, "pan_id", dataset.mPanId);
-    cJSON_AddStringToObject(root, "extended_pan_id", ext_pan_id);
-    cJSON_AddStringToObject(root, "mesh_local_prefix", mesh_prefix);
-
-    char *json = cJSON_PrintUnformatted(root);
-    if (!json) {
-        cJSON_Delete(root);
-        return ESP_FAIL;
-    }
-
-    strncpy(json_buf, json, buf_size - 1);
-    json_buf[buf_size - 1] = '\0';
-
-    cJSON_free(json);
-    cJSON_Delete(root);
     return ESP_OK;
 }
 
@@ -5,9 +5,18 @@
 #include <esp_matter.h>
 
 #include "../../include/messages/outbound_message_builder.h"
+#include "messages/state_store.h"
+#include "websocket_server.h"
 
 static const char *TAG = "CHIP_EVENT_HANDLER";
 
+// Largest attribute value copied as raw TLV, for the state store and CBOR clients. Larger values are still
+// reported, decoded straight from the report.
+static constexpr size_t MAX_ATTRIBUTE_TLV_SIZE = 1024;
+
+// TLV copy of the attribute being reported. Reports are delivered one at a time on the CHIP task.
+static uint8_t attribute_tlv[MAX_ATTRIBUTE_TLV_SIZE];
+
 void handle_chip_device_event(const ChipDeviceEvent *event, intptr_t arg) {
     switch (event->Type) {
         case chip::DeviceLayer::DeviceEventType::PublicEventTypes::kInterfaceIpAddressChanged:
@@ -64,101 +73,51 @@ void handle_chip_device_event(const ChipDeviceEvent *event, intptr_t arg) {
     }
 }
 
+/**
+ * Copies the attribute value into `attribute_tlv` as an anonymous TLV element, leaving `data` untouched.
+ *
+ * @return Length of the copy in bytes, or 0 if the value could not be copied.
+ */
+static size_t copy_attribute_tlv(const chip::TLV::TLVReader *data) {
+    chip::TLV::TLVReader reader;
+    reader.Init(*data);
+
+    chip::TLV::TLVWriter writer;
+    writer.Init(attribute_tlv, sizeof(attribute_tlv));
+    if (writer.CopyElement(chip::TLV::AnonymousTag(), reader) != CHIP_NO_ERROR ||
+        writer.Finalize() != CHIP_NO_ERROR) {
+        return 0;
+    }
+    return writer.GetLengthWritten();
+}
+
 void attribute_data_report_callback(uint64_t remote_node_id, const chip::app::ConcreteDataAttributePath &path,
                                     chip::TLV::TLVReader *data) {
     ESP_LOGI(TAG, "Received attribute report from node: %" PRIu64, remote_node_id);
 
-    char value_str[256] = {};
-    bool value_extracted = false;
-
-    chip::TLV::TLVType container;
-    if (data->EnterContainer(container) == CHIP_NO_ERROR) {
-        while (data->Next() == CHIP_NO_ERROR) {
-            switch (data->GetType()) {
-                case chip::TLV::kTLVType_UnsignedInteger: {
-                    uint64_t val;
-                    if (data->Get(val) == CHIP_NO_ERROR) {
-                        snprintf(value_str, sizeof(value_str), "%" PRIu64, val);
-                        value_extracted = true;
-                    }
-                    break;
-                }
-                case chip::TLV::kTLVType_SignedInteger: {
-                    int64_t val;
-                    if (data->Get(val) == CHIP_NO_ERROR) {
-                        snprintf(value_str, sizeof(value_str), "%" PRId64, val);
-                        value_extracted = true;
-                    }
-                    break;
-                }
-                case chip::TLV::kTLVType_FloatingPointNumber: {
-                    double val;
-                    if (data->Get(val) == CHIP_NO_ERROR) {
-                        snprintf(value_str, sizeof(value_str), "%f", val);
-                        value_extracted = true;
-                    }
-                    break;
-                }
-                case chip::TLV::kTLVType_UTF8String: {
-                    if (data->GetString(value_str, sizeof(value_str)) == CHIP_NO_ERROR) {
-                        value_extracted = true;
-                    }
-                    break;
-                }
-                default:
-                    break;
-            }
-            if (value_extracted) break;
-        }
-        data->ExitContainer(container);
-    } else {
-        switch (data->GetType()) {
-            case chip::TLV::kTLVType_UnsignedInteger: {
-                uint64_t val;
-                if (data->Get(val) == CHIP_NO_ERROR) {
-                    snprintf(value_str, sizeof(value_str), "%" PRIu64, val);
-                    value_extracted = true;
-                }
-                break;
-            }
-            case chip::TLV::kTLVType_SignedInteger: {
-                int64_t val;
-                if (data->Get(val) == CHIP_NO_ERROR) {
-                    snprintf(value_str, sizeof(value_str), "%" PRId64, val);
-                    value_extracted = true;
-                }
-                break;
-            }
-            case chip::TLV::kTLVType_FloatingPointNumber: {
-                double val;
-                if (data->Get(val) == CHIP_NO_ERROR) {
-                    snprintf(value_str, sizeof(value_str), "%f", val);
-                    value_extracted = true;
-                }
-                break;
-            }
-            case chip::TLV::kTLVType_UTF8String: {
-                if (data->GetString(value_str, sizeof(value_str)) == CHIP_NO_ERROR) {
-                    value_extracted = true;
-                }
-                break;
-            }
-            default:
-                break;
-        }
-    }
-
-    if (!value_extracted) {
-        ESP_LOGW(TAG, "No attribute value could be extracted");
+    // The value is stored for clients that connect later and for reads accepting a recent value, whoever is
+    // subscribed right now
+    const size_t tlv_len = copy_attribute_tlv(data);
+    state_store_set_attribute(remote_node_id, path.mEndpointId, path.mClusterId, path.mAttributeId,
+                              tlv_len > 0 ? attribute_tlv : nullptr, tlv_len,
+                              path.mDataVersion.HasValue() ? &path.mDataVersion.Value() : nullptr);
+
+    if (!matter_attribute_report_wanted(WS_PROTOCOL_JSON, remote_node_id, path.mEndpointId, path.mClusterId,
+                                        path.mAttributeId) &&
+        !matter_attribute_report_wanted(WS_PROTOCOL_CBOR, remote_node_id, path.mEndpointId, path.mClusterId,
+                                        path.mAttributeId)) {
         return;
     }
 
+    // The value is encoded from the reader itself, so values too large to copy are still reported whole
     broadcast_info_matter_attribute_report_message(
         remote_node_id,
         path.mEndpointId,
         path.mClusterId,
         path.mAttributeId,
-        value_str
+        data,
+        tlv_len > 0 ? attribute_tlv : nullptr,
+        tlv_len
     );
 }
 
@@ -1,5 +1,6 @@
 #include "event_handlers/thread_event_handler.h"
 #include "messages/outbound_message_builder.h"
+#include "messages/state_store.h"
 #include "thread_util.h"
 
 #include <esp_log.h>
@@ -16,32 +17,39 @@ void handle_thread_event(void *arg, const esp_event_base_t event_base, const int
 
     switch (event_id) {
         case OPENTHREAD_EVENT_START:
+            state_store_set_flag(STATE_THREAD_STACK_RUNNING, true);
             broadcast_info_thread_stack_status_message(true);
             break;
 
         case OPENTHREAD_EVENT_STOP:
+            state_store_set_flag(STATE_THREAD_STACK_RUNNING, false);
             broadcast_info_thread_stack_status_message(false);
             break;
 
         case OPENTHREAD_EVENT_IF_UP:
+            state_store_set_flag(STATE_THREAD_INTERFACE_UP, true);
             broadcast_info_thread_interface_status_message(true);
             break;
 
         case OPENTHREAD_EVENT_IF_DOWN:
+            state_store_set_flag(STATE_THREAD_INTERFACE_UP, false);
             broadcast_info_thread_interface_status_message(false);
             break;
 
         case OPENTHREAD_EVENT_ATTACHED:
+            state_store_set_flag(STATE_THREAD_ATTACHED, true);
             broadcast_info_thread_attachment_status_message(true);
             break;
 
         case OPENTHREAD_EVENT_DETACHED:
+            state_store_set_flag(STATE_THREAD_ATTACHED, false);
             broadcast_info_thread_attachment_status_message(false);
             break;
 
                 case OPENTHREAD_EVENT_ROLE_CHANGED: {
             const char *role_str = nullptr;
             if (thread_get_device_role_string(&role_str) == ESP_OK && role_str != nullptr) {
+                state_store_set_thread_role(role_str);
                 broadcast_info_thread_role_message(role_str);
             } else {
                 ESP_LOGW(TAG, "Failed to get Thread role string");
@@ -55,6 +63,7 @@ void handle_thread_event(void *arg, const esp_event_base_t event_base, const int
             size_t count = 0;
 
             if (thread_get_unicast_addresses(addresses, THREAD_ADDRESS_LIST_MAX, &count) == ESP_OK) {
+                state_store_set_addresses(STATE_UNICAST_ADDRESSES, addresses, count);
                 broadcast_info_unicast_addresses_message(const_cast<const char **>(addresses), count);
                 thread_free_address_list(addresses, count);
             } else {
@@ -69,6 +78,7 @@ void handle_thread_event(void *arg, const esp_event_base_t event_base, const int
             size_t count = 0;
 
             if (thread_get_multicast_addresses(addresses, THREAD_ADDRESS_LIST_MAX, &count) == ESP_OK) {
+                state_store_set_addresses(STATE_MULTICAST_ADDRESSES, addresses, count);
                 broadcast_info_multicast_addresses_message(const_cast<const char **>(addresses), count);
                 thread_free_address_list(addresses, count);
             } else {
@@ -78,16 +88,26 @@ void handle_thread_event(void *arg, const esp_event_base_t event_base, const int
         }
 
         case OPENTHREAD_EVENT_PUBLISH_MESHCOP_E:
+            state_store_set_flag(STATE_MESHCOP_PUBLISHED, true);
             broadcast_info_meshcop_service_status_message(true);
             break;
 
         case OPENTHREAD_EVENT_REMOVE_MESHCOP_E:
+            state_store_set_flag(STATE_MESHCOP_PUBLISHED, false);
             broadcast_info_meshcop_service_status_message(false);
             break;
 
         case OPENTHREAD_EVENT_DATASET_CHANGED: {
             otOperationalDataset dataset;
             if (thread_get_active_dataset(&dataset) == ESP_OK) {
+                state_store_set_active_dataset(
+                    dataset.mActiveTimestamp.mSeconds,
+                    (const char *)dataset.mNetworkName.m8,
+                    dataset.mExtendedPanId.m8,
+                    dataset.mMeshLocalPrefix.m8,
+                    dataset.mPanId,
+                    dataset.mChannel
+                );
                 broadcast_info_active_dataset_message(
                     dataset.mActiveTimestamp.mSeconds,
                     (const char *)dataset.mNetworkName.m8,
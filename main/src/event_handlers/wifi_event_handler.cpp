@@ -1,6 +1,7 @@
 #include "event_handlers/wifi_event_handler.h"
 
 #include "messages/outbound_message_builder.h"
+#include "messages/state_store.h"
 #include "wifi_interface.h"
 
 #include <esp_err.h>
@@ -8,7 +9,7 @@
 #include <esp_wifi_types_generic.h>
 
 #include "websocket_server.h"
-#include "messages/inbound_message_handler.h"
+#include "messages/command_executor.h"
 
 static const char *TAG = "WIFI_EVENT_HANDLER";
 
@@ -23,19 +24,22 @@ void handle_wifi_event(void *arg, esp_event_base_t event_base, int32_t event_id,
 
         case WIFI_EVENT_STA_CONNECTED:
             ESP_LOGI(TAG, "Wi-Fi STA Connected");
+            state_store_set_wifi_status("connected");
             broadcast_info_wifi_status_message("connected");
             break;
 
         case WIFI_EVENT_STA_DISCONNECTED:
             ESP_LOGI(TAG, "Wi-Fi STA Disconnected");
+            state_store_set_wifi_status("disconnect");
             broadcast_info_wifi_status_message("disconnect");
             break;
 
         case WIFI_EVENT_AP_START:
             ESP_LOGI(TAG, "Wi-Fi AP Started");
 
-            // Start WebSocket server
-            err = websocket_server_start(handle_json_inbound_message);
+            // Start WebSocket server; inbound messages are executed on the command executor task and every new
+            // client is sent the current state
+            err = websocket_server_start(command_executor_submit, send_state_snapshot_message);
             if (err != ESP_OK) {
                 ESP_LOGE(TAG, "Failed to start WebSocket server: %s", esp_err_to_name(err));
             }
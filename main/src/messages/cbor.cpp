@@ -0,0 +1,317 @@
+#include "messages/cbor.h"
+
+#include <cstdlib>
+#include <cstring>
+
+// ---- ENCODING ----
+
+// Capacity of the first heap buffer when a writer starts without one.
+static constexpr size_t WRITER_INITIAL_CAPACITY = 128;
+
+/**
+ * Encodes the header of a data item.
+ *
+ * @param[out] out Receives the header, at most 9 bytes.
+ * @return Length of the header in bytes.
+ */
+static size_t encode_head(uint8_t *out, const uint8_t major, const uint64_t arg) {
+    const auto type = static_cast<uint8_t>(major << 5);
+    size_t size;
+
+    if (arg < 24) {
+        out[0] = type | static_cast<uint8_t>(arg);
+        return 1;
+    }
+    if (arg <= UINT8_MAX) {
+        out[0] = type | 24;
+        size = 1;
+    } else if (arg <= UINT16_MAX) {
+        out[0] = type | 25;
+        size = 2;
+    } else if (arg <= UINT32_MAX) {
+        out[0] = type | 26;
+        size = 4;
+    } else {
+        out[0] = type | 27;
+        size = 8;
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        out[size - i] = static_cast<uint8_t>(arg >> (8 * i));
+    }
+    return size + 1;
+}
+
+/**
+ * Makes room for `n` more bytes. Leaves the caller-provided buffer for the heap when it is too small and
+ * grows heap buffers geometrically.
+ *
+ * @return false if the writer has failed or the buffer could not be grown.
+ */
+static bool reserve(cbor_writer_t *writer, const size_t n) {
+    if (writer->failed) return false;
+    if (writer->len + n <= writer->cap) return true;
+
+    size_t cap = writer->cap ? writer->cap * 2 : WRITER_INITIAL_CAPACITY;
+    while (cap < writer->len + n) cap *= 2;
+
+    uint8_t *buf;
+    if (writer->owned) {
+        buf = static_cast<uint8_t *>(realloc(writer->buf, cap));
+    } else {
+        buf = static_cast<uint8_t *>(malloc(cap));
+        if (buf && writer->len > 0) memcpy(buf, writer->buf, writer->len);
+    }
+    if (!buf) {
+        writer->failed = true;
+        return false;
+    }
+
+    writer->buf = buf;
+    writer->cap = cap;
+    writer->owned = true;
+    return true;
+}
+
+static void write_raw(cbor_writer_t *writer, const void *data, const size_t len) {
+    if (!reserve(writer, len)) return;
+    if (len > 0) memcpy(writer->buf + writer->len, data, len);
+    writer->len += len;
+}
+
+static void write_head(cbor_writer_t *writer, const uint8_t major, const uint64_t arg) {
+    uint8_t head[9];
+    write_raw(writer, head, encode_head(head, major, arg));
+}
+
+void cbor_writer_init(cbor_writer_t *writer, uint8_t *buf, const size_t cap) {
+    *writer = {};
+    writer->buf = buf;
+    writer->cap = buf ? cap : 0;
+}
+
+void cbor_writer_release(cbor_writer_t *writer) {
+    if (writer->owned) free(writer->buf);
+    *writer = {};
+}
+
+void cbor_write_uint(cbor_writer_t *writer, const uint64_t value) {
+    write_head(writer, CBOR_MAJOR_UINT, value);
+}
+
+void cbor_write_int(cbor_writer_t *writer, const int64_t value) {
+    if (value >= 0) {
+        write_head(writer, CBOR_MAJOR_UINT, static_cast<uint64_t>(value));
+    } else {
+        write_head(writer, CBOR_MAJOR_NEGINT, static_cast<uint64_t>(-1 - value));
+    }
+}
+
+void cbor_write_text(cbor_writer_t *writer, const char *text, const size_t len) {
+    write_head(writer, CBOR_MAJOR_TEXT, len);
+    write_raw(writer, text, len);
+}
+
+void cbor_write_bytes(cbor_writer_t *writer, const uint8_t *data, const size_t len) {
+    write_head(writer, CBOR_MAJOR_BYTES, len);
+    write_raw(writer, data, len);
+}
+
+void cbor_write_bool(cbor_writer_t *writer, const bool value) {
+    write_head(writer, CBOR_MAJOR_SIMPLE, value ? 21 : 20);
+}
+
+void cbor_write_null(cbor_writer_t *writer) {
+    write_head(writer, CBOR_MAJOR_SIMPLE, 22);
+}
+
+void cbor_write_encoded(cbor_writer_t *writer, const uint8_t *data, const size_t len) {
+    write_raw(writer, data, len);
+}
+
+void cbor_write_double(cbor_writer_t *writer, const double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint8_t out[9];
+    out[0] = CBOR_MAJOR_SIMPLE << 5 | 27;
+    for (size_t i = 0; i < 8; ++i) {
+        out[8 - i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+    write_raw(writer, out, sizeof(out));
+}
+
+size_t cbor_begin_container(cbor_writer_t *writer, const uint8_t major) {
+    const size_t offset = writer->len;
+    const auto placeholder = static_cast<uint8_t>(major << 5);
+    write_raw(writer, &placeholder, 1);
+    return offset;
+}
+
+void cbor_end_container(cbor_writer_t *writer, const size_t offset, const uint8_t major, const size_t count) {
+    if (writer->failed) return;
+
+    uint8_t head[9];
+    const size_t head_len = encode_head(head, major, count);
+    const size_t extra = head_len - 1;
+
+    if (extra > 0) {
+        if (!reserve(writer, extra)) return;
+        memmove(writer->buf + offset + head_len, writer->buf + offset + 1, writer->len - offset - 1);
+        writer->len += extra;
+    }
+    memcpy(writer->buf + offset, head, head_len);
+}
+
+// ---- DECODING ----
+
+// Parser state shared by the recursive-descent helpers below.
+struct cbor_parser_t {
+    // Input and its length.
+    const uint8_t *data;
+    size_t len;
+    // Offset of the next byte to be consumed.
+    size_t pos;
+    // Caller-provided token storage.
+    cbor_token_t *tokens;
+    size_t max_tokens;
+    // Number of tokens emitted so far.
+    size_t count;
+};
+
+/**
+ * Reserves the next token slot and initializes it.
+ *
+ * @return Index of the new token, or CBOR_TOKENIZE_ERROR_LIMIT if the token array is full.
+ */
+static int alloc_token(cbor_parser_t *p, const cbor_token_type_t type, const size_t start, const uint64_t value) {
+    if (p->count >= p->max_tokens || p->count >= UINT16_MAX) return CBOR_TOKENIZE_ERROR_LIMIT;
+
+    const size_t index = p->count++;
+    cbor_token_t *token = &p->tokens[index];
+    token->type = type;
+    token->start = static_cast<uint32_t>(start);
+    token->value = value;
+    token->next = static_cast<uint16_t>(index + 1);
+    return static_cast<int>(index);
+}
+
+/**
+ * Reads the header of the item at the current position.
+ *
+ * @param[out] major The major type.
+ * @param[out] info The additional information (low five bits of the initial byte).
+ * @param[out] arg The argument: the immediate value or the following 1, 2, 4 or 8 bytes.
+ * @return false if the input ends early or the header uses a reserved or indefinite length encoding.
+ */
+static bool read_head(cbor_parser_t *p, uint8_t *major, uint8_t *info, uint64_t *arg) {
+    if (p->pos >= p->len) return false;
+
+    const uint8_t initial = p->data[p->pos++];
+    *major = initial >> 5;
+    *info = initial & 0x1f;
+
+    if (*info < 24) {
+        *arg = *info;
+        return true;
+    }
+    if (*info > 27) return false;
+
+    const size_t size = static_cast<size_t>(1) << (*info - 24);
+    if (p->len - p->pos < size) return false;
+
+    *arg = 0;
+    for (size_t i = 0; i < size; ++i) {
+        *arg = *arg << 8 | p->data[p->pos++];
+    }
+    return true;
+}
+
+/**
+ * Parses any data item at the current position, emitting container tokens before their children.
+ */
+static int parse_item(cbor_parser_t *p, const int depth) {
+    if (depth >= CBOR_TOKENIZE_MAX_DEPTH) return CBOR_TOKENIZE_ERROR_LIMIT;
+
+    const size_t start = p->pos;
+    uint8_t major, info;
+    uint64_t arg;
+    if (!read_head(p, &major, &info, &arg)) return CBOR_TOKENIZE_ERROR_INVALID;
+
+    switch (major) {
+        case CBOR_MAJOR_UINT:
+            return alloc_token(p, CBOR_TOKEN_UINT, start, arg);
+
+        case CBOR_MAJOR_NEGINT:
+            return alloc_token(p, CBOR_TOKEN_NEGINT, start, arg);
+
+        case CBOR_MAJOR_BYTES:
+        case CBOR_MAJOR_TEXT: {
+            if (arg > p->len - p->pos) return CBOR_TOKENIZE_ERROR_INVALID;
+            const int index = alloc_token(p, major == CBOR_MAJOR_TEXT ? CBOR_TOKEN_TEXT : CBOR_TOKEN_BYTES,
+                                          p->pos, arg);
+            p->pos += arg;
+            return index;
+        }
+
+        case CBOR_MAJOR_ARRAY:
+        case CBOR_MAJOR_MAP: {
+            const uint64_t children = major == CBOR_MAJOR_MAP ? arg * 2 : arg;
+            // Every child takes at least one byte
+            if (arg > p->len - p->pos || children > p->len - p->pos) return CBOR_TOKENIZE_ERROR_INVALID;
+
+            const int index = alloc_token(p, major == CBOR_MAJOR_MAP ? CBOR_TOKEN_MAP : CBOR_TOKEN_ARRAY,
+                                          start, arg);
+            if (index < 0) return index;
+
+            for (uint64_t i = 0; i < children; ++i) {
+                const int child = parse_item(p, depth + 1);
+                if (child < 0) return child;
+            }
+
+            p->tokens[index].next = static_cast<uint16_t>(p->count);
+            return index;
+        }
+
+        case CBOR_MAJOR_TAG:
+            // Semantic tags carry no meaning for the command schema; describe the tagged item instead
+            return parse_item(p, depth + 1);
+
+        default:
+            if (info <= 24) return alloc_token(p, CBOR_TOKEN_SIMPLE, start, arg);
+            return alloc_token(p, CBOR_TOKEN_FLOAT, start, arg);
+    }
+}
+
+int cbor_tokenize(const uint8_t *data, const size_t len, cbor_token_t *tokens, const size_t max_tokens) {
+    if (!data || !tokens || max_tokens == 0) return CBOR_TOKENIZE_ERROR_INVALID;
+
+    cbor_parser_t p = {.data = data, .len = len, .pos = 0, .tokens = tokens, .max_tokens = max_tokens, .count = 0};
+    const int root = parse_item(&p, 0);
+    if (root < 0) return root;
+
+    if (p.pos != p.len) return CBOR_TOKENIZE_ERROR_INVALID;
+    return static_cast<int>(p.count);
+}
+
+int cbor_map_get(const uint8_t *data, const cbor_token_t *tokens, const int map, const char *key) {
+    if (map < 0 || tokens[map].type != CBOR_TOKEN_MAP) return -1;
+
+    const size_t key_len = strlen(key);
+    int item = map + 1;
+    for (uint64_t i = 0; i < tokens[map].value; ++i) {
+        const cbor_token_t *k = &tokens[item];
+        const int value = k->next;
+        if (k->type == CBOR_TOKEN_TEXT && k->value == key_len && memcmp(data + k->start, key, key_len) == 0) {
+            return value;
+        }
+        item = tokens[value].next;
+    }
+    return -1;
+}
+
+char *cbor_text_terminate(uint8_t *data, const cbor_token_t *token) {
+    char *text = reinterpret_cast<char *>(data + token->start);
+    text[token->value] = '\0';
+    return text;
+}
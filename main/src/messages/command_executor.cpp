@@ -0,0 +1,190 @@
+#include "messages/command_executor.h"
+#include "sdkconfig.h"
+
+#include <esp_attr.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <cinttypes>
+#include <cstring>
+
+static const char *TAG = "COMMAND_EXECUTOR";
+
+static constexpr size_t QUEUE_LENGTH = CONFIG_COMMAND_EXECUTOR_QUEUE_LENGTH;
+static constexpr size_t MAX_MESSAGE_SIZE = CONFIG_COMMAND_EXECUTOR_MAX_MESSAGE_SIZE;
+static_assert(MAX_MESSAGE_SIZE >= CONFIG_WEBSOCKET_MAX_INBOUND_MESSAGE_SIZE,
+              "Every message the WebSocket server accepts must fit into an executor buffer");
+
+// A queued message: the sending client, its encoding, the buffer slot holding it and when it was admitted.
+struct command_job_t {
+    int fd;
+    ws_protocol_t protocol;
+    uint8_t slot;
+    uint32_t len;
+    int64_t admitted_us;
+};
+
+// Message buffers, one per queue entry, plus room for the terminator.
+EXT_RAM_BSS_ATTR static char slot_buffers[QUEUE_LENGTH][MAX_MESSAGE_SIZE + 1];
+
+// Indices of the buffers that are not in use.
+static QueueHandle_t free_slots = nullptr;
+
+// Admitted messages waiting for the executor task, in arrival order.
+static QueueHandle_t pending_jobs = nullptr;
+
+// Function executing each message.
+static command_executor_handler_t message_handler = nullptr;
+
+// Function notifying clients of messages that were not admitted.
+static command_executor_reject_handler_t reject_handler = nullptr;
+
+// Statistics, updated by both the admitting task and the executor task.
+static command_executor_stats_t stats = {};
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Records the outcome of one executed message.
+ */
+static void record_completion(const uint32_t wait_us, const uint32_t exec_us, const esp_err_t err) {
+    portENTER_CRITICAL(&stats_lock);
+    stats.completed++;
+    if (err != ESP_OK) stats.failed++;
+    stats.total_wait_us += wait_us;
+    stats.total_exec_us += exec_us;
+    if (wait_us > stats.max_wait_us) stats.max_wait_us = wait_us;
+    if (exec_us > stats.max_exec_us) stats.max_exec_us = exec_us;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+/**
+ * Executor task: takes admitted messages off the queue one at a time and runs the handler on them.
+ *
+ * Commands that wait for the CHIP stack lock only block this task, never the server task that receives
+ * frames and answers pings.
+ */
+static void command_executor_task(void *) {
+    while (true) {
+        command_job_t job;
+        if (xQueueReceive(pending_jobs, &job, portMAX_DELAY) != pdTRUE) continue;
+
+        const int64_t started_us = esp_timer_get_time();
+        const esp_err_t err = message_handler(job.fd, job.protocol, slot_buffers[job.slot], job.len);
+        const int64_t finished_us = esp_timer_get_time();
+
+        xQueueSendToBack(free_slots, &job.slot, 0);
+
+        const auto wait_us = static_cast<uint32_t>(started_us - job.admitted_us);
+        const auto exec_us = static_cast<uint32_t>(finished_us - started_us);
+        record_completion(wait_us, exec_us, err);
+
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Command failed after %" PRIu32 " us: %s", exec_us, esp_err_to_name(err));
+        } else {
+            ESP_LOGD(TAG, "Command completed: waited %" PRIu32 " us, executed in %" PRIu32 " us", wait_us, exec_us);
+        }
+    }
+}
+
+esp_err_t command_executor_start(const command_executor_handler_t handler,
+                                 const command_executor_reject_handler_t reject_handler_fun) {
+    if (!handler) return ESP_ERR_INVALID_ARG;
+    if (pending_jobs) return ESP_ERR_INVALID_STATE;
+
+    free_slots = xQueueCreate(QUEUE_LENGTH, sizeof(uint8_t));
+    pending_jobs = xQueueCreate(QUEUE_LENGTH, sizeof(command_job_t));
+    if (!free_slots || !pending_jobs) {
+        ESP_LOGE(TAG, "Failed to create executor queues");
+        if (free_slots) vQueueDelete(free_slots);
+        if (pending_jobs) vQueueDelete(pending_jobs);
+        free_slots = nullptr;
+        pending_jobs = nullptr;
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (size_t i = 0; i < QUEUE_LENGTH; ++i) {
+        const auto slot = static_cast<uint8_t>(i);
+        xQueueSendToBack(free_slots, &slot, 0);
+    }
+
+    message_handler = handler;
+    reject_handler = reject_handler_fun;
+    stats.capacity = QUEUE_LENGTH;
+
+    if (xTaskCreate(command_executor_task, "command_executor", CONFIG_COMMAND_EXECUTOR_TASK_STACK_SIZE, nullptr,
+                    CONFIG_COMMAND_EXECUTOR_TASK_PRIORITY, nullptr) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start command executor task");
+        vQueueDelete(free_slots);
+        vQueueDelete(pending_jobs);
+        free_slots = nullptr;
+        pending_jobs = nullptr;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Command executor started: %zu slots of %zu bytes", QUEUE_LENGTH, MAX_MESSAGE_SIZE);
+    return ESP_OK;
+}
+
+/**
+ * Counts a message that was not admitted and notifies its sender.
+ *
+ * @return `reason`, so that callers can return the result directly.
+ */
+static esp_err_t reject_message(const int fd, const ws_protocol_t protocol, char *message, const size_t len,
+                                const esp_err_t reason) {
+    portENTER_CRITICAL(&stats_lock);
+    stats.rejected++;
+    portEXIT_CRITICAL(&stats_lock);
+
+    if (reject_handler) {
+        reject_handler(fd, protocol, message, len, reason);
+    }
+    return reason;
+}
+
+esp_err_t command_executor_submit(const int fd, const ws_protocol_t protocol, char *message, const size_t len) {
+    if (!message) return ESP_ERR_INVALID_ARG;
+    if (!pending_jobs) return ESP_ERR_INVALID_STATE;
+
+    if (len > MAX_MESSAGE_SIZE) {
+        ESP_LOGW(TAG, "Rejecting message of %zu bytes from fd=%d (limit %zu)", len, fd, MAX_MESSAGE_SIZE);
+        return reject_message(fd, protocol, message, len, ESP_ERR_INVALID_SIZE);
+    }
+
+    uint8_t slot;
+    if (xQueueReceive(free_slots, &slot, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Command queue full, rejecting message from fd=%d", fd);
+        return reject_message(fd, protocol, message, len, ESP_ERR_NO_MEM);
+    }
+
+    memcpy(slot_buffers[slot], message, len);
+    slot_buffers[slot][len] = '\0';
+
+    const command_job_t job = {
+        .fd = fd, .protocol = protocol, .slot = slot, .len = static_cast<uint32_t>(len),
+        .admitted_us = esp_timer_get_time()
+    };
+    // Cannot fail: a job is only created after taking one of the QUEUE_LENGTH free slots
+    xQueueSendToBack(pending_jobs, &job, 0);
+
+    const auto depth = static_cast<uint32_t>(uxQueueMessagesWaiting(pending_jobs));
+    portENTER_CRITICAL(&stats_lock);
+    stats.submitted++;
+    if (depth > stats.max_depth) stats.max_depth = depth;
+    portEXIT_CRITICAL(&stats_lock);
+
+    return ESP_OK;
+}
+
+esp_err_t command_executor_get_stats(command_executor_stats_t *out) {
+    if (!out) return ESP_ERR_INVALID_ARG;
+
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+
+    out->depth = pending_jobs ? static_cast<uint32_t>(uxQueueMessagesWaiting(pending_jobs)) : 0;
+    return ESP_OK;
+}
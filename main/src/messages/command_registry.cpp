@@ -0,0 +1,627 @@
+#include "messages/command_registry.h"
+#include "commands/matter_commands.h"
+#include "commands/wifi_commands.h"
+#include "commands/thread_commands.h"
+#include "matter_controller.h"
+#include "messages/outbound_message_builder.h"
+#include "thread_util.h"
+#include "websocket_server.h"
+#include "sdkconfig.h"
+
+#include <freertos/FreeRTOS.h>
+#include <cstring>
+#include <iterator>
+
+// ---- THREAD ----
+
+#if CONFIG_OPENTHREAD_ENABLED
+static esp_err_t handle_thread_enable(const command_args_t *, command_result_t *) {
+    return execute_thread_enable_command();
+}
+
+static esp_err_t handle_thread_disable(const command_args_t *, command_result_t *) {
+    return execute_thread_disable_command();
+}
+
+static constexpr command_arg_descriptor_t THREAD_DATASET_INIT_ARGS[] = {
+    {"channel", COMMAND_ARG_UINT, UINT16_MAX},
+    {"pan_id", COMMAND_ARG_UINT, UINT16_MAX},
+    {"network_name", COMMAND_ARG_STRING, 0},
+    {"extended_pan_id", COMMAND_ARG_STRING, 0},
+    {"mesh_local_prefix", COMMAND_ARG_STRING, 0},
+    {"master_key", COMMAND_ARG_STRING, 0},
+    {"pskc", COMMAND_ARG_STRING, 0},
+};
+
+static esp_err_t handle_thread_dataset_init(const command_args_t *args, command_result_t *) {
+    const command_arg_t *v = args->values;
+    return execute_thread_dataset_init_command(static_cast<uint16_t>(v[0].num), static_cast<uint16_t>(v[1].num),
+                                               v[2].str, v[3].str, v[4].str, v[5].str, v[6].str);
+}
+
+static esp_err_t handle_thread_status_get(const command_args_t *, command_result_t *result) {
+    bool is_running;
+    const esp_err_t ret = execute_thread_status_get_command(&is_running);
+    if (ret != ESP_OK) return ret;
+
+    return command_result_add_bool(result, "running", is_running);
+}
+
+static esp_err_t handle_thread_attached_get(const command_args_t *, command_result_t *result) {
+    bool is_attached;
+    const esp_err_t ret = execute_thread_attached_get_command(&is_attached);
+    if (ret != ESP_OK) return ret;
+
+    return command_result_add_bool(result, "attached", is_attached);
+}
+
+static esp_err_t handle_thread_role_get(const command_args_t *, command_result_t *result) {
+    const char *role_str;
+    const esp_err_t ret = execute_thread_role_get_command(&role_str);
+    if (ret != ESP_OK) return ret;
+
+    return command_result_add_string(result, "role", role_str);
+}
+
+/**
+ * Formats binary data as an uppercase hex string. `hex` must hold at least `len * 2 + 1` characters.
+ */
+static void to_hex_string(const uint8_t *bin, const size_t len, char *hex) {
+    static constexpr char DIGITS[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < len; ++i) {
+        hex[i * 2] = DIGITS[bin[i] >> 4];
+        hex[i * 2 + 1] = DIGITS[bin[i] & 0x0F];
+    }
+    hex[len * 2] = '\0';
+}
+
+static esp_err_t handle_thread_active_dataset_get(const command_args_t *, command_result_t *result) {
+    otOperationalDataset dataset;
+    esp_err_t ret = execute_thread_active_dataset_get_command(&dataset);
+    if (ret != ESP_OK) return ret;
+
+    char extended_pan_id[sizeof(dataset.mExtendedPanId.m8) * 2 + 1];
+    char mesh_local_prefix[sizeof(dataset.mMeshLocalPrefix.m8) * 2 + 1];
+    to_hex_string(dataset.mExtendedPanId.m8, sizeof(dataset.mExtendedPanId.m8), extended_pan_id);
+    to_hex_string(dataset.mMeshLocalPrefix.m8, sizeof(dataset.mMeshLocalPrefix.m8), mesh_local_prefix);
+
+    if ((ret = command_result_add_uint(result, "active_timestamp", dataset.mActiveTimestamp.mSeconds)) != ESP_OK ||
+        (ret = command_result_add_string(result, "network_name", dataset.mNetworkName.m8)) != ESP_OK ||
+        (ret = command_result_add_string(result, "extended_pan_id", extended_pan_id)) != ESP_OK ||
+        (ret = command_result_add_string(result, "mesh_local_prefix", mesh_local_prefix)) != ESP_OK ||
+        (ret = command_result_add_uint(result, "pan_id", dataset.mPanId)) != ESP_OK) {
+        return ret;
+    }
+    return command_result_add_uint(result, "channel", dataset.mChannel);
+}
+
+// Maximum number of IPv6 addresses reported by the address getters.
+static constexpr size_t MAX_REPORTED_ADDRESSES = 10;
+
+static esp_err_t handle_thread_unicast_addresses_get(const command_args_t *, command_result_t *result) {
+    char *addresses[MAX_REPORTED_ADDRESSES];
+    size_t count = 0;
+    esp_err_t ret = execute_thread_unicast_addresses_get_command(addresses, MAX_REPORTED_ADDRESSES, &count);
+    if (ret != ESP_OK) return ret;
+
+    ret = command_result_add_string_array(result, "unicast", addresses, count);
+    thread_free_address_list(addresses, count);
+    return ret;
+}
+
+static esp_err_t handle_thread_multicast_addresses_get(const command_args_t *, command_result_t *result) {
+    char *addresses[MAX_REPORTED_ADDRESSES];
+    size_t count = 0;
+    esp_err_t ret = execute_thread_multicast_addresses_get_command(addresses, MAX_REPORTED_ADDRESSES, &count);
+    if (ret != ESP_OK) return ret;
+
+    ret = command_result_add_string_array(result, "multicast", addresses, count);
+    thread_free_address_list(addresses, count);
+    return ret;
+}
+
+#if CONFIG_OPENTHREAD_BORDER_ROUTER
+static esp_err_t handle_thread_br_init(const command_args_t *, command_result_t *) {
+    return execute_thread_br_init_command();
+}
+#endif
+
+static esp_err_t handle_thread_br_deinit(const command_args_t *, command_result_t *) {
+    return execute_thread_br_deinit_command();
+}
+#endif // CONFIG_OPENTHREAD_ENABLED
+
+// ---- WI-FI ----
+
+#if CONFIG_ENABLE_WIFI_STATION
+static constexpr command_arg_descriptor_t WIFI_STA_CONNECT_ARGS[] = {
+    {"ssid", COMMAND_ARG_STRING, 0},
+    {"password", COMMAND_ARG_STRING, 0},
+};
+
+static esp_err_t handle_wifi_sta_connect(const command_args_t *args, command_result_t *) {
+    return execute_wifi_sta_connect_command(args->values[0].str, args->values[1].str);
+}
+#endif
+
+// ---- CLIENT ----
+
+// Leaving "topics" out sends every broadcast to the client again.
+static constexpr command_arg_descriptor_t CLIENT_SUBSCRIBE_ARGS[] = {
+    {"topics", COMMAND_ARG_STRING, 0, true},
+};
+
+static esp_err_t handle_client_subscribe(const command_args_t *args, command_result_t *) {
+    return websocket_set_client_topics(args->client_fd, args->values[0].str);
+}
+
+static esp_err_t handle_client_stats_get(const command_args_t *args, command_result_t *result) {
+    ws_client_stats_t stats;
+    esp_err_t ret = websocket_get_client_stats(args->client_fd, &stats);
+    if (ret != ESP_OK) return ret;
+
+    if ((ret = command_result_add_uint(result, "queued_messages", stats.queued_messages)) != ESP_OK ||
+        (ret = command_result_add_uint(result, "queued_bytes", stats.queued_bytes)) != ESP_OK ||
+        (ret = command_result_add_uint(result, "peak_messages", stats.peak_messages)) != ESP_OK ||
+        (ret = command_result_add_uint(result, "peak_bytes", stats.peak_bytes)) != ESP_OK ||
+        (ret = command_result_add_uint(result, "sent", stats.sent)) != ESP_OK ||
+        (ret = command_result_add_uint(result, "dropped", stats.dropped)) != ESP_OK ||
+        (ret = command_result_add_uint(result, "coalesced", stats.coalesced)) != ESP_OK ||
+        (ret = command_result_add_uint(result, "send_failures", stats.send_failures)) != ESP_OK ||
+        (ret = command_result_add_uint(result, "sent_bytes", stats.sent_bytes)) != ESP_OK) {
+        return ret;
+    }
+    return command_result_add_uint(result, "raw_bytes", stats.raw_bytes);
+}
+
+static constexpr command_arg_descriptor_t CLIENT_RESUME_ARGS[] = {
+    {"resume_from", COMMAND_ARG_UINT, UINT64_MAX},
+};
+
+static esp_err_t handle_client_resume(const command_args_t *args, command_result_t *result) {
+    size_t events = 0;
+    esp_err_t ret = send_replay_message(args->client_fd, args->values[0].num, &events);
+    const bool replayed = ret == ESP_OK;
+    if (ret == ESP_ERR_INVALID_STATE) {
+        // Some missed events are gone, or the sequence restarted: the client starts over from the current state
+        send_state_snapshot_message(args->client_fd, websocket_get_client_protocol(args->client_fd));
+        ret = ESP_OK;
+    }
+    if (ret != ESP_OK) return ret;
+
+    if ((ret = command_result_add_bool(result, "replayed", replayed)) != ESP_OK) return ret;
+    return command_result_add_uint(result, "events", events);
+}
+
+// ---- SERVER ----
+
+static esp_err_t handle_server_tls_stats_get(const command_args_t *, command_result_t *result) {
+    ws_handshake_stats_t stats;
+    websocket_get_handshake_stats(&stats);
+
+    esp_err_t ret;
+    if ((ret = command_result_add_uint(result, "full_handshakes", stats.full)) != ESP_OK ||
+        (ret = command_result_add_uint(result, "resumed_handshakes", stats.resumed)) != ESP_OK ||
+        (ret = command_result_add_uint(result, "failed_handshakes", stats.failed)) != ESP_OK ||
+        (ret = command_result_add_uint(result, "full_handshake_us", stats.full_us)) != ESP_OK) {
+        return ret;
+    }
+    return command_result_add_uint(result, "resumed_handshake_us", stats.resumed_us);
+}
+
+// ---- MATTER ----
+
+static constexpr command_arg_descriptor_t MATTER_CONTROLLER_INIT_ARGS[] = {
+    {"node_id", COMMAND_ARG_UINT_STRING, UINT64_MAX},
+    {"fabric_id", COMMAND_ARG_UINT, UINT64_MAX},
+    {"listen_port", COMMAND_ARG_UINT, UINT16_MAX},
+};
+
+static esp_err_t handle_matter_controller_init(const command_args_t *args, command_result_t *) {
+    const command_arg_t *v = args->values;
+    return execute_matter_controller_init_command(v[0].num, v[1].num, static_cast<uint16_t>(v[2].num));
+}
+
+static constexpr command_arg_descriptor_t MATTER_PAIR_BLE_THREAD_ARGS[] = {
+    {"node_id", COMMAND_ARG_UINT_STRING, UINT64_MAX},
+    {"setup_code", COMMAND_ARG_UINT_STRING, UINT32_MAX},
+    {"discriminator", COMMAND_ARG_UINT_STRING, UINT16_MAX},
+};
+
+static esp_err_t handle_matter_pair_ble_thread(const command_args_t *args, command_result_t *) {
+    const command_arg_t *v = args->values;
+    return execute_matter_pair_ble_thread_command(v[0].num, static_cast<uint32_t>(v[1].num),
+                                                  static_cast<uint16_t>(v[2].num));
+}
+
+static constexpr command_arg_descriptor_t MATTER_CLUSTER_COMMAND_INVOKE_ARGS[] = {
+    {"destination_id", COMMAND_ARG_UINT_STRING, UINT64_MAX},
+    {"endpoint_id", COMMAND_ARG_UINT, UINT16_MAX},
+    {"cluster_id", COMMAND_ARG_UINT, UINT32_MAX},
+    {"command_id", COMMAND_ARG_UINT, UINT32_MAX},
+    {"command_data", COMMAND_ARG_STRING, 0},
+};
+
+static esp_err_t handle_matter_cluster_command_invoke(const command_args_t *args, command_result_t *) {
+    const command_arg_t *v = args->values;
+    return execute_cmd_invoke_command(v[0].num, static_cast<uint16_t>(v[1].num), static_cast<uint32_t>(v[2].num),
+                                      static_cast<uint32_t>(v[3].num), v[4].str);
+}
+
+static void batch_matter_cluster_command_invoke(const command_args_t *args, matter_batch_op_t *op) {
+    const command_arg_t *v = args->values;
+    op->type = MATTER_BATCH_OP_INVOKE;
+    op->node_id = v[0].num;
+    op->endpoint_id = static_cast<uint16_t>(v[1].num);
+    op->cluster_id = static_cast<uint32_t>(v[2].num);
+    op->id = static_cast<uint32_t>(v[3].num);
+    op->command_data = v[4].str;
+}
+
+static constexpr command_arg_descriptor_t MATTER_ATTRIBUTE_READ_ARGS[] = {
+    {"node_id", COMMAND_ARG_UINT_STRING, UINT64_MAX},
+    {"endpoint_id", COMMAND_ARG_UINT, UINT16_MAX},
+    {"cluster_id", COMMAND_ARG_UINT, UINT32_MAX},
+    {"attribute_id", COMMAND_ARG_UINT, UINT32_MAX},
+    {"max_age_ms", COMMAND_ARG_UINT, UINT32_MAX, true},
+};
+
+static esp_err_t handle_matter_attribute_read(const command_args_t *args, command_result_t *result) {
+    const command_arg_t *v = args->values;
+    bool cached = false;
+    bool joined = false;
+    uint32_t age_ms = 0;
+    esp_err_t ret = execute_attr_read_command(args->client_fd, v[0].num, static_cast<uint16_t>(v[1].num),
+                                              static_cast<uint32_t>(v[2].num), static_cast<uint32_t>(v[3].num),
+                                              static_cast<uint32_t>(v[4].num), &cached, &age_ms, &joined);
+    if (ret != ESP_OK) return ret;
+    if ((ret = command_result_add_bool(result, "cached", cached)) != ESP_OK) return ret;
+    if (!cached) return command_result_add_bool(result, "joined", joined);
+    return command_result_add_uint(result, "age_ms", age_ms);
+}
+
+static void batch_matter_attribute_read(const command_args_t *args, matter_batch_op_t *op) {
+    const command_arg_t *v = args->values;
+    op->type = MATTER_BATCH_OP_READ;
+    op->node_id = v[0].num;
+    op->endpoint_id = static_cast<uint16_t>(v[1].num);
+    op->cluster_id = static_cast<uint32_t>(v[2].num);
+    op->id = static_cast<uint32_t>(v[3].num);
+}
+
+static constexpr command_arg_descriptor_t MATTER_ATTRIBUTE_SUBSCRIBE_ARGS[] = {
+    {"node_id", COMMAND_ARG_UINT_STRING, UINT64_MAX},
+    {"endpoint_id", COMMAND_ARG_UINT, UINT16_MAX},
+    {"cluster_id", COMMAND_ARG_UINT, UINT32_MAX},
+    {"attribute_id", COMMAND_ARG_UINT, UINT32_MAX},
+    {"min_interval", COMMAND_ARG_UINT, UINT16_MAX},
+    {"max_interval", COMMAND_ARG_UINT, UINT16_MAX},
+};
+
+/**
+ * Adds the registry handle of a subscription, and whether it was shared with other clients, to a result.
+ */
+static esp_err_t add_subscription_result(command_result_t *result, const uint32_t handle, const bool shared) {
+    esp_err_t ret = command_result_add_uint(result, "subscription", handle);
+    if (ret != ESP_OK) return ret;
+    return command_result_add_bool(result, "shared", shared);
+}
+
+static esp_err_t handle_matter_attribute_subscribe(const command_args_t *args, command_result_t *result) {
+    const command_arg_t *v = args->values;
+    uint32_t handle = 0;
+    bool shared = false;
+    esp_err_t ret = execute_attr_subscribe_command(args->client_fd, v[0].num, static_cast<uint16_t>(v[1].num),
+                                                   static_cast<uint32_t>(v[2].num), static_cast<uint32_t>(v[3].num),
+                                                   static_cast<uint16_t>(v[4].num), static_cast<uint16_t>(v[5].num),
+                                                   &handle, &shared);
+    if (ret != ESP_OK) return ret;
+    return add_subscription_result(result, handle, shared);
+}
+
+static void batch_matter_attribute_subscribe(const command_args_t *args, matter_batch_op_t *op) {
+    const command_arg_t *v = args->values;
+    op->type = MATTER_BATCH_OP_SUBSCRIBE;
+    op->node_id = v[0].num;
+    op->endpoint_id = static_cast<uint16_t>(v[1].num);
+    op->cluster_id = static_cast<uint32_t>(v[2].num);
+    op->id = static_cast<uint32_t>(v[3].num);
+    op->min_interval = static_cast<uint16_t>(v[4].num);
+    op->max_interval = static_cast<uint16_t>(v[5].num);
+    op->subscriber = args->client_fd;
+}
+
+static constexpr command_arg_descriptor_t MATTER_ATTRIBUTES_READ_ARGS[] = {
+    {"node_id", COMMAND_ARG_UINT_STRING, UINT64_MAX},
+    {"paths", COMMAND_ARG_STRING, 0},
+};
+
+static esp_err_t handle_matter_attributes_read(const command_args_t *args, command_result_t *result) {
+    const command_arg_t *v = args->values;
+    size_t path_count = 0;
+    size_t joined_count = 0;
+    esp_err_t ret = execute_attrs_read_command(v[0].num, v[1].str, &path_count, &joined_count);
+    if (ret != ESP_OK) return ret;
+    if ((ret = command_result_add_uint(result, "paths", path_count)) != ESP_OK) return ret;
+    return command_result_add_uint(result, "joined", joined_count);
+}
+
+static constexpr command_arg_descriptor_t MATTER_ATTRIBUTES_SUBSCRIBE_ARGS[] = {
+    {"node_id", COMMAND_ARG_UINT_STRING, UINT64_MAX},
+    {"paths", COMMAND_ARG_STRING, 0},
+    {"min_interval", COMMAND_ARG_UINT, UINT16_MAX},
+    {"max_interval", COMMAND_ARG_UINT, UINT16_MAX},
+};
+
+static esp_err_t handle_matter_attributes_subscribe(const command_args_t *args, command_result_t *result) {
+    const command_arg_t *v = args->values;
+    size_t path_count = 0;
+    uint32_t handle = 0;
+    bool shared = false;
+    esp_err_t ret = execute_attrs_subscribe_command(args->client_fd, v[0].num, v[1].str,
+                                                    static_cast<uint16_t>(v[2].num), static_cast<uint16_t>(v[3].num),
+                                                    &path_count, &handle, &shared);
+    if (ret != ESP_OK) return ret;
+    if ((ret = command_result_add_uint(result, "paths", path_count)) != ESP_OK) return ret;
+    return add_subscription_result(result, handle, shared);
+}
+
+// Maximum number of subscriptions reported by matter.subscriptions_get.
+static constexpr size_t MAX_REPORTED_SUBSCRIPTIONS = 8;
+
+static esp_err_t handle_matter_subscriptions_get(const command_args_t *, command_result_t *result) {
+    char subscriptions[MAX_REPORTED_SUBSCRIPTIONS][MATTER_SUBSCRIPTION_TEXT_SIZE];
+    size_t count = 0;
+    esp_err_t ret = execute_subscriptions_get_command(subscriptions, MAX_REPORTED_SUBSCRIPTIONS, &count);
+    if (ret != ESP_OK) return ret;
+
+    const char *entries[MAX_REPORTED_SUBSCRIPTIONS];
+    for (size_t i = 0; i < count; ++i) {
+        entries[i] = subscriptions[i];
+    }
+    return command_result_add_string_array(result, "subscriptions", entries, count);
+}
+
+static constexpr command_arg_descriptor_t MATTER_SUBSCRIPTION_CANCEL_ARGS[] = {
+    {"subscription", COMMAND_ARG_UINT, UINT32_MAX},
+};
+
+static esp_err_t handle_matter_subscription_cancel(const command_args_t *args, command_result_t *) {
+    return execute_subscription_cancel_command(args->client_fd, static_cast<uint32_t>(args->values[0].num));
+}
+
+// ---- REGISTRY ----
+
+/**
+ * Builds a registry entry for a command without payload fields.
+ */
+static constexpr command_descriptor_t command(const char *action, const command_handler_t handler) {
+    return {action, handler, nullptr, 0, nullptr};
+}
+
+/**
+ * Builds a registry entry for a command whose payload layout is described by `args`. Commands with a
+ * `batch` builder may also be sent inside a batch envelope.
+ */
+template<size_t N>
+static constexpr command_descriptor_t command(const char *action, const command_handler_t handler,
+                                              const command_arg_descriptor_t (&args)[N],
+                                              const command_batch_builder_t batch = nullptr) {
+    static_assert(N <= COMMAND_MAX_ARGS, "Too many payload fields, increase COMMAND_MAX_ARGS");
+    return {action, handler, args, N, batch};
+}
+
+// Every inbound command action. New commands only need an entry here.
+static constexpr command_descriptor_t COMMANDS[] = {
+#if CONFIG_OPENTHREAD_ENABLED
+    command("thread.enable", handle_thread_enable),
+    command("thread.disable", handle_thread_disable),
+    command("thread.dataset.init", handle_thread_dataset_init, THREAD_DATASET_INIT_ARGS),
+    command("thread.status_get", handle_thread_status_get),
+    command("thread.attached_get", handle_thread_attached_get),
+    command("thread.role_get", handle_thread_role_get),
+    command("thread.active_dataset_get", handle_thread_active_dataset_get),
+    command("thread.unicast_addresses_get", handle_thread_unicast_addresses_get),
+    command("thread.multicast_addresses_get", handle_thread_multicast_addresses_get),
+#if CONFIG_OPENTHREAD_BORDER_ROUTER
+    command("thread.br_init", handle_thread_br_init),
+#endif
+    command("thread.br_deinit", handle_thread_br_deinit),
+#endif
+#if CONFIG_ENABLE_WIFI_STATION
+    command("wifi.sta_connect", handle_wifi_sta_connect, WIFI_STA_CONNECT_ARGS),
+#endif
+    command("client.subscribe", handle_client_subscribe, CLIENT_SUBSCRIBE_ARGS),
+    command("client.stats_get", handle_client_stats_get),
+    command("client.resume", handle_client_resume, CLIENT_RESUME_ARGS),
+    command("server.tls_stats_get", handle_server_tls_stats_get),
+    command("matter.controller_init", handle_matter_controller_init, MATTER_CONTROLLER_INIT_ARGS),
+    command("matter.pair_ble_thread", handle_matter_pair_ble_thread, MATTER_PAIR_BLE_THREAD_ARGS),
+    command("matter.cluster_command_invoke", handle_matter_cluster_command_invoke, MATTER_CLUSTER_COMMAND_INVOKE_ARGS,
+            batch_matter_cluster_command_invoke),
+    command("matter.attribute_read", handle_matter_attribute_read, MATTER_ATTRIBUTE_READ_ARGS,
+            batch_matter_attribute_read),
+    command("matter.attribute_subscribe", handle_matter_attribute_subscribe, MATTER_ATTRIBUTE_SUBSCRIBE_ARGS,
+            batch_matter_attribute_subscribe),
+    command("matter.attributes_read", handle_matter_attributes_read, MATTER_ATTRIBUTES_READ_ARGS),
+    command("matter.attributes_subscribe", handle_matter_attributes_subscribe, MATTER_ATTRIBUTES_SUBSCRIBE_ARGS),
+    command("matter.subscriptions_get", handle_matter_subscriptions_get),
+    command("matter.subscription_cancel", handle_matter_subscription_cancel, MATTER_SUBSCRIPTION_CANCEL_ARGS),
+};
+
+// ---- PERFECT HASH ----
+
+/**
+ * FNV-1a hash of an action string with the seed folded into the offset basis.
+ *
+ * @param s Null-terminated action string.
+ * @param seed Seed selecting one member of the hash family.
+ * @return 32-bit hash value.
+ */
+static constexpr uint32_t action_hash(const char *s, const uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    while (*s) {
+        h ^= static_cast<uint8_t>(*s++);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * Returns the smallest power of two that is greater than or equal to `n` (and at least 1).
+ */
+static constexpr size_t next_pow2(const size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+// Upper bound on the displacement search for a single bucket. Only reached for duplicate actions.
+static constexpr uint32_t MAX_DISPLACEMENT = 1u << 16;
+
+/**
+ * Two-level "hash and displace" perfect hash over the command table.
+ *
+ * An action is first hashed with seed 0 into a bucket; the bucket's displacement is then used as the seed of
+ * the second hash, which yields a collision-free slot. Buckets hold two actions on average and the slot table
+ * is kept at most half full, so construction stays cheap and lookup cost is independent of the table size.
+ */
+template<size_t N>
+struct command_hash_table_t {
+    static constexpr size_t BUCKETS = next_pow2((N + 1) / 2);
+    static constexpr size_t SLOTS = next_pow2(N) * 2;
+
+    // Second-level seed for each bucket.
+    uint32_t displacement[BUCKETS] = {};
+    // Index + 1 into the command table for each slot, 0 if the slot is empty.
+    uint16_t slots[SLOTS] = {};
+    // False if no collision-free layout could be found (e.g. duplicate actions).
+    bool valid = false;
+};
+
+/**
+ * Builds the perfect hash table for `commands` at compile time.
+ *
+ * Buckets are placed largest first while the slot table is still sparse; for each bucket the first
+ * displacement that maps all of its actions to distinct free slots is kept.
+ */
+template<size_t N>
+static constexpr command_hash_table_t<N> build_command_hash_table(const command_descriptor_t (&commands)[N]) {
+    using table_t = command_hash_table_t<N>;
+    table_t table{};
+
+    size_t bucket_of[N] = {};
+    size_t bucket_size[table_t::BUCKETS] = {};
+    for (size_t i = 0; i < N; ++i) {
+        bucket_of[i] = action_hash(commands[i].action, 0) & (table_t::BUCKETS - 1);
+        bucket_size[bucket_of[i]]++;
+    }
+
+    bool placed[table_t::BUCKETS] = {};
+    for (size_t n = 0; n < table_t::BUCKETS; ++n) {
+        // Pick the largest bucket that has not been placed yet
+        size_t bucket = 0;
+        size_t largest = 0;
+        bool found = false;
+        for (size_t b = 0; b < table_t::BUCKETS; ++b) {
+            if (!placed[b] && (!found || bucket_size[b] > largest)) {
+                bucket = b;
+                largest = bucket_size[b];
+                found = true;
+            }
+        }
+        placed[bucket] = true;
+        if (largest == 0) break;
+
+        // Search for a displacement mapping the whole bucket to free, distinct slots
+        uint32_t displacement = 1;
+        for (; displacement < MAX_DISPLACEMENT; ++displacement) {
+            size_t taken[N] = {};
+            size_t taken_count = 0;
+            bool fits = true;
+            for (size_t i = 0; i < N && fits; ++i) {
+                if (bucket_of[i] != bucket) continue;
+                const size_t slot = action_hash(commands[i].action, displacement) & (table_t::SLOTS - 1);
+                if (table.slots[slot] != 0) fits = false;
+                for (size_t k = 0; k < taken_count && fits; ++k) {
+                    if (taken[k] == slot) fits = false;
+                }
+                taken[taken_count++] = slot;
+            }
+            if (fits) break;
+        }
+        if (displacement == MAX_DISPLACEMENT) return table;
+
+        table.displacement[bucket] = displacement;
+        for (size_t i = 0; i < N; ++i) {
+            if (bucket_of[i] != bucket) continue;
+            const size_t slot = action_hash(commands[i].action, displacement) & (table_t::SLOTS - 1);
+            table.slots[slot] = static_cast<uint16_t>(i + 1);
+        }
+    }
+
+    table.valid = true;
+    return table;
+}
+
+static constexpr auto COMMAND_HASH_TABLE = build_command_hash_table(COMMANDS);
+static_assert(COMMAND_HASH_TABLE.valid, "Failed to build the command perfect hash, check for duplicate actions");
+
+/**
+ * Looks up an action in `commands` through its perfect hash table: two hashes and a single string compare,
+ * whatever the number of commands.
+ */
+template<size_t N>
+static const command_descriptor_t *find_command(const command_hash_table_t<N> &table,
+                                                const command_descriptor_t (&commands)[N], const char *action) {
+    if (!action) return nullptr;
+
+    const uint32_t bucket = action_hash(action, 0) & (table.BUCKETS - 1);
+    const uint32_t slot = action_hash(action, table.displacement[bucket]) & (table.SLOTS - 1);
+    const uint16_t index = table.slots[slot];
+
+    if (index == 0 || strcmp(commands[index - 1].action, action) != 0) return nullptr;
+    return &commands[index - 1];
+}
+
+const command_descriptor_t *command_registry_find(const char *action) {
+    return find_command(COMMAND_HASH_TABLE, COMMANDS, action);
+}
+
+// ---- STATISTICS ----
+
+static constexpr size_t COMMAND_COUNT = std::size(COMMANDS);
+
+// Execution statistics, indexed like COMMANDS. Written by the executor task, read when metrics are scraped.
+static command_stats_t command_stats[COMMAND_COUNT] = {};
+static portMUX_TYPE command_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+size_t command_registry_count() {
+    return COMMAND_COUNT;
+}
+
+const command_descriptor_t *command_registry_at(const size_t index) {
+    return index < COMMAND_COUNT ? &COMMANDS[index] : nullptr;
+}
+
+void command_registry_record(const command_descriptor_t *command, const esp_err_t result, const uint32_t exec_us) {
+    if (!command || command < COMMANDS || command >= COMMANDS + COMMAND_COUNT) return;
+
+    command_stats_t &stats = command_stats[command - COMMANDS];
+    portENTER_CRITICAL(&command_stats_lock);
+    stats.executed++;
+    if (result != ESP_OK) stats.failed++;
+    metrics_histogram_record(&stats.latency, exec_us);
+    portEXIT_CRITICAL(&command_stats_lock);
+}
+
+void command_registry_get_stats(const size_t index, command_stats_t *stats) {
+    if (index >= COMMAND_COUNT) {
+        *stats = {};
+        return;
+    }
+
+    portENTER_CRITICAL(&command_stats_lock);
+    *stats = command_stats[index];
+    portEXIT_CRITICAL(&command_stats_lock);
+}
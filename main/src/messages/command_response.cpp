@@ -0,0 +1,92 @@
+#include "messages/command_response.h"
+
+#include <cstring>
+
+/**
+ * Reserves the next field of a result.
+ *
+ * @return The new field, or nullptr if all fields are in use.
+ */
+static command_result_field_t *add_field(command_result_t *result, const char *key,
+                                         const command_result_type_t type) {
+    if (!result || !key || result->field_count >= COMMAND_RESULT_MAX_FIELDS) return nullptr;
+
+    command_result_field_t *field = &result->fields[result->field_count++];
+    *field = {};
+    field->key = key;
+    field->type = type;
+    return field;
+}
+
+/**
+ * Copies a string into the arena of a result.
+ *
+ * @return The copy, or nullptr if the arena is full.
+ */
+static const char *copy_string(command_result_t *result, const char *value) {
+    const size_t len = strlen(value) + 1;
+    if (len > COMMAND_RESULT_ARENA_SIZE - result->arena_used) return nullptr;
+
+    char *copy = result->arena + result->arena_used;
+    memcpy(copy, value, len);
+    result->arena_used += len;
+    return copy;
+}
+
+void command_result_reset(command_result_t *result) {
+    if (!result) return;
+    result->field_count = 0;
+    result->arena_used = 0;
+}
+
+esp_err_t command_result_add_bool(command_result_t *result, const char *key, const bool value) {
+    command_result_field_t *field = add_field(result, key, COMMAND_RESULT_BOOL);
+    if (!field) return ESP_ERR_NO_MEM;
+
+    field->boolean = value;
+    return ESP_OK;
+}
+
+esp_err_t command_result_add_uint(command_result_t *result, const char *key, const uint64_t value) {
+    command_result_field_t *field = add_field(result, key, COMMAND_RESULT_UINT);
+    if (!field) return ESP_ERR_NO_MEM;
+
+    field->number = value;
+    return ESP_OK;
+}
+
+esp_err_t command_result_add_string(command_result_t *result, const char *key, const char *value) {
+    if (!value) return ESP_ERR_INVALID_ARG;
+
+    command_result_field_t *field = add_field(result, key, COMMAND_RESULT_STRING);
+    if (!field) return ESP_ERR_NO_MEM;
+
+    field->str = copy_string(result, value);
+    if (!field->str) {
+        result->field_count--;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t command_result_add_string_array(command_result_t *result, const char *key, const char *const *values,
+                                          const size_t count) {
+    if (!values && count > 0) return ESP_ERR_INVALID_ARG;
+
+    command_result_field_t *field = add_field(result, key, COMMAND_RESULT_STRING_ARRAY);
+    if (!field) return ESP_ERR_NO_MEM;
+
+    const size_t arena_mark = result->arena_used;
+    field->str = result->arena + arena_mark;
+
+    for (size_t i = 0; i < count; ++i) {
+        if (!values[i]) continue;
+        if (!copy_string(result, values[i])) {
+            result->field_count--;
+            result->arena_used = arena_mark;
+            return ESP_ERR_NO_MEM;
+        }
+        field->count++;
+    }
+    return ESP_OK;
+}
@@ -1,12 +1,18 @@
 #include "messages/inbound_message_handler.h"
+#include "messages/cbor.h"
+#include "messages/command_registry.h"
+#include "messages/json_tokenizer.h"
+#include "messages/outbound_message_builder.h"
 #include "commands/matter_commands.h"
-#include "commands/wifi_commands.h"
-#include "commands/thread_commands.h"
-#include "sdkconfig.h"
+#include "matter_controller.h"
 
 #include <cJSON.h>
-#include <esp_event.h>
+#include <esp_attr.h>
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
 #include <cstring>
 
 static const char *TAG = "JSON_INBOUND_HANDLER";
@@ -22,324 +28,621 @@ static const char *TAG = "JSON_INBOUND_HANDLER";
  *         parsing errors.
  */
 static bool parse_uint64(const char *s, uint64_t *out) {
-    if (!s || !*s) return false;
+    if (!s || *s < '0' || *s > '9') return false;
     char *end;
+    errno = 0;
     const uint64_t val = strtoull(s, &end, 10);
-    if (end == s || *end != '\0') return false;
+    if (end == s || *end != '\0' || errno == ERANGE) return false;
     *out = val;
     return true;
 }
 
 /**
- * Parses a null-terminated string into an unsigned 32-bit integer.
+ * Converts a JSON number to an unsigned 64-bit integer.
  *
- * Converts the input string `s` into a `uint32_t` value if it represents a valid
- * non-negative integer within the range [0, UINT32_MAX]. The result is stored in
- * the location pointed to by `out` if parsing succeeds.
- *
- * @param[in] s A pointer to a null-terminated string containing the input to parse.
- *              Must not be null, and must contain at least one character.
- * @param[out] out A pointer to a `uint32_t` variable where the parsed value will be stored
- *                 if the function succeeds. Must not be null.
- *
- * @retval true If the parsing is successful, and `*out` contains the parsed value.
- * @retval false If parsing fails due to an invalid input, overflow, or other errors.
+ * @param number The number as parsed from JSON.
+ * @param out A pointer to a variable where the converted value will be stored upon success.
+ * @return true if `number` is a non-negative integer representable as uint64_t, false otherwise.
  */
-static bool parse_uint32(const char *s, uint32_t *out) {
-    if (!s || !*s) return false;
-    char *end;
-    const unsigned long val = strtoul(s, &end, 10);
-    if (end == s || *end != '\0' || val > UINT32_MAX) return false;
-    *out = static_cast<uint32_t>(val);
+static bool number_to_uint64(const double number, uint64_t *out) {
+    if (!(number >= 0) || number >= 18446744073709551616.0 || number != std::floor(number)) return false;
+    *out = static_cast<uint64_t>(number);
     return true;
 }
 
 /**
- * Parses a string into an unsigned 16-bit integer.
+ * Looks up the registry entry for an action and logs unknown actions.
  *
- * This function attempts to convert the input string to an unsigned 16-bit
- * integer. The conversion succeeds only if the entire string represents a
- * valid number within the range of a uint16_t.
+ * @param action Null-terminated action name.
+ * @return The matching descriptor, or nullptr if the action is not registered.
+ */
+static const command_descriptor_t *find_command(const char *action) {
+    ESP_LOGI(TAG, "Processing command action: %s", action);
+
+    const command_descriptor_t *command = command_registry_find(action);
+    if (!command) {
+        ESP_LOGW(TAG, "Unknown action");
+    }
+    return command;
+}
+
+/**
+ * Logs a payload field that is missing or does not match its descriptor.
+ */
+static esp_err_t invalid_command_arg(const command_descriptor_t *command, const command_arg_descriptor_t *field) {
+    ESP_LOGW(TAG, "Missing or invalid payload field '%s' for action %s", field->name, command->action);
+    return ESP_ERR_INVALID_ARG;
+}
+
+/**
+ * Sends an error response for a request that could not be executed.
  *
- * @param s Pointer to a null-terminated string containing the input number.
- *          Should not be null, and must represent a valid numeric value.
- * @param out Pointer to a uint16_t variable where the parsed result is stored
- *            upon successful conversion. Must not be null.
+ * @return `err`, so that callers can return the result directly.
+ */
+static esp_err_t reply_error(const int fd, const command_request_id_t *request_id, const char *action,
+                             const esp_err_t err) {
+    send_command_response_message(fd, request_id, action, err, nullptr);
+    return err;
+}
+
+/**
+ * Stores a string request ID, rejecting IDs longer than COMMAND_REQUEST_ID_MAX_LEN.
+ */
+static esp_err_t set_string_request_id(const char *str, command_request_id_t *request_id) {
+    const size_t len = strlen(str);
+    if (len > COMMAND_REQUEST_ID_MAX_LEN) {
+        ESP_LOGW(TAG, "'request_id' longer than %d characters", COMMAND_REQUEST_ID_MAX_LEN);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memcpy(request_id->string, str, len + 1);
+    request_id->is_string = true;
+    request_id->present = true;
+    return ESP_OK;
+}
+
+/**
+ * Stores a numeric request ID, rejecting numbers above COMMAND_REQUEST_ID_MAX_NUMBER.
+ */
+static esp_err_t set_number_request_id(const uint64_t number, command_request_id_t *request_id) {
+    if (number > COMMAND_REQUEST_ID_MAX_NUMBER) {
+        ESP_LOGW(TAG, "Numeric 'request_id' out of range");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    request_id->number = number;
+    request_id->is_string = false;
+    request_id->present = true;
+    return ESP_OK;
+}
+
+// Result of the command being executed. Inbound messages are handled one at a time.
+static command_result_t command_result;
+
+/**
+ * Runs a decoded command and sends its response to the originating client.
+ */
+static esp_err_t execute_command(const int fd, const command_request_id_t *request_id,
+                                 const command_descriptor_t *command, command_args_t *args) {
+    args->client_fd = fd;
+    command_result_reset(&command_result);
+    const int64_t started_us = esp_timer_get_time();
+    const esp_err_t ret = command->handler(args, &command_result);
+    send_command_response_message(fd, request_id, command->action, ret, &command_result);
+    command_registry_record(command, ret, static_cast<uint32_t>(esp_timer_get_time() - started_us));
+    return ret;
+}
+
+// ---- BATCH ----
+
+// Maximum number of commands carried by a single batch envelope.
+static constexpr size_t BATCH_MAX_COMMANDS = 64;
+
+// Scratch state of the batch being processed. Inbound messages are handled one at a time, so a single
+// instance suffices; it is kept in external RAM when available.
+EXT_RAM_BSS_ATTR static matter_batch_op_t batch_ops[BATCH_MAX_COMMANDS];
+// Index into the batch of the command behind each entry of `batch_ops`.
+EXT_RAM_BSS_ATTR static size_t batch_op_commands[BATCH_MAX_COMMANDS];
+EXT_RAM_BSS_ATTR static const char *batch_actions[BATCH_MAX_COMMANDS];
+EXT_RAM_BSS_ATTR static esp_err_t batch_results[BATCH_MAX_COMMANDS];
+
+/**
+ * Queues a decoded batch command for execution.
  *
- * @return True if the string is successfully converted to a uint16_t and false
- *         otherwise. Returns false if the input string is null, empty, contains
- *         non-numeric characters, or represents a number outside the uint16_t range.
+ * @param index Position of the command inside the batch.
+ * @param command The registry entry of the command.
+ * @param args The decoded payload. Strings must stay valid until the batch has been executed.
+ * @param[in,out] op_count Number of operations queued so far.
  */
-static bool parse_uint16(const char *s, uint16_t *out) {
-    if (!s || !*s) return false;
-    char *end;
-    const unsigned long val = strtoul(s, &end, 10);
-    if (end == s || *end != '\0' || val > UINT16_MAX) return false;
-    *out = static_cast<uint16_t>(val);
-    return true;
+static void stage_batch_command(const size_t index, const command_descriptor_t *command, const command_args_t *args,
+                                size_t *op_count) {
+    if (!command->batch) {
+        ESP_LOGW(TAG, "Action %s cannot be part of a batch", command->action);
+        batch_results[index] = ESP_ERR_NOT_SUPPORTED;
+        return;
+    }
+
+    matter_batch_op_t *op = &batch_ops[*op_count];
+    *op = {};
+    command->batch(args, op);
+    batch_op_commands[(*op_count)++] = index;
+    batch_results[index] = ESP_ERR_NOT_FINISHED;
 }
 
 /**
- * Processes a command message by executing the appropriate action based on the specified command and payload.
- * This function handles various commands related to Thread, Wi-Fi, and Matter functionalities.
+ * Issues the staged operations of a batch and sends the aggregated result to the originating client.
  *
- * @param action The command action to be processed. The action specifies the type of operation to execute.
- *               Supported actions are specific to Thread, Wi-Fi, and Matter components (e.g., "thread.enable",
- *               "wifi.sta_connect", "matter.controller_init").
- * @param payload The payload containing the parameters required to execute the specified action. This is expected
- *                to be a cJSON object with key-value pairs relevant to the command action.
+ * @param fd The file descriptor of the originating client.
+ * @param request_id The request ID of the batch.
+ * @param count Number of commands in the batch.
+ * @param op_count Number of staged operations.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+static esp_err_t execute_batch(const int fd, const command_request_id_t *request_id, const size_t count,
+                               const size_t op_count) {
+    esp_err_t ret = ESP_OK;
+    const int64_t started_us = esp_timer_get_time();
+    if (op_count > 0) {
+        ret = execute_matter_batch_command(batch_ops, op_count);
+        for (size_t i = 0; i < op_count; ++i) {
+            batch_results[batch_op_commands[i]] = batch_ops[i].result;
+        }
+    }
+
+    ESP_LOGI(TAG, "Executed batch of %zu commands (%zu issued)", count, op_count);
+
+    const esp_err_t err = send_batch_response_message(fd, request_id, batch_actions, batch_results, count);
+
+    // Every issued command took as long as the whole batch
+    const auto exec_us = static_cast<uint32_t>(esp_timer_get_time() - started_us);
+    for (size_t i = 0; i < op_count; ++i) {
+        const size_t index = batch_op_commands[i];
+        command_registry_record(command_registry_find(batch_actions[index]), batch_results[index], exec_us);
+    }
+    return ret != ESP_OK ? ret : err;
+}
+
+// ---- DOCUMENT ACCESS ----
+
+// Token budget of the in-situ decoders. The command envelope with a flat payload needs well under this.
+static constexpr size_t INBOUND_MAX_TOKENS = 48;
+
+// Token budget for larger documents such as batch envelopes, about 16 tokens per batched command. JSON
+// documents exceeding it fall back to cJSON; CBOR has no fallback decoder, so larger documents are rejected.
+static constexpr size_t INBOUND_MAX_BATCH_TOKENS = BATCH_MAX_COMMANDS * 16 + 8;
+EXT_RAM_BSS_ATTR static json_token_t batch_tokens[INBOUND_MAX_BATCH_TOKENS];
+EXT_RAM_BSS_ATTR static cbor_token_t cbor_batch_tokens[INBOUND_MAX_BATCH_TOKENS];
+
+/*
+ * The envelope and payload decoding below is written once against the accessors of a parsed document, one
+ * accessor type per decoder. A `value_t` designates a value of the document; `get` returns an absent value
+ * for missing members, which the type predicates reject. Strings are decoded in place, so each string value
+ * is read at most once.
+ */
+
+/**
+ * A JSON message tokenized in place. Values are token indices, negative if absent.
+ */
+struct json_document_t {
+    typedef int value_t;
+    // JSON carries 64-bit integers as decimal strings only.
+    static constexpr bool NATIVE_UINT_STRINGS = false;
+
+    char *js;
+    const json_token_t *tokens;
+
+    value_t root() const { return 0; }
+    bool present(const value_t v) const { return v >= 0; }
+    value_t get(const value_t object, const char *key) const { return json_object_get(js, tokens, object, key); }
+    bool is_string(const value_t v) const { return v >= 0 && tokens[v].type == JSON_TOKEN_STRING; }
+    bool is_object(const value_t v) const { return v >= 0 && tokens[v].type == JSON_TOKEN_OBJECT; }
+    bool is_array(const value_t v) const { return v >= 0 && tokens[v].type == JSON_TOKEN_ARRAY; }
+    const char *string(const value_t v) const { return json_string_decode(js, &tokens[v]); }
+    bool uint(const value_t v, uint64_t *out) const { return json_number_to_uint64(js, &tokens[v], out); }
+    size_t size(const value_t array) const { return tokens[array].size; }
+    value_t first(const value_t array) const { return array + 1; }
+    value_t next(const value_t v) const { return tokens[v].next; }
+};
+
+/**
+ * A CBOR message tokenized in place. Values are token indices, negative if absent.
+ */
+struct cbor_document_t {
+    typedef int value_t;
+    // COMMAND_ARG_UINT_STRING fields accept a native unsigned integer as well as a decimal text string.
+    static constexpr bool NATIVE_UINT_STRINGS = true;
+
+    uint8_t *data;
+    const cbor_token_t *tokens;
+
+    value_t root() const { return 0; }
+    bool present(const value_t v) const { return v >= 0; }
+    value_t get(const value_t map, const char *key) const { return cbor_map_get(data, tokens, map, key); }
+    bool is_string(const value_t v) const { return v >= 0 && tokens[v].type == CBOR_TOKEN_TEXT; }
+    bool is_object(const value_t v) const { return v >= 0 && tokens[v].type == CBOR_TOKEN_MAP; }
+    bool is_array(const value_t v) const { return v >= 0 && tokens[v].type == CBOR_TOKEN_ARRAY; }
+    const char *string(const value_t v) const { return cbor_text_terminate(data, &tokens[v]); }
+
+    bool uint(const value_t v, uint64_t *out) const {
+        if (tokens[v].type != CBOR_TOKEN_UINT) return false;
+        *out = tokens[v].value;
+        return true;
+    }
+
+    size_t size(const value_t array) const { return tokens[array].value; }
+    value_t first(const value_t array) const { return array + 1; }
+    value_t next(const value_t v) const { return tokens[v].next; }
+};
+
+/**
+ * A JSON message parsed with cJSON. Values are items of the tree, null if absent; strings stay valid as long
+ * as the tree is alive.
+ */
+struct cjson_document_t {
+    typedef const cJSON *value_t;
+    static constexpr bool NATIVE_UINT_STRINGS = false;
+
+    const cJSON *tree;
+
+    value_t root() const { return tree; }
+    bool present(const value_t v) const { return v != nullptr; }
+    value_t get(const value_t object, const char *key) const { return cJSON_GetObjectItemCaseSensitive(object, key); }
+    bool is_string(const value_t v) const { return cJSON_IsString(v); }
+    bool is_object(const value_t v) const { return cJSON_IsObject(v); }
+    bool is_array(const value_t v) const { return cJSON_IsArray(v); }
+    const char *string(const value_t v) const { return v->valuestring; }
+
+    bool uint(const value_t v, uint64_t *out) const {
+        return cJSON_IsNumber(v) && number_to_uint64(v->valuedouble, out);
+    }
+
+    size_t size(const value_t array) const { return cJSON_GetArraySize(array); }
+    value_t first(const value_t array) const { return array->child; }
+    value_t next(const value_t v) const { return v->next; }
+};
+
+// ---- DECODING ----
+
+/**
+ * Extracts the payload fields declared by a command descriptor from a payload object.
  *
- * @return `ESP_OK` if the command was successfully processed, and the corresponding operation was executed,
- *         or an error code defining the failure reason. Potential error cases include invalid arguments,
- *         unsupported actions, or internal execution failures.
+ * Every declared field is mandatory unless marked optional. Integer fields are range-checked against the
+ * descriptor's `max`; string values are referenced inside the document.
+ *
+ * @param command The registry entry describing the expected payload layout.
+ * @param doc The message.
+ * @param payload The payload object.
+ * @param[out] args Decoded field values, in descriptor order.
+ * @return ESP_OK if all mandatory fields were present and all fields valid, ESP_ERR_INVALID_ARG otherwise.
  */
-static esp_err_t process_command_message(const char *action, const cJSON *payload) {
-    ESP_LOGI(TAG, "Processing command action: %s", action);
+template<typename document_t>
+static esp_err_t decode_command_args(const command_descriptor_t *command, const document_t &doc,
+                                     const typename document_t::value_t payload, command_args_t *args) {
+    args->count = command->arg_count;
 
-    // Thread commands defined in thread_command.h
-#if CONFIG_OPENTHREAD_ENABLED
-    // thread.enable
-    if (strcmp(action, "thread.enable") == 0) {
-        return execute_thread_enable_command();
-    }
-    // thread.disable
-    if (strcmp(action, "thread.disable") == 0) {
-        return execute_thread_disable_command();
-    }
-    // thread.dataset_init
-    if (strcmp(action, "thread.dataset.init") == 0) {
-        return execute_thread_dataset_init_command(
-            cJSON_GetObjectItem(payload, "channel")->valueint,
-            cJSON_GetObjectItem(payload, "pan_id")->valueint,
-            cJSON_GetObjectItem(payload, "network_name")->valuestring,
-            cJSON_GetObjectItem(payload, "extended_pan_id")->valuestring,
-            cJSON_GetObjectItem(payload, "mesh_local_prefix")->valuestring,
-            cJSON_GetObjectItem(payload, "master_key")->valuestring,
-            cJSON_GetObjectItem(payload, "pskc")->valuestring
-        );
-    }
-    // thread.status_get
-    if (strcmp(action, "thread.status_get") == 0) {
-        bool is_running;
-        esp_err_t ret = execute_thread_status_get_command(&is_running);
-        if (ret == ESP_OK) {
-            ESP_LOGI(TAG, "Thread status - Running: %s", is_running ? "true" : "false");
-        }
-        return ret;
-    }
-    // thread.attached_get
-    if (strcmp(action, "thread.attached_get") == 0) {
-        bool is_attached;
-        esp_err_t ret = execute_thread_attached_get_command(&is_attached);
-        if (ret == ESP_OK) {
-            ESP_LOGI(TAG, "Thread attached state: %s", is_attached ? "attached" : "not attached");
-        }
-        return ret;
-    }
-    // thread.role_get
-    if (strcmp(action, "thread.role_get") == 0) {
-        const char *role_str;
-        esp_err_t ret = execute_thread_role_get_command(&role_str);
-        if (ret == ESP_OK) {
-            ESP_LOGI(TAG, "Thread role: %s", role_str);
-        }
-        return ret;
-    }
-    // thread.active_dataset_get
-    if (strcmp(action, "thread.active_dataset_get") == 0) {
-        char json_buf[512]; // Example buffer size
-        esp_err_t ret = execute_thread_active_dataset_get_command(json_buf, sizeof(json_buf));
-        if (ret == ESP_OK) {
-            ESP_LOGI(TAG, "Active Dataset: %s", json_buf);
-        }
-        return ret;
-    }
-    // thread.unicast_addresses_get
-    if (strcmp(action, "thread.unicast_addresses_get") == 0) {
-        char *addresses[10];
-        size_t count;
-        esp_err_t ret = execute_thread_unicast_addresses_get_command(addresses, 10, &count);
-        if (ret == ESP_OK) {
-            ESP_LOGI(TAG, "Unicast addresses count: %zu", count);
-        }
-        return ret;
-    }
-    // thread.multicast_addresses_get
-    if (strcmp(action, "thread.multicast_addresses_get") == 0) {
-        char *addresses[10];
-        size_t count;
-        esp_err_t ret = execute_thread_multicast_addresses_get_command(addresses, 10, &count);
-        if (ret == ESP_OK) {
-            ESP_LOGI(TAG, "Multicast addresses count: %zu", count);
+    for (size_t i = 0; i < command->arg_count; ++i) {
+        const command_arg_descriptor_t *field = &command->args[i];
+        const typename document_t::value_t item = doc.get(payload, field->name);
+        command_arg_t *value = &args->values[i];
+        value->str = nullptr;
+        value->num = 0;
+
+        if (!doc.present(item)) {
+            if (field->optional) continue;
+            return invalid_command_arg(command, field);
         }
-        return ret;
-    }
-    // thread.br_init
-#if CONFIG_OPENTHREAD_BORDER_ROUTER
-    if (strcmp(action, "thread.br_init") == 0) {
-        return execute_thread_br_init_command();
-    }
-#endif
-    // thread.br_deinit
-    if (strcmp(action, "thread.br_deinit") == 0) {
-        return execute_thread_br_deinit_command();
-    }
-#endif
-
-    // Wi-Fi commands defined in wifi_command.h
-#if CONFIG_ENABLE_WIFI_STATION
-    // wifi.sta_connect
-    if (strcmp(action, "wifi.sta_connect") == 0) {
-        const cJSON *ssid = cJSON_GetObjectItem(payload, "ssid");
-        const cJSON *password = cJSON_GetObjectItem(payload, "password");
-        if (!cJSON_IsString(ssid) || !cJSON_IsString(password)) {
-            ESP_LOGW(TAG, "Invalid Wi-Fi payload");
-            return ESP_ERR_INVALID_ARG;
+
+        switch (field->type) {
+            case COMMAND_ARG_STRING:
+                if (!doc.is_string(item)) return invalid_command_arg(command, field);
+                value->str = doc.string(item);
+                break;
+            case COMMAND_ARG_UINT:
+                if (!doc.uint(item, &value->num) || value->num > field->max) {
+                    return invalid_command_arg(command, field);
+                }
+                break;
+            case COMMAND_ARG_UINT_STRING:
+                if (doc.is_string(item)) {
+                    if (!parse_uint64(doc.string(item), &value->num)) return invalid_command_arg(command, field);
+                } else if (!document_t::NATIVE_UINT_STRINGS || !doc.uint(item, &value->num)) {
+                    return invalid_command_arg(command, field);
+                }
+                if (value->num > field->max) return invalid_command_arg(command, field);
+                break;
         }
+    }
 
-        return execute_wifi_sta_connect_command(ssid->valuestring, password->valuestring);
+    return ESP_OK;
+}
+
+/**
+ * Decodes the optional "request_id" member of a message: a string of at most COMMAND_REQUEST_ID_MAX_LEN
+ * characters or an integer up to COMMAND_REQUEST_ID_MAX_NUMBER.
+ *
+ * @param doc The message.
+ * @param[out] request_id The decoded request ID; `present` stays false if the message has none.
+ * @return ESP_OK if the request ID is absent or valid, ESP_ERR_INVALID_ARG otherwise.
+ */
+template<typename document_t>
+static esp_err_t decode_request_id(const document_t &doc, command_request_id_t *request_id) {
+    const typename document_t::value_t item = doc.get(doc.root(), "request_id");
+    if (!doc.present(item)) return ESP_OK;
+
+    if (doc.is_string(item)) return set_string_request_id(doc.string(item), request_id);
+
+    uint64_t number;
+    if (!doc.uint(item, &number)) {
+        ESP_LOGW(TAG, "Invalid 'request_id' (expected a string or a non-negative integer)");
+        return ESP_ERR_INVALID_ARG;
+    }
+    return set_number_request_id(number, request_id);
+}
+
+/**
+ * Decodes and executes a batch envelope.
+ *
+ * @param fd The file descriptor of the originating client.
+ * @param request_id The request ID of the batch.
+ * @param doc The message.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+template<typename document_t>
+static esp_err_t process_batch(const int fd, const command_request_id_t *request_id, const document_t &doc) {
+    const typename document_t::value_t commands = doc.get(doc.root(), "commands");
+    if (!doc.is_array(commands)) {
+        ESP_LOGW(TAG, "Missing or invalid 'commands' field");
+        return reply_error(fd, request_id, "batch", ESP_ERR_INVALID_ARG);
+    }
+
+    const size_t count = doc.size(commands);
+    if (count == 0 || count > BATCH_MAX_COMMANDS) {
+        ESP_LOGW(TAG, "A batch must contain between 1 and %zu commands", BATCH_MAX_COMMANDS);
+        return reply_error(fd, request_id, "batch", ESP_ERR_INVALID_ARG);
     }
-#endif
 
-    // Matter commands defined in matter_command.h
-    // matter.controller_init
-    if (strcmp(action, "matter.controller_init") == 0) {
-        const cJSON *node_id = cJSON_GetObjectItem(payload, "node_id");
-        const cJSON *fabric_id = cJSON_GetObjectItem(payload, "fabric_id");
-        const cJSON *listen_port = cJSON_GetObjectItem(payload, "listen_port");
-        if (!cJSON_IsString(node_id) || !cJSON_IsNumber(fabric_id) || !cJSON_IsNumber(listen_port)) {
-            ESP_LOGW(TAG, "Invalid Matter init payload");
-            return ESP_ERR_INVALID_ARG;
+    size_t op_count = 0;
+    typename document_t::value_t item = doc.first(commands);
+    for (size_t i = 0; i < count; ++i, item = doc.next(item)) {
+        batch_actions[i] = nullptr;
+
+        const typename document_t::value_t action = doc.get(item, "action");
+        const typename document_t::value_t payload = doc.get(item, "payload");
+        if (!doc.is_string(action) || !doc.is_object(payload)) {
+            ESP_LOGW(TAG, "Malformed command at batch index %zu", i);
+            batch_results[i] = ESP_ERR_INVALID_ARG;
+            continue;
         }
 
-        return execute_matter_controller_init_command(
-            static_cast<uint64_t>(node_id->valueint),
-            static_cast<uint64_t>(fabric_id->valuedouble),
-            static_cast<uint16_t>(listen_port->valueint)
-        );
-    }
-    // matter.pair_ble_thread
-    if (strcmp(action, "matter.pair_ble_thread") == 0) {
-        const cJSON *node_id = cJSON_GetObjectItem(payload, "node_id");
-        const cJSON *setup_code = cJSON_GetObjectItem(payload, "setup_code");
-        const cJSON *discriminator = cJSON_GetObjectItem(payload, "discriminator");
-
-        uint64_t node_id_val;
-        uint32_t pin;
-        uint16_t disc;
-
-        if (!parse_uint64(node_id->valuestring, &node_id_val) ||
-            !parse_uint32(setup_code->valuestring, &pin) ||
-            !parse_uint16(discriminator->valuestring, &disc)) {
-            ESP_LOGW(TAG, "BLE pairing values invalid");
-            return ESP_ERR_INVALID_ARG;
+        batch_actions[i] = doc.string(action);
+        const command_descriptor_t *command = find_command(batch_actions[i]);
+        command_args_t args;
+        if (!command) {
+            batch_results[i] = ESP_ERR_NOT_FOUND;
+        } else if ((batch_results[i] = decode_command_args(command, doc, payload, &args)) == ESP_OK) {
+            stage_batch_command(i, command, &args, &op_count);
         }
+    }
+
+    return execute_batch(fd, request_id, count, op_count);
+}
 
-        return execute_matter_pair_ble_thread_command(node_id_val, pin, disc);
+/**
+ * Validates the envelope of a message whose root is an object, executes the command or batch it carries and
+ * sends the response to the originating client.
+ *
+ * @param fd The file descriptor of the originating client.
+ * @param doc The message.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+template<typename document_t>
+static esp_err_t process_message(const int fd, const document_t &doc) {
+    command_request_id_t request_id = {};
+    if (decode_request_id(doc, &request_id) != ESP_OK) {
+        return reply_error(fd, nullptr, nullptr, ESP_ERR_INVALID_ARG);
     }
 
-    // matter.cluster_command_invoke
-    if (strcmp(action, "matter.cluster_command_invoke") == 0) {
-        const cJSON *dest = cJSON_GetObjectItem(payload, "destination_id");
-        const cJSON *ep = cJSON_GetObjectItem(payload, "endpoint_id");
-        const cJSON *cluster = cJSON_GetObjectItem(payload, "cluster_id");
-        const cJSON *cmd = cJSON_GetObjectItem(payload, "command_id");
-        const cJSON *data = cJSON_GetObjectItem(payload, "command_data");
-        if (!cJSON_IsString(dest) || !cJSON_IsNumber(ep) || !cJSON_IsNumber(cluster) || !cJSON_IsNumber(cmd) || !
-            cJSON_IsString(data)) {
-            ESP_LOGW(TAG, "Invalid invoke payload");
-            return ESP_ERR_INVALID_ARG;
-        }
+    const typename document_t::value_t type = doc.get(doc.root(), "type");
+    const typename document_t::value_t action = doc.get(doc.root(), "action");
+    const typename document_t::value_t payload = doc.get(doc.root(), "payload");
 
+    // Validate the message structure: type, action, payload
+    if (!doc.is_string(type)) {
+        ESP_LOGW(TAG, "Invalid or missing 'type' (expected: 'command' or 'batch')");
+        return reply_error(fd, &request_id, nullptr, ESP_ERR_INVALID_ARG);
+    }
+
+    const char *type_str = doc.string(type);
+    if (strcmp(type_str, "batch") == 0) return process_batch(fd, &request_id, doc);
 
-        return execute_cmd_invoke_command(static_cast<uint64_t>(dest->valueint),
-                                          static_cast<uint16_t>(ep->valueint),
-                                          static_cast<uint32_t>(cluster->valueint),
-                                          static_cast<uint32_t>(cmd->valueint),
-                                          data->valuestring);
+    if (!doc.is_string(action)) {
+        ESP_LOGW(TAG, "Missing or invalid 'action' field");
+        return reply_error(fd, &request_id, nullptr, ESP_ERR_INVALID_ARG);
     }
 
-    // matter.attribute_read
-    if (strcmp(action, "matter.attribute_read") == 0) {
-        const cJSON *node = cJSON_GetObjectItem(payload, "node_id");
-        const cJSON *ep = cJSON_GetObjectItem(payload, "endpoint_id");
-        const cJSON *cluster = cJSON_GetObjectItem(payload, "cluster_id");
-        const cJSON *attr = cJSON_GetObjectItem(payload, "attribute_id");
-        if (!cJSON_IsString(node) || !cJSON_IsNumber(ep) || !cJSON_IsNumber(cluster) || !cJSON_IsNumber(attr)) {
-            ESP_LOGW(TAG, "Invalid read-attr payload");
-            return ESP_ERR_INVALID_ARG;
-        }
+    const char *action_str = doc.string(action);
+    if (!doc.is_object(payload)) {
+        ESP_LOGW(TAG, "Missing or invalid 'payload' field");
+        return reply_error(fd, &request_id, action_str, ESP_ERR_INVALID_ARG);
+    }
 
-        return execute_attr_read_command(
-            static_cast<uint64_t>(node->valueint),
-            static_cast<uint16_t>(ep->valueint),
-            static_cast<uint32_t>(cluster->valueint),
-            static_cast<uint32_t>(attr->valueint));
-    }
-
-    // matter.attribute_subscribe
-    if (strcmp(action, "matter.attribute_subscribe") == 0) {
-        const cJSON *node = cJSON_GetObjectItem(payload, "node_id");
-        const cJSON *ep = cJSON_GetObjectItem(payload, "endpoint_id");
-        const cJSON *cluster = cJSON_GetObjectItem(payload, "cluster_id");
-        const cJSON *attr = cJSON_GetObjectItem(payload, "attribute_id");
-        const cJSON *min = cJSON_GetObjectItem(payload, "min_interval");
-        const cJSON *max = cJSON_GetObjectItem(payload, "max_interval");
-        if (!cJSON_IsString(node) || !cJSON_IsNumber(ep) || !cJSON_IsNumber(cluster) ||
-            !cJSON_IsNumber(attr) || !cJSON_IsNumber(min) || !cJSON_IsNumber(max)) {
-            ESP_LOGW(TAG, "Invalid subscribe-attr payload");
-            return ESP_ERR_INVALID_ARG;
-        }
+    if (strcmp(type_str, "command") != 0) {
+        ESP_LOGW(TAG, "Unsupported message type: %s", type_str);
+        return reply_error(fd, &request_id, action_str, ESP_ERR_NOT_SUPPORTED);
+    }
+
+    const command_descriptor_t *command = find_command(action_str);
+    if (!command) return reply_error(fd, &request_id, action_str, ESP_ERR_NOT_FOUND);
+
+    command_args_t args;
+    const esp_err_t ret = decode_command_args(command, doc, payload, &args);
+    if (ret != ESP_OK) return reply_error(fd, &request_id, action_str, ret);
+
+    return execute_command(fd, &request_id, command, &args);
+}
 
-        return execute_attr_subscribe_command(
-            static_cast<uint64_t>(node->valueint),
-            static_cast<uint16_t>(ep->valueint),
-            static_cast<uint32_t>(cluster->valueint),
-            static_cast<uint32_t>(attr->valueint),
-            static_cast<uint16_t>(min->valueint),
-            static_cast<uint16_t>(max->valueint)
-        );
+// ---- cJSON FALLBACK ----
+
+/**
+ * Parses a message with cJSON, executes the command or batch it carries and sends the response to the
+ * originating client. Used for documents that exceed the limits of the in-situ decoder.
+ *
+ * @param fd The file descriptor of the originating client.
+ * @param message The message text.
+ * @param len Length of the message in bytes.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+static esp_err_t process_cjson_message(const int fd, const char *message, const size_t len) {
+    cJSON *root = cJSON_ParseWithLength(message, len);
+    if (!root) {
+        ESP_LOGE(TAG, "JSON parse error");
+        return reply_error(fd, nullptr, nullptr, ESP_ERR_INVALID_ARG);
     }
 
-    ESP_LOGW(TAG, "Unknown action");
-    return ESP_ERR_INVALID_ARG;
+    esp_err_t ret;
+    if (!cJSON_IsObject(root)) {
+        ESP_LOGW(TAG, "Inbound message is not a JSON object");
+        ret = reply_error(fd, nullptr, nullptr, ESP_ERR_INVALID_ARG);
+    } else {
+        ret = process_message(fd, cjson_document_t{root});
+    }
+
+    cJSON_Delete(root);
+    return ret;
 }
 
-esp_err_t handle_json_inbound_message(const char *inbound_message) {
+// ---- CBOR DECODING ----
+
+/**
+ * Tokenizes a CBOR message, executes the command or batch it carries and sends the response to the
+ * originating client.
+ *
+ * @param fd The file descriptor of the originating client.
+ * @param inbound_message The message. Must be writable, with one extra byte after `len`.
+ * @param len Length of the message in bytes.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+static esp_err_t handle_cbor_inbound_message(const int fd, char *inbound_message, const size_t len) {
+    auto *data = reinterpret_cast<uint8_t *>(inbound_message);
+
+    cbor_token_t small_tokens[INBOUND_MAX_TOKENS];
+    const cbor_token_t *tokens = small_tokens;
+    int count = cbor_tokenize(data, len, small_tokens, INBOUND_MAX_TOKENS);
+
+    if (count == CBOR_TOKENIZE_ERROR_LIMIT) {
+        tokens = cbor_batch_tokens;
+        count = cbor_tokenize(data, len, cbor_batch_tokens, INBOUND_MAX_BATCH_TOKENS);
+    }
+    if (count == CBOR_TOKENIZE_ERROR_LIMIT) {
+        ESP_LOGW(TAG, "CBOR message exceeds decoder limits");
+        return reply_error(fd, nullptr, nullptr, ESP_ERR_INVALID_SIZE);
+    }
+    if (count < 0) {
+        ESP_LOGE(TAG, "CBOR parse error");
+        return reply_error(fd, nullptr, nullptr, ESP_ERR_INVALID_ARG);
+    }
+    if (tokens[0].type != CBOR_TOKEN_MAP) {
+        ESP_LOGW(TAG, "Inbound message is not a CBOR map");
+        return reply_error(fd, nullptr, nullptr, ESP_ERR_INVALID_ARG);
+    }
+
+    return process_message(fd, cbor_document_t{data, tokens});
+}
+
+// ---- ENTRY POINTS ----
+
+/**
+ * Tokenizes a JSON message in place, falling back to cJSON for documents exceeding the token budgets,
+ * executes the command or batch it carries and sends the response to the originating client.
+ *
+ * @param fd The file descriptor of the originating client.
+ * @param inbound_message The message. Must be writable.
+ * @param len Length of the message in bytes.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+static esp_err_t handle_json_inbound_message(const int fd, char *inbound_message, const size_t len) {
+    json_token_t small_tokens[INBOUND_MAX_TOKENS];
+    const json_token_t *tokens = small_tokens;
+    int count = json_tokenize(inbound_message, len, small_tokens, INBOUND_MAX_TOKENS);
+
+    if (count == JSON_TOKENIZE_ERROR_LIMIT) {
+        tokens = batch_tokens;
+        count = json_tokenize(inbound_message, len, batch_tokens, INBOUND_MAX_BATCH_TOKENS);
+    }
+    if (count == JSON_TOKENIZE_ERROR_LIMIT) {
+        ESP_LOGD(TAG, "Message exceeds in-situ decoder limits, falling back to cJSON");
+        return process_cjson_message(fd, inbound_message, len);
+    }
+    if (count < 0) {
+        ESP_LOGE(TAG, "JSON parse error");
+        return reply_error(fd, nullptr, nullptr, ESP_ERR_INVALID_ARG);
+    }
+    if (tokens[0].type != JSON_TOKEN_OBJECT) {
+        ESP_LOGW(TAG, "Inbound message is not a JSON object");
+        return reply_error(fd, nullptr, nullptr, ESP_ERR_INVALID_ARG);
+    }
+
+    return process_message(fd, json_document_t{inbound_message, tokens});
+}
+
+esp_err_t handle_inbound_message(const int fd, const ws_protocol_t protocol, char *inbound_message,
+                                 const size_t len) {
     if (!inbound_message) {
         ESP_LOGE(TAG, "Null inbound message");
         return ESP_ERR_INVALID_ARG;
     }
 
-    cJSON *root = cJSON_Parse(inbound_message);
-    if (!root) {
-        ESP_LOGE(TAG, "JSON parse error");
-        return ESP_ERR_INVALID_ARG;
+    if (protocol == WS_PROTOCOL_CBOR) return handle_cbor_inbound_message(fd, inbound_message, len);
+    return handle_json_inbound_message(fd, inbound_message, len);
+}
+
+/**
+ * Recovers the request ID and action of a CBOR message without executing it.
+ */
+static void recover_cbor_request(char *inbound_message, const size_t len, command_request_id_t *request_id,
+                                 const char **action_str) {
+    auto *data = reinterpret_cast<uint8_t *>(inbound_message);
+    cbor_token_t tokens[INBOUND_MAX_TOKENS];
+    if (cbor_tokenize(data, len, tokens, INBOUND_MAX_TOKENS) <= 0 || tokens[0].type != CBOR_TOKEN_MAP) return;
+
+    decode_request_id(cbor_document_t{data, tokens}, request_id);
+
+    const int action = cbor_map_get(data, tokens, 0, "action");
+    if (action >= 0 && tokens[action].type == CBOR_TOKEN_TEXT) {
+        *action_str = cbor_text_terminate(data, &tokens[action]);
     }
+}
 
-    cJSON *type = cJSON_GetObjectItemCaseSensitive(root, "type");
-    cJSON *action = cJSON_GetObjectItemCaseSensitive(root, "action");
-    cJSON *payload = cJSON_GetObjectItemCaseSensitive(root, "payload");
+/**
+ * Recovers the request ID and action of a JSON message without executing it.
+ */
+static void recover_json_request(char *inbound_message, const size_t len, command_request_id_t *request_id,
+                                 const char **action_str) {
+    json_token_t tokens[INBOUND_MAX_TOKENS];
+    if (json_tokenize(inbound_message, len, tokens, INBOUND_MAX_TOKENS) <= 0 ||
+        tokens[0].type != JSON_TOKEN_OBJECT) {
+        return;
+    }
 
-    esp_err_t ret = ESP_OK;
+    decode_request_id(json_document_t{inbound_message, tokens}, request_id);
 
-    // Validate the message structure: type, action, payload
-    if (!cJSON_IsString(type)) {
-        ESP_LOGW(TAG, "Invalid or missing 'type' (expected: 'command')");
-        ret = ESP_ERR_INVALID_ARG;
-    } else if (!cJSON_IsString(action)) {
-        ESP_LOGW(TAG, "Missing or invalid 'action' field");
-        ret = ESP_ERR_INVALID_ARG;
-    } else if (!cJSON_IsObject(payload)) {
-        ESP_LOGW(TAG, "Missing or invalid 'payload' field");
-        ret = ESP_ERR_INVALID_ARG;
+    const int action = json_object_get(inbound_message, tokens, 0, "action");
+    if (action >= 0 && tokens[action].type == JSON_TOKEN_STRING) {
+        *action_str = json_string_decode(inbound_message, &tokens[action]);
     }
+}
+
+void reject_inbound_message(const int fd, const ws_protocol_t protocol, char *inbound_message, const size_t len,
+                            const esp_err_t reason) {
+    command_request_id_t request_id = {};
+    const char *action_str = nullptr;
 
-    // If the message is valid, process it
-    if (ret == ESP_OK && strcmp(type->valuestring, "command") == 0) {
-        ret = process_command_message(action->valuestring, payload);
+    // Best effort: recover the request ID and action so that the client can correlate the rejection
+    if (inbound_message && protocol == WS_PROTOCOL_CBOR) {
+        recover_cbor_request(inbound_message, len, &request_id, &action_str);
+    } else if (inbound_message) {
+        recover_json_request(inbound_message, len, &request_id, &action_str);
     }
 
-    cJSON_Delete(root);
-    return ret;
+    reply_error(fd, &request_id, action_str, reason);
 }
@@ -0,0 +1,348 @@
+#include "messages/json_tokenizer.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+// Parser state shared by the recursive-descent helpers below.
+struct json_parser_t {
+    // Input text and its length.
+    const char *js;
+    size_t len;
+    // Offset of the next character to be consumed.
+    size_t pos;
+    // Caller-provided token storage.
+    json_token_t *tokens;
+    size_t max_tokens;
+    // Number of tokens emitted so far.
+    size_t count;
+};
+
+static int parse_value(json_parser_t *p, int depth);
+
+/**
+ * Advances the parser past any JSON whitespace.
+ */
+static void skip_whitespace(json_parser_t *p) {
+    while (p->pos < p->len) {
+        const char c = p->js[p->pos];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') break;
+        p->pos++;
+    }
+}
+
+/**
+ * Reserves the next token slot and initializes it.
+ *
+ * @return Index of the new token, or JSON_TOKENIZE_ERROR_LIMIT if the token array is full.
+ */
+static int alloc_token(json_parser_t *p, const json_token_type_t type, const size_t start, const size_t end) {
+    if (p->count >= p->max_tokens || p->count >= UINT16_MAX) return JSON_TOKENIZE_ERROR_LIMIT;
+
+    const size_t index = p->count++;
+    json_token_t *token = &p->tokens[index];
+    token->type = type;
+    token->start = static_cast<uint32_t>(start);
+    token->end = static_cast<uint32_t>(end);
+    token->size = 0;
+    token->next = static_cast<uint16_t>(index + 1);
+    return static_cast<int>(index);
+}
+
+static bool is_hex_digit(const char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+static bool is_digit(const char c) {
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * Scans a string starting at the opening quote and validates its escape sequences.
+ */
+static int parse_string(json_parser_t *p) {
+    const size_t start = ++p->pos;
+
+    while (p->pos < p->len) {
+        const char c = p->js[p->pos];
+        if (c == '"') {
+            const int index = alloc_token(p, JSON_TOKEN_STRING, start, p->pos);
+            p->pos++;
+            return index;
+        }
+        if (static_cast<uint8_t>(c) < 0x20) return JSON_TOKENIZE_ERROR_INVALID;
+
+        if (c == '\\') {
+            if (++p->pos >= p->len) return JSON_TOKENIZE_ERROR_INVALID;
+            switch (p->js[p->pos]) {
+                case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+                    break;
+                case 'u':
+                    for (int i = 0; i < 4; ++i) {
+                        if (++p->pos >= p->len || !is_hex_digit(p->js[p->pos])) return JSON_TOKENIZE_ERROR_INVALID;
+                    }
+                    break;
+                default:
+                    return JSON_TOKENIZE_ERROR_INVALID;
+            }
+        }
+        p->pos++;
+    }
+
+    return JSON_TOKENIZE_ERROR_INVALID;
+}
+
+/**
+ * Consumes one or more decimal digits.
+ *
+ * @return false if the current character is not a digit.
+ */
+static bool consume_digits(json_parser_t *p) {
+    if (p->pos >= p->len || !is_digit(p->js[p->pos])) return false;
+    while (p->pos < p->len && is_digit(p->js[p->pos])) p->pos++;
+    return true;
+}
+
+/**
+ * Scans a number or one of the literals true, false and null.
+ */
+static int parse_primitive(json_parser_t *p) {
+    const size_t start = p->pos;
+    const size_t remaining = p->len - p->pos;
+    const char *s = p->js + p->pos;
+
+    if (remaining >= 4 && (memcmp(s, "true", 4) == 0 || memcmp(s, "null", 4) == 0)) {
+        p->pos += 4;
+    } else if (remaining >= 5 && memcmp(s, "false", 5) == 0) {
+        p->pos += 5;
+    } else {
+        if (p->js[p->pos] == '-') p->pos++;
+        if (p->pos < p->len && p->js[p->pos] == '0') {
+            p->pos++;
+        } else if (!consume_digits(p)) {
+            return JSON_TOKENIZE_ERROR_INVALID;
+        }
+        if (p->pos < p->len && p->js[p->pos] == '.') {
+            p->pos++;
+            if (!consume_digits(p)) return JSON_TOKENIZE_ERROR_INVALID;
+        }
+        if (p->pos < p->len && (p->js[p->pos] == 'e' || p->js[p->pos] == 'E')) {
+            p->pos++;
+            if (p->pos < p->len && (p->js[p->pos] == '+' || p->js[p->pos] == '-')) p->pos++;
+            if (!consume_digits(p)) return JSON_TOKENIZE_ERROR_INVALID;
+        }
+    }
+
+    return alloc_token(p, JSON_TOKEN_PRIMITIVE, start, p->pos);
+}
+
+/**
+ * Parses an object or an array, emitting the container token before its children.
+ */
+static int parse_container(json_parser_t *p, const int depth, const bool is_object) {
+    if (depth >= JSON_TOKENIZE_MAX_DEPTH) return JSON_TOKENIZE_ERROR_LIMIT;
+
+    const char close = is_object ? '}' : ']';
+    const int index = alloc_token(p, is_object ? JSON_TOKEN_OBJECT : JSON_TOKEN_ARRAY, p->pos, p->pos);
+    if (index < 0) return index;
+    p->pos++;
+
+    skip_whitespace(p);
+    if (p->pos < p->len && p->js[p->pos] == close) {
+        p->pos++;
+    } else {
+        while (true) {
+            if (is_object) {
+                skip_whitespace(p);
+                if (p->pos >= p->len || p->js[p->pos] != '"') return JSON_TOKENIZE_ERROR_INVALID;
+                const int key = parse_string(p);
+                if (key < 0) return key;
+
+                skip_whitespace(p);
+                if (p->pos >= p->len || p->js[p->pos] != ':') return JSON_TOKENIZE_ERROR_INVALID;
+                p->pos++;
+            }
+
+            const int value = parse_value(p, depth + 1);
+            if (value < 0) return value;
+            p->tokens[index].size++;
+
+            skip_whitespace(p);
+            if (p->pos >= p->len) return JSON_TOKENIZE_ERROR_INVALID;
+            const char c = p->js[p->pos++];
+            if (c == close) break;
+            if (c != ',') return JSON_TOKENIZE_ERROR_INVALID;
+        }
+    }
+
+    p->tokens[index].end = static_cast<uint32_t>(p->pos);
+    p->tokens[index].next = static_cast<uint16_t>(p->count);
+    return index;
+}
+
+/**
+ * Parses any JSON value at the current position.
+ */
+static int parse_value(json_parser_t *p, const int depth) {
+    skip_whitespace(p);
+    if (p->pos >= p->len) return JSON_TOKENIZE_ERROR_INVALID;
+
+    switch (p->js[p->pos]) {
+        case '{':
+            return parse_container(p, depth, true);
+        case '[':
+            return parse_container(p, depth, false);
+        case '"':
+            return parse_string(p);
+        default:
+            return parse_primitive(p);
+    }
+}
+
+int json_tokenize(const char *js, const size_t len, json_token_t *tokens, const size_t max_tokens) {
+    if (!js || !tokens) return JSON_TOKENIZE_ERROR_INVALID;
+
+    json_parser_t parser = {.js = js, .len = len, .pos = 0, .tokens = tokens, .max_tokens = max_tokens, .count = 0};
+
+    const int root = parse_value(&parser, 0);
+    if (root < 0) return root;
+
+    skip_whitespace(&parser);
+    if (parser.pos != parser.len) return JSON_TOKENIZE_ERROR_INVALID;
+
+    return static_cast<int>(parser.count);
+}
+
+int json_object_get(const char *js, const json_token_t *tokens, const int object, const char *key) {
+    if (object < 0 || tokens[object].type != JSON_TOKEN_OBJECT || !key) return -1;
+
+    const size_t key_len = strlen(key);
+    int member = object + 1;
+    for (uint16_t i = 0; i < tokens[object].size; ++i) {
+        const json_token_t *name = &tokens[member];
+        if (name->end - name->start == key_len && memcmp(js + name->start, key, key_len) == 0) {
+            return member + 1;
+        }
+        member = tokens[member + 1].next;
+    }
+
+    return -1;
+}
+
+/**
+ * Parses four hexadecimal digits. The tokenizer has already validated them.
+ */
+static uint32_t parse_hex4(const char *s) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        const char c = s[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= c - '0';
+        else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+        else value |= c - 'A' + 10;
+    }
+    return value;
+}
+
+/**
+ * Writes a code point as UTF-8.
+ *
+ * @return Number of bytes written.
+ */
+static size_t encode_utf8(const uint32_t cp, char *out) {
+    if (cp < 0x80) {
+        out[0] = static_cast<char>(cp);
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = static_cast<char>(0xC0 | (cp >> 6));
+        out[1] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = static_cast<char>(0xE0 | (cp >> 12));
+        out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = static_cast<char>(0xF0 | (cp >> 18));
+    out[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = static_cast<char>(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+char *json_string_decode(char *js, const json_token_t *token) {
+    const char *in = js + token->start;
+    const char *end = js + token->end;
+    char *out = js + token->start;
+
+    // Every escape sequence is at least as long as its decoded form, so writing never overtakes reading.
+    while (in < end) {
+        if (*in != '\\') {
+            *out++ = *in++;
+            continue;
+        }
+
+        in++;
+        switch (*in++) {
+            case 'b': *out++ = '\b'; break;
+            case 'f': *out++ = '\f'; break;
+            case 'n': *out++ = '\n'; break;
+            case 'r': *out++ = '\r'; break;
+            case 't': *out++ = '\t'; break;
+            case 'u': {
+                uint32_t cp = parse_hex4(in);
+                in += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF && end - in >= 6 && in[0] == '\\' && in[1] == 'u') {
+                    const uint32_t low = parse_hex4(in + 2);
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        in += 6;
+                    }
+                }
+                out += encode_utf8(cp, out);
+                break;
+            }
+            default:
+                // '"', '\\' and '/' decode to themselves
+                *out++ = in[-1];
+                break;
+        }
+    }
+
+    *out = '\0';
+    return js + token->start;
+}
+
+bool json_number_to_uint64(const char *js, const json_token_t *token, uint64_t *out) {
+    if (token->type != JSON_TOKEN_PRIMITIVE) return false;
+
+    const char *s = js + token->start;
+    const size_t len = token->end - token->start;
+    if (len == 0 || !is_digit(s[0])) return false;
+
+    // Fast path: exact conversion of a plain digit sequence
+    uint64_t value = 0;
+    size_t i = 0;
+    for (; i < len && is_digit(s[i]); ++i) {
+        const uint64_t digit = s[i] - '0';
+        if (value > (UINT64_MAX - digit) / 10) return false;
+        value = value * 10 + digit;
+    }
+    if (i == len) {
+        *out = value;
+        return true;
+    }
+
+    // Fraction or exponent: accept only integral values
+    char buf[32];
+    if (len >= sizeof(buf)) return false;
+    memcpy(buf, s, len);
+    buf[len] = '\0';
+
+    const double number = strtod(buf, nullptr);
+    if (number >= 18446744073709551616.0 || number != std::floor(number)) return false;
+    *out = static_cast<uint64_t>(number);
+    return true;
+}
@@ -0,0 +1,257 @@
+#include "messages/json_writer.h"
+
+#include <cfloat>
+#include <cinttypes>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Capacity of the first heap buffer when a writer starts without one.
+static constexpr size_t WRITER_INITIAL_CAPACITY = 256;
+
+/**
+ * Makes room for `n` more bytes plus a terminator. Leaves the caller-provided buffer for the heap when it
+ * is too small and grows heap buffers geometrically.
+ *
+ * @return false if the writer has failed or the buffer could not be grown.
+ */
+static bool reserve(json_writer_t *writer, const size_t n) {
+    if (writer->failed) return false;
+    if (writer->len + n + 1 <= writer->cap) return true;
+
+    size_t cap = writer->cap ? writer->cap * 2 : WRITER_INITIAL_CAPACITY;
+    while (cap < writer->len + n + 1) cap *= 2;
+
+    char *buf;
+    if (writer->owned) {
+        buf = static_cast<char *>(realloc(writer->buf, cap));
+    } else {
+        buf = static_cast<char *>(malloc(cap));
+        if (buf && writer->len > 0) memcpy(buf, writer->buf, writer->len);
+    }
+    if (!buf) {
+        writer->failed = true;
+        return false;
+    }
+
+    writer->buf = buf;
+    writer->cap = cap;
+    writer->owned = true;
+    return true;
+}
+
+static void write_raw(json_writer_t *writer, const char *data, const size_t len) {
+    if (!reserve(writer, len)) return;
+    memcpy(writer->buf + writer->len, data, len);
+    writer->len += len;
+}
+
+static void write_char(json_writer_t *writer, const char c) {
+    if (!reserve(writer, 1)) return;
+    writer->buf[writer->len++] = c;
+}
+
+/**
+ * Writes the separator required before the next value of the innermost container.
+ */
+static void begin_value(json_writer_t *writer) {
+    if (writer->after_key) {
+        writer->after_key = false;
+        return;
+    }
+    if (writer->depth == 0) return;
+
+    if (writer->has_items[writer->depth - 1]) write_char(writer, ',');
+    writer->has_items[writer->depth - 1] = true;
+}
+
+/**
+ * Writes a quoted string, escaping it exactly like cJSON's print_string_ptr.
+ */
+static void write_escaped(json_writer_t *writer, const char *value, const size_t len) {
+    write_char(writer, '"');
+
+    const auto *p = reinterpret_cast<const unsigned char *>(value);
+    const unsigned char *end = p + len;
+    const unsigned char *run = p;
+    for (; p < end; ++p) {
+        if (*p > 31 && *p != '"' && *p != '\\') continue;
+
+        write_raw(writer, reinterpret_cast<const char *>(run), p - run);
+        run = p + 1;
+
+        char escape[7];
+        switch (*p) {
+            case '"': write_raw(writer, "\\\"", 2); break;
+            case '\\': write_raw(writer, "\\\\", 2); break;
+            case '\b': write_raw(writer, "\\b", 2); break;
+            case '\f': write_raw(writer, "\\f", 2); break;
+            case '\n': write_raw(writer, "\\n", 2); break;
+            case '\r': write_raw(writer, "\\r", 2); break;
+            case '\t': write_raw(writer, "\\t", 2); break;
+            default:
+                snprintf(escape, sizeof(escape), "\\u%04x", *p);
+                write_raw(writer, escape, 6);
+                break;
+        }
+    }
+    write_raw(writer, reinterpret_cast<const char *>(run), p - run);
+
+    write_char(writer, '"');
+}
+
+static void begin_container(json_writer_t *writer, const char open) {
+    begin_value(writer);
+    if (writer->depth >= JSON_WRITER_MAX_DEPTH) {
+        writer->failed = true;
+        return;
+    }
+    writer->has_items[writer->depth++] = false;
+    write_char(writer, open);
+}
+
+static void end_container(json_writer_t *writer, const char close) {
+    if (writer->depth == 0 || writer->after_key) {
+        writer->failed = true;
+        return;
+    }
+    writer->depth--;
+    write_char(writer, close);
+}
+
+void json_writer_init(json_writer_t *writer, char *buf, const size_t cap) {
+    *writer = {};
+    writer->buf = buf;
+    writer->cap = buf ? cap : 0;
+}
+
+void json_writer_release(json_writer_t *writer) {
+    if (writer->owned) free(writer->buf);
+    *writer = {};
+}
+
+const char *json_writer_finish(json_writer_t *writer) {
+    if (writer->failed || writer->depth != 0 || writer->after_key || !reserve(writer, 0)) return nullptr;
+    writer->buf[writer->len] = '\0';
+    return writer->buf;
+}
+
+void json_begin_object(json_writer_t *writer) {
+    begin_container(writer, '{');
+}
+
+void json_end_object(json_writer_t *writer) {
+    end_container(writer, '}');
+}
+
+void json_begin_array(json_writer_t *writer) {
+    begin_container(writer, '[');
+}
+
+void json_end_array(json_writer_t *writer) {
+    end_container(writer, ']');
+}
+
+void json_write_key(json_writer_t *writer, const char *key) {
+    if (writer->after_key || writer->depth == 0) {
+        writer->failed = true;
+        return;
+    }
+    begin_value(writer);
+    write_escaped(writer, key, strlen(key));
+    write_char(writer, ':');
+    writer->after_key = true;
+}
+
+void json_write_string(json_writer_t *writer, const char *value) {
+    begin_value(writer);
+    write_escaped(writer, value, strlen(value));
+}
+
+void json_write_text(json_writer_t *writer, const char *text, const size_t len) {
+    begin_value(writer);
+    write_escaped(writer, text, len);
+}
+
+void json_write_hex_string(json_writer_t *writer, const uint8_t *data, const size_t len) {
+    static constexpr char HEX_DIGITS[] = "0123456789ABCDEF";
+
+    begin_value(writer);
+    if (!reserve(writer, 2 * len + 2)) return;
+
+    char *out = writer->buf + writer->len;
+    *out++ = '"';
+    for (size_t i = 0; i < len; ++i) {
+        *out++ = HEX_DIGITS[data[i] >> 4];
+        *out++ = HEX_DIGITS[data[i] & 0x0f];
+    }
+    *out++ = '"';
+    writer->len = out - writer->buf;
+}
+
+void json_write_encoded(json_writer_t *writer, const char *json, const size_t len) {
+    begin_value(writer);
+    write_raw(writer, json, len);
+}
+
+void json_write_number(json_writer_t *writer, const double value) {
+    begin_value(writer);
+
+    // cJSON_CreateNumber saturates valueint; print_number uses "%d" whenever it round-trips
+    int as_int;
+    if (value >= INT_MAX) {
+        as_int = INT_MAX;
+    } else if (value <= static_cast<double>(INT_MIN)) {
+        as_int = INT_MIN;
+    } else {
+        as_int = static_cast<int>(value);
+    }
+
+    char number[26];
+    int length;
+    if (std::isnan(value) || std::isinf(value)) {
+        length = snprintf(number, sizeof(number), "null");
+    } else if (value == static_cast<double>(as_int)) {
+        length = snprintf(number, sizeof(number), "%d", as_int);
+    } else {
+        length = snprintf(number, sizeof(number), "%1.15g", value);
+        // Fall back to 17 digits when 15 do not read back as the same double
+        const double test = strtod(number, nullptr);
+        const double max = std::fmax(std::fabs(test), std::fabs(value));
+        if (!(std::fabs(test - value) <= max * DBL_EPSILON)) {
+            length = snprintf(number, sizeof(number), "%1.17g", value);
+        }
+    }
+
+    write_raw(writer, number, length);
+}
+
+void json_write_uint(json_writer_t *writer, const uint64_t value) {
+    begin_value(writer);
+    char number[21];
+    const int length = snprintf(number, sizeof(number), "%" PRIu64, value);
+    write_raw(writer, number, length);
+}
+
+void json_write_int(json_writer_t *writer, const int64_t value) {
+    begin_value(writer);
+    char number[21];
+    const int length = snprintf(number, sizeof(number), "%" PRId64, value);
+    write_raw(writer, number, length);
+}
+
+void json_write_bool(json_writer_t *writer, const bool value) {
+    begin_value(writer);
+    if (value) {
+        write_raw(writer, "true", 4);
+    } else {
+        write_raw(writer, "false", 5);
+    }
+}
+
+void json_write_null(json_writer_t *writer) {
+    begin_value(writer);
+    write_raw(writer, "null", 4);
+}
@@ -0,0 +1,276 @@
+#include "messages/message_encoder.h"
+#include "sdkconfig.h"
+
+#include <freertos/FreeRTOS.h>
+#include <cstring>
+
+static constexpr size_t POOL_SIZE = CONFIG_OUTBOUND_MESSAGE_POOL_SIZE;
+static constexpr size_t BUFFER_SIZE = CONFIG_OUTBOUND_MESSAGE_BUFFER_SIZE;
+static_assert(POOL_SIZE <= 32, "pool_in_use holds one bit per buffer");
+
+// Buffers outbound messages are encoded into. Kept in internal RAM: every message is written once and
+// read back when it is copied for sending.
+static uint8_t pool_buffers[POOL_SIZE][BUFFER_SIZE];
+
+// Bit i is set while pool_buffers[i] is in use. Messages are encoded on several tasks.
+static uint32_t pool_in_use = 0;
+static portMUX_TYPE pool_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Takes a buffer from the pool.
+ *
+ * @return Index of the buffer, or -1 if all buffers are in use.
+ */
+static int acquire_pool_buffer() {
+    int slot = -1;
+    portENTER_CRITICAL(&pool_lock);
+    for (size_t i = 0; i < POOL_SIZE; ++i) {
+        if (!(pool_in_use & (1u << i))) {
+            pool_in_use |= 1u << i;
+            slot = static_cast<int>(i);
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&pool_lock);
+    return slot;
+}
+
+static void release_pool_buffer(const int slot) {
+    if (slot < 0) return;
+    portENTER_CRITICAL(&pool_lock);
+    pool_in_use &= ~(1u << slot);
+    portEXIT_CRITICAL(&pool_lock);
+}
+
+/**
+ * Writes the key of the next value if the innermost open container is an object, and counts the value
+ * for CBOR.
+ */
+static void add_key(message_encoder_t *enc, const char *key) {
+    const size_t top = enc->depth - 1;
+    if (enc->is_object[top] && !key) {
+        enc->failed = true;
+        return;
+    }
+
+    if (enc->protocol == WS_PROTOCOL_CBOR) {
+        if (enc->is_object[top]) cbor_write_text(&enc->cbor, key, strlen(key));
+        enc->cbor_counts[top]++;
+    } else if (enc->is_object[top]) {
+        json_write_key(&enc->json, key);
+    }
+}
+
+/**
+ * Checks that a value can be added to the encoder and writes its key.
+ */
+static bool begin_value(message_encoder_t *enc, const char *key) {
+    if (enc->failed || enc->depth == 0) return false;
+    add_key(enc, key);
+    return !enc->failed;
+}
+
+/**
+ * Opens a container of either kind, including the root.
+ */
+static void begin_container(message_encoder_t *enc, const bool is_object) {
+    if (enc->depth >= MESSAGE_ENCODER_MAX_DEPTH) {
+        enc->failed = true;
+        return;
+    }
+
+    if (enc->protocol == WS_PROTOCOL_CBOR) {
+        enc->cbor_offsets[enc->depth] = cbor_begin_container(&enc->cbor, is_object ? CBOR_MAJOR_MAP
+                                                                                    : CBOR_MAJOR_ARRAY);
+        enc->cbor_counts[enc->depth] = 0;
+    } else if (is_object) {
+        json_begin_object(&enc->json);
+    } else {
+        json_begin_array(&enc->json);
+    }
+    enc->is_object[enc->depth++] = is_object;
+}
+
+/**
+ * Closes the innermost container, including the root.
+ */
+static void end_container(message_encoder_t *enc) {
+    const size_t top = --enc->depth;
+    if (enc->protocol == WS_PROTOCOL_CBOR) {
+        cbor_end_container(&enc->cbor, enc->cbor_offsets[top], enc->is_object[top] ? CBOR_MAJOR_MAP
+                                                                                    : CBOR_MAJOR_ARRAY,
+                           enc->cbor_counts[top]);
+    } else if (enc->is_object[top]) {
+        json_end_object(&enc->json);
+    } else {
+        json_end_array(&enc->json);
+    }
+}
+
+void message_encoder_init(message_encoder_t *enc, const ws_protocol_t protocol) {
+    *enc = {};
+    enc->protocol = protocol;
+    enc->pool_slot = acquire_pool_buffer();
+
+    uint8_t *buf = enc->pool_slot >= 0 ? pool_buffers[enc->pool_slot] : nullptr;
+    if (protocol == WS_PROTOCOL_CBOR) {
+        cbor_writer_init(&enc->cbor, buf, BUFFER_SIZE);
+    } else {
+        json_writer_init(&enc->json, reinterpret_cast<char *>(buf), BUFFER_SIZE);
+    }
+
+    begin_container(enc, true);
+}
+
+void message_encoder_release(message_encoder_t *enc) {
+    if (enc->protocol == WS_PROTOCOL_CBOR) {
+        cbor_writer_release(&enc->cbor);
+    } else {
+        json_writer_release(&enc->json);
+    }
+    release_pool_buffer(enc->pool_slot);
+    enc->pool_slot = -1;
+}
+
+esp_err_t message_encoder_finish(message_encoder_t *enc, const uint8_t **data, size_t *len) {
+    if (enc->failed) return ESP_ERR_NO_MEM;
+    if (enc->depth != 1) return ESP_ERR_INVALID_STATE;
+
+    end_container(enc);
+
+    if (enc->protocol == WS_PROTOCOL_CBOR) {
+        if (enc->cbor.failed) return ESP_ERR_NO_MEM;
+        *data = enc->cbor.buf;
+        *len = enc->cbor.len;
+        return ESP_OK;
+    }
+
+    const char *json_str = json_writer_finish(&enc->json);
+    if (!json_str) return ESP_ERR_NO_MEM;
+    *data = reinterpret_cast<const uint8_t *>(json_str);
+    *len = enc->json.len;
+    return ESP_OK;
+}
+
+void message_begin_object(message_encoder_t *enc, const char *key) {
+    if (begin_value(enc, key)) begin_container(enc, true);
+}
+
+void message_begin_array(message_encoder_t *enc, const char *key) {
+    if (begin_value(enc, key)) begin_container(enc, false);
+}
+
+void message_end(message_encoder_t *enc) {
+    if (enc->failed) return;
+    if (enc->depth <= 1) {
+        enc->failed = true;
+        return;
+    }
+    end_container(enc);
+}
+
+void message_add_string(message_encoder_t *enc, const char *key, const char *value) {
+    if (!value) {
+        enc->failed = true;
+        return;
+    }
+    if (!begin_value(enc, key)) return;
+
+    if (enc->protocol == WS_PROTOCOL_CBOR) {
+        cbor_write_text(&enc->cbor, value, strlen(value));
+    } else {
+        json_write_string(&enc->json, value);
+    }
+}
+
+void message_add_text(message_encoder_t *enc, const char *key, const char *text, const size_t len) {
+    if (!text && len > 0) {
+        enc->failed = true;
+        return;
+    }
+    if (!begin_value(enc, key)) return;
+
+    if (enc->protocol == WS_PROTOCOL_CBOR) {
+        cbor_write_text(&enc->cbor, text, len);
+    } else {
+        json_write_text(&enc->json, text, len);
+    }
+}
+
+void message_add_bool(message_encoder_t *enc, const char *key, const bool value) {
+    if (!begin_value(enc, key)) return;
+
+    if (enc->protocol == WS_PROTOCOL_CBOR) {
+        cbor_write_bool(&enc->cbor, value);
+    } else {
+        json_write_bool(&enc->json, value);
+    }
+}
+
+void message_add_uint(message_encoder_t *enc, const char *key, const uint64_t value) {
+    if (!begin_value(enc, key)) return;
+
+    if (enc->protocol == WS_PROTOCOL_CBOR) {
+        cbor_write_uint(&enc->cbor, value);
+    } else {
+        json_write_uint(&enc->json, value);
+    }
+}
+
+void message_add_int(message_encoder_t *enc, const char *key, const int64_t value) {
+    if (!begin_value(enc, key)) return;
+
+    if (enc->protocol == WS_PROTOCOL_CBOR) {
+        cbor_write_int(&enc->cbor, value);
+    } else {
+        json_write_int(&enc->json, value);
+    }
+}
+
+void message_add_double(message_encoder_t *enc, const char *key, const double value) {
+    if (!begin_value(enc, key)) return;
+
+    if (enc->protocol == WS_PROTOCOL_CBOR) {
+        cbor_write_double(&enc->cbor, value);
+    } else {
+        json_write_number(&enc->json, value);
+    }
+}
+
+void message_add_null(message_encoder_t *enc, const char *key) {
+    if (!begin_value(enc, key)) return;
+
+    if (enc->protocol == WS_PROTOCOL_CBOR) {
+        cbor_write_null(&enc->cbor);
+    } else {
+        json_write_null(&enc->json);
+    }
+}
+
+void message_add_bytes(message_encoder_t *enc, const char *key, const uint8_t *data, const size_t len) {
+    if (!data && len > 0) {
+        enc->failed = true;
+        return;
+    }
+    if (!begin_value(enc, key)) return;
+
+    if (enc->protocol == WS_PROTOCOL_CBOR) {
+        cbor_write_bytes(&enc->cbor, data, len);
+    } else {
+        json_write_hex_string(&enc->json, data, len);
+    }
+}
+
+void message_add_encoded(message_encoder_t *enc, const char *key, const uint8_t *data, const size_t len) {
+    if (!data || len == 0) {
+        enc->failed = true;
+        return;
+    }
+    if (!begin_value(enc, key)) return;
+
+    if (enc->protocol == WS_PROTOCOL_CBOR) {
+        cbor_write_encoded(&enc->cbor, data, len);
+    } else {
+        json_write_encoded(&enc->json, reinterpret_cast<const char *>(data), len);
+    }
+}
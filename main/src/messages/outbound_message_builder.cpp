@@ -1,201 +1,375 @@
 #include "messages/outbound_message_builder.h"
+#include "messages/message_encoder.h"
+#include "messages/state_store.h"
+#include "messages/tlv_encoder.h"
 #include "websocket_server.h"
 
 #include <esp_log.h>
 #include <esp_err.h>
-#include <cJSON.h>
+#include <freertos/FreeRTOS.h>
+#include <cinttypes>
 #include <cstdio>
 #include <cstring>
+#include <initializer_list>
 
-static const char *TAG = "JSON_OUTBOUND";
+static const char *TAG = "OUTBOUND_MESSAGE";
 
-/**
- * Builds a JSON message string with the given type, action, and payload.
- *
- * @param type The type of the message. This must not be null.
- * @param action Optional action field for the message. This is only included if the type is "info".
- * @param payload The cJSON object representing the payload of the message. This must not be null.
- * @return A pointer to the generated JSON string if successful, or nullptr on failure.
- *         The caller is responsible for freeing the memory allocated for the returned string.
- */
-static char *build_json_message(const char *type, const char *action, cJSON *payload) {
-    if (!type || !payload) return nullptr;
+// Maximum length of a broadcast topic, including the terminator.
+static constexpr size_t MAX_TOPIC_LEN = 128;
 
-    cJSON *root = cJSON_CreateObject();
-    if (!root) return nullptr;
+// Sequence number of the last broadcast event. Events are broadcast from several tasks.
+static uint64_t event_seq = 0;
+static portMUX_TYPE event_seq_lock = portMUX_INITIALIZER_UNLOCKED;
 
-    cJSON_AddStringToObject(root, "type", type);
+static uint64_t next_event_seq() {
+    portENTER_CRITICAL(&event_seq_lock);
+    const uint64_t seq = ++event_seq;
+    portEXIT_CRITICAL(&event_seq_lock);
+    return seq;
+}
 
-    if (strcmp(type, "info") == 0 && action) {
-        cJSON_AddStringToObject(root, "action", action);
-    }
+static uint64_t last_event_seq() {
+    portENTER_CRITICAL(&event_seq_lock);
+    const uint64_t seq = event_seq;
+    portEXIT_CRITICAL(&event_seq_lock);
+    return seq;
+}
 
-    cJSON_AddItemToObject(root, "payload", payload);
+/**
+ * Adds the fields of a message payload to an encoder.
+ *
+ * @param enc The encoder, positioned inside the "payload" object.
+ * @param ctx The values to encode, as passed to the sending function.
+ */
+typedef void (*payload_builder_t)(message_encoder_t *enc, const void *ctx);
 
-    char *json_str = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
+/**
+ * Encodes a message of type "info" with the given action and payload.
+ *
+ * @param protocol The protocol to encode the message for.
+ * @param action The action of the message.
+ * @param seq Sequence number carried by the message, or 0 for none.
+ * @param build Function adding the payload fields.
+ * @param ctx Passed to `build`.
+ * @param enc An encoder, to be released by the caller whether or not encoding succeeds.
+ * @param[out] data The encoded message, owned by `enc`.
+ * @param[out] len Length of the encoded message in bytes.
+ * @return ESP_OK on success, or an error code if encoding failed.
+ */
+static esp_err_t encode_info_message(const ws_protocol_t protocol, const char *action, const uint64_t seq,
+                                     const payload_builder_t build, const void *ctx, message_encoder_t *enc,
+                                     const uint8_t **data, size_t *len) {
+    message_encoder_init(enc, protocol);
+
+    message_add_string(enc, "type", "info");
+    message_add_string(enc, "action", action);
+    if (seq != 0) {
+        message_add_uint(enc, "seq", seq);
+    }
+    message_begin_object(enc, "payload");
+    build(enc, ctx);
+    message_end(enc);
 
-    return json_str; // Caller is responsible for freeing this memory.
+    return message_encoder_finish(enc, data, len);
 }
 
 /**
- * @brief Broadcasts a JSON-formatted message based on the given type, action, and payload.
+ * @brief Broadcasts a message of type "info" with the given action and payload.
  *
- * This function constructs a JSON message using the provided parameters and broadcasts it
- * via a WebSocket connection. The caller is responsible for ensuring that the input
- * parameters meet the requirements of the function.
+ * The message carries the next event sequence number. It is encoded once for every protocol that has
+ * clients subscribed to its topic or keeps events for replay, and handed to the server; other protocols are
+ * skipped without encoding anything.
  *
- * @param type The type of the message. This parameter is mandatory and cannot be null.
- * @param action The action of the message. This parameter is optional and can be null.
- * @param payload The JSON payload to attach to the message. This parameter is mandatory and cannot be null.
+ * @param topic The topic of the message.
+ * @param policy What to do for recipients that cannot keep up.
+ * @param action The action of the message. This parameter is mandatory and cannot be null.
+ * @param build Function adding the payload fields.
+ * @param ctx Passed to `build`.
  * @return
  * - ESP_OK: The message was successfully broadcasted.
- * - ESP_FAIL: JSON message generation failed or broadcasting via WebSocket failed.
- * - Other values: Any specific error codes returned by the `websocket_broadcast_message` function.
+ * - ESP_ERR_NO_MEM: Message generation failed.
+ * - Other values: Any specific error codes returned by the `websocket_broadcast` function.
  */
-static esp_err_t broadcast_message(const char *type, const char *action, cJSON *payload) {
-    char *json_str = build_json_message(type, action, payload);
-    if (!json_str) {
-        ESP_LOGE(TAG, "Failed to generate JSON message");
-        return ESP_FAIL;
-    }
+static esp_err_t broadcast_topic_message(const char *topic, const ws_overflow_policy_t policy, const char *action,
+                                         const payload_builder_t build, const void *ctx) {
+    esp_err_t ret = ESP_OK;
+    const uint64_t seq = next_event_seq();
+
+    for (const ws_protocol_t protocol: {WS_PROTOCOL_JSON, WS_PROTOCOL_CBOR}) {
+        if (websocket_get_subscriber_count(protocol, topic) == 0 && !websocket_replay_enabled(protocol)) continue;
+
+        message_encoder_t enc;
+        const uint8_t *data;
+        size_t len;
+        esp_err_t err = encode_info_message(protocol, action, seq, build, ctx, &enc, &data, &len);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to generate %s message: %s", action, esp_err_to_name(err));
+            message_encoder_release(&enc);
+            ret = err;
+            continue;
+        }
 
-    esp_err_t err = websocket_broadcast_message(json_str);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to broadcast message: %s", esp_err_to_name(err));
+        err = websocket_broadcast(protocol, topic, seq, policy, data, len);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to broadcast message: %s", esp_err_to_name(err));
+            ret = err;
+        }
+        message_encoder_release(&enc);
     }
 
-    free(json_str);
-    return err;
+    return ret;
 }
 
 /**
- * Sends a JSON-encoded message to a specified client over a websocket connection.
- *
- * This method constructs a JSON message with the specified type, action, and payload
- * and sends it to the client identified by the given file descriptor.
- * The constructed JSON string is freed after sending the message.
+ * Broadcasts a status message of type "info" under the topic named by its action. Only the latest status
+ * matters, so a newer message replaces one still queued for a slow client.
+ */
+static esp_err_t broadcast_message(const char *action, const payload_builder_t build, const void *ctx) {
+    return broadcast_topic_message(action, WS_OVERFLOW_COALESCE, action, build, ctx);
+}
+
+// ---- RESPONSES
+
+/**
+ * Adds the fields of a command result to the payload of a response.
+ */
+static void add_command_result(message_encoder_t *enc, const void *ctx) {
+    const auto *result = static_cast<const command_result_t *>(ctx);
+    if (!result) return;
+
+    for (size_t i = 0; i < result->field_count; ++i) {
+        const command_result_field_t *field = &result->fields[i];
+
+        switch (field->type) {
+            case COMMAND_RESULT_BOOL:
+                message_add_bool(enc, field->key, field->boolean);
+                break;
+            case COMMAND_RESULT_UINT:
+                message_add_uint(enc, field->key, field->number);
+                break;
+            case COMMAND_RESULT_STRING:
+                message_add_string(enc, field->key, field->str);
+                break;
+            case COMMAND_RESULT_STRING_ARRAY: {
+                message_begin_array(enc, field->key);
+                const char *str = field->str;
+                for (size_t k = 0; k < field->count; ++k) {
+                    message_add_string(enc, nullptr, str);
+                    str += strlen(str) + 1;
+                }
+                message_end(enc);
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * Builds a response message and queues it for the originating client, encoded in the protocol the client
+ * negotiated.
  *
- * @param type A string representing the type of the message. Must not be null.
- * @param action A string representing the action of the message. Can be null depending on type.
- * @param payload A cJSON pointer to the payload of the message. Must not be null.
- * @param client_fd The file descriptor of the target client to send the message to.
- * @return
- *     - ESP_OK on successful sending of the message.
- *     - ESP_FAIL if the JSON message could not be generated or sending the message failed.
+ * @param fd The file descriptor of the originating client.
+ * @param request_id The request ID to echo. May be null.
+ * @param action The action of the command. May be null.
+ * @param status The outcome of the command.
+ * @param build Function adding the payload fields.
+ * @param ctx Passed to `build`.
+ * @return ESP_OK if the message was queued for sending, or an error code otherwise.
  */
-static esp_err_t send_message_to_client(const char *type, const char *action, cJSON *payload, int client_fd) {
-    char *json_str = build_json_message(type, action, payload);
-    if (!json_str) {
-        ESP_LOGE(TAG, "Failed to generate JSON message");
-        return ESP_FAIL;
+static esp_err_t send_response_message(const int fd, const command_request_id_t *request_id, const char *action,
+                                       const esp_err_t status, const payload_builder_t build, const void *ctx) {
+    const ws_protocol_t protocol = websocket_get_client_protocol(fd);
+    message_encoder_t enc;
+    message_encoder_init(&enc, protocol);
+
+    message_add_string(&enc, "type", "response");
+    if (request_id && request_id->present) {
+        if (request_id->is_string) {
+            message_add_string(&enc, "request_id", request_id->string);
+        } else {
+            message_add_uint(&enc, "request_id", request_id->number);
+        }
+    }
+    if (action) {
+        message_add_string(&enc, "action", action);
+    }
+    message_add_string(&enc, "status", status == ESP_OK ? "ok" : "error");
+    if (status != ESP_OK) {
+        message_add_string(&enc, "error", esp_err_to_name(status));
     }
+    message_begin_object(&enc, "payload");
+    build(&enc, ctx);
+    message_end(&enc);
 
-    esp_err_t err = websocket_send_message_to_client(client_fd, json_str);
+    const uint8_t *data;
+    size_t len;
+    esp_err_t err = message_encoder_finish(&enc, &data, &len);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to send message: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Failed to generate response message: %s", esp_err_to_name(err));
+        message_encoder_release(&enc);
+        return err;
     }
-    ESP_LOGI(TAG, "Sending message: %s", json_str);
 
-    free(json_str);
+    err = websocket_send_to_client(fd, protocol, data, len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send response to fd=%d: %s", fd, esp_err_to_name(err));
+    }
+
+    message_encoder_release(&enc);
     return err;
 }
 
+esp_err_t send_command_response_message(const int fd, const command_request_id_t *request_id, const char *action,
+                                        const esp_err_t status, const command_result_t *result) {
+    return send_response_message(fd, request_id, action, status, add_command_result,
+                                 status == ESP_OK ? result : nullptr);
+}
+
+// Per-command outcomes of a batch, passed to the payload builder.
+struct batch_results_t {
+    const char *const *actions;
+    const esp_err_t *results;
+    size_t count;
+};
+
+esp_err_t send_batch_response_message(const int fd, const command_request_id_t *request_id,
+                                      const char *const *actions, const esp_err_t *results, const size_t count) {
+    if ((!actions || !results) && count > 0) return ESP_ERR_INVALID_ARG;
+
+    const batch_results_t batch = {.actions = actions, .results = results, .count = count};
+    return send_response_message(fd, request_id, "batch", ESP_OK, [](message_encoder_t *enc, const void *ctx) {
+        const auto *b = static_cast<const batch_results_t *>(ctx);
+        message_begin_array(enc, "results");
+        for (size_t i = 0; i < b->count; ++i) {
+            message_begin_object(enc, nullptr);
+            if (b->actions[i]) {
+                message_add_string(enc, "action", b->actions[i]);
+            }
+            message_add_string(enc, "status", b->results[i] == ESP_OK ? "ok" : "error");
+            if (b->results[i] != ESP_OK) {
+                message_add_string(enc, "error", esp_err_to_name(b->results[i]));
+            }
+            message_end(enc);
+        }
+        message_end(enc);
+    }, &batch);
+}
+
 // ---- THREAD
 
-esp_err_t broadcast_info_thread_stack_status_message(const bool is_running) {
-    cJSON *payload = cJSON_CreateObject();
-    if (!payload) return ESP_FAIL;
+// Action of the event reporting a value and the payload key the value is sent under.
+struct event_field_t {
+    const char *action;
+    const char *key;
+};
+
+// Events reporting the boolean statuses, indexed by state_flag_t.
+static constexpr event_field_t FLAG_MESSAGES[STATE_FLAG_COUNT] = {
+    {"thread.stack_status", "running"},
+    {"thread.interface_status", "interface_up"},
+    {"thread.attachment_status", "attached"},
+    {"thread.meshcop_service", "published"},
+};
+
+// A boolean status, passed to the payload builder.
+struct flag_value_t {
+    state_flag_t flag;
+    bool value;
+};
+
+static void add_flag(message_encoder_t *enc, const void *ctx) {
+    const auto *f = static_cast<const flag_value_t *>(ctx);
+    message_add_bool(enc, FLAG_MESSAGES[f->flag].key, f->value);
+}
 
-    cJSON_AddBoolToObject(payload, "running", is_running);
-    return broadcast_message("info", "thread.stack_status", payload);
+static esp_err_t broadcast_flag_message(const state_flag_t flag, const bool value) {
+    const flag_value_t f = {.flag = flag, .value = value};
+    return broadcast_message(FLAG_MESSAGES[flag].action, add_flag, &f);
 }
 
-esp_err_t broadcast_info_thread_interface_status_message(const bool is_up) {
-    cJSON *payload = cJSON_CreateObject();
-    if (!payload) return ESP_FAIL;
+esp_err_t broadcast_info_thread_stack_status_message(const bool is_running) {
+    return broadcast_flag_message(STATE_THREAD_STACK_RUNNING, is_running);
+}
 
-    cJSON_AddBoolToObject(payload, "interface_up", is_up);
-    return broadcast_message("info", "thread.interface_status", payload);
+esp_err_t broadcast_info_thread_interface_status_message(const bool is_up) {
+    return broadcast_flag_message(STATE_THREAD_INTERFACE_UP, is_up);
 }
 
 esp_err_t broadcast_info_thread_attachment_status_message(const bool is_attached) {
-    cJSON *payload = cJSON_CreateObject();
-    if (!payload) return ESP_FAIL;
+    return broadcast_flag_message(STATE_THREAD_ATTACHED, is_attached);
+}
 
-    cJSON_AddBoolToObject(payload, "attached", is_attached);
-    return broadcast_message("info", "thread.attachment_status", payload);
+static void add_thread_role(message_encoder_t *enc, const void *ctx) {
+    message_add_string(enc, "role", static_cast<const char *>(ctx));
 }
 
 esp_err_t broadcast_info_thread_role_message(const char *role) {
     if (!role) return ESP_ERR_INVALID_ARG;
 
-    cJSON *payload = cJSON_CreateObject();
-    if (!payload) return ESP_FAIL;
-
-    cJSON_AddStringToObject(payload, "role", role);
-    return broadcast_message("info", "thread.role", payload);
+    return broadcast_message("thread.role", add_thread_role, role);
 }
 
-esp_err_t broadcast_info_unicast_addresses_message(const char **addresses, const size_t count) {
-    cJSON *payload = cJSON_CreateObject();
-    if (!payload) return ESP_FAIL;
+// Events reporting the address lists, indexed by state_address_list_t.
+static constexpr event_field_t ADDRESS_MESSAGES[STATE_ADDRESS_LIST_COUNT] = {
+    {"ipv6.unicast_addresses", "unicast"},
+    {"ipv6.multicast_addresses", "multicast"},
+};
 
-    cJSON *array = cJSON_CreateArray();
-    if (!array) {
-        cJSON_Delete(payload);
-        return ESP_FAIL;
-    }
+// A list of addresses and the payload key it is sent under.
+struct address_list_t {
+    const char *key;
+    const char *const *addresses;
+    size_t count;
+};
 
-    for (size_t i = 0; i < count; ++i) {
-        if (addresses[i]) {
-            cJSON_AddItemToArray(array, cJSON_CreateString(addresses[i]));
+/**
+ * Adds a list of addresses as a string array, skipping null entries.
+ */
+static void add_address_list(message_encoder_t *enc, const void *ctx) {
+    const auto *list = static_cast<const address_list_t *>(ctx);
+    message_begin_array(enc, list->key);
+    for (size_t i = 0; i < list->count; ++i) {
+        if (list->addresses[i]) {
+            message_add_string(enc, nullptr, list->addresses[i]);
         }
     }
+    message_end(enc);
+}
 
-    cJSON_AddItemToObject(payload, "unicast", array);
-    return broadcast_message("info", "ipv6.unicast_addresses", payload);
+esp_err_t broadcast_info_unicast_addresses_message(const char **addresses, const size_t count) {
+    const address_list_t list = {.key = ADDRESS_MESSAGES[STATE_UNICAST_ADDRESSES].key, .addresses = addresses,
+                                 .count = count};
+    return broadcast_message(ADDRESS_MESSAGES[STATE_UNICAST_ADDRESSES].action, add_address_list, &list);
 }
 
 esp_err_t broadcast_info_multicast_addresses_message(const char **addresses, size_t count) {
-    cJSON *payload = cJSON_CreateObject();
-    if (!payload) return ESP_FAIL;
-
-    cJSON *array = cJSON_CreateArray();
-    if (!array) {
-        cJSON_Delete(payload);
-        return ESP_FAIL;
-    }
-
-    for (size_t i = 0; i < count; ++i) {
-        if (addresses[i]) {
-            cJSON_AddItemToArray(array, cJSON_CreateString(addresses[i]));
-        }
-    }
-
-    cJSON_AddItemToObject(payload, "multicast", array);
-    return broadcast_message("info", "ipv6.multicast_addresses", payload);
+    const address_list_t list = {.key = ADDRESS_MESSAGES[STATE_MULTICAST_ADDRESSES].key, .addresses = addresses,
+                                 .count = count};
+    return broadcast_message(ADDRESS_MESSAGES[STATE_MULTICAST_ADDRESSES].action, add_address_list, &list);
 }
 
 esp_err_t broadcast_info_meshcop_service_status_message(bool is_published) {
-    cJSON *payload = cJSON_CreateObject();
-    if (!payload) return ESP_FAIL;
-
-    cJSON_AddBoolToObject(payload, "published", is_published);
-    return broadcast_message("info", "thread.meshcop_service", payload);
+    return broadcast_flag_message(STATE_MESHCOP_PUBLISHED, is_published);
 }
 
-static void binary_to_hex_string(const uint8_t *bin, const size_t bin_len, char *hex_str, const size_t hex_size) {
-    if (!bin || !hex_str || hex_size < (bin_len * 2 + 1)) {
-        ESP_LOGE(TAG, "Invalid arguments in binary_to_hex_string");
-        return;
-    }
-
-    for (size_t i = 0; i < bin_len; i++) {
-        snprintf(hex_str + (i * 2), 3, "%02X", bin[i]);
-    }
-
-    hex_str[bin_len * 2] = '\0';
+// Fields of an active operational dataset, passed to the payload builder.
+struct active_dataset_t {
+    uint64_t active_timestamp;
+    const char *network_name;
+    const uint8_t *extended_pan_id;
+    const uint8_t *mesh_local_prefix;
+    uint16_t pan_id;
+    uint16_t channel;
+};
+
+static void add_active_dataset(message_encoder_t *enc, const void *ctx) {
+    const auto *d = static_cast<const active_dataset_t *>(ctx);
+    message_add_uint(enc, "active_timestamp", d->active_timestamp);
+    message_add_string(enc, "network_name", d->network_name);
+    message_add_bytes(enc, "extended_pan_id", d->extended_pan_id, 8);
+    message_add_bytes(enc, "mesh_local_prefix", d->mesh_local_prefix, 8);
+    message_add_uint(enc, "pan_id", d->pan_id);
+    message_add_uint(enc, "channel", d->channel);
 }
 
 esp_err_t broadcast_info_active_dataset_message(
@@ -211,45 +385,114 @@ esp_err_t broadcast_info_active_dataset_message(
         return ESP_ERR_INVALID_ARG;
     }
 
-    cJSON *payload = cJSON_CreateObject();
-    if (!payload) return ESP_FAIL;
+    const active_dataset_t dataset = {
+        .active_timestamp = active_timestamp,
+        .network_name = network_name,
+        .extended_pan_id = extended_pan_id,
+        .mesh_local_prefix = mesh_local_prefix,
+        .pan_id = pan_id,
+        .channel = channel
+    };
+    return broadcast_message("thread.active_dataset", add_active_dataset, &dataset);
+}
 
-    char extended_pan_id_hex[17] = {};
-    char mesh_local_prefix_hex[33] = {};
+// ---- WI-FI
 
-    binary_to_hex_string(extended_pan_id, 8, extended_pan_id_hex, sizeof(extended_pan_id_hex));
-    binary_to_hex_string(mesh_local_prefix, 8, mesh_local_prefix_hex, sizeof(mesh_local_prefix_hex));
+static void add_wifi_status(message_encoder_t *enc, const void *ctx) {
+    message_add_string(enc, "status", static_cast<const char *>(ctx));
+}
 
-    cJSON_AddNumberToObject(payload, "active_timestamp", static_cast<double>(active_timestamp));
-    cJSON_AddStringToObject(payload, "network_name", network_name);
-    cJSON_AddStringToObject(payload, "extended_pan_id", extended_pan_id_hex);
-    cJSON_AddStringToObject(payload, "mesh_local_prefix", mesh_local_prefix_hex);
-    cJSON_AddNumberToObject(payload, "pan_id", pan_id);
-    cJSON_AddNumberToObject(payload, "channel", channel);
+esp_err_t broadcast_info_wifi_status_message(const char *status) {
+    if (!status) return ESP_ERR_INVALID_ARG;
 
-    return broadcast_message("info", "thread.active_dataset", payload);
+    return broadcast_message("wifi.sta_status", add_wifi_status, status);
 }
 
-// ---- WI-FI
+// ---- MATTER ----
 
-esp_err_t broadcast_info_wifi_status_message(const char *status) {
-    cJSON *payload = cJSON_CreateObject();
-    if (!payload) return ESP_FAIL;
+// Node of a commissioning or subscription event, passed to the payload builder.
+struct matter_node_event_t {
+    uint64_t node_id;
+    const char *key;
+    uint32_t value;
+};
 
-    cJSON_AddStringToObject(payload, "status", status);
-    return broadcast_message("info", "wifi.sta_status", payload);
+/**
+ * Adds the node ID and the event-specific integer of a Matter node event.
+ */
+static void add_matter_node_event(message_encoder_t *enc, const void *ctx) {
+    const auto *event = static_cast<const matter_node_event_t *>(ctx);
+    message_add_uint(enc, "node_id", event->node_id);
+    message_add_uint(enc, event->key, event->value);
 }
 
-// ---- MATTER ----
+/**
+ * Broadcasts an event about a Matter node under the node's topic. Events are not repeated, so a client
+ * that cannot take one is disconnected and resynchronizes when it reconnects.
+ */
+static esp_err_t broadcast_node_event(const char *action, const matter_node_event_t *event) {
+    char topic[MAX_TOPIC_LEN];
+    snprintf(topic, sizeof(topic), "%s/node/0x%" PRIx64, action, event->node_id);
+    return broadcast_topic_message(topic, WS_OVERFLOW_DISCONNECT, action, add_matter_node_event, event);
+}
 
 esp_err_t broadcast_info_matter_commissioning_complete_message(const uint64_t nodeId, const uint8_t fabricIndex) {
-    cJSON *payload = cJSON_CreateObject();
-    if (!payload) return ESP_FAIL;
+    const matter_node_event_t event = {.node_id = nodeId, .key = "fabric_index", .value = fabricIndex};
+    return broadcast_node_event("matter.commissioning_complete", &event);
+}
+
+/**
+ * Formats the topic of an attribute report: the report action followed by the attribute path.
+ */
+static void format_attribute_report_topic(char *topic, const uint64_t node_id, const uint16_t endpoint_id,
+                                          const uint32_t cluster_id, const uint32_t attribute_id) {
+    snprintf(topic, MAX_TOPIC_LEN,
+             "matter.attribute_report/node/0x%" PRIx64 "/endpoint/%u/cluster/0x%" PRIx32 "/attribute/0x%" PRIx32,
+             node_id, endpoint_id, cluster_id, attribute_id);
+}
+
+bool matter_attribute_report_wanted(const ws_protocol_t protocol, const uint64_t nodeId, const uint16_t endpointId,
+                                    const uint32_t clusterId, const uint32_t attributeId) {
+    if (websocket_replay_enabled(protocol)) return true;
 
-    cJSON_AddNumberToObject(payload, "node_id", nodeId);
-    cJSON_AddNumberToObject(payload, "fabric_index", fabricIndex);
+    char topic[MAX_TOPIC_LEN];
+    format_attribute_report_topic(topic, nodeId, endpointId, clusterId, attributeId);
+    return websocket_get_subscriber_count(protocol, topic) > 0;
+}
 
-    return broadcast_message("info", "matter.commissioning_complete", payload);
+// Fields of an attribute report, passed to the payload builder.
+struct attribute_report_t {
+    uint64_t node_id;
+    uint16_t endpoint_id;
+    uint32_t cluster_id;
+    uint32_t attribute_id;
+    // Reader positioned on the value, or null to decode `tlv`.
+    const chip::TLV::TLVReader *value;
+    const uint8_t *tlv;
+    size_t tlv_len;
+};
+
+static void add_attribute_report(message_encoder_t *enc, const void *ctx) {
+    const auto *r = static_cast<const attribute_report_t *>(ctx);
+    message_add_uint(enc, "node_id", r->node_id);
+    message_add_uint(enc, "endpoint_id", r->endpoint_id);
+    message_add_uint(enc, "cluster_id", r->cluster_id);
+    message_add_uint(enc, "attribute_id", r->attribute_id);
+
+    // CBOR clients receive the attribute's TLV element untouched if it was copied; JSON clients its decoded form
+    if (enc->protocol == WS_PROTOCOL_CBOR && r->tlv) {
+        message_add_bytes(enc, "value", r->tlv, r->tlv_len);
+    } else if (r->value) {
+        message_add_tlv(enc, "value", r->value);
+    } else {
+        chip::TLV::TLVReader reader;
+        reader.Init(r->tlv, r->tlv_len);
+        if (reader.Next() != CHIP_NO_ERROR) {
+            enc->failed = true;
+            return;
+        }
+        message_add_tlv(enc, "value", &reader);
+    }
 }
 
 esp_err_t broadcast_info_matter_attribute_report_message(
@@ -257,26 +500,196 @@ esp_err_t broadcast_info_matter_attribute_report_message(
     const uint16_t endpointId,
     const uint32_t clusterId,
     const uint32_t attributeId,
-    const char *value
+    const chip::TLV::TLVReader *value,
+    const uint8_t *tlv,
+    const size_t tlv_len
 ) {
-    cJSON *payload = cJSON_CreateObject();
-    if (!payload) return ESP_FAIL;
+    if (!value) return ESP_ERR_INVALID_ARG;
+
+    const attribute_report_t report = {
+        .node_id = nodeId,
+        .endpoint_id = endpointId,
+        .cluster_id = clusterId,
+        .attribute_id = attributeId,
+        .value = value,
+        .tlv = tlv,
+        .tlv_len = tlv_len
+    };
+    char topic[MAX_TOPIC_LEN];
+    format_attribute_report_topic(topic, nodeId, endpointId, clusterId, attributeId);
+    // Reports are telemetry: a slow client loses the oldest ones
+    return broadcast_topic_message(topic, WS_OVERFLOW_DROP_OLDEST, "matter.attribute_report", add_attribute_report,
+                                   &report);
+}
 
-    cJSON_AddNumberToObject(payload, "node_id", nodeId);
-    cJSON_AddNumberToObject(payload, "endpoint_id", endpointId);
-    cJSON_AddNumberToObject(payload, "cluster_id", clusterId);
-    cJSON_AddNumberToObject(payload, "attribute_id", attributeId);
-    cJSON_AddStringToObject(payload, "value", value);
+/**
+ * Builds the report of a stored attribute value.
+ */
+static attribute_report_t stored_attribute_report(const state_attribute_t &a) {
+    return {
+        .node_id = a.node_id,
+        .endpoint_id = a.endpoint_id,
+        .cluster_id = a.cluster_id,
+        .attribute_id = a.attribute_id,
+        .value = nullptr,
+        .tlv = a.tlv,
+        .tlv_len = a.tlv_len
+    };
+}
 
-    return broadcast_message("info", "matter.attribute_report", payload);
+esp_err_t send_matter_attribute_report_message(const int fd, const state_attribute_t *attribute) {
+    if (!attribute) return ESP_ERR_INVALID_ARG;
+
+    const ws_protocol_t protocol = websocket_get_client_protocol(fd);
+    const attribute_report_t report = stored_attribute_report(*attribute);
+    message_encoder_t enc;
+    const uint8_t *data;
+    size_t len;
+    esp_err_t err = encode_info_message(protocol, "matter.attribute_report", 0, add_attribute_report, &report, &enc,
+                                        &data, &len);
+    if (err == ESP_OK) {
+        err = websocket_send_to_client(fd, protocol, data, len);
+    }
+    message_encoder_release(&enc);
+    return err;
 }
 
 esp_err_t broadcast_info_matter_subscribe_done_message(const uint64_t nodeId, const uint32_t subscription_id) {
-    cJSON *payload = cJSON_CreateObject();
-    if (!payload) return ESP_FAIL;
+    const matter_node_event_t event = {.node_id = nodeId, .key = "subscription_id", .value = subscription_id};
+    return broadcast_node_event("matter.subscribe_done", &event);
+}
+
+// ---- STATE ----
 
-    cJSON_AddNumberToObject(payload, "node_id", nodeId);
-    cJSON_AddNumberToObject(payload, "subscription_id", subscription_id);
+/**
+ * Adds one section of the snapshot: the payload of the event reporting a value, under the event's action.
+ */
+static void add_snapshot_section(message_encoder_t *enc, const char *action, const payload_builder_t build,
+                                 const void *ctx) {
+    message_begin_object(enc, action);
+    build(enc, ctx);
+    message_end(enc);
+}
 
-    return broadcast_message("info", "matter.subscribe_done", payload);
+/**
+ * Adds every known value of the stored state to the payload of a snapshot.
+ */
+static void add_state_snapshot(message_encoder_t *enc, const void *ctx) {
+    const auto *state = static_cast<const orchestrator_state_t *>(ctx);
+
+    for (size_t i = 0; i < STATE_FLAG_COUNT; ++i) {
+        if (!state->flags_known[i]) continue;
+        const flag_value_t f = {.flag = static_cast<state_flag_t>(i), .value = state->flags[i]};
+        add_snapshot_section(enc, FLAG_MESSAGES[i].action, add_flag, &f);
+    }
+
+    if (state->thread_role[0] != '\0') {
+        add_snapshot_section(enc, "thread.role", add_thread_role, state->thread_role);
+    }
+
+    for (size_t i = 0; i < STATE_ADDRESS_LIST_COUNT; ++i) {
+        const state_addresses_t &stored = state->address_lists[i];
+        if (!stored.known) continue;
+
+        const char *addresses[STATE_STORE_MAX_ADDRESSES];
+        for (size_t k = 0; k < stored.count; ++k) {
+            addresses[k] = stored.addresses[k];
+        }
+        const address_list_t list = {.key = ADDRESS_MESSAGES[i].key, .addresses = addresses, .count = stored.count};
+        add_snapshot_section(enc, ADDRESS_MESSAGES[i].action, add_address_list, &list);
+    }
+
+    if (state->dataset.known) {
+        const state_dataset_t &d = state->dataset;
+        const active_dataset_t dataset = {
+            .active_timestamp = d.active_timestamp,
+            .network_name = d.network_name,
+            .extended_pan_id = d.extended_pan_id,
+            .mesh_local_prefix = d.mesh_local_prefix,
+            .pan_id = d.pan_id,
+            .channel = d.channel
+        };
+        add_snapshot_section(enc, "thread.active_dataset", add_active_dataset, &dataset);
+    }
+
+    if (state->wifi_status[0] != '\0') {
+        add_snapshot_section(enc, "wifi.sta_status", add_wifi_status, state->wifi_status);
+    }
+
+    // Attribute values are a list of report payloads
+    message_begin_array(enc, "matter.attribute_report");
+    for (size_t i = 0; i < state->attribute_count; ++i) {
+        const attribute_report_t report = stored_attribute_report(state->attributes[i]);
+        message_begin_object(enc, nullptr);
+        add_attribute_report(enc, &report);
+        message_end(enc);
+    }
+    message_end(enc);
+}
+
+void send_state_snapshot_message(const int fd, const ws_protocol_t protocol) {
+    message_encoder_t enc;
+    const uint8_t *data;
+    size_t len;
+
+    // The state is encoded under the store lock, so the snapshot is consistent. Its sequence number tells the
+    // client where to resume from
+    const orchestrator_state_t *state = state_store_acquire();
+    esp_err_t err = encode_info_message(protocol, "state.snapshot", last_event_seq(), add_state_snapshot, state,
+                                        &enc, &data, &len);
+    state_store_release();
+
+    if (err == ESP_OK) {
+        err = websocket_send_to_client(fd, protocol, data, len);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send state snapshot to fd=%d: %s", fd, esp_err_to_name(err));
+    }
+    message_encoder_release(&enc);
+}
+
+// A replay being encoded: the encoder, positioned inside the "events" array, and the number of events.
+struct replay_t {
+    message_encoder_t *enc;
+    size_t count;
+};
+
+esp_err_t send_replay_message(const int fd, const uint64_t after_seq, size_t *count) {
+    const ws_protocol_t protocol = websocket_get_client_protocol(fd);
+    message_encoder_t enc;
+    message_encoder_init(&enc, protocol);
+
+    message_add_string(&enc, "type", "info");
+    message_add_string(&enc, "action", "client.replay");
+    message_begin_object(&enc, "payload");
+    message_begin_array(&enc, "events");
+
+    // Recorded events are complete messages in the client's protocol and are embedded as they are
+    replay_t replay = {.enc = &enc, .count = 0};
+    esp_err_t err = websocket_replay_events(fd, after_seq, [](const uint8_t *data, const size_t len, void *ctx) {
+        auto *r = static_cast<replay_t *>(ctx);
+        message_add_encoded(r->enc, nullptr, data, len);
+        r->count++;
+    }, &replay);
+    if (err != ESP_OK) {
+        message_encoder_release(&enc);
+        return err;
+    }
+
+    message_end(&enc);
+    message_end(&enc);
+
+    const uint8_t *data;
+    size_t len;
+    err = message_encoder_finish(&enc, &data, &len);
+    if (err == ESP_OK) {
+        err = websocket_send_to_client(fd, protocol, data, len);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send replay to fd=%d: %s", fd, esp_err_to_name(err));
+    }
+    message_encoder_release(&enc);
+
+    if (count) *count = replay.count;
+    return err;
 }
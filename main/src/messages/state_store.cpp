@@ -0,0 +1,212 @@
+#include "messages/state_store.h"
+
+#include <esp_attr.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <cstring>
+
+// The state, written by the event handlers and read when a client connects.
+EXT_RAM_BSS_ATTR static orchestrator_state_t state;
+static SemaphoreHandle_t state_lock = nullptr;
+
+// Incremented on every attribute update and cache hit to order entries by use.
+static uint32_t attribute_clock = 0;
+
+// Guarded by state_lock.
+static state_cache_stats_t cache_stats = {};
+
+/**
+ * Copies a string into a fixed buffer, truncating it if needed.
+ */
+static void copy_string(char *dest, const size_t size, const char *src) {
+    strncpy(dest, src ? src : "", size - 1);
+    dest[size - 1] = '\0';
+}
+
+esp_err_t state_store_init() {
+    if (state_lock) return ESP_OK;
+
+    memset(&state, 0, sizeof(state));
+    state_lock = xSemaphoreCreateMutex();
+    return state_lock ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+void state_store_set_flag(const state_flag_t flag, const bool value) {
+    if (!state_lock || flag >= STATE_FLAG_COUNT) return;
+
+    xSemaphoreTake(state_lock, portMAX_DELAY);
+    state.flags_known[flag] = true;
+    state.flags[flag] = value;
+    xSemaphoreGive(state_lock);
+}
+
+void state_store_set_thread_role(const char *role) {
+    if (!state_lock || !role) return;
+
+    xSemaphoreTake(state_lock, portMAX_DELAY);
+    copy_string(state.thread_role, sizeof(state.thread_role), role);
+    xSemaphoreGive(state_lock);
+}
+
+void state_store_set_wifi_status(const char *status) {
+    if (!state_lock || !status) return;
+
+    xSemaphoreTake(state_lock, portMAX_DELAY);
+    copy_string(state.wifi_status, sizeof(state.wifi_status), status);
+    xSemaphoreGive(state_lock);
+}
+
+void state_store_set_addresses(const state_address_list_t list, const char *const *addresses, const size_t count) {
+    if (!state_lock || list >= STATE_ADDRESS_LIST_COUNT || (!addresses && count > 0)) return;
+
+    xSemaphoreTake(state_lock, portMAX_DELAY);
+    state_addresses_t &entry = state.address_lists[list];
+    entry.known = true;
+    entry.count = 0;
+    for (size_t i = 0; i < count && entry.count < STATE_STORE_MAX_ADDRESSES; ++i) {
+        if (addresses[i]) {
+            copy_string(entry.addresses[entry.count++], STATE_STORE_ADDRESS_SIZE, addresses[i]);
+        }
+    }
+    xSemaphoreGive(state_lock);
+}
+
+void state_store_set_active_dataset(const uint64_t active_timestamp, const char *network_name,
+                                    const uint8_t *extended_pan_id, const uint8_t *mesh_local_prefix,
+                                    const uint16_t pan_id, const uint16_t channel) {
+    if (!state_lock || !network_name || !extended_pan_id || !mesh_local_prefix) return;
+
+    xSemaphoreTake(state_lock, portMAX_DELAY);
+    state_dataset_t &dataset = state.dataset;
+    dataset.known = true;
+    dataset.active_timestamp = active_timestamp;
+    copy_string(dataset.network_name, sizeof(dataset.network_name), network_name);
+    memcpy(dataset.extended_pan_id, extended_pan_id, sizeof(dataset.extended_pan_id));
+    memcpy(dataset.mesh_local_prefix, mesh_local_prefix, sizeof(dataset.mesh_local_prefix));
+    dataset.pan_id = pan_id;
+    dataset.channel = channel;
+    xSemaphoreGive(state_lock);
+}
+
+/**
+ * Finds the stored entry of an attribute. Called with state_lock held.
+ *
+ * @param[out] oldest Set to the least recently used entry if there is no entry for the attribute. May be null.
+ */
+static state_attribute_t *lookup_attribute_entry(const uint64_t node_id, const uint16_t endpoint_id,
+                                                 const uint32_t cluster_id, const uint32_t attribute_id,
+                                                 state_attribute_t **oldest) {
+    for (size_t i = 0; i < state.attribute_count; ++i) {
+        state_attribute_t &entry = state.attributes[i];
+        if (entry.node_id == node_id && entry.endpoint_id == endpoint_id && entry.cluster_id == cluster_id &&
+            entry.attribute_id == attribute_id) {
+            return &entry;
+        }
+        // Ages are compared relative to the clock so that wrapping does not matter
+        if (oldest && (!*oldest || attribute_clock - entry.used > attribute_clock - (*oldest)->used)) {
+            *oldest = &entry;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Finds the entry of an attribute, claiming a free or the least recently used entry if it has none.
+ * Called with state_lock held.
+ */
+static state_attribute_t *find_attribute_entry(const uint64_t node_id, const uint16_t endpoint_id,
+                                               const uint32_t cluster_id, const uint32_t attribute_id) {
+    state_attribute_t *oldest = nullptr;
+    state_attribute_t *entry = lookup_attribute_entry(node_id, endpoint_id, cluster_id, attribute_id, &oldest);
+    if (entry) return entry;
+
+    if (state.attribute_count < CONFIG_STATE_STORE_MAX_ATTRIBUTES) {
+        entry = &state.attributes[state.attribute_count++];
+    } else {
+        entry = oldest;
+        cache_stats.evictions++;
+    }
+    entry->node_id = node_id;
+    entry->endpoint_id = endpoint_id;
+    entry->cluster_id = cluster_id;
+    entry->attribute_id = attribute_id;
+    return entry;
+}
+
+/**
+ * Forgets the value of an attribute, if it is stored. Called with state_lock held.
+ */
+static void remove_attribute_entry(const uint64_t node_id, const uint16_t endpoint_id, const uint32_t cluster_id,
+                                   const uint32_t attribute_id) {
+    state_attribute_t *entry = lookup_attribute_entry(node_id, endpoint_id, cluster_id, attribute_id, nullptr);
+    if (!entry) return;
+
+    // Entries are unordered, so the last one fills the gap
+    *entry = state.attributes[--state.attribute_count];
+}
+
+void state_store_set_attribute(const uint64_t node_id, const uint16_t endpoint_id, const uint32_t cluster_id,
+                               const uint32_t attribute_id, const uint8_t *tlv, const size_t tlv_len,
+                               const uint32_t *data_version) {
+    if (!state_lock) return;
+
+    const int64_t now_us = esp_timer_get_time();
+    xSemaphoreTake(state_lock, portMAX_DELAY);
+    if (!tlv || tlv_len == 0 || tlv_len > CONFIG_STATE_STORE_MAX_VALUE_SIZE) {
+        remove_attribute_entry(node_id, endpoint_id, cluster_id, attribute_id);
+        xSemaphoreGive(state_lock);
+        return;
+    }
+
+    state_attribute_t *entry = find_attribute_entry(node_id, endpoint_id, cluster_id, attribute_id);
+    entry->used = ++attribute_clock;
+    entry->updated_us = now_us;
+    entry->has_data_version = data_version != nullptr;
+    entry->data_version = data_version ? *data_version : 0;
+    memcpy(entry->tlv, tlv, tlv_len);
+    entry->tlv_len = tlv_len;
+    xSemaphoreGive(state_lock);
+}
+
+bool state_store_get_attribute(const uint64_t node_id, const uint16_t endpoint_id, const uint32_t cluster_id,
+                               const uint32_t attribute_id, const uint32_t max_age_ms, state_attribute_t *attribute,
+                               uint32_t *age_ms) {
+    if (!state_lock || !attribute) return false;
+
+    const int64_t now_us = esp_timer_get_time();
+    xSemaphoreTake(state_lock, portMAX_DELAY);
+    state_attribute_t *entry = lookup_attribute_entry(node_id, endpoint_id, cluster_id, attribute_id, nullptr);
+    const int64_t age_us = entry ? now_us - entry->updated_us : 0;
+    const bool hit = entry && age_us <= static_cast<int64_t>(max_age_ms) * 1000;
+    if (hit) {
+        entry->used = ++attribute_clock;
+        *attribute = *entry;
+        if (age_ms) *age_ms = static_cast<uint32_t>(age_us / 1000);
+        cache_stats.hits++;
+    } else {
+        cache_stats.misses++;
+    }
+    xSemaphoreGive(state_lock);
+    return hit;
+}
+
+void state_store_get_cache_stats(state_cache_stats_t *stats) {
+    if (!state_lock) {
+        *stats = {};
+        return;
+    }
+
+    xSemaphoreTake(state_lock, portMAX_DELAY);
+    *stats = cache_stats;
+    xSemaphoreGive(state_lock);
+}
+
+const orchestrator_state_t *state_store_acquire() {
+    xSemaphoreTake(state_lock, portMAX_DELAY);
+    return &state;
+}
+
+void state_store_release() {
+    xSemaphoreGive(state_lock);
+}
@@ -0,0 +1,134 @@
+#include "messages/tlv_encoder.h"
+
+#include <esp_log.h>
+
+#include <cinttypes>
+#include <cstdio>
+
+static const char *TAG = "TLV_ENCODER";
+
+// Size of a structure member key: "0x", 8 hex digits, ':', up to 10 digits and the terminator.
+static constexpr size_t MEMBER_KEY_SIZE = 22;
+
+/**
+ * Formats the key a structure member is encoded under, from its tag.
+ */
+static void format_member_key(char *key, const chip::TLV::Tag tag) {
+    if (chip::TLV::IsContextTag(tag)) {
+        // Context tags are a single byte and make up nearly every key, so they skip snprintf
+        uint32_t num = chip::TLV::TagNumFromTag(tag);
+        char digits[3];
+        size_t count = 0;
+        do {
+            digits[count++] = static_cast<char>('0' + num % 10);
+            num /= 10;
+        } while (num > 0 && count < sizeof(digits));
+        for (size_t i = 0; i < count; ++i) key[i] = digits[count - 1 - i];
+        key[count] = '\0';
+    } else if (chip::TLV::IsProfileTag(tag)) {
+        snprintf(key, MEMBER_KEY_SIZE, "0x%08" PRIX32 ":%" PRIu32, chip::TLV::ProfileIdFromTag(tag),
+                 chip::TLV::TagNumFromTag(tag));
+    } else {
+        key[0] = '\0';
+    }
+}
+
+static CHIP_ERROR add_element(message_encoder_t *enc, const char *key, chip::TLV::TLVReader &reader);
+
+/**
+ * Adds the members of the container the reader is positioned on, leaving the reader after the container.
+ * The container itself has already been opened in the encoder.
+ */
+static CHIP_ERROR add_members(message_encoder_t *enc, chip::TLV::TLVReader &reader, const bool is_object) {
+    chip::TLV::TLVType outer;
+    CHIP_ERROR err = reader.EnterContainer(outer);
+    if (err != CHIP_NO_ERROR) return err;
+
+    char member_key[MEMBER_KEY_SIZE];
+    while ((err = reader.Next()) == CHIP_NO_ERROR) {
+        if (is_object) format_member_key(member_key, reader.GetTag());
+        err = add_element(enc, is_object ? member_key : nullptr, reader);
+        if (err != CHIP_NO_ERROR) return err;
+    }
+    if (err != CHIP_END_OF_TLV) return err;
+    return reader.ExitContainer(outer);
+}
+
+/**
+ * Adds the element the reader is positioned on, recursing into containers. Recursion is bounded by the
+ * nesting depth of the encoder: opening a container beyond it fails the encoder, which ends the walk.
+ */
+static CHIP_ERROR add_element(message_encoder_t *enc, const char *key, chip::TLV::TLVReader &reader) {
+    if (enc->failed) return CHIP_ERROR_NO_MEMORY;
+
+    CHIP_ERROR err = CHIP_NO_ERROR;
+    switch (reader.GetType()) {
+        case chip::TLV::kTLVType_SignedInteger: {
+            int64_t value;
+            if ((err = reader.Get(value)) == CHIP_NO_ERROR) message_add_int(enc, key, value);
+            return err;
+        }
+        case chip::TLV::kTLVType_UnsignedInteger: {
+            uint64_t value;
+            if ((err = reader.Get(value)) == CHIP_NO_ERROR) message_add_uint(enc, key, value);
+            return err;
+        }
+        case chip::TLV::kTLVType_Boolean: {
+            bool value;
+            if ((err = reader.Get(value)) == CHIP_NO_ERROR) message_add_bool(enc, key, value);
+            return err;
+        }
+        case chip::TLV::kTLVType_FloatingPointNumber: {
+            double value;
+            if ((err = reader.Get(value)) == CHIP_NO_ERROR) message_add_double(enc, key, value);
+            return err;
+        }
+        case chip::TLV::kTLVType_Null:
+            message_add_null(enc, key);
+            return CHIP_NO_ERROR;
+        case chip::TLV::kTLVType_UTF8String:
+        case chip::TLV::kTLVType_ByteString: {
+            // Strings are read in place, without a copy
+            const uint8_t *data = nullptr;
+            const uint32_t len = reader.GetLength();
+            if (len > 0 && (err = reader.GetDataPtr(data)) != CHIP_NO_ERROR) return err;
+            if (reader.GetType() == chip::TLV::kTLVType_UTF8String) {
+                message_add_text(enc, key, len > 0 ? reinterpret_cast<const char *>(data) : "", len);
+            } else {
+                message_add_bytes(enc, key, data, len);
+            }
+            return CHIP_NO_ERROR;
+        }
+        case chip::TLV::kTLVType_Structure:
+        case chip::TLV::kTLVType_Array:
+        case chip::TLV::kTLVType_List: {
+            const bool is_object = reader.GetType() == chip::TLV::kTLVType_Structure;
+            if (is_object) {
+                message_begin_object(enc, key);
+            } else {
+                message_begin_array(enc, key);
+            }
+            if (enc->failed) return CHIP_ERROR_NO_MEMORY;
+            if ((err = add_members(enc, reader, is_object)) != CHIP_NO_ERROR) return err;
+            message_end(enc);
+            return CHIP_NO_ERROR;
+        }
+        default:
+            return CHIP_ERROR_INVALID_TLV_ELEMENT;
+    }
+}
+
+void message_add_tlv(message_encoder_t *enc, const char *key, const chip::TLV::TLVReader *element) {
+    if (!element) {
+        enc->failed = true;
+        return;
+    }
+
+    chip::TLV::TLVReader reader;
+    reader.Init(*element);
+    const bool encoder_failed = enc->failed;
+    if (add_element(enc, key, reader) != CHIP_NO_ERROR) {
+        if (!encoder_failed && !enc->failed) ESP_LOGW(TAG, "Malformed TLV element");
+        enc->failed = true;
+    }
+}
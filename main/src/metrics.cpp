@@ -0,0 +1,185 @@
+#include "metrics.h"
+#include "matter_controller.h"
+#include "messages/command_executor.h"
+#include "messages/command_registry.h"
+#include "messages/state_store.h"
+#include "thread_util.h"
+#include "sdkconfig.h"
+
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Tasks whose stack high-water mark is reported, by FreeRTOS task name. Tasks that do not exist are skipped.
+static constexpr const char *MONITORED_TASKS[] = {
+    "httpd",            // WebSocket server
+    "command_executor", // Command executor
+    "keep_alive_task",  // WebSocket keep-alive
+    "ot_task",          // OpenThread main loop
+    "CHIP",             // Matter stack
+    "sys_evt",          // Default event loop
+    "tiT",              // lwIP
+};
+
+// Heap regions whose free memory is reported.
+struct heap_region_t {
+    const char *name;
+    uint32_t caps;
+};
+static constexpr heap_region_t HEAP_REGIONS[] = {
+    {"internal", MALLOC_CAP_INTERNAL},
+#if CONFIG_SPIRAM
+    {"psram", MALLOC_CAP_SPIRAM},
+#endif
+};
+
+static void write_executor_metrics(metrics_writer_t *writer) {
+    command_executor_stats_t stats;
+    if (command_executor_get_stats(&stats) != ESP_OK) return;
+
+    metrics_write_family(writer, "command_queue_depth", "gauge", "Commands waiting for the executor.");
+    metrics_write_uint(writer, "command_queue_depth", nullptr, nullptr, stats.depth);
+    metrics_write_family(writer, "command_queue_capacity", "gauge", "Capacity of the command queue.");
+    metrics_write_uint(writer, "command_queue_capacity", nullptr, nullptr, stats.capacity);
+    metrics_write_family(writer, "command_queue_max_depth", "gauge", "Highest command queue depth since boot.");
+    metrics_write_uint(writer, "command_queue_max_depth", nullptr, nullptr, stats.max_depth);
+    metrics_write_family(writer, "commands_rejected_total", "counter",
+                         "Commands rejected because the queue was full or they were too large.");
+    metrics_write_uint(writer, "commands_rejected_total", nullptr, nullptr, stats.rejected);
+    metrics_write_family(writer, "command_queue_wait_seconds", "summary",
+                         "Time commands waited in the queue before execution.");
+    metrics_write_seconds(writer, "command_queue_wait_seconds_sum", nullptr, nullptr, stats.total_wait_us);
+    metrics_write_uint(writer, "command_queue_wait_seconds_count", nullptr, nullptr, stats.completed);
+}
+
+/**
+ * Renders the statistics of every command executed at least once. Commands never executed are left out,
+ * which keeps scrapes small.
+ */
+static void write_command_metrics(metrics_writer_t *writer) {
+    const size_t count = command_registry_count();
+
+    metrics_write_family(writer, "commands_executed_total", "counter", "Commands executed, by action.");
+    for (size_t i = 0; i < count; ++i) {
+        command_stats_t stats;
+        command_registry_get_stats(i, &stats);
+        if (stats.executed == 0) continue;
+        metrics_write_uint(writer, "commands_executed_total", "action", command_registry_at(i)->action,
+                           stats.executed);
+    }
+
+    metrics_write_family(writer, "commands_failed_total", "counter", "Commands that returned an error, by action.");
+    for (size_t i = 0; i < count; ++i) {
+        command_stats_t stats;
+        command_registry_get_stats(i, &stats);
+        if (stats.executed == 0) continue;
+        metrics_write_uint(writer, "commands_failed_total", "action", command_registry_at(i)->action, stats.failed);
+    }
+
+    metrics_write_family(writer, "command_duration_seconds", "histogram",
+                         "Time from the start of a command until its response was sent, by action.");
+    for (size_t i = 0; i < count; ++i) {
+        command_stats_t stats;
+        command_registry_get_stats(i, &stats);
+        if (stats.executed == 0) continue;
+        metrics_write_histogram(writer, "command_duration_seconds", "action", command_registry_at(i)->action,
+                                &stats.latency);
+    }
+}
+
+static void write_heap_metrics(metrics_writer_t *writer) {
+    metrics_write_family(writer, "heap_free_bytes", "gauge", "Free heap.");
+    for (const auto &region: HEAP_REGIONS) {
+        metrics_write_uint(writer, "heap_free_bytes", "region", region.name, heap_caps_get_free_size(region.caps));
+    }
+    metrics_write_family(writer, "heap_min_free_bytes", "gauge", "Lowest free heap since boot.");
+    for (const auto &region: HEAP_REGIONS) {
+        metrics_write_uint(writer, "heap_min_free_bytes", "region", region.name,
+                           heap_caps_get_minimum_free_size(region.caps));
+    }
+    metrics_write_family(writer, "heap_largest_free_block_bytes", "gauge", "Largest block that can be allocated.");
+    for (const auto &region: HEAP_REGIONS) {
+        metrics_write_uint(writer, "heap_largest_free_block_bytes", "region", region.name,
+                           heap_caps_get_largest_free_block(region.caps));
+    }
+}
+
+static void write_task_metrics(metrics_writer_t *writer) {
+    metrics_write_family(writer, "task_stack_free_min_bytes", "gauge",
+                         "Least free stack a task ever had (stack high-water mark).");
+    for (const char *name: MONITORED_TASKS) {
+        TaskHandle_t task = xTaskGetHandle(name);
+        if (!task) continue;
+        metrics_write_uint(writer, "task_stack_free_min_bytes", "task", name, uxTaskGetStackHighWaterMark(task));
+    }
+}
+
+/**
+ * Renders the time the orchestrator waited for the stack locks.
+ */
+static void write_lock_metrics(metrics_writer_t *writer) {
+    matter_lock_stats_t chip;
+    matter_controller_get_lock_stats(&chip);
+#if CONFIG_OPENTHREAD_ENABLED
+    thread_lock_stats_t openthread;
+    thread_get_lock_stats(&openthread);
+#endif
+
+    metrics_write_family(writer, "lock_wait_seconds", "summary", "Time spent waiting for a stack lock.");
+    metrics_write_seconds(writer, "lock_wait_seconds_sum", "lock", "chip", chip.total_wait_us);
+    metrics_write_uint(writer, "lock_wait_seconds_count", "lock", "chip", chip.acquisitions + chip.failures);
+#if CONFIG_OPENTHREAD_ENABLED
+    metrics_write_seconds(writer, "lock_wait_seconds_sum", "lock", "openthread", openthread.total_wait_us);
+    metrics_write_uint(writer, "lock_wait_seconds_count", "lock", "openthread",
+                       openthread.acquisitions + openthread.timeouts);
+#endif
+
+    metrics_write_family(writer, "lock_wait_max_seconds", "gauge", "Longest wait for a stack lock since boot.");
+    metrics_write_seconds(writer, "lock_wait_max_seconds", "lock", "chip", chip.max_wait_us);
+#if CONFIG_OPENTHREAD_ENABLED
+    metrics_write_seconds(writer, "lock_wait_max_seconds", "lock", "openthread", openthread.max_wait_us);
+#endif
+
+    metrics_write_family(writer, "lock_failures_total", "counter", "Attempts that did not get a stack lock.");
+    metrics_write_uint(writer, "lock_failures_total", "lock", "chip", chip.failures);
+#if CONFIG_OPENTHREAD_ENABLED
+    metrics_write_uint(writer, "lock_failures_total", "lock", "openthread", openthread.timeouts);
+#endif
+}
+
+static void write_attribute_cache_metrics(metrics_writer_t *writer) {
+    state_cache_stats_t stats;
+    state_store_get_cache_stats(&stats);
+
+    metrics_write_family(writer, "attribute_cache_hits_total", "counter",
+                         "Attribute reads answered from a stored value.");
+    metrics_write_uint(writer, "attribute_cache_hits_total", nullptr, nullptr, stats.hits);
+    metrics_write_family(writer, "attribute_cache_misses_total", "counter",
+                         "Attribute reads accepting a stored value that had to query the node.");
+    metrics_write_uint(writer, "attribute_cache_misses_total", nullptr, nullptr, stats.misses);
+    metrics_write_family(writer, "attribute_cache_evictions_total", "counter",
+                         "Stored attribute values forgotten to make room for another attribute.");
+    metrics_write_uint(writer, "attribute_cache_evictions_total", nullptr, nullptr, stats.evictions);
+}
+
+static void write_read_metrics(metrics_writer_t *writer) {
+    matter_read_stats_t stats;
+    matter_controller_get_read_stats(&stats);
+
+    metrics_write_family(writer, "matter_read_requests_total", "counter", "Attribute read requests sent to nodes.");
+    metrics_write_uint(writer, "matter_read_requests_total", nullptr, nullptr, stats.requests);
+    metrics_write_family(writer, "matter_read_paths_total", "counter",
+                         "Attribute paths read, by whether they were sent or joined a read in flight.");
+    metrics_write_uint(writer, "matter_read_paths_total", "outcome", "sent", stats.paths_read);
+    metrics_write_uint(writer, "matter_read_paths_total", "outcome", "joined", stats.paths_joined);
+}
+
+void write_orchestrator_metrics(metrics_writer_t *writer) {
+    write_executor_metrics(writer);
+    write_command_metrics(writer);
+    write_heap_metrics(writer);
+    write_task_metrics(writer);
+    write_lock_metrics(writer);
+    write_attribute_cache_metrics(writer);
+    write_read_metrics(writer);
+}
@@ -1,6 +1,11 @@
+#include "commands/matter_commands.h"
 #include "event_handlers/chip_event_handler.h"
 #include "event_handlers/thread_event_handler.h"
 #include "event_handlers/wifi_event_handler.h"
+#include "messages/command_executor.h"
+#include "messages/inbound_message_handler.h"
+#include "messages/state_store.h"
+#include "metrics.h"
 #include "thread_interface.h"
 #include "matter_interface.h"
 #include "wifi_interface.h"
@@ -37,6 +42,26 @@ extern "C" void app_main() {
         return;
     }
 
+    // Create the state store before the event handlers record into it
+    err = state_store_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize state store: %s", esp_err_to_name(err));
+        return;
+    }
+
+    // Start the command executor before the WebSocket server can admit messages
+    ESP_LOGI(TAG, "Starting command executor");
+    err = command_executor_start(handle_inbound_message, reject_inbound_message);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start command executor: %s", esp_err_to_name(err));
+        return;
+    }
+
+    // Add the orchestrator's metrics to /metrics before the WebSocket server is started
+    websocket_server_set_metrics_handler(write_orchestrator_metrics);
+    // Subscriptions are held by clients and released when they disconnect
+    websocket_server_set_disconnected_handler(release_client_subscriptions);
+
     // Initialize Wi-Fi Interface
 #if CONFIG_ENABLE_WIFI_STATION || CONFIG_ENABLE_WIFI_AP
     err = wifi_interface_init(handle_wifi_event);
@@ -0,0 +1,29 @@
+#include "allocation_counter.h"
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+}
+
+static size_t allocations = 0;
+
+size_t allocation_count() { return allocations; }
+
+extern "C" void *malloc(const size_t size) {
+    allocations++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(const size_t count, const size_t size) {
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, const size_t size) {
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void *ptr) { __libc_free(ptr); }
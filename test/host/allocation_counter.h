@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * Number of heap allocations made by the program so far, operator new included. Programs linking
+ * allocation_counter.cpp count them by replacing the malloc family of the C library.
+ */
+size_t allocation_count();
@@ -0,0 +1,102 @@
+/**
+ * Counts the heap allocations and measures the time of the broadcast_info_* builders, which encode every
+ * event once per protocol into pooled buffers. The server is stubbed: the real websocket_broadcast adds a
+ * single shared copy of each encoding, whatever the number of recipients. The program fails if a builder
+ * allocates, so it also runs as a test.
+ */
+
+#include "allocation_counter.h"
+#include "messages/outbound_message_builder.h"
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+static constexpr int ITERATIONS = 20000;
+
+// Bytes handed to the server by the last broadcast, per protocol.
+static size_t broadcast_bytes[2];
+
+size_t websocket_get_subscriber_count(ws_protocol_t, const char *) { return 1; }
+
+bool websocket_replay_enabled(ws_protocol_t) { return false; }
+
+esp_err_t websocket_broadcast(const ws_protocol_t protocol, const char *, uint64_t, ws_overflow_policy_t,
+                              const uint8_t *, const size_t len) {
+    broadcast_bytes[protocol == WS_PROTOCOL_CBOR] = len;
+    return ESP_OK;
+}
+
+// Only used by the responses and the snapshot, which the benchmark does not send.
+esp_err_t websocket_send_to_client(int, ws_protocol_t, const uint8_t *, size_t) { return ESP_OK; }
+
+ws_protocol_t websocket_get_client_protocol(int) { return WS_PROTOCOL_JSON; }
+
+esp_err_t websocket_replay_events(int, uint64_t, ws_replay_visitor_t, void *) { return ESP_OK; }
+
+const orchestrator_state_t *state_store_acquire() {
+    static orchestrator_state_t state = {};
+    return &state;
+}
+
+void state_store_release() {}
+
+static bool bench(const char *name, const std::function<esp_err_t()> &broadcast) {
+    if (broadcast() != ESP_OK) {
+        printf("FAIL %s: broadcast failed\n", name);
+        return false;
+    }
+
+    const size_t allocations = allocation_count();
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) broadcast();
+    const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    const double allocations_per_broadcast = static_cast<double>(allocation_count() - allocations) / ITERATIONS;
+
+    printf("%-30s JSON %4zu B   CBOR %4zu B   %6.2f us   %4.1f allocations per broadcast\n", name,
+           broadcast_bytes[0], broadcast_bytes[1], elapsed.count() / ITERATIONS, allocations_per_broadcast);
+    if (allocations_per_broadcast != 0) {
+        printf("FAIL %s: the builder allocates\n", name);
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    // A temperature measurement, and the Descriptor DeviceTypeList attribute (a list of 8 structures)
+    const std::vector<uint8_t> temperature = {0x01, 0x7A, 0x08};
+    std::vector<uint8_t> device_types = {0x16};
+    for (uint8_t i = 0; i < 8; ++i) device_types.insert(device_types.end(), {0x15, 0x24, 0, i, 0x24, 1, 1, 0x18});
+    device_types.push_back(0x18);
+
+    const auto attribute_report = [](const std::vector<uint8_t> &tlv, const uint32_t cluster_id) {
+        chip::TLV::TLVReader reader;
+        reader.Init(tlv.data(), tlv.size());
+        reader.Next();
+        return broadcast_info_matter_attribute_report_message(0x1234, 1, cluster_id, 0, &reader, tlv.data(),
+                                                              tlv.size());
+    };
+
+    const char *addresses[] = {"fd11:22::1", "fd11:22:0:0:8f5a:2c1e:4d7b:9a01", "fe80::a8bb:ccff:fedd:eeff",
+                               "fd00:db8::ff:fe00:fc00"};
+    const uint8_t extended_pan_id[] = {0xDE, 0xAD, 0x00, 0xBE, 0xEF, 0x00, 0xCA, 0xFE};
+    const uint8_t mesh_local_prefix[] = {0xFD, 0x11, 0x22, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+    bool passed = true;
+    passed &= bench("attribute report (int16)", [&] { return attribute_report(temperature, 0x402); });
+    passed &= bench("attribute report (list)", [&] { return attribute_report(device_types, 0x1D); });
+    passed &= bench("thread.role", [] { return broadcast_info_thread_role_message("leader"); });
+    passed &= bench("thread.attachment_status", [] { return broadcast_info_thread_attachment_status_message(true); });
+    passed &= bench("thread.unicast_addresses", [&] {
+        return broadcast_info_unicast_addresses_message(addresses, std::size(addresses));
+    });
+    passed &= bench("thread.active_dataset", [&] {
+        return broadcast_info_active_dataset_message(1, "OpenThread-1234", extended_pan_id, mesh_local_prefix,
+                                                     0x1234, 15);
+    });
+    passed &= bench("matter.commissioning_complete",
+                    [] { return broadcast_info_matter_commissioning_complete_message(0x1234, 1); });
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+/**
+ * Measures the cost of dispatching an action through the command registry's perfect hash as the number of
+ * registered actions grows from 15 to 200, against the chain of strcmp calls it replaced. Synthetic tables
+ * are built with the registry's own builder and looked up with its own lookup, which are internal to
+ * command_registry.cpp, so the source is included here.
+ */
+
+#include "../../main/src/messages/command_registry.cpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static constexpr int LOOKUPS = 2000000;
+static constexpr size_t QUERIES = 1024;
+
+static uint64_t random_state = 0x2545F4914F6CDD1Dull;
+
+static uint64_t next_random() {
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return random_state * 2685821657736338717ull;
+}
+
+/**
+ * The chain of strcmp calls the registry replaced, over the same table.
+ */
+template<size_t N>
+static const command_descriptor_t *find_linear(const command_descriptor_t (&commands)[N], const char *action) {
+    for (const command_descriptor_t &command: commands) {
+        if (strcmp(command.action, action) == 0) return &command;
+    }
+    return nullptr;
+}
+
+/**
+ * Looks up every query in turn, `LOOKUPS` times in total.
+ *
+ * @return Nanoseconds per lookup.
+ */
+template<typename find_fn>
+static double measure(const std::vector<std::string> &queries, size_t &found, find_fn find) {
+    found = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < LOOKUPS; ++i) found += find(queries[i % QUERIES].c_str()) != nullptr;
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / LOOKUPS;
+}
+
+/**
+ * Dispatches registered actions, in random order, and unknown actions sharing their prefixes through both
+ * lookups of `commands`.
+ */
+template<size_t N>
+static void bench(const char *name, const command_descriptor_t (&commands)[N],
+                  const command_hash_table_t<N> &table) {
+    std::vector<std::string> hits;
+    std::vector<std::string> misses;
+    for (size_t i = 0; i < QUERIES; ++i) {
+        const std::string action = commands[next_random() % N].action;
+        hits.push_back(action);
+        misses.push_back(action + "s");
+    }
+
+    const auto hash = [&](const char *action) { return find_command(table, commands, action); };
+    const auto linear = [&](const char *action) { return find_linear(commands, action); };
+    size_t found[4];
+    const double hash_hit_ns = measure(hits, found[0], hash);
+    const double linear_hit_ns = measure(hits, found[1], linear);
+    const double hash_miss_ns = measure(misses, found[2], hash);
+    const double linear_miss_ns = measure(misses, found[3], linear);
+    if (found[0] != LOOKUPS || found[1] != LOOKUPS || found[2] != 0 || found[3] != 0) {
+        printf("FAIL %s: lookups disagree\n", name);
+        exit(1);
+    }
+
+    printf("%-20s %3zu actions   perfect hash %6.1f ns hit %6.1f ns miss   strcmp chain %6.1f ns hit %6.1f ns miss\n",
+           name, N, hash_hit_ns, hash_miss_ns, linear_hit_ns, linear_miss_ns);
+}
+
+/**
+ * Builds a table of `N` actions named like the registered ones, spread over the same namespaces.
+ */
+template<size_t N>
+static void bench_synthetic() {
+    static const char *NAMESPACES[] = {"thread", "wifi", "client", "server", "matter"};
+    static const char *VERBS[] = {"attribute_read", "attributes_subscribe", "status_get", "dataset_init",
+                                  "cluster_command_invoke", "subscription_cancel", "enable"};
+    static char actions[N][48];
+    static command_descriptor_t commands[N];
+    for (size_t i = 0; i < N; ++i) {
+        snprintf(actions[i], sizeof(actions[i]), "%s.%s_%zu", NAMESPACES[i % std::size(NAMESPACES)],
+                 VERBS[i % std::size(VERBS)], i);
+        commands[i] = command(actions[i], nullptr);
+    }
+
+    static const command_hash_table_t<N> table = build_command_hash_table(commands);
+    if (!table.valid) {
+        printf("FAIL no perfect hash for %zu actions\n", N);
+        exit(1);
+    }
+    bench("synthetic", commands, table);
+}
+
+int main() {
+    bench("registry", COMMANDS, COMMAND_HASH_TABLE);
+    bench_synthetic<15>();
+    bench_synthetic<25>();
+    bench_synthetic<50>();
+    bench_synthetic<100>();
+    bench_synthetic<200>();
+    return 0;
+}
@@ -0,0 +1,128 @@
+/**
+ * Host tests of command_registry_find: every registered action is found, and near misses of registered
+ * actions (a character dropped, added, changed or in another case) and unknown actions are rejected. Each
+ * lookup is checked against a linear scan of the registry.
+ */
+
+#include "messages/command_registry.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+static constexpr int RANDOM_ACTIONS = 200000;
+
+static int failures = 0;
+
+static uint64_t random_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t next_random() {
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return random_state * 2685821657736338717ull;
+}
+
+/**
+ * The entry a lookup of `action` must return: the registered command with that exact action, if any.
+ */
+static const command_descriptor_t *find_linear(const char *action) {
+    for (size_t i = 0; i < command_registry_count(); ++i) {
+        const command_descriptor_t *command = command_registry_at(i);
+        if (strcmp(command->action, action) == 0) return command;
+    }
+    return nullptr;
+}
+
+static void check_lookup(const std::string &action) {
+    const command_descriptor_t *expected = find_linear(action.c_str());
+    const command_descriptor_t *found = command_registry_find(action.c_str());
+    if (found != expected) {
+        printf("FAIL \"%s\": expected %s, got %s\n", action.c_str(), expected ? expected->action : "no command",
+               found ? found->action : "no command");
+        failures++;
+    }
+}
+
+static void test_registered() {
+    if (command_registry_count() == 0) {
+        printf("FAIL no registered commands\n");
+        failures++;
+    }
+    for (size_t i = 0; i < command_registry_count(); ++i) {
+        const command_descriptor_t *command = command_registry_at(i);
+        if (command_registry_find(command->action) != command) {
+            printf("FAIL registered action \"%s\" not found\n", command->action);
+            failures++;
+        }
+        // A copy, so that the lookup cannot rely on the address of the registered string
+        check_lookup(command->action);
+    }
+}
+
+static void test_near_misses() {
+    for (size_t i = 0; i < command_registry_count(); ++i) {
+        const std::string action = command_registry_at(i)->action;
+        for (size_t pos = 0; pos <= action.size(); ++pos) {
+            if (pos < action.size()) {
+                std::string dropped = action;
+                dropped.erase(pos, 1);
+                check_lookup(dropped);
+
+                std::string changed = action;
+                changed[pos] = static_cast<char>(changed[pos] + 1);
+                check_lookup(changed);
+
+                std::string upper = action;
+                upper[pos] = static_cast<char>(toupper(upper[pos]));
+                check_lookup(upper);
+            }
+            for (const char c: {'s', '_', '.', ' ', 'x'}) {
+                std::string added = action;
+                added.insert(pos, 1, c);
+                check_lookup(added);
+            }
+            check_lookup(action.substr(0, pos));
+        }
+        check_lookup(action + action);
+    }
+}
+
+static void test_unknown() {
+    for (const char *action: {"", ".", "matter", "matter.", "thread.", "client.", "MATTER.ATTRIBUTE_READ",
+                              "matter.attribute_read\n", "matter.attribute_read\xff", "unknown.action"}) {
+        check_lookup(action);
+    }
+    if (command_registry_find(nullptr) != nullptr) {
+        printf("FAIL null action found\n");
+        failures++;
+    }
+    check_lookup(std::string(4096, 'm'));
+
+    // Random strings over the characters of the registered actions
+    std::string alphabet;
+    for (size_t i = 0; i < command_registry_count(); ++i) {
+        for (const char *c = command_registry_at(i)->action; *c; ++c) {
+            if (alphabet.find(*c) == std::string::npos) alphabet += *c;
+        }
+    }
+    for (int i = 0; i < RANDOM_ACTIONS && failures < 10; ++i) {
+        std::string action(next_random() % 40, ' ');
+        for (char &c: action) c = alphabet[next_random() % alphabet.size()];
+        check_lookup(action);
+    }
+}
+
+int main() {
+    test_registered();
+    test_near_misses();
+    test_unknown();
+
+    if (failures > 0) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("All tests passed (%zu commands)\n", command_registry_count());
+    return 0;
+}
@@ -0,0 +1,148 @@
+/**
+ * Measures what DEFLATE saves on the wire and what it costs in CPU for typical outbound messages, comparing
+ * deflate_compress with zlib at levels 1 and 6. Every compressed message is inflated back with zlib and
+ * checked against the original.
+ */
+
+#include "deflate.h"
+#include "messages/message_encoder.h"
+
+#include <zlib.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+typedef std::vector<uint8_t> bytes_t;
+
+static constexpr int ITERATIONS = 2000;
+
+// The default configuration of the server: CONFIG_WEBSOCKET_DEFLATE_WINDOW_BITS 12, MEM_LEVEL 4.
+static constexpr uint8_t WINDOW_BITS = 12;
+static constexpr uint8_t HASH_BITS = 4 + 7;
+
+static bool failed = false;
+
+static bytes_t finish(message_encoder_t &enc) {
+    const uint8_t *data;
+    size_t len;
+    bytes_t out;
+    if (message_encoder_finish(&enc, &data, &len) == ESP_OK) out.assign(data, data + len);
+    message_encoder_release(&enc);
+    return out;
+}
+
+static bytes_t attribute_report(const ws_protocol_t protocol) {
+    message_encoder_t enc;
+    message_encoder_init(&enc, protocol);
+    message_add_string(&enc, "action", "matter.attribute_report");
+    message_add_uint(&enc, "seq", 1042);
+    message_begin_object(&enc, "payload");
+    message_add_string(&enc, "node_id", "0x0000000000001234");
+    message_add_uint(&enc, "endpoint_id", 1);
+    message_add_uint(&enc, "cluster_id", 0x402);
+    message_add_uint(&enc, "attribute_id", 0);
+    message_add_int(&enc, "value", 2137);
+    message_end(&enc);
+    return finish(enc);
+}
+
+/**
+ * A state snapshot of 20 nodes with 6 cached attributes each, as sent to a newly connected client.
+ */
+static bytes_t snapshot(const ws_protocol_t protocol) {
+    message_encoder_t enc;
+    message_encoder_init(&enc, protocol);
+    message_add_string(&enc, "action", "state.snapshot");
+    message_begin_object(&enc, "payload");
+    message_begin_array(&enc, "attributes");
+    char node_id[24];
+    for (uint32_t node = 0; node < 20; ++node) {
+        snprintf(node_id, sizeof(node_id), "0x%016X", 0x1000 + node);
+        for (uint32_t attribute = 0; attribute < 6; ++attribute) {
+            message_begin_object(&enc, nullptr);
+            message_add_string(&enc, "node_id", node_id);
+            message_add_uint(&enc, "endpoint_id", 1);
+            message_add_uint(&enc, "cluster_id", attribute < 3 ? 0x6 : 0x8);
+            message_add_uint(&enc, "attribute_id", attribute);
+            message_add_uint(&enc, "value", (node * 37 + attribute * 11) % 255);
+            message_add_uint(&enc, "data_version", 100000 + node * 7 + attribute);
+            message_end(&enc);
+        }
+    }
+    message_end(&enc);
+    message_end(&enc);
+    return finish(enc);
+}
+
+static void check_inflates(const char *name, const bytes_t &compressed, const bytes_t &original) {
+    bytes_t inflated(original.size() + 1);
+    uLongf inflated_len = inflated.size();
+    z_stream stream = {};
+    inflateInit2(&stream, -15);
+    stream.next_in = const_cast<uint8_t *>(compressed.data());
+    stream.avail_in = static_cast<uInt>(compressed.size());
+    stream.next_out = inflated.data();
+    stream.avail_out = static_cast<uInt>(inflated_len);
+    const int ret = inflate(&stream, Z_FINISH);
+    inflated.resize(stream.total_out);
+    inflateEnd(&stream);
+    if (ret != Z_STREAM_END || inflated != original) {
+        printf("FAIL %s does not inflate back\n", name);
+        failed = true;
+    }
+}
+
+template <typename compress_fn> static double measure(compress_fn compress) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) compress();
+    const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / ITERATIONS;
+}
+
+static bytes_t zlib_compress(const bytes_t &in, const int level) {
+    z_stream stream = {};
+    deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+    bytes_t out(deflateBound(&stream, in.size()));
+    stream.next_in = const_cast<uint8_t *>(in.data());
+    stream.avail_in = static_cast<uInt>(in.size());
+    stream.next_out = out.data();
+    stream.avail_out = static_cast<uInt>(out.size());
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+}
+
+static void bench(const char *name, const bytes_t &message) {
+    static uint16_t head[1 << HASH_BITS];
+    static uint16_t prev[1 << WINDOW_BITS];
+    static const deflate_workspace_t workspace = {WINDOW_BITS, HASH_BITS, head, prev};
+
+    bytes_t compressed(deflate_bound(message.size()));
+    const double deflate_us = measure([&] {
+        compressed.resize(deflate_bound(message.size()));
+        compressed.resize(deflate_compress(&workspace, message.data(), message.size(), compressed.data()));
+    });
+    check_inflates(name, compressed, message);
+
+    bytes_t zlib_fast;
+    bytes_t zlib_default;
+    const double zlib_fast_us = measure([&] { zlib_fast = zlib_compress(message, 1); });
+    const double zlib_default_us = measure([&] { zlib_default = zlib_compress(message, 6); });
+    check_inflates(name, zlib_fast, message);
+    check_inflates(name, zlib_default, message);
+
+    printf("%-24s %5zu B   deflate_compress %5zu B %7.2f us   zlib -1 %5zu B %7.2f us   zlib -6 %5zu B %7.2f us\n",
+           name, message.size(), compressed.size(), deflate_us, zlib_fast.size(), zlib_fast_us,
+           zlib_default.size(), zlib_default_us);
+}
+
+int main() {
+    bench("attribute report JSON", attribute_report(WS_PROTOCOL_JSON));
+    bench("attribute report CBOR", attribute_report(WS_PROTOCOL_CBOR));
+    bench("snapshot JSON", snapshot(WS_PROTOCOL_JSON));
+    bench("snapshot CBOR", snapshot(WS_PROTOCOL_CBOR));
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+/**
+ * Fuzz test of deflate_compress: random inputs of several shapes are compressed into a heap buffer of
+ * exactly deflate_bound() bytes, so that AddressSanitizer catches any write past it, and inflated back
+ * with zlib.
+ */
+
+#include "deflate.h"
+
+#include <zlib.h>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+static constexpr int ITERATIONS = 4000;
+
+static int failures = 0;
+
+// xorshift64*, so that failures reproduce from the iteration number.
+static uint64_t random_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t next_random() {
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return random_state * 2685821657736338717ull;
+}
+
+static size_t random_below(const size_t n) { return static_cast<size_t>(next_random() % n); }
+
+/**
+ * Appends a copy of earlier data, as a back-reference the compressor can find.
+ */
+static void append_repeat(std::vector<uint8_t> &data, const size_t max_distance) {
+    if (data.empty()) return;
+    const size_t distance = 1 + random_below(data.size() < max_distance ? data.size() : max_distance);
+    const size_t length = 3 + random_below(300);
+    const size_t start = data.size() - distance;
+    for (size_t i = 0; i < length; ++i) data.push_back(data[start + i]);
+}
+
+/**
+ * Generates an input of one of several shapes: noise, bytes above 143 (9-bit literals, the worst case of
+ * the fixed code) ending in a long match, text-like data with repeats, and runs of a single byte.
+ */
+static std::vector<uint8_t> generate_input(const int shape, const size_t window) {
+    const size_t target = random_below(shape == 0 ? 70000 : 4096);
+    std::vector<uint8_t> data;
+    data.reserve(target + 512);
+    switch (shape) {
+        case 0:
+            while (data.size() < target) data.push_back(static_cast<uint8_t>(next_random()));
+            break;
+        case 1:
+            while (data.size() < target) data.push_back(static_cast<uint8_t>(144 + random_below(112)));
+            append_repeat(data, window);
+            break;
+        case 2: {
+            static const char *WORDS[] = {"{\"action\":", "\"matter.attribute_report\"", ",\"node_id\":",
+                                          "\"0x1234\"", ",\"value\":", "true", "42", "}", "[", "]"};
+            while (data.size() < target) {
+                if (random_below(4) == 0) {
+                    append_repeat(data, window);
+                } else {
+                    const char *word = WORDS[random_below(sizeof(WORDS) / sizeof(WORDS[0]))];
+                    data.insert(data.end(), word, word + strlen(word));
+                }
+            }
+            break;
+        }
+        default:
+            data.assign(target, static_cast<uint8_t>(next_random()));
+            break;
+    }
+    return data;
+}
+
+static bool inflate_raw(const uint8_t *in, const size_t len, std::vector<uint8_t> &out, const size_t expected) {
+    z_stream stream = {};
+    if (inflateInit2(&stream, -15) != Z_OK) return false;
+    out.assign(expected + 1, 0);
+    stream.next_in = const_cast<uint8_t *>(in);
+    stream.avail_in = static_cast<uInt>(len);
+    stream.next_out = out.data();
+    stream.avail_out = static_cast<uInt>(out.size());
+    const int ret = inflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    inflateEnd(&stream);
+    return ret == Z_STREAM_END && stream.avail_in == 0;
+}
+
+static void check_round_trip(const deflate_workspace_t &workspace, const std::vector<uint8_t> &input,
+                             const int iteration) {
+    const size_t bound = deflate_bound(input.size());
+    // Exactly the bound, on the heap, as the server allocates it
+    std::unique_ptr<uint8_t[]> out(new uint8_t[bound]);
+    const size_t len = deflate_compress(&workspace, input.data(), input.size(), out.get());
+
+    std::vector<uint8_t> inflated;
+    if (len > bound) {
+        printf("FAIL iteration %d: %zu bytes compressed into %zu, past the bound of %zu\n", iteration,
+               input.size(), len, bound);
+        failures++;
+    } else if (!inflate_raw(out.get(), len, inflated, input.size()) || inflated != input) {
+        printf("FAIL iteration %d: %zu bytes do not inflate back\n", iteration, input.size());
+        failures++;
+    }
+}
+
+int main() {
+    // The default configuration, and the smallest and largest windows
+    const uint8_t configs[][2] = {{12, 11}, {9, 8}, {15, 15}};
+    for (const auto &config: configs) {
+        std::vector<uint16_t> head(static_cast<size_t>(1) << config[1]);
+        std::vector<uint16_t> prev(static_cast<size_t>(1) << config[0]);
+        const deflate_workspace_t workspace = {config[0], config[1], head.data(), prev.data()};
+        const size_t window = static_cast<size_t>(1) << config[0];
+
+        for (size_t len = 0; len < 8; ++len) check_round_trip(workspace, std::vector<uint8_t>(len, 0xAB), -1);
+        for (int i = 0; i < ITERATIONS && failures < 10; ++i) {
+            check_round_trip(workspace, generate_input(i % 4, window), i);
+        }
+    }
+
+    if (failures > 0) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,116 @@
+/**
+ * Compares the heap allocations and the time per message of the in-situ JSON decoder with the cJSON path it
+ * replaced for every frame, which now only handles documents over the token budget. Both paths run the
+ * real envelope decoding, registry lookup and payload decoding of inbound_message_handler.cpp, which are
+ * internal to it, so the source is included here. Handlers and responses are stubbed, and both paths must
+ * reply with the expected status: ESP_ERR_NOT_SUPPORTED from the stubbed handlers, ESP_OK for batches.
+ */
+
+#include "../../main/src/messages/inbound_message_handler.cpp"
+#include "allocation_counter.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static constexpr int ITERATIONS = 20000;
+
+int64_t esp_timer_get_time() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Status of the last response, and of the last command of a batch.
+static esp_err_t last_status;
+
+esp_err_t send_command_response_message(int, const command_request_id_t *, const char *, const esp_err_t status,
+                                        const command_result_t *) {
+    last_status = status;
+    return ESP_OK;
+}
+
+esp_err_t send_batch_response_message(int, const command_request_id_t *, const char *const *,
+                                      const esp_err_t *results, const size_t count) {
+    last_status = results[count - 1];
+    return ESP_OK;
+}
+
+esp_err_t execute_matter_batch_command(matter_batch_op_t *ops, const size_t count) {
+    for (size_t i = 0; i < count; ++i) ops[i].result = ESP_OK;
+    return ESP_OK;
+}
+
+/**
+ * Handles `message` `ITERATIONS` times, from a fresh writable copy each time as the server receives it.
+ *
+ * @param[out] allocations_per_message Heap allocations per message.
+ * @param[out] status Response status of the last message.
+ * @return Microseconds per message.
+ */
+template<typename handle_fn>
+static double measure(const std::string &message, double &allocations_per_message, esp_err_t &status,
+                      handle_fn handle) {
+    std::vector<char> buffer(message.size() + 1);
+    const size_t allocations = allocation_count();
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        memcpy(buffer.data(), message.data(), message.size() + 1);
+        handle(buffer.data(), message.size());
+    }
+    const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    allocations_per_message = static_cast<double>(allocation_count() - allocations) / ITERATIONS;
+    status = last_status;
+    return elapsed.count() / ITERATIONS;
+}
+
+static bool bench(const char *name, const std::string &message, const esp_err_t expected) {
+    double tokenized_allocations;
+    double cjson_allocations;
+    esp_err_t tokenized_status;
+    esp_err_t cjson_status;
+    const double tokenized_us = measure(message, tokenized_allocations, tokenized_status,
+                                        [](char *m, const size_t len) { handle_json_inbound_message(1, m, len); });
+    const double cjson_us = measure(message, cjson_allocations, cjson_status,
+                                    [](char *m, const size_t len) { process_cjson_message(1, m, len); });
+
+    printf("%-30s %5zu B   in-situ %6.2f us %5.1f allocations   cJSON %6.2f us %5.1f allocations\n", name,
+           message.size(), tokenized_us, tokenized_allocations, cjson_us, cjson_allocations);
+    if (tokenized_status != expected || cjson_status != expected) {
+        printf("FAIL %s: response status %d in-situ, %d with cJSON, expected %d\n", name, tokenized_status,
+               cjson_status, expected);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * A batch envelope of `count` attribute reads.
+ */
+static std::string batch(const size_t count) {
+    std::string message = R"({"type":"batch","request_id":7,"commands":[)";
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0) message += ",";
+        message += R"({"action":"matter.attribute_read","payload":{"node_id":"4660","endpoint_id":1,)"
+                   R"("cluster_id":6,"attribute_id":)" + std::to_string(i) + "}}";
+    }
+    return message + "]}";
+}
+
+int main() {
+    bool passed = true;
+    passed &= bench("matter.attribute_read",
+                    R"({"type":"command","action":"matter.attribute_read","request_id":"r-1042",)"
+                    R"("payload":{"node_id":"4660","endpoint_id":1,"cluster_id":1026,"attribute_id":0}})",
+                    ESP_ERR_NOT_SUPPORTED);
+    passed &= bench("matter.cluster_command_invoke",
+                    R"({"type":"command","action":"matter.cluster_command_invoke","request_id":1043,)"
+                    R"("payload":{"destination_id":"4660","endpoint_id":1,"cluster_id":6,"command_id":2,)"
+                    R"("command_data":"{\"0:U8\":1}"}})", ESP_ERR_NOT_SUPPORTED);
+    passed &= bench("client.subscribe",
+                    R"({"type":"command","action":"client.subscribe","payload":{"topics":"matter.*,thread.role"}})",
+                    ESP_ERR_NOT_SUPPORTED);
+    passed &= bench("batch of 4 reads", batch(4), ESP_OK);
+    passed &= bench("batch of 64 reads", batch(64), ESP_OK);
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+/**
+ * Churn benchmark of the keep-alive bookkeeping: 500 client slots over about 700 file descriptors, driven by
+ * random adds, removes, activity updates and checks on a simulated clock. The deadline heap and the fd
+ * index are checked against a reference model along the way, so the program also runs as a test.
+ *
+ * The keep-alive task itself is not started; the benchmark calls the operations the task runs for each
+ * queued action, which are internal to keep_alive.cpp, so the source is included here.
+ */
+
+#include "../../components/websocket_server/src/keep_alive.cpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+static constexpr size_t MAX_CLIENTS = 500;
+static constexpr int FD_RANGE = 700;
+static constexpr size_t KEEP_ALIVE_PERIOD_MS = 10000;
+static constexpr size_t NOT_ALIVE_AFTER_MS = 20000;
+static constexpr size_t VERIFY_EVERY = 1000;
+
+static int64_t now_us = 1000000;
+
+int64_t esp_timer_get_time() { return now_us; }
+
+// The keep-alive task is never started: the benchmark performs its actions itself.
+QueueHandle_t xQueueCreate(UBaseType_t, UBaseType_t) { return reinterpret_cast<QueueHandle_t>(1); }
+
+void vQueueDelete(QueueHandle_t) {}
+
+BaseType_t xQueueReceive(QueueHandle_t, void *, TickType_t) { return pdFALSE; }
+
+BaseType_t xQueueSendToBack(QueueHandle_t, const void *, TickType_t) { return pdTRUE; }
+
+BaseType_t xTaskCreate(void (*)(void *), const char *, uint32_t, void *, UBaseType_t, TaskHandle_t *) {
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t) {}
+
+// Reference model: the registered clients and the activity the server recorded for them.
+static std::map<int, wss_client_activity_t> model;
+
+static uint64_t random_state = 0x2545F4914F6CDD1Dull;
+
+static uint64_t next_random() {
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return random_state * 2685821657736338717ull;
+}
+
+static bool get_activity(wss_keep_alive_t, const int fd, wss_client_activity_t *activity) {
+    const auto it = model.find(fd);
+    if (it == model.end()) return false;
+    *activity = it->second;
+    return true;
+}
+
+static bool ping_client(wss_keep_alive_t, const int fd) {
+    // Most clients answer their pings within a few milliseconds
+    if (next_random() % 4 != 0) model[fd].last_pong_ms = now_us / 1000 + 1 + next_random() % 50;
+    return true;
+}
+
+static bool drop_client(wss_keep_alive_t, const int fd) {
+    model.erase(fd);
+    return true;
+}
+
+static void fail(const char *what) {
+    printf("FAIL %s\n", what);
+    exit(1);
+}
+
+/**
+ * Checks the heap order, the heap positions, the fd index and the free slots against the model.
+ */
+static void verify(const wss_keep_alive_storage *h) {
+    if (h->count != model.size()) fail("client count differs from the model");
+    for (size_t pos = 0; pos < h->count; ++pos) {
+        const keep_alive_client_t &client = h->clients[h->heap[pos]];
+        if (client.heap_pos != pos) fail("heap position out of date");
+        if (pos > 0 && client.deadline < h->clients[h->heap[(pos - 1) / 2]].deadline) fail("heap order broken");
+    }
+    for (const auto &entry: model) {
+        const uint16_t slot = h->index[index_find(h, entry.first)];
+        if (slot == NO_SLOT || h->clients[slot].fd != entry.first) fail("registered client not in the index");
+    }
+    size_t indexed = 0;
+    for (size_t pos = 0; pos <= h->index_mask; ++pos) indexed += h->index[pos] != NO_SLOT;
+    if (indexed != h->count) fail("stale entries in the index");
+
+    std::vector<bool> used(h->max_clients, false);
+    for (size_t pos = 0; pos < h->count; ++pos) used[h->heap[pos]] = true;
+    for (size_t i = 0; i < h->max_clients - h->count; ++i) {
+        if (used[h->free_slots[i]]) fail("slot both free and in use");
+        used[h->free_slots[i]] = true;
+    }
+}
+
+int main(const int argc, char **argv) {
+    const long operations = argc > 1 ? strtol(argv[1], nullptr, 10) : 2000000;
+
+    wss_keep_alive_config_t config = KEEP_ALIVE_CONFIG_DEFAULT();
+    config.max_clients = MAX_CLIENTS;
+    config.keep_alive_period_ms = KEEP_ALIVE_PERIOD_MS;
+    config.not_alive_after_ms = NOT_ALIVE_AFTER_MS;
+    config.check_client_alive_cb = ping_client;
+    config.client_not_alive_cb = drop_client;
+    config.get_client_activity_cb = get_activity;
+    wss_keep_alive_storage *h = wss_keep_alive_start(&config);
+    if (!h) fail("wss_keep_alive_start");
+
+    long counts[4] = {};
+    const auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < operations; ++i) {
+        const int fd = static_cast<int>(next_random() % FD_RANGE);
+        const bool registered = model.count(fd) > 0;
+        const uint64_t op = next_random() % 4;
+        counts[op]++;
+        switch (op) {
+            case 0:
+                if (register_client(h, fd) != (registered || model.size() < MAX_CLIENTS)) fail("register_client");
+                if (registered || model.size() < MAX_CLIENTS) model[fd] = {now_us / 1000, 0};
+                break;
+            case 1:
+                if (unregister_client(h, fd) != registered) fail("unregister_client");
+                model.erase(fd);
+                break;
+            case 2:
+                // Activity recorded by the server, picked up at the next check
+                if (registered) model[fd].last_frame_ms = now_us / 1000;
+                break;
+            default:
+                now_us += static_cast<int64_t>(next_random() % 200) * 1000;
+                check_due_clients(h);
+                break;
+        }
+        if (i % VERIFY_EVERY == 0) verify(h);
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    verify(h);
+
+    printf("%ld operations (%ld adds, %ld removes, %ld updates, %ld checks) over %zu slots: %.1f ns per operation"
+           " including verification every %zu\n",
+           operations, counts[0], counts[1], counts[2], counts[3], MAX_CLIENTS, elapsed.count() / operations,
+           VERIFY_EVERY);
+    free(h);
+    return 0;
+}
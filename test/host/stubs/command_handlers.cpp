@@ -0,0 +1,83 @@
+/**
+ * Host stand-ins for the functions the command registry's handlers call into. The host tests only look
+ * commands up, so none of them is expected to run: they all fail with ESP_ERR_NOT_SUPPORTED.
+ */
+
+#include "commands/matter_commands.h"
+#include "commands/thread_commands.h"
+#include "commands/wifi_commands.h"
+#include "messages/outbound_message_builder.h"
+#include "thread_util.h"
+#include "websocket_server.h"
+
+esp_err_t execute_thread_enable_command() { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t execute_thread_disable_command() { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t execute_thread_dataset_init_command(uint16_t, uint16_t, const char *, const char *, const char *,
+                                              const char *, const char *) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t execute_thread_status_get_command(bool *) { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t execute_thread_attached_get_command(bool *) { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t execute_thread_role_get_command(const char **) { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t execute_thread_active_dataset_get_command(otOperationalDataset *) { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t execute_thread_unicast_addresses_get_command(char **, size_t, size_t *) { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t execute_thread_multicast_addresses_get_command(char **, size_t, size_t *) { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t execute_thread_br_init_command() { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t execute_thread_br_deinit_command() { return ESP_ERR_NOT_SUPPORTED; }
+
+void thread_free_address_list(char **, size_t) {}
+
+esp_err_t execute_wifi_sta_connect_command(const char *, const char *) { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t execute_matter_controller_init_command(uint64_t, uint64_t, uint16_t) { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t execute_matter_pair_ble_thread_command(uint64_t, uint32_t, uint16_t) { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t execute_cmd_invoke_command(uint64_t, uint16_t, uint32_t, uint32_t, const char *) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t execute_attr_read_command(int, uint64_t, uint16_t, uint32_t, uint32_t, uint32_t, bool *, uint32_t *,
+                                    bool *) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t execute_attr_subscribe_command(int, uint64_t, uint16_t, uint32_t, uint32_t, uint16_t, uint16_t,
+                                         uint32_t *, bool *) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t execute_attrs_read_command(uint64_t, const char *, size_t *, size_t *) { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t execute_attrs_subscribe_command(int, uint64_t, const char *, uint16_t, uint16_t, size_t *, uint32_t *,
+                                          bool *) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t execute_subscription_cancel_command(int, uint32_t) { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t execute_subscriptions_get_command(char (*)[MATTER_SUBSCRIPTION_TEXT_SIZE], size_t, size_t *) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t websocket_set_client_topics(int, const char *) { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t websocket_get_client_stats(int, ws_client_stats_t *) { return ESP_ERR_NOT_SUPPORTED; }
+
+ws_protocol_t websocket_get_client_protocol(int) { return WS_PROTOCOL_JSON; }
+
+void websocket_get_handshake_stats(ws_handshake_stats_t *stats) { *stats = {}; }
+
+esp_err_t send_replay_message(int, uint64_t, size_t *) { return ESP_ERR_NOT_SUPPORTED; }
+
+void send_state_snapshot_message(int, ws_protocol_t) {}
@@ -0,0 +1,4 @@
+#pragma once
+
+// Every variable lives in internal RAM on the host.
+#define EXT_RAM_BSS_ATTR
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stdio.h>
+
+// Logging is compiled out of the host tests; the arguments are still checked against the format.
+#define ESP_LOG_DISCARD(tag, ...) do { (void)(tag); if (0) printf(__VA_ARGS__); } while (0)
+#define ESP_LOGE(tag, ...) ESP_LOG_DISCARD(tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) ESP_LOG_DISCARD(tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) ESP_LOG_DISCARD(tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) ESP_LOG_DISCARD(tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) ESP_LOG_DISCARD(tag, __VA_ARGS__)
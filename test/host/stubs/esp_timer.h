@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+// Defined by the test that needs it, usually as a clock the test advances.
+int64_t esp_timer_get_time(void);
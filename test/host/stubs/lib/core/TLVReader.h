@@ -0,0 +1,282 @@
+#pragma once
+
+/**
+ * Host stand-in for the TLVReader of the Matter SDK. It decodes real Matter TLV and implements the subset of
+ * the API the firmware uses, with the same semantics: Next() returns CHIP_END_OF_TLV at the end of a
+ * container, containers are skipped when not entered, and EnterContainer/ExitContainer nest.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+typedef int CHIP_ERROR;
+
+#define CHIP_NO_ERROR 0
+#define CHIP_END_OF_TLV 1
+#define CHIP_ERROR_INVALID_TLV_ELEMENT 2
+#define CHIP_ERROR_NO_MEMORY 3
+#define CHIP_ERROR_WRONG_TLV_TYPE 4
+#define CHIP_ERROR_TLV_UNDERRUN 5
+
+namespace chip {
+namespace TLV {
+
+enum TLVType {
+    kTLVType_NotSpecified = -1,
+    kTLVType_SignedInteger = 0x00,
+    kTLVType_UnsignedInteger = 0x04,
+    kTLVType_Boolean = 0x08,
+    kTLVType_FloatingPointNumber = 0x0A,
+    kTLVType_UTF8String = 0x0C,
+    kTLVType_ByteString = 0x10,
+    kTLVType_Null = 0x14,
+    kTLVType_Structure = 0x15,
+    kTLVType_Array = 0x16,
+    kTLVType_List = 0x17,
+};
+
+// Tag control of the element: 0 anonymous, 1 context, 2-7 profile tags of various forms.
+struct Tag {
+    uint8_t control;
+    // Vendor ID in the upper 16 bits, profile number in the lower ones.
+    uint32_t profile;
+    uint32_t num;
+};
+
+inline bool IsContextTag(const Tag tag) { return tag.control == 1; }
+
+inline bool IsProfileTag(const Tag tag) { return tag.control >= 2; }
+
+inline uint32_t TagNumFromTag(const Tag tag) { return tag.num; }
+
+inline uint32_t ProfileIdFromTag(const Tag tag) { return tag.profile; }
+
+class TLVReader {
+public:
+    void Init(const uint8_t *data, const size_t len) {
+        *this = TLVReader();
+        buf = data;
+        buf_len = len;
+    }
+
+    void Init(const TLVReader &other) { *this = other; }
+
+    CHIP_ERROR Next() {
+        size_t pos = elem_start;
+        if (type != kTLVType_NotSpecified) {
+            pos = elem_end;
+            if (is_container(type) && skip_members(elem_end, &pos) != CHIP_NO_ERROR) return CHIP_ERROR_TLV_UNDERRUN;
+        }
+        type = kTLVType_NotSpecified;
+        elem_start = elem_end = pos;
+
+        if (pos >= buf_len) return container == kTLVType_NotSpecified ? CHIP_END_OF_TLV : CHIP_ERROR_TLV_UNDERRUN;
+        if (buf[pos] == END_OF_CONTAINER) {
+            return container == kTLVType_NotSpecified ? CHIP_ERROR_INVALID_TLV_ELEMENT : CHIP_END_OF_TLV;
+        }
+        return parse(pos);
+    }
+
+    TLVType GetType() const { return type; }
+
+    Tag GetTag() const { return tag; }
+
+    uint32_t GetLength() const { return data_len; }
+
+    CHIP_ERROR Get(uint64_t &value) const {
+        if (type != kTLVType_UnsignedInteger) return CHIP_ERROR_WRONG_TLV_TYPE;
+        value = int_value;
+        return CHIP_NO_ERROR;
+    }
+
+    CHIP_ERROR Get(int64_t &value) const {
+        if (type != kTLVType_SignedInteger) return CHIP_ERROR_WRONG_TLV_TYPE;
+        value = static_cast<int64_t>(int_value);
+        return CHIP_NO_ERROR;
+    }
+
+    CHIP_ERROR Get(bool &value) const {
+        if (type != kTLVType_Boolean) return CHIP_ERROR_WRONG_TLV_TYPE;
+        value = int_value != 0;
+        return CHIP_NO_ERROR;
+    }
+
+    CHIP_ERROR Get(double &value) const {
+        if (type != kTLVType_FloatingPointNumber) return CHIP_ERROR_WRONG_TLV_TYPE;
+        value = float_value;
+        return CHIP_NO_ERROR;
+    }
+
+    CHIP_ERROR GetString(char *out, const size_t size) const {
+        if (type != kTLVType_UTF8String) return CHIP_ERROR_WRONG_TLV_TYPE;
+        if (data_len + 1 > size) return CHIP_ERROR_NO_MEMORY;
+        memcpy(out, data, data_len);
+        out[data_len] = '\0';
+        return CHIP_NO_ERROR;
+    }
+
+    CHIP_ERROR GetDataPtr(const uint8_t *&out) const {
+        if (type != kTLVType_UTF8String && type != kTLVType_ByteString) return CHIP_ERROR_WRONG_TLV_TYPE;
+        out = data;
+        return CHIP_NO_ERROR;
+    }
+
+    CHIP_ERROR EnterContainer(TLVType &outer) {
+        if (!is_container(type)) return CHIP_ERROR_WRONG_TLV_TYPE;
+        outer = container;
+        container = type;
+        type = kTLVType_NotSpecified;
+        elem_start = elem_end;
+        return CHIP_NO_ERROR;
+    }
+
+    CHIP_ERROR ExitContainer(const TLVType outer) {
+        // Skip the rest of the current element, then the remaining members and the end of the container
+        size_t pos = elem_start;
+        if (type != kTLVType_NotSpecified) {
+            pos = elem_end;
+            if (is_container(type) && skip_members(elem_end, &pos) != CHIP_NO_ERROR) return CHIP_ERROR_TLV_UNDERRUN;
+        }
+        size_t end;
+        if (skip_members(pos, &end) != CHIP_NO_ERROR) return CHIP_ERROR_TLV_UNDERRUN;
+
+        container = outer;
+        type = kTLVType_NotSpecified;
+        elem_start = elem_end = end;
+        return CHIP_NO_ERROR;
+    }
+
+private:
+    static constexpr uint8_t END_OF_CONTAINER = 0x18;
+
+    static bool is_container(const TLVType t) {
+        return t == kTLVType_Structure || t == kTLVType_Array || t == kTLVType_List;
+    }
+
+    uint64_t read_le(const size_t pos, const size_t len) const {
+        uint64_t value = 0;
+        for (size_t i = len; i > 0; --i) value = (value << 8) | buf[pos + i - 1];
+        return value;
+    }
+
+    /**
+     * Skips container members starting at `pos`, up to and including the end of the container.
+     */
+    CHIP_ERROR skip_members(size_t pos, size_t *end) const {
+        int depth = 1;
+        while (depth > 0) {
+            if (pos >= buf_len) return CHIP_ERROR_TLV_UNDERRUN;
+            if (buf[pos] == END_OF_CONTAINER) {
+                depth--;
+                pos++;
+                continue;
+            }
+            TLVReader member = *this;
+            if (member.parse(pos) != CHIP_NO_ERROR) return CHIP_ERROR_TLV_UNDERRUN;
+            if (is_container(member.type)) depth++;
+            pos = member.elem_end;
+        }
+        *end = pos;
+        return CHIP_NO_ERROR;
+    }
+
+    /**
+     * Decodes the control byte, tag and value of the element at `pos`. Container members are left in place.
+     */
+    CHIP_ERROR parse(size_t pos) {
+        static const size_t TAG_LENGTHS[] = {0, 1, 2, 4, 2, 4, 6, 8};
+
+        const uint8_t control = buf[pos++];
+        const uint8_t tag_control = control >> 5;
+        const uint8_t element_type = control & 0x1F;
+        if (pos + TAG_LENGTHS[tag_control] > buf_len) return CHIP_ERROR_TLV_UNDERRUN;
+
+        tag = {tag_control, 0, 0};
+        switch (tag_control) {
+            case 1: tag.num = buf[pos]; break;
+            case 2:
+            case 4: tag.num = read_le(pos, 2); break;
+            case 3:
+            case 5: tag.num = read_le(pos, 4); break;
+            case 6:
+            case 7:
+                tag.profile = (read_le(pos, 2) << 16) | read_le(pos + 2, 2);
+                tag.num = read_le(pos + 4, tag_control == 6 ? 2 : 4);
+                break;
+            default: break;
+        }
+        pos += TAG_LENGTHS[tag_control];
+
+        TLVType t;
+        size_t value_len = 0;
+        if (element_type <= 0x03) {
+            t = kTLVType_SignedInteger;
+            value_len = 1u << element_type;
+        } else if (element_type <= 0x07) {
+            t = kTLVType_UnsignedInteger;
+            value_len = 1u << (element_type - 0x04);
+        } else if (element_type <= 0x09) {
+            t = kTLVType_Boolean;
+            int_value = element_type == 0x09;
+        } else if (element_type <= 0x0B) {
+            t = kTLVType_FloatingPointNumber;
+            value_len = element_type == 0x0A ? 4 : 8;
+        } else if (element_type <= 0x0F) {
+            t = kTLVType_UTF8String;
+            value_len = 1u << (element_type - 0x0C);
+        } else if (element_type <= 0x13) {
+            t = kTLVType_ByteString;
+            value_len = 1u << (element_type - 0x10);
+        } else if (element_type <= 0x17) {
+            t = static_cast<TLVType>(element_type);
+        } else {
+            return CHIP_ERROR_INVALID_TLV_ELEMENT;
+        }
+        if (pos + value_len > buf_len) return CHIP_ERROR_TLV_UNDERRUN;
+
+        if (t == kTLVType_SignedInteger) {
+            // Sign-extend from the encoded width
+            const unsigned shift = 64 - 8 * value_len;
+            int_value = static_cast<uint64_t>(static_cast<int64_t>(read_le(pos, value_len) << shift) >> shift);
+        } else if (t == kTLVType_UnsignedInteger) {
+            int_value = read_le(pos, value_len);
+        } else if (t == kTLVType_FloatingPointNumber) {
+            if (value_len == 4) {
+                const uint32_t bits = static_cast<uint32_t>(read_le(pos, 4));
+                float value;
+                memcpy(&value, &bits, sizeof(value));
+                float_value = value;
+            } else {
+                const uint64_t bits = read_le(pos, 8);
+                memcpy(&float_value, &bits, sizeof(float_value));
+            }
+        } else if (t == kTLVType_UTF8String || t == kTLVType_ByteString) {
+            const uint64_t len = read_le(pos, value_len);
+            if (pos + value_len + len > buf_len) return CHIP_ERROR_TLV_UNDERRUN;
+            data = buf + pos + value_len;
+            data_len = static_cast<uint32_t>(len);
+            value_len += len;
+        }
+
+        type = t;
+        elem_end = pos + value_len;
+        return CHIP_NO_ERROR;
+    }
+
+    const uint8_t *buf = nullptr;
+    size_t buf_len = 0;
+    // Bounds of the current element; its members follow `elem_end` for containers.
+    size_t elem_start = 0;
+    size_t elem_end = 0;
+    TLVType type = kTLVType_NotSpecified;
+    TLVType container = kTLVType_NotSpecified;
+    Tag tag = {};
+    uint64_t int_value = 0;
+    double float_value = 0;
+    const uint8_t *data = nullptr;
+    uint32_t data_len = 0;
+};
+
+} // namespace TLV
+} // namespace chip
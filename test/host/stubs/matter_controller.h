@@ -0,0 +1,25 @@
+#pragma once
+
+#include "esp_err.h"
+
+#include <stdint.h>
+
+// The batch operation filled in by the command registry, as declared by the Matter interface component.
+typedef enum {
+    MATTER_BATCH_OP_INVOKE,
+    MATTER_BATCH_OP_READ,
+    MATTER_BATCH_OP_SUBSCRIBE,
+} matter_batch_op_type_t;
+
+typedef struct matter_batch_op {
+    matter_batch_op_type_t type;
+    uint64_t node_id;
+    uint16_t endpoint_id;
+    uint32_t cluster_id;
+    uint32_t id;
+    const char *command_data;
+    uint16_t min_interval;
+    uint16_t max_interval;
+    int subscriber;
+    esp_err_t result;
+} matter_batch_op_t;
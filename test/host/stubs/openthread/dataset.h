@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+// The members of the OpenThread operational dataset read by the command registry.
+typedef struct {
+    struct {
+        uint64_t mSeconds;
+    } mActiveTimestamp;
+    struct {
+        char m8[17];
+    } mNetworkName;
+    struct {
+        uint8_t m8[8];
+    } mExtendedPanId;
+    struct {
+        uint8_t m8[8];
+    } mMeshLocalPrefix;
+    uint16_t mPanId;
+    uint16_t mChannel;
+} otOperationalDataset;
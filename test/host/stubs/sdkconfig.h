@@ -0,0 +1,9 @@
+#pragma once
+
+// Configuration of the message encoder sources built by the host tests.
+#define CONFIG_OUTBOUND_MESSAGE_POOL_SIZE 4
+#define CONFIG_OUTBOUND_MESSAGE_BUFFER_SIZE 2048
+
+// Configuration of the state store, whose types the command registry sees through the outbound message builder.
+#define CONFIG_STATE_STORE_MAX_ATTRIBUTES 32
+#define CONFIG_STATE_STORE_MAX_VALUE_SIZE 64
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <stddef.h>
+
+void thread_free_address_list(char **addresses, size_t count);
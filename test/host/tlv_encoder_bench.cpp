@@ -0,0 +1,115 @@
+/**
+ * Compares the cost of encoding attribute values with message_add_tlv against the formatter it replaced,
+ * which printed the first scalar of a value into a fixed buffer with snprintf and sent it as a string.
+ */
+
+#include "messages/tlv_encoder.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <vector>
+
+typedef std::vector<uint8_t> tlv_t;
+
+static constexpr int ITERATIONS = 200000;
+
+/**
+ * Prints a scalar element into `out`.
+ *
+ * @return Whether the element was a scalar the formatter handles.
+ */
+static bool format_scalar(const chip::TLV::TLVReader &reader, char *out, const size_t size) {
+    switch (reader.GetType()) {
+        case chip::TLV::kTLVType_UnsignedInteger: {
+            uint64_t value;
+            if (reader.Get(value) != CHIP_NO_ERROR) return false;
+            snprintf(out, size, "%" PRIu64, value);
+            return true;
+        }
+        case chip::TLV::kTLVType_SignedInteger: {
+            int64_t value;
+            if (reader.Get(value) != CHIP_NO_ERROR) return false;
+            snprintf(out, size, "%" PRId64, value);
+            return true;
+        }
+        case chip::TLV::kTLVType_FloatingPointNumber: {
+            double value;
+            if (reader.Get(value) != CHIP_NO_ERROR) return false;
+            snprintf(out, size, "%f", value);
+            return true;
+        }
+        case chip::TLV::kTLVType_UTF8String:
+            return reader.GetString(out, size) == CHIP_NO_ERROR;
+        default:
+            return false;
+    }
+}
+
+/**
+ * The formatter replaced by message_add_tlv: the value itself if it is a scalar, else the first scalar
+ * member of the container.
+ */
+static bool format_attribute_value(chip::TLV::TLVReader &reader, char *out, const size_t size) {
+    chip::TLV::TLVType container;
+    if (reader.EnterContainer(container) != CHIP_NO_ERROR) return format_scalar(reader, out, size);
+
+    bool formatted = false;
+    while (!formatted && reader.Next() == CHIP_NO_ERROR) formatted = format_scalar(reader, out, size);
+    reader.ExitContainer(container);
+    return formatted;
+}
+
+/**
+ * Encodes a value into a message `ITERATIONS` times.
+ *
+ * @return Nanoseconds per message.
+ */
+template <typename encode_fn> static double measure(const tlv_t &tlv, size_t &message_len, encode_fn encode) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        chip::TLV::TLVReader reader;
+        reader.Init(tlv.data(), tlv.size());
+        reader.Next();
+
+        message_encoder_t enc;
+        message_encoder_init(&enc, WS_PROTOCOL_JSON);
+        encode(enc, reader);
+        const uint8_t *data;
+        if (message_encoder_finish(&enc, &data, &message_len) != ESP_OK) message_len = 0;
+        message_encoder_release(&enc);
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / ITERATIONS;
+}
+
+static void bench(const char *name, const tlv_t &tlv) {
+    size_t formatted_len = 0;
+    const double formatted_ns = measure(tlv, formatted_len, [](message_encoder_t &enc, chip::TLV::TLVReader &reader) {
+        char value[256] = {};
+        if (format_attribute_value(reader, value, sizeof(value))) message_add_string(&enc, "value", value);
+    });
+
+    size_t walked_len = 0;
+    const double walked_ns = measure(tlv, walked_len, [](message_encoder_t &enc, chip::TLV::TLVReader &reader) {
+        message_add_tlv(&enc, "value", &reader);
+    });
+
+    printf("%-24s snprintf %7.1f ns (%3zu B)   message_add_tlv %7.1f ns (%3zu B)\n", name, formatted_ns,
+           formatted_len, walked_ns, walked_len);
+}
+
+int main() {
+    bench("uint8", {0x04, 42});
+    bench("int16 (temperature)", {0x01, 0x7A, 0x08});
+    bench("double", {0x0B, 0, 0, 0, 0, 0, 0x60, 0x35, 0x40});
+    bench("string (16 chars)", {0x0C, 16, 'L', 'i', 'v', 'i', 'n', 'g', ' ', 'r', 'o', 'o', 'm', ' ', 'l', 'a',
+                                'm', 'p'});
+
+    // A list of 8 structures with two members, like the Descriptor DeviceTypeList attribute
+    tlv_t list = {0x16};
+    for (uint8_t i = 0; i < 8; ++i) list.insert(list.end(), {0x15, 0x24, 0, i, 0x24, 1, 1, 0x18});
+    list.push_back(0x18);
+    bench("list of 8 structures", list);
+    return 0;
+}
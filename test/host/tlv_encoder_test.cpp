@@ -0,0 +1,253 @@
+/**
+ * Host tests of message_add_tlv: every TLV element type, tags, nesting up to the encoder depth, malformed
+ * input, and the CBOR encoding of a structure.
+ */
+
+#include "messages/tlv_encoder.h"
+
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+typedef std::vector<uint8_t> tlv_t;
+
+static int failures = 0;
+
+static tlv_t concat(std::initializer_list<tlv_t> parts) {
+    tlv_t out;
+    for (const auto &part: parts) out.insert(out.end(), part.begin(), part.end());
+    return out;
+}
+
+static tlv_t little_endian(const uint64_t value, const size_t len) {
+    tlv_t out;
+    for (size_t i = 0; i < len; ++i) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    return out;
+}
+
+static tlv_t uint_element(const uint64_t value) {
+    const uint8_t width = value <= UINT8_MAX ? 0 : value <= UINT16_MAX ? 1 : value <= UINT32_MAX ? 2 : 3;
+    return concat({{static_cast<uint8_t>(0x04 | width)}, little_endian(value, 1u << width)});
+}
+
+static tlv_t int_element(const int64_t value, const uint8_t width) {
+    return concat({{width}, little_endian(static_cast<uint64_t>(value), 1u << width)});
+}
+
+static tlv_t float_element(const float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return concat({{0x0A}, little_endian(bits, 4)});
+}
+
+static tlv_t double_element(const double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return concat({{0x0B}, little_endian(bits, 8)});
+}
+
+static tlv_t string_element(const std::string &value, const bool bytes = false) {
+    tlv_t out = {static_cast<uint8_t>(bytes ? 0x10 : 0x0C), static_cast<uint8_t>(value.size())};
+    out.insert(out.end(), value.begin(), value.end());
+    return out;
+}
+
+/**
+ * Gives an anonymous element a context tag.
+ */
+static tlv_t tagged(const uint8_t tag, tlv_t element) {
+    element[0] |= 0x20;
+    element.insert(element.begin() + 1, tag);
+    return element;
+}
+
+static tlv_t container(const uint8_t type, std::initializer_list<tlv_t> members) {
+    tlv_t out = {type};
+    for (const auto &member: members) out.insert(out.end(), member.begin(), member.end());
+    out.push_back(0x18);
+    return out;
+}
+
+static tlv_t structure(std::initializer_list<tlv_t> members) { return container(0x15, members); }
+
+static tlv_t array(std::initializer_list<tlv_t> members) { return container(0x16, members); }
+
+/**
+ * Encodes a TLV element as the "value" member of a JSON message.
+ *
+ * @return Whether the message was encoded.
+ */
+static bool encode_json(const tlv_t &tlv, std::string &json) {
+    message_encoder_t enc;
+    message_encoder_init(&enc, WS_PROTOCOL_JSON);
+    chip::TLV::TLVReader reader;
+    reader.Init(tlv.data(), tlv.size());
+    bool ok = reader.Next() == CHIP_NO_ERROR;
+    if (ok) message_add_tlv(&enc, "value", &reader);
+
+    const uint8_t *data;
+    size_t len;
+    ok = ok && message_encoder_finish(&enc, &data, &len) == ESP_OK;
+    if (ok) json.assign(reinterpret_cast<const char *>(data), len);
+    message_encoder_release(&enc);
+    return ok;
+}
+
+static void expect_json(const char *name, const tlv_t &tlv, const std::string &value) {
+    const std::string expected = "{\"value\":" + value + "}";
+    std::string json;
+    if (!encode_json(tlv, json)) {
+        printf("FAIL %s: not encoded, expected %s\n", name, expected.c_str());
+        failures++;
+    } else if (json != expected) {
+        printf("FAIL %s: got %s, expected %s\n", name, json.c_str(), expected.c_str());
+        failures++;
+    }
+}
+
+static void expect_failure(const char *name, const tlv_t &tlv) {
+    std::string json;
+    if (encode_json(tlv, json)) {
+        printf("FAIL %s: encoded as %s, expected a failure\n", name, json.c_str());
+        failures++;
+    }
+}
+
+static void test_scalars() {
+    expect_json("uint8", uint_element(42), "42");
+    expect_json("uint16", uint_element(0x1234), "4660");
+    expect_json("uint32", uint_element(4000000000u), "4000000000");
+    expect_json("uint64", uint_element(1ull << 40), "1099511627776");
+    expect_json("uint64 beyond 2^53", uint_element((1ull << 53) + 1), "9007199254740993");
+    expect_json("uint64 max", uint_element(UINT64_MAX), "18446744073709551615");
+    expect_json("int8", int_element(-5, 0), "-5");
+    expect_json("int16", int_element(-300, 1), "-300");
+    expect_json("int32", int_element(-70000, 2), "-70000");
+    expect_json("int64", int_element(-(1ll << 40), 3), "-1099511627776");
+    expect_json("int64 min", int_element(INT64_MIN, 3), "-9223372036854775808");
+    expect_json("true", {0x09}, "true");
+    expect_json("false", {0x08}, "false");
+    expect_json("null", {0x14}, "null");
+    expect_json("float", float_element(1.5f), "1.5");
+    expect_json("double", double_element(21.37), "21.37");
+    expect_json("nan", double_element(NAN), "null");
+}
+
+static void test_strings() {
+    expect_json("string", string_element("Kitchen"), "\"Kitchen\"");
+    expect_json("empty string", string_element(""), "\"\"");
+    expect_json("escapes", string_element("a\"b\\c\n"), "\"a\\\"b\\\\c\\n\"");
+    expect_json("embedded null", string_element(std::string("a\0b", 3)), "\"a\\u0000b\"");
+    expect_json("bytes", string_element(std::string("\x01\xab", 2), true), "\"01AB\"");
+    expect_json("empty bytes", string_element("", true), "\"\"");
+
+    // Longer than any fixed buffer of the encoder
+    const std::string text(5000, 'x');
+    expect_json("long string", concat({{0x0D}, little_endian(text.size(), 2), tlv_t(text.begin(), text.end())}),
+                "\"" + text + "\"");
+}
+
+static void test_containers() {
+    expect_json("structure", structure({tagged(0, uint_element(1)), tagged(1, string_element("x")), tagged(254, {0x09})}),
+                "{\"0\":1,\"1\":\"x\",\"254\":true}");
+    expect_json("empty structure", structure({}), "{}");
+    expect_json("array", array({uint_element(1), uint_element(2), uint_element(3)}), "[1,2,3]");
+    expect_json("empty array", array({}), "[]");
+    expect_json("list drops tags", container(0x17, {tagged(3, uint_element(1)), uint_element(2)}), "[1,2]");
+
+    // Fully-qualified 6-byte tag: vendor 0xFFF1, profile 0x1234, tag 5
+    const tlv_t profile_tagged = {0xC4, 0xF1, 0xFF, 0x34, 0x12, 0x05, 0x00, 0x07};
+    expect_json("profile tag", structure({profile_tagged}), "{\"0xFFF11234:5\":7}");
+
+    // A list of structures holding lists, like the Descriptor or ACL attributes
+    expect_json("nested",
+                array({structure({tagged(0, uint_element(6)), tagged(1, array({uint_element(1), uint_element(2)})),
+                                  tagged(2, {0x14})}),
+                       structure({tagged(0, uint_element(8)), tagged(1, array({}))})}),
+                "[{\"0\":6,\"1\":[1,2],\"2\":null},{\"0\":8,\"1\":[]}]");
+}
+
+static void test_depth() {
+    // The root object of the message takes one level of the encoder
+    const size_t max_depth = MESSAGE_ENCODER_MAX_DEPTH - 1;
+    tlv_t nested = uint_element(1);
+    for (size_t i = 0; i < max_depth; ++i) nested = array({nested});
+    expect_json("deepest nesting", nested, std::string(max_depth, '[') + "1" + std::string(max_depth, ']'));
+    expect_failure("nesting too deep", array({nested}));
+}
+
+static void test_malformed() {
+    tlv_t truncated = array({uint_element(1), uint_element(2)});
+    truncated.pop_back();
+    expect_failure("truncated container", truncated);
+    expect_failure("invalid element type", array({{0x1F}}));
+    expect_failure("string overrunning the buffer", {0x16, 0x0C, 0x10, 'a', 0x18});
+}
+
+static void test_reader_untouched() {
+    const tlv_t tlv = array({uint_element(1)});
+    chip::TLV::TLVReader reader;
+    reader.Init(tlv.data(), tlv.size());
+    reader.Next();
+
+    message_encoder_t enc;
+    message_encoder_init(&enc, WS_PROTOCOL_JSON);
+    message_add_tlv(&enc, "value", &reader);
+    message_encoder_release(&enc);
+
+    chip::TLV::TLVType outer;
+    if (reader.GetType() != chip::TLV::kTLVType_Array || reader.EnterContainer(outer) != CHIP_NO_ERROR) {
+        printf("FAIL reader untouched: the reader moved\n");
+        failures++;
+    }
+}
+
+static void test_cbor() {
+    const tlv_t tlv = structure({tagged(0, int_element(-2, 0)),
+                                 tagged(1, array({{0x09}, {0x14}, string_element("hi"), string_element("\x01", true)})),
+                                 tagged(2, double_element(0.5)), tagged(3, uint_element(UINT64_MAX))});
+    const tlv_t expected = {0xA1, 0x61, 'v', 0xA4, 0x61, '0', 0x21, 0x61, '1', 0x84, 0xF5, 0xF6, 0x62, 'h', 'i',
+                            0x41, 0x01, 0x61, '2', 0xFB, 0x3F, 0xE0, 0, 0, 0, 0, 0, 0, 0x61, '3', 0x1B, 0xFF,
+                            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+    message_encoder_t enc;
+    message_encoder_init(&enc, WS_PROTOCOL_CBOR);
+    chip::TLV::TLVReader reader;
+    reader.Init(tlv.data(), tlv.size());
+    reader.Next();
+    message_add_tlv(&enc, "v", &reader);
+
+    const uint8_t *data;
+    size_t len;
+    if (message_encoder_finish(&enc, &data, &len) != ESP_OK) {
+        printf("FAIL cbor: not encoded\n");
+        failures++;
+    } else if (tlv_t(data, data + len) != expected) {
+        printf("FAIL cbor: got");
+        for (size_t i = 0; i < len; ++i) printf(" %02X", data[i]);
+        printf("\n");
+        failures++;
+    }
+    message_encoder_release(&enc);
+}
+
+int main() {
+    test_scalars();
+    test_strings();
+    test_containers();
+    test_depth();
+    test_malformed();
+    test_reader_untouched();
+    test_cbor();
+
+    if (failures > 0) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}